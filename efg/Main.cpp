@@ -65,6 +65,33 @@ double GetTimeInSeconds()
     return static_cast<double>(elapsedTicks) / static_cast<double>(frequency.QuadPart);
 }
 
+// Bits of a shader variant mask, in the order of variantKeywords.
+enum VariantKeyword
+{
+    VARIANT_USE_TRANSFORM = 1 << 0,
+    VARIANT_INSTANCED = 1 << 1,
+    VARIANT_DIFFUSE_MAP = 1 << 2,
+    VARIANT_SINGLE_POINT_LIGHT = 1 << 3
+};
+static const std::vector<std::string> variantKeywords = { "EFG_USE_TRANSFORM", "EFG_INSTANCED", "EFG_DIFFUSE_MAP", "EFG_SINGLE_POINT_LIGHT" };
+
+static uint32_t GetVariantMask(const ObjectConstants& constants, int diffuseMapFlag)
+{
+    uint32_t mask = 0;
+    if (constants.useTransform)
+        mask |= VARIANT_USE_TRANSFORM;
+    if (constants.isInstanced)
+        mask |= VARIANT_INSTANCED;
+    if (diffuseMapFlag > 0)
+        mask |= VARIANT_DIFFUSE_MAP;
+    return mask;
+}
+
+static uint32_t GetVariantMask(const GameObject& object)
+{
+    return GetVariantMask(object.constants, object.material.diffuseMapFlag);
+}
+
 int main()
 {
     if (GetModuleHandle(L"WinPixGpuCapturer.dll") == 0)
@@ -75,6 +102,13 @@ int main()
     EfgWindow efgWindow = efgCreateWindow(1920, 1080, L"New Window");
     EfgContext efg;
     efg.initialize(efgWindow);
+    // Packed with efgPacker <assetRoot> <assetRoot>.pak, the loose files are read when it's missing.
+    const std::wstring assetRoot = L"C:\\Users\\Ethan\\Documents\\FreesideEngineTestAssets";
+    efg.MountArchive(assetRoot + L".pak", assetRoot);
+#if defined(_DEBUG)
+    // Edit the shaders next to this file, not the copies in the output directory, while the app runs.
+    efg.EnableShaderHotReload(std::filesystem::path(__FILE__).parent_path().wstring() + L"\\");
+#endif
     Camera camera = efgCreateCamera(efg, DirectX::XMFLOAT3(0.0f, 5.0f, -5.0f), DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f));
 
     RECT windowRect = {};
@@ -101,13 +135,12 @@ int main()
     InstanceableObject sphereInstanced;
     sphereInstanced.constants.useTransform = true;
     sphereInstanced.vertexBuffer = efg.CreateVertexBuffer<Vertex>(square.vertices.data(), square.vertexCount);
-    sphereInstanced.indexBuffer = efg.CreateIndexBuffer<uint32_t>(square.indices.data(), square.indexCount);
-    sphereInstanced.constantsBuffer = efg.CreateConstantBuffer<ObjectConstants>(&sphereInstanced.constants, 1);
+    sphereInstanced.indexBuffer = efg.CreateIndexBuffer<uint32_t>(square.indices.data(), static_cast<uint32_t>(square.indices.size()));
 
     GameObject sphere;
     sphere.constants.useTransform = true;
     sphere.vertexBuffer = efg.CreateVertexBuffer<Vertex>(square.vertices.data(), square.vertexCount);
-    sphere.indexBuffer = efg.CreateIndexBuffer<uint32_t>(square.indices.data(), square.indexCount);
+    sphere.indexBuffer = efg.CreateIndexBuffer<uint32_t>(square.indices.data(), static_cast<uint32_t>(square.indices.size()));
     sphere.material.ambient = XMFLOAT4(0.2f, 0.2f, 0.2f, 0.0f);
     sphere.material.diffuse = XMFLOAT4(0.5f, 0.5f, 0.5f, 0.0f);
     sphere.material.ambient = XMFLOAT4(0.5f, 0.5f, 0.5f, 0.0f);
@@ -118,7 +151,6 @@ int main()
     sphere.transform.translation = XMFLOAT3(1.5f, 0.5f, 1.0f);
     sphere.transform.scale = XMFLOAT3(1.0f, 1.0f, 1.0f);
     sphere.transform.rotation = XMFLOAT3(0.0f, 0.0f, 0.0f);
-    sphere.constantsBuffer = efg.CreateConstantBuffer<ObjectConstants>(&sphere.constants, 1);
     sphere.transformBuffer = efg.CreateConstantBuffer<XMMATRIX>(&sphere.transform.GetTransformMatrix(), 1);
 
     GameObject cube;
@@ -136,7 +168,6 @@ int main()
     cube.transform.translation = XMFLOAT3(-1.5f, 0.5f, 1.0f);
     cube.transform.scale = XMFLOAT3(1.0f, 1.0f, 1.0f);
     cube.transform.rotation = XMFLOAT3(0.0f, 0.0f, 0.0f);
-    cube.constantsBuffer = efg.CreateConstantBuffer<ObjectConstants>(&cube.constants, 1);
     cube.transformBuffer = efg.CreateConstantBuffer<XMMATRIX>(&cube.transform.GetTransformMatrix(), 1);
 
     GameObject cube2;
@@ -146,7 +177,6 @@ int main()
     cube2.transform.translation = XMFLOAT3(0.0f, 2.5f, 7.0f);
     cube2.transform.scale = XMFLOAT3(7.0f, 7.0f, 7.0f);
     cube2.transform.rotation = XMFLOAT3(0.0f, 0.0f, 0.0f);
-    cube2.constantsBuffer = efg.CreateConstantBuffer<ObjectConstants>(&cube2.constants, 1);
     cube2.transformBuffer = efg.CreateConstantBuffer<XMMATRIX>(&cube2.transform.GetTransformMatrix(), 1);
     GameObject cube3;
     cube3.constants.useTransform = true;
@@ -155,7 +185,6 @@ int main()
     cube3.transform.translation = XMFLOAT3(7.0f, 2.5f, 0.0f);
     cube3.transform.scale = XMFLOAT3(7.0f, 7.0f, 7.0f);
     cube3.transform.rotation = XMFLOAT3(0.0f, 0.0f, 0.0f);
-    cube3.constantsBuffer = efg.CreateConstantBuffer<ObjectConstants>(&cube3.constants, 1);
     cube3.transformBuffer = efg.CreateConstantBuffer<XMMATRIX>(&cube3.transform.GetTransformMatrix(), 1);
     GameObject cube4;
     cube4.constants.useTransform = true;
@@ -164,7 +193,6 @@ int main()
     cube4.transform.translation = XMFLOAT3(-7.0f, 2.5f, 0.0f);
     cube4.transform.scale = XMFLOAT3(7.0f, 7.0f, 7.0f);
     cube4.transform.rotation = XMFLOAT3(0.0f, 0.0f, 0.0f);
-    cube4.constantsBuffer = efg.CreateConstantBuffer<ObjectConstants>(&cube4.constants, 1);
     cube4.transformBuffer = efg.CreateConstantBuffer<XMMATRIX>(&cube4.transform.GetTransformMatrix(), 1);
 
     GameObject plane;
@@ -177,12 +205,11 @@ int main()
     plane.material.ambient = XMFLOAT4(0.5f, 0.5f, 0.5f, 0.0f);
     plane.material.specular = XMFLOAT4(0.2f, 0.2f, 0.2f, 0.0f);
     plane.material.shininess = 32.0f;
-    plane.material.diffuseMapFlag = false;
+    plane.material.diffuseMapFlag = true;
     EfgBuffer planeMaterialBuffer = efg.CreateConstantBuffer<EfgMaterialBuffer>(&plane.material, 1);
     plane.transform.translation = XMFLOAT3(0.0f, 0.0f, 0.0f);
     plane.transform.scale = XMFLOAT3(1.5f, 1.5f, 1.5f);
     plane.transform.rotation = XMFLOAT3(0.0f, 0.0f, 0.0f);
-    plane.constantsBuffer = efg.CreateConstantBuffer<ObjectConstants>(&plane.constants, 1);
     plane.transformBuffer = efg.CreateConstantBuffer<XMMATRIX>(&plane.transform.GetTransformMatrix(), 1);
 
     std::vector<PointLightBuffer> pointLights(1);
@@ -252,28 +279,35 @@ int main()
     //EfgTexture texture = efg.CreateTexture2DFromFile(L"earth.jpeg");
     //EfgTexture texture2 = efg.CreateTexture2DFromFile(L"grass.png");
     //EfgTexture textureBox = efg.CreateTexture2DFromFile(L"box.jpg");
+    // Cooked with efgTextureCooker grass.png grass.dds. Only the coarse mips load here, the
+    // finer ones stream in as the camera gets close to the plane.
+    EfgTexture planeTexture = efg.CreateMipStreamedTexture2D((assetRoot + L"\\grass.dds").c_str());
 
     EfgSampler sampler = efg.CreateTextureSampler();
     EfgSampler depthSampler = efg.CreateDepthSampler();
     EfgSampler depthCubeSampler = efg.CreateDepthCubeSampler();
 
     //EfgImportMesh mesh = efg.LoadFromObj("C:\\Users\\Ethan\\Documents\\sibenik", "C:\\Users\\Ethan\\Documents\\sibenik\\sibenik.obj");
-    //EfgImportMesh mesh = efg.LoadFromObj(nullptr, "C:\\Users\\Ethan\\Documents\\FreesideEngineTestAssets\\donut\\donut.obj");
+    //EfgImportMesh mesh = efg.LoadFromObj(nullptr, (std::filesystem::path(assetRoot) / "donut/donut.obj").string().c_str());
+    // Converted with efgObjToGlb, draw each batch with DrawIndexedInstanced(instances.indexCount, instances.instanceCount)
+    // and its instanceBuffer bound as "instances".
+    //EfgImportMesh mesh = efg.LoadFromGlb((std::filesystem::path(assetRoot) / "donut/donut.glb").string().c_str());
 
     // Create a Skybox
     Shape skybox = Shapes::getShape(Shapes::SKYBOX);
     EfgBuffer skyboxVertexBuffer = efg.CreateVertexBuffer<Vertex>(skybox.vertices.data(), skybox.vertexCount);
     EfgBuffer skyboxIndexBuffer = efg.CreateIndexBuffer<uint32_t>(skybox.indices.data(), skybox.indexCount);
-    std::wstring rightFace = L"C:\\Users\\Ethan\\Documents\\FreesideEngineTestAssets\\skybox\\right.png";
-    std::wstring leftFace = L"C:\\Users\\Ethan\\Documents\\FreesideEngineTestAssets\\skybox\\left.png";
-    std::wstring topFace = L"C:\\Users\\Ethan\\Documents\\FreesideEngineTestAssets\\skybox\\top.png";
-    std::wstring bottomFace = L"C:\\Users\\Ethan\\Documents\\FreesideEngineTestAssets\\skybox\\bottom.png";
-    std::wstring frontFace = L"C:\\Users\\Ethan\\Documents\\FreesideEngineTestAssets\\skybox\\front.png";
-    std::wstring backFace = L"C:\\Users\\Ethan\\Documents\\FreesideEngineTestAssets\\skybox\\back.png";
+    std::wstring rightFace = assetRoot + L"\\skybox\\right.png";
+    std::wstring leftFace = assetRoot + L"\\skybox\\left.png";
+    std::wstring topFace = assetRoot + L"\\skybox\\top.png";
+    std::wstring bottomFace = assetRoot + L"\\skybox\\bottom.png";
+    std::wstring frontFace = assetRoot + L"\\skybox\\front.png";
+    std::wstring backFace = assetRoot + L"\\skybox\\back.png";
     std::vector<std::wstring> skyboxTextures = {
         rightFace, leftFace, topFace, bottomFace, frontFace, backFace
     };
-    EfgTexture skyBox = efg.CreateTextureCube(skyboxTextures);
+    // Decoded on a streaming worker while the scene starts, the sky is grey until then.
+    EfgTexture skyBox = efg.StreamTextureCube(skyboxTextures).texture;
     XMFLOAT4X4 skybox_view = camera.view;
     skybox_view._41 = 0.0f;
     skybox_view._42 = 0.0f;
@@ -285,95 +319,49 @@ int main()
     // Must commit all resources before creating root signatures. This will pack all resources in the heap by type.
     efg.CommitShaderResources();
 
-    // Skybox Root Signature
-    EfgDescriptorRange skybox_range_CBV = EfgDescriptorRange(efgRange_CBV, 0);
-    skybox_range_CBV.insert(skybox_viewBuffer);
-    skybox_range_CBV.insert(skybox_projBuffer);
-    EfgDescriptorRange skybox_range_cube = EfgDescriptorRange(efgRange_SRV, 0);
-    skybox_range_cube.insert(skyBox);
-    EfgDescriptorRange skybox_rangeSampler = EfgDescriptorRange(efgRange_SAMPLER, 0);
-    skybox_rangeSampler.insert(sampler);
-    EfgRootParameter skybox_rootParameter_1(efgRootParamter_DESCRIPTOR_TABLE);
-    EfgRootParameter skybox_rootParameter_2(efgRootParamter_DESCRIPTOR_TABLE);
-    EfgRootParameter skybox_rootParameter_3(efgRootParamter_DESCRIPTOR_TABLE);
-    skybox_rootParameter_1.insert(skybox_range_CBV);
-    skybox_rootParameter_2.insert(skybox_range_cube);
-    skybox_rootParameter_3.insert(skybox_rangeSampler);
+    // Shaders compile in parallel on the worker pool, each PSO is created as soon as its
+    // shaders are done. Root signatures are generated from shader reflection. Hints put the
+    // per-draw and per-material bindings first, everything else is per-frame. Object features
+    // pick a shader variant instead of being branched on in the shaders.
+    std::shared_future<EfgShader> skybox_vertexShader = efg.CreateShaderAsync(L"skybox.hlsl", "vs_5_0", "VSMain");
+    std::shared_future<EfgShader> skybox_pixelShader = efg.CreateShaderAsync(L"skybox.hlsl", "ps_5_0", "PSMain");
+
     EfgRootSignature skybox_rootSignature;
-    skybox_rootSignature.insert(skybox_rootParameter_1);
-    skybox_rootSignature.insert(skybox_rootParameter_2);
-    skybox_rootSignature.insert(skybox_rootParameter_3);
-    efg.CreateRootSignature(skybox_rootSignature);
-    EfgProgram skyBox_program;
-    skyBox_program.vertexShader = efg.CreateShader(L"skybox.hlsl", "vs_5_0", "VSMain");
-    skyBox_program.pixelShader = efg.CreateShader(L"skybox.hlsl", "ps_5_0", "PSMain");
-    EfgPSO skyboxPso = efg.CreateGraphicsPipelineState(skyBox_program, skybox_rootSignature);
-
-    EfgDescriptorRange range = EfgDescriptorRange(efgRange_CBV, 0);
-    range.insert(viewProjBuffer);
-    range.insert(viewPosBuffer);
-    range.insert(lightDataBuffer);
-    range.insert(dirLightViewProj);
-    EfgDescriptorRange rangeSrv = EfgDescriptorRange(efgRange_SRV, 0);
-    rangeSrv.insert(pointLightBuffer);
-    rangeSrv.insert(transformMatrixBuffer);
-    EfgDescriptorRange rangeTex = EfgDescriptorRange(efgRange_SRV, 2, 1);
-    EfgDescriptorRange rangeShadowMap = EfgDescriptorRange(efgRange_SRV, 3, 1);
-    EfgDescriptorRange rangeShadowCubeMap = EfgDescriptorRange(efgRange_SRV, 4, 1);
-    EfgDescriptorRange rangeSampler = EfgDescriptorRange(efgRange_SAMPLER, 0);
-    rangeSampler.insert(sampler);
-    rangeSampler.insert(depthSampler);
-    rangeSampler.insert(depthCubeSampler);
-    EfgRootParameter rootParameter0(efgRootParamter_DESCRIPTOR_TABLE);
-    rootParameter0.insert(range);
-    EfgRootParameter rootParameter1(efgRootParameter_CBV); // Transform
-    EfgRootParameter rootParameter2(efgRootParameter_CBV); // Object constants
-    EfgRootParameter rootParameter3(efgRootParameter_CBV); // Material
-    EfgRootParameter dirLightRootParameter(efgRootParameter_CBV); //Dir Light
-    EfgRootParameter rootParameter4(efgRootParamter_DESCRIPTOR_TABLE);
-    rootParameter4.insert(rangeSrv);
-    EfgRootParameter rootParameter5(efgRootParamter_DESCRIPTOR_TABLE); // Texture
-    rootParameter5.insert(rangeTex);
-    EfgRootParameter rootParameter6(efgRootParamter_DESCRIPTOR_TABLE);
-    rootParameter6.insert(rangeSampler);
-    EfgRootParameter rootParameter7(efgRootParamter_DESCRIPTOR_TABLE);
-    rootParameter7.insert(rangeShadowMap);
-    EfgRootParameter rootParameter8(efgRootParamter_DESCRIPTOR_TABLE);
-    rootParameter8.insert(rangeShadowCubeMap);
+    skybox_rootSignature.SetStaticSampler("textureSampler", sampler);
+    EfgPSO skyboxPso = efg.CreateGraphicsPipelineStateAsync(skybox_vertexShader, skybox_pixelShader, skybox_rootSignature, efgPSO_SKIP);
+
     EfgRootSignature rootSignature;
-    rootSignature.insert(rootParameter0);
-    rootSignature.insert(rootParameter1);
-    rootSignature.insert(rootParameter2);
-    rootSignature.insert(rootParameter3);
-    rootSignature.insert(dirLightRootParameter);
-    rootSignature.insert(rootParameter4);
-    rootSignature.insert(rootParameter5);
-    rootSignature.insert(rootParameter6);
-    rootSignature.insert(rootParameter7);
-    rootSignature.insert(rootParameter8);
-    efg.CreateRootSignature(rootSignature);
-
-    EfgRootParameter shadowMap_rootParameter0(efgRootParameter_CBV);
-    EfgRootParameter shadowMap_rootParameter1(efgRootParameter_CBV);
-    EfgRootParameter shadowMap_rootParameter2(efgRootParameter_CBV);
-    EfgRootParameter shadowMap_rootParameter3(efgRootParamter_SRV);
+    rootSignature.SetUpdateFrequency("TransformBuffer", efgUpdate_PER_DRAW);
+    rootSignature.SetUpdateFrequency("MatBuffer", efgUpdate_PER_MATERIAL);
+    rootSignature.SetUpdateFrequency("diffuseMap", efgUpdate_PER_MATERIAL);
+    rootSignature.SetStaticSampler("textureSampler", sampler);
+    rootSignature.SetStaticSampler("shadowSampler", depthSampler);
+    rootSignature.SetStaticSampler("shadowCubeSampler", depthCubeSampler);
+    EfgProgramVariantsDesc programDesc;
+    programDesc.vertexShader = L"vertex.hlsl";
+    programDesc.pixelShader = L"shaders.hlsl";
+    programDesc.keywords = variantKeywords;
+    programDesc.vertexKeywords = VARIANT_USE_TRANSFORM | VARIANT_INSTANCED;
+    programDesc.pixelKeywords = VARIANT_DIFFUSE_MAP | VARIANT_SINGLE_POINT_LIGHT;
+    EfgPSOVariants pso = efg.CreatePipelineVariants(programDesc, rootSignature);
 
     EfgRootSignature shadowMap_rootSignature;
-    shadowMap_rootSignature.insert(shadowMap_rootParameter0);
-    shadowMap_rootSignature.insert(shadowMap_rootParameter1);
-    shadowMap_rootSignature.insert(shadowMap_rootParameter2);
-    shadowMap_rootSignature.insert(shadowMap_rootParameter3);
-    efg.CreateRootSignature(shadowMap_rootSignature);
-
-    EfgProgram program;
-    program.vertexShader = efg.CreateShader(L"vertex.hlsl", "vs_5_0");
-    program.pixelShader = efg.CreateShader(L"shaders.hlsl", "ps_5_0");
-    EfgPSO pso = efg.CreateGraphicsPipelineState(program, rootSignature);
-
-    EfgProgram shadowMap_program;
-    shadowMap_program.vertexShader = efg.CreateShader(L"shadowMap_vertex.hlsl", "vs_5_0");
-    EfgPSO shadowMapPSO = efg.CreateShadowMapPSO(shadowMap_program, shadowMap_rootSignature);
-
+    shadowMap_rootSignature.SetUpdateFrequency("TransformBuffer", efgUpdate_PER_DRAW);
+    EfgProgramVariantsDesc shadowMapProgramDesc;
+    shadowMapProgramDesc.vertexShader = L"shadowMap_vertex.hlsl";
+    shadowMapProgramDesc.keywords = variantKeywords;
+    shadowMapProgramDesc.vertexKeywords = VARIANT_USE_TRANSFORM | VARIANT_INSTANCED;
+    shadowMapProgramDesc.state = EfgPipelineStateDesc().ShadowMap();
+    EfgPSOVariants shadowMapPSO = efg.CreatePipelineVariants(shadowMapProgramDesc, shadowMap_rootSignature);
+
+    // The lights don't change, so neither does their keyword. Everything in the scene is
+    // transformed, start compiling those variants now instead of on the first frame.
+    uint32_t lightingVariant = (pointLights.size() == 1) ? VARIANT_SINGLE_POINT_LIGHT : 0;
+    efg.GetPipelineVariant(pso, VARIANT_USE_TRANSFORM | lightingVariant);
+    efg.GetPipelineVariant(pso, VARIANT_USE_TRANSFORM | VARIANT_DIFFUSE_MAP | lightingVariant);
+    efg.GetPipelineVariant(shadowMapPSO, VARIANT_USE_TRANSFORM);
+
+    uint32_t sphereLod = 0;
     double deltaTime = 0.0f;
     double lastFrameTime = GetTimeInSeconds();
 
@@ -400,43 +388,57 @@ int main()
         efg.UpdateConstantBuffer(skybox_viewBuffer, &skybox_view, sizeof(skybox_view));
         efg.UpdateConstantBuffer(skybox_projBuffer, &camera.proj, sizeof(camera.proj));
 
+        // The sphere's level of detail follows its projected size, distance to its surface.
+        XMVECTOR sphereOffset = XMVectorSubtract(XMLoadFloat3(&sphere.transform.translation), XMLoadFloat3(&camera.eye));
+        float sphereDistance = XMVectorGetX(XMVector3Length(sphereOffset)) - 0.5f * sphere.transform.scale.x;
+        float pixelsPerUnit = windowHeight * 0.5f * camera.proj._22 * sphere.transform.scale.x / XMMax(sphereDistance, 0.1f);
+        sphereLod = efgSelectLod(square.lods, square.lodCount, sphereLod, pixelsPerUnit);
+        const EfgMeshLod& sphereMesh = square.lods[sphereLod];
+
+        // The plane's texels are densest at its point closest to the camera, one repeat of the
+        // texture spans the whole plane.
+        float planeHalfSize = 2.5f * plane.transform.scale.x;
+        XMFLOAT3 planePoint(XMMax(-planeHalfSize, XMMin(camera.eye.x, planeHalfSize)), plane.transform.translation.y,
+            XMMax(-planeHalfSize, XMMin(camera.eye.z, planeHalfSize)));
+        float planeDistance = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&planePoint), XMLoadFloat3(&camera.eye))));
+        efg.ReportTextureUsage(planeTexture, windowHeight * 0.5f * camera.proj._22 * 2.0f * planeHalfSize / XMMax(planeDistance, 0.1f));
+
         // Shadow Maps
         {
             // Dir Light Shadow map
             {
-                efg.SetPipelineState(shadowMapPSO);
-                efg.BindRootDescriptorTable(shadowMap_rootSignature);
+                efg.SetPipelineState(shadowMapPSO, GetVariantMask(sphere));
                 efg.ClearDepthStencilView(shadowMap);
                 efg.SetRenderTarget(shadowMap);
                 efg.SetRenderTargetResolution(2048, 2048);
-                efg.BindConstantBuffer(0, dirLightViewProj);
-                efg.BindStructuredBuffer(3, transformMatrixBuffer);
+                efg.BindConstantBuffer(shadowMap_rootSignature, "ViewProjectionBuffer", dirLightViewProj);
+                efg.BindStructuredBuffer(shadowMap_rootSignature, "instances", transformMatrixBuffer);
 
                 efg.BindVertexBuffer(sphere.vertexBuffer);
                 efg.BindIndexBuffer(sphere.indexBuffer);
-                efg.BindConstantBuffer(1, sphere.transformBuffer);
-                efg.BindConstantBuffer(2, sphere.constantsBuffer);
-                efg.DrawIndexedInstanced(square.indexCount, 1);
+                efg.BindConstantBuffer(shadowMap_rootSignature, "TransformBuffer", sphere.transformBuffer);
+                efg.SetPipelineState(shadowMapPSO, GetVariantMask(sphere));
+                efg.DrawIndexedInstanced(sphereMesh.indexCount, 1, sphereMesh.firstIndex);
 
                 efg.BindVertexBuffer(cube.vertexBuffer);
                 efg.BindIndexBuffer(cube.indexBuffer);
-                efg.BindConstantBuffer(1, cube.transformBuffer);
-                efg.BindConstantBuffer(2, cube.constantsBuffer);
+                efg.BindConstantBuffer(shadowMap_rootSignature, "TransformBuffer", cube.transformBuffer);
+                efg.SetPipelineState(shadowMapPSO, GetVariantMask(cube));
                 efg.DrawIndexedInstanced(cubeShape.indexCount, 1);
 
                 efg.BindVertexBuffer(plane.vertexBuffer);
                 efg.BindIndexBuffer(plane.indexBuffer);
-                efg.BindConstantBuffer(1, plane.transformBuffer);
-                efg.BindConstantBuffer(2, plane.constantsBuffer);
+                efg.BindConstantBuffer(shadowMap_rootSignature, "TransformBuffer", plane.transformBuffer);
+                efg.SetPipelineState(shadowMapPSO, GetVariantMask(plane));
                 efg.DrawIndexedInstanced(planeShape.indexCount, 1);
 
-                //efg.BindConstantBuffer(2, sphereInstanced.constantsBuffer);
+                //efg.SetPipelineState(shadowMapPSO, GetVariantMask(sphereInstanced));
                 //efg.DrawIndexedInstanced(square.indexCount, 2000);
 
                 //for (size_t m = 0; m < mesh.materialBatches.size(); m++)
                 //{
                 //    EfgInstanceBatch instances = mesh.materialBatches[m];
-                //    efg.BindConstantBuffer(2, mesh.constantsBuffer);
+                //    efg.SetPipelineState(shadowMapPSO, GetVariantMask(mesh.constants, 0));
                 //    efg.BindVertexBuffer(instances.vertexBuffer);
                 //    efg.BindIndexBuffer(instances.indexBuffer);
                 //    efg.DrawIndexedInstanced(instances.indexCount);
@@ -450,21 +452,21 @@ int main()
                 for (int i = 0; i < 6; i++)
                 {
                     efg.SetRenderTarget(cubeShadowMap, i);
-                    efg.BindConstantBuffer(0, pl_viewProjBuffers[i]);
+                    efg.BindConstantBuffer(shadowMap_rootSignature, "ViewProjectionBuffer", pl_viewProjBuffers[i]);
 
                     efg.BindVertexBuffer(sphere.vertexBuffer);
                     efg.BindIndexBuffer(sphere.indexBuffer);
-                    efg.BindConstantBuffer(1, sphere.transformBuffer);
-                    efg.BindConstantBuffer(2, sphere.constantsBuffer);
-                    efg.DrawIndexedInstanced(square.indexCount, 1);
+                    efg.BindConstantBuffer(shadowMap_rootSignature, "TransformBuffer", sphere.transformBuffer);
+                    efg.SetPipelineState(shadowMapPSO, GetVariantMask(sphere));
+                    efg.DrawIndexedInstanced(sphereMesh.indexCount, 1, sphereMesh.firstIndex);
 
                     efg.BindVertexBuffer(cube.vertexBuffer);
                     efg.BindIndexBuffer(cube.indexBuffer);
-                    efg.BindConstantBuffer(1, cube.transformBuffer);
-                    efg.BindConstantBuffer(2, cube.constantsBuffer);
+                    efg.BindConstantBuffer(shadowMap_rootSignature, "TransformBuffer", cube.transformBuffer);
+                    efg.SetPipelineState(shadowMapPSO, GetVariantMask(cube));
                     efg.DrawIndexedInstanced(cubeShape.indexCount, 1);
 
-                    //efg.BindConstantBuffer(2, sphereInstanced.constantsBuffer);
+                    //efg.SetPipelineState(shadowMapPSO, GetVariantMask(sphereInstanced));
                     //efg.DrawIndexedInstanced(square.indexCount, 2000);
                 }
             }
@@ -472,11 +474,16 @@ int main()
 
         // Main color render pass
         {
-            efg.SetPipelineState(pso);
-            efg.BindRootDescriptorTable(rootSignature);
-            efg.BindConstantBuffer(4, dirLightBuffer);
-            efg.Bind2DTexture(8, shadowMap);
-            efg.Bind2DTexture(9, cubeShadowMap);
+            efg.SetPipelineState(pso, GetVariantMask(sphere) | lightingVariant);
+            efg.BindConstantBuffer(rootSignature, "ViewProjectionBuffer", viewProjBuffer);
+            efg.BindConstantBuffer(rootSignature, "ViewBuffer", viewPosBuffer);
+            efg.BindConstantBuffer(rootSignature, "LightConstants", lightDataBuffer);
+            efg.BindConstantBuffer(rootSignature, "DirLightViewProj", dirLightViewProj);
+            efg.BindConstantBuffer(rootSignature, "DirLight", dirLightBuffer);
+            efg.BindStructuredBuffer(rootSignature, "lights", pointLightBuffer);
+            efg.BindStructuredBuffer(rootSignature, "instances", transformMatrixBuffer);
+            efg.Bind2DTexture(rootSignature, "shadowMap", shadowMap);
+            efg.Bind2DTexture(rootSignature, "shadowCubeMap", cubeShadowMap);
 
             efg.SetRenderTarget(colorBuffer, 0, &depthBuffer);
             efg.SetRenderTargetResolution(1920, 1080);
@@ -485,56 +492,56 @@ int main()
 
             efg.BindVertexBuffer(sphere.vertexBuffer);
             efg.BindIndexBuffer(sphere.indexBuffer);
-            //efg.Bind2DTexture(6, texture);
-            efg.BindConstantBuffer(1, sphere.transformBuffer);
-            efg.BindConstantBuffer(2, sphere.constantsBuffer);
-            efg.BindConstantBuffer(3, materialBuffer);
-            efg.DrawIndexedInstanced(square.indexCount, 1);
+            //efg.Bind2DTexture(rootSignature, "diffuseMap", texture);
+            efg.BindConstantBuffer(rootSignature, "TransformBuffer", sphere.transformBuffer);
+            efg.SetPipelineState(pso, GetVariantMask(sphere) | lightingVariant);
+            efg.BindConstantBuffer(rootSignature, "MatBuffer", materialBuffer);
+            efg.DrawIndexedInstanced(sphereMesh.indexCount, 1, sphereMesh.firstIndex);
 
             efg.BindVertexBuffer(cube.vertexBuffer);
             efg.BindIndexBuffer(cube.indexBuffer);
-            //efg.Bind2DTexture(6, textureBox);
-            efg.BindConstantBuffer(1, cube.transformBuffer);
-            efg.BindConstantBuffer(2, cube.constantsBuffer);
-            efg.BindConstantBuffer(3, cubeMaterialBuffer);
+            //efg.Bind2DTexture(rootSignature, "diffuseMap", textureBox);
+            efg.BindConstantBuffer(rootSignature, "TransformBuffer", cube.transformBuffer);
+            efg.SetPipelineState(pso, GetVariantMask(cube) | lightingVariant);
+            efg.BindConstantBuffer(rootSignature, "MatBuffer", cubeMaterialBuffer);
             efg.DrawIndexedInstanced(cubeShape.indexCount, 1);
 
             efg.BindVertexBuffer(plane.vertexBuffer);
             efg.BindIndexBuffer(plane.indexBuffer);
-            //efg.Bind2DTexture(6, texture2);
-            efg.BindConstantBuffer(1, plane.transformBuffer);
-            efg.BindConstantBuffer(2, plane.constantsBuffer);
-            efg.BindConstantBuffer(3, planeMaterialBuffer);
+            efg.Bind2DTexture(rootSignature, "diffuseMap", planeTexture);
+            efg.BindConstantBuffer(rootSignature, "TransformBuffer", plane.transformBuffer);
+            efg.SetPipelineState(pso, GetVariantMask(plane) | lightingVariant);
+            efg.BindConstantBuffer(rootSignature, "MatBuffer", planeMaterialBuffer);
             efg.DrawIndexedInstanced(planeShape.indexCount, 1);
 
             efg.BindVertexBuffer(cube2.vertexBuffer);
             efg.BindIndexBuffer(cube2.indexBuffer);
-            efg.BindConstantBuffer(1, cube2.transformBuffer);
-            efg.BindConstantBuffer(2, cube2.constantsBuffer);
+            efg.BindConstantBuffer(rootSignature, "TransformBuffer", cube2.transformBuffer);
+            efg.SetPipelineState(pso, GetVariantMask(cube2) | lightingVariant);
             efg.DrawIndexedInstanced(cubeShape.indexCount, 1);
 
             efg.BindVertexBuffer(cube3.vertexBuffer);
             efg.BindIndexBuffer(cube3.indexBuffer);
-            efg.BindConstantBuffer(1, cube3.transformBuffer);
-            efg.BindConstantBuffer(2, cube3.constantsBuffer);
+            efg.BindConstantBuffer(rootSignature, "TransformBuffer", cube3.transformBuffer);
+            efg.SetPipelineState(pso, GetVariantMask(cube3) | lightingVariant);
             efg.DrawIndexedInstanced(cubeShape.indexCount, 1);
 
             efg.BindVertexBuffer(cube4.vertexBuffer);
             efg.BindIndexBuffer(cube4.indexBuffer);
-            efg.BindConstantBuffer(1, cube4.transformBuffer);
-            efg.BindConstantBuffer(2, cube4.constantsBuffer);
+            efg.BindConstantBuffer(rootSignature, "TransformBuffer", cube4.transformBuffer);
+            efg.SetPipelineState(pso, GetVariantMask(cube4) | lightingVariant);
             efg.DrawIndexedInstanced(cubeShape.indexCount, 1);
 
-            //efg.BindConstantBuffer(2, sphereInstanced.constantsBuffer);
+            //efg.SetPipelineState(pso, GetVariantMask(sphereInstanced) | lightingVariant);
             //efg.DrawIndexedInstanced(square.indexCount, 2000);
 
             //for (size_t m = 0; m < mesh.materialBatches.size(); m++)
             //{
             //    EfgInstanceBatch instances = mesh.materialBatches[m];
             //    if(mesh.textures[m].diffuse_map.handle > 0)
-            //        efg.Bind2DTexture(6, mesh.textures[m].diffuse_map);
-            //    efg.BindConstantBuffer(2, mesh.constantsBuffer);
-            //    efg.BindConstantBuffer(3, mesh.materialBuffers[m]);
+            //        efg.Bind2DTexture(rootSignature, "diffuseMap", mesh.textures[m].diffuse_map);
+            //    efg.SetPipelineState(pso, GetVariantMask(mesh.constants, mesh.textures[m].diffuse_map.handle > 0) | lightingVariant);
+            //    efg.BindConstantBuffer(rootSignature, "MatBuffer", mesh.materialBuffers[m]);
             //    efg.BindVertexBuffer(instances.vertexBuffer);
             //    efg.BindIndexBuffer(instances.indexBuffer);
             //    efg.DrawIndexedInstanced(instances.indexCount);
@@ -542,7 +549,9 @@ int main()
         }
 
         //efg.SetPipelineState(skyboxPso);
-        //efg.BindRootDescriptorTable(skybox_rootSignature);
+        //efg.BindConstantBuffer(skybox_rootSignature, "ViewBuffer", skybox_viewBuffer);
+        //efg.BindConstantBuffer(skybox_rootSignature, "ProjBuffer", skybox_projBuffer);
+        //efg.Bind2DTexture(skybox_rootSignature, "cubeMap", skyBox);
         //efg.BindVertexBuffer(skyboxVertexBuffer);
         //efg.BindIndexBuffer(skyboxIndexBuffer);
         //efg.DrawIndexedInstanced(skybox.indexCount);
@@ -1,4 +1,6 @@
 #include "Shapes.h"
+#include "efg_meshOptimizer.h"
+#include "efg_meshSimplifier.h"
 #include <DirectXMath.h>
 
 using namespace DirectX;
@@ -518,6 +520,8 @@ Shape Shapes::getShape(Types type)
         break;
     case GRID:
         shape = grid();
+        efgOptimizeMesh(shape.vertices, shape.indices);
+        shape.vertexCount = static_cast<int>(shape.vertices.size());
         break;
     case CUBE:
         shape = cube();
@@ -527,6 +531,9 @@ Shape Shapes::getShape(Types type)
         break;
     case SPHERE:
         shape = sphere();
+        efgOptimizeMesh(shape.vertices, shape.indices);
+        shape.vertexCount = static_cast<int>(shape.vertices.size());
+        shape.lodCount = efgBuildLods(shape.lods, EfgMaxLods, shape.indices, shape.vertices.data(), shape.vertices.size());
         break;
     case TRIANGLE:
         shape = triangle();
@@ -535,6 +542,8 @@ Shape Shapes::getShape(Types type)
         shape = pyramid();
         break;
     }
+    if (shape.lodCount == 1)
+        shape.lods[0].indexCount = static_cast<uint32_t>(shape.indexCount);
 
     return shape;
 }
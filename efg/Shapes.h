@@ -5,6 +5,8 @@
 #include <vector>
 #include <DirectXMath.h>
 
+#include "efg_meshSimplifier.h"
+
 struct Vertex
 {
     DirectX::XMFLOAT3 position  = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
@@ -18,6 +20,9 @@ struct Shape
     int                     indexCount      = 0;
     std::vector<Vertex>  vertices        = {};
     std::vector<uint32_t>   indices         = {};
+    // Ranges of indices, indexCount is the first. Only SPHERE has coarser levels.
+    uint32_t                lodCount        = 1;
+    EfgMeshLod              lods[EfgMaxLods] = {};
 };
 
 namespace Shapes
@@ -1,9 +1,19 @@
 #include "efg.h"
 #include "efg_exception.h"
+#include "efg_gltf.h"
+#include "efg_hash.h"
+#include "efg_imageDecoder.h"
+#include "efg_meshOptimizer.h"
+#include "efg_objParser.h"
+#include "efg_vertexWelder.h"
 #include <iostream>
-
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "../../tinyobjloader/tiny_obj_loader.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <objbase.h>
+#include <stdexcept>
 
 XMMATRIX efgCreateTransformMatrix(XMFLOAT3 translation, XMFLOAT3 rotation, XMFLOAT3 scale)
 {
@@ -35,6 +45,15 @@ void EfgContext::initialize(HWND window)
 
     LoadPipeline();
     LoadAssets();
+
+    // Leave a core for the main thread.
+    uint32_t coreCount = std::thread::hardware_concurrency();
+    // WIC needs COM on every thread that decodes.
+    auto startCom = []() { CoInitializeEx(nullptr, COINIT_MULTITHREADED); };
+    auto stopCom = []() { CoUninitialize(); };
+    m_threadPool.Initialize((coreCount > 1) ? coreCount - 1 : 1, startCom, stopCom);
+    // Two streaming workers keep the disk busy, mesh processing still fans out to the pool.
+    m_assetStreamer.Initialize(2, startCom, stopCom);
 }
 
 std::wstring EfgContext::GetAssetFullPath(LPCWSTR assetName)
@@ -42,6 +61,11 @@ std::wstring EfgContext::GetAssetFullPath(LPCWSTR assetName)
     return m_assetsPath + assetName;
 }
 
+std::wstring EfgContext::GetShaderPath(LPCWSTR fileName)
+{
+    return m_shaderDirectory.empty() ? GetAssetFullPath(fileName) : m_shaderDirectory + fileName;
+}
+
 _Use_decl_annotations_
 void EfgContext::GetHardwareAdapter(
     IDXGIFactory1* pFactory,
@@ -160,6 +184,20 @@ void EfgContext::LoadPipeline()
 
     EFG_D3D_TRY(m_device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&m_commandQueue)));
 
+    // Root signature 1.1 lets the driver assume static descriptors/data. Fall back to 1.0 on older runtimes.
+    D3D12_FEATURE_DATA_ROOT_SIGNATURE rootSignatureFeature = {};
+    rootSignatureFeature.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_1;
+    if (FAILED(m_device->CheckFeatureSupport(D3D12_FEATURE_ROOT_SIGNATURE, &rootSignatureFeature, sizeof(rootSignatureFeature))))
+        rootSignatureFeature.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
+    m_rootSignatureVersion = rootSignatureFeature.HighestVersion;
+
+    ComPtr<IDXGIAdapter1> adapter;
+    EFG_D3D_TRY(factory->EnumAdapterByLuid(m_device->GetAdapterLuid(), IID_PPV_ARGS(&adapter)));
+    m_pipelineCache.Initialize(m_device.Get(), adapter.Get(), GetAssetFullPath(L"pipelines.cache"));
+    m_shaderCache.Initialize(GetAssetFullPath(L"shadercache"), m_vfs);
+    // Built by efgShaderCompiler, shaders missing from it are compiled at runtime.
+    m_shaderArchive.Open(GetAssetFullPath(L"shaders.efgsa"));
+
     // Describe and create the swap chain.
     DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
     swapChainDesc.BufferCount = FrameCount;
@@ -433,6 +471,10 @@ void EfgContext::Frame()
     // list, that command list can then be reset at any time and must be before 
     // re-recording.
     EFG_D3D_TRY(m_commandList->Reset(m_commandAllocator.Get(), nullptr));
+    m_boundPSO = nullptr;
+    ApplyShaderReloads();
+    ProcessStreamedUploads();
+    UpdateMipStreaming();
 
     // Indicate that the back buffer will be used as a render target.
     m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_backBuffers[m_frameIndex].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
@@ -546,7 +588,7 @@ void EfgContext::CreateTextureView(EfgTextureInternal* texture, uint32_t heapOff
     srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
     srvDesc.Texture2D.MostDetailedMip = 0;
     srvDesc.Texture2D.MipLevels = texture->Get()->GetDesc().MipLevels;
-    srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
+    srvDesc.Texture2D.ResourceMinLODClamp = texture->minLodClamp;
     texture->heapOffset = heapOffset;
     texture->srvHandle = m_cbvSrvHeap->GetCPUDescriptorHandleForHeapStart();
     texture->srvHandle.Offset(heapOffset, m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV));
@@ -561,7 +603,7 @@ void EfgContext::CreateTextureCubeView(EfgTextureInternal* texture, uint32_t hea
     srvDesc.Format = texture->format;
     srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
     srvDesc.TextureCube.MostDetailedMip = 0;
-    srvDesc.TextureCube.MipLevels = 1;
+    srvDesc.TextureCube.MipLevels = texture->Get()->GetDesc().MipLevels;
     srvDesc.TextureCube.ResourceMinLODClamp = 0.0f;
     texture->heapOffset = heapOffset;
     texture->srvHandle = m_cbvSrvHeap->GetCPUDescriptorHandleForHeapStart();
@@ -580,7 +622,7 @@ void EfgContext::CommitSampler(EfgSamplerInternal* sampler, uint32_t heapOffset)
 
 EfgResult EfgContext::CommitShaderResources()
 {
-    CreateCbvSrvDescriptorHeap(m_cbvDescriptorCount + m_srvDescriptorCount + m_textureCount +m_textureCubeCount);
+    CreateCbvSrvDescriptorHeap(m_cbvDescriptorCount + m_srvDescriptorCount + m_textureCount +m_textureCubeCount + m_reservedTextureDescriptors);
     CreateSamplerDescriptorHeap(m_samplerCount);
 
     uint32_t heapOffset = 0;
@@ -603,6 +645,9 @@ EfgResult EfgContext::CommitShaderResources()
         CreateTextureCubeView(texture, heapOffset);
         heapOffset++;
     }
+    m_nextReservedDescriptor = heapOffset;
+    m_reservedDescriptorEnd = heapOffset + m_reservedTextureDescriptors;
+    m_shaderResourcesCommitted = true;
 
     heapOffset = 0;
     for (EfgSamplerInternal* sampler : m_samplers) {
@@ -614,20 +659,34 @@ EfgResult EfgContext::CommitShaderResources()
 
 void EfgContext::DrawInstanced(uint32_t vertexCount)
 {
+    if (m_pipelineSkipped)
+        return;
     m_commandList->IASetVertexBuffers(0, 1, &m_boundVertexBuffer->view);
     m_commandList->DrawInstanced(vertexCount, 1, 0, 0);
 }
 
-void EfgContext::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount)
+void EfgContext::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex)
 {
+    if (m_pipelineSkipped)
+        return;
     m_commandList->IASetVertexBuffers(0, 1, &m_boundVertexBuffer->view);
     m_commandList->IASetIndexBuffer(&m_boundIndexBuffer->view);
-    m_commandList->DrawIndexedInstanced(indexCount, instanceCount, 0, 0, 0);
+    m_commandList->DrawIndexedInstanced(indexCount, instanceCount, firstIndex, 0, 0);
 }
 
 void EfgContext::Destroy()
 {
+    m_fileWatcher.Destroy();
+    // Streaming workers may still be importing on the pool.
+    m_assetStreamer.Destroy();
+    m_threadPool.Destroy();
     WaitForPreviousFrame();
+    m_streamedUploads.clear();
+    m_streamStaging.clear();
+    m_mipStreamedTextures.clear();
+    m_retiredMipHeaps.clear();
+    m_placeholderTexture.Reset();
+    m_placeholderCube.Reset();
     m_swapChain.Reset();
     m_commandAllocator.Reset();
     m_commandQueue.Reset();
@@ -693,12 +752,30 @@ void EfgContext::Destroy()
         pso->rootSignature.Reset();
         delete pso;
     }
+    for (auto variants : m_pipelineVariants)
+    {
+        delete variants;
+    }
+    m_pendingReloads.clear();
+    m_retiredPipelineStates.clear();
+    m_pipelineLookup.clear();
 
     //ComPtr<ID3D12DebugDevice> debugDevice;
     //if (SUCCEEDED(m_device.As(&debugDevice))) {
     //    debugDevice->ReportLiveDeviceObjects(D3D12_RLDO_DETAIL | D3D12_RLDO_IGNORE_INTERNAL);
     //}
 
+    m_pipelineCache.Destroy();
+    m_shaderCache.Destroy();
+    m_shaderArchive.Close();
+    EfgVfsStats vfsStats = m_vfs.GetStats();
+    if (vfsStats.archiveFiles + vfsStats.looseFiles > 0)
+    {
+        std::cout << "Asset files: " << vfsStats.archiveFiles << " from archives, " << vfsStats.looseFiles << " loose, "
+            << (vfsStats.mappedBytes + vfsStats.decompressedBytes) / 1024 << " KB (" << vfsStats.decompressedBytes / 1024 << " KB decompressed) in "
+            << vfsStats.openMs << " ms" << std::endl;
+    }
+    m_vfs.UnmountAll();
     m_device.Reset();
 
     CloseHandle(m_fenceEvent);
@@ -791,7 +868,10 @@ void EfgContext::CreateBuffer(void const* data, EfgBufferInternal& buffer, EFG_C
     case EFG_CPU_NONE:
         uploadBuffer->Unmap(0, nullptr);
         buffer.Set(CreateBufferResource(cpuAccess, buffer.size));
-        CopyBuffer(&buffer, uploadBuffer, buffer.alignmentSize, D3D12_RESOURCE_STATE_COMMON, finalState);
+        if (m_recordBufferCopies)
+            RecordBufferCopy(&buffer, uploadBuffer, buffer.alignmentSize, finalState);
+        else
+            CopyBuffer(&buffer, uploadBuffer, buffer.alignmentSize, D3D12_RESOURCE_STATE_COMMON, finalState);
         break;
     case EFG_CPU_WRITE:
         CD3DX12_RANGE writeRange(0, buffer.alignmentSize);
@@ -832,8 +912,17 @@ void EfgContext::CopyBuffer(EfgResource* dest, ComPtr<ID3D12Resource> src, UINT
     OpenCommandList();
 }
 
+// Records the copy ahead of the frame's draws, the upload buffer lives until the next Frame().
+void EfgContext::RecordBufferCopy(EfgResource* dest, ComPtr<ID3D12Resource> src, UINT size, D3D12_RESOURCE_STATES finalState)
+{
+    TransitionResourceState(dest, D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST);
+    m_commandList->CopyBufferRegion(dest->Get(), 0, src.Get(), 0, size);
+    TransitionResourceState(dest, D3D12_RESOURCE_STATE_COPY_DEST, finalState);
+    m_streamStaging.push_back(src);
+}
+
 
-EfgBuffer EfgContext::CreateVertexBuffer(void const* data, UINT size)
+EfgBuffer EfgContext::CreateVertexBuffer(void const* data, UINT size, UINT stride)
 {
     EfgBuffer buffer = { };
     EfgVertexBuffer* bufferInternal = new EfgVertexBuffer();
@@ -845,7 +934,7 @@ EfgBuffer EfgContext::CreateVertexBuffer(void const* data, UINT size)
     CreateBuffer(data, *bufferInternal, EFG_CPU_NONE, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
 
     bufferInternal->view.BufferLocation = bufferInternal->Get()->GetGPUVirtualAddress();
-    bufferInternal->view.StrideInBytes = sizeof(Vertex);
+    bufferInternal->view.StrideInBytes = stride;
     bufferInternal->view.SizeInBytes = bufferInternal->size;
 
     m_vertexBuffers.push_back(bufferInternal);
@@ -916,285 +1005,984 @@ EfgTexture EfgContext::CreateTexture2D()
     return texture;
 }
 
-EfgTexture EfgContext::CreateTexture2DFromFile(const wchar_t* filename)
+// Cooked textures skip decoding, their mips are already block compressed.
+static bool IsDdsFile(const std::wstring& filename)
 {
-    EfgTexture texture = {};
-    EfgTextureInternal* textureInternal = new EfgTextureInternal();
-    texture.handle = reinterpret_cast<uint64_t>(textureInternal);
-    ResourceUploadBatch resourceUpload(m_device.Get());
-    resourceUpload.Begin();
-    EFG_D3D_TRY(CreateWICTextureFromFile(m_device.Get(), resourceUpload, filename, textureInternal->Ptr().ReleaseAndGetAddressOf()));
-    auto uploadResourcesFinished = resourceUpload.End(m_commandQueue.Get());
-    uploadResourcesFinished.wait();
-    textureInternal->format = textureInternal->Get()->GetDesc().Format;
-    texture.index = m_textureCount;
-    textureInternal->currState = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
-    m_textures.push_back(textureInternal);
-    m_textureCount++;
-    return texture;
+    std::wstring extension = std::filesystem::path(filename).extension().wstring();
+    return _wcsicmp(extension.c_str(), L".dds") == 0;
 }
 
-EfgTexture EfgContext::CreateTextureCube(const std::vector<std::wstring>& filenames)
+static bool IsDdsData(const uint8_t* data, size_t size)
 {
-    // Ensure there are six filenames provided
-    if (filenames.size() != 6) throw std::runtime_error("Six filenames required for a texture cube");
+    return size >= 4 && memcmp(data, "DDS ", 4) == 0;
+}
 
-    EfgTexture texture = {};
-    EfgTextureInternal* textureInternal = new EfgTextureInternal();
-    texture.handle = reinterpret_cast<uint64_t>(textureInternal);
-    ComPtr<ID3D12Resource> textureResources[6];
-
-    // Describe the cube texture
-    D3D12_RESOURCE_DESC textureDesc = {};
-    textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-    textureDesc.Width = 1024; // Example width, should match your texture's dimensions
-    textureDesc.Height = 1024; // Example height, should match your texture's dimensions
-    textureDesc.DepthOrArraySize = 6;
-    textureDesc.MipLevels = 1;
-    textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-    textureDesc.SampleDesc.Count = 1;
-    textureDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
-    textureDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
-
-    // Create the cube texture resource
-    D3D12_HEAP_PROPERTIES heapProps = {};
-    heapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
+EfgTexture EfgContext::CreateTexture2DFromFile(const wchar_t* filename)
+{
+    return DecodeTextures({ { filename } }, false)[0];
+}
 
-    EFG_D3D_TRY(m_device->CreateCommittedResource(
-        &heapProps,
-        D3D12_HEAP_FLAG_NONE,
-        &textureDesc,
-        D3D12_RESOURCE_STATE_COPY_DEST,
-        nullptr,
-        IID_PPV_ARGS(&textureInternal->Ptr())
-    ));
+std::vector<EfgTexture> EfgContext::CreateTextures2DFromFiles(const std::vector<std::wstring>& filenames)
+{
+    std::vector<std::vector<std::wstring>> textures;
+    for (const std::wstring& filename : filenames)
+        textures.push_back({ filename });
+    return DecodeTextures(textures, false);
+}
 
-    ResourceUploadBatch resourceUpload(m_device.Get());
-    resourceUpload.Begin();
+EfgTexture EfgContext::CreateTextureCube(const std::vector<std::wstring>& filenames)
+{
+    return DecodeTextures({ filenames }, true)[0];
+}
 
-    for (int i = 0; i < 6; ++i) {
-        CreateWICTextureFromFileEx(
-            m_device.Get(),
-            resourceUpload,
-            filenames[i].c_str(),
-            0,
-            D3D12_RESOURCE_FLAG_NONE,
-            WIC_LOADER_FORCE_RGBA32,
-            textureResources[i].ReleaseAndGetAddressOf()
-        );
-    }
+EfgTexture EfgContext::AcquireTexture2D(const wchar_t* filename)
+{
+    return AcquireTextures2D({ filename })[0];
+}
 
-    auto uploadResourcesFinished = resourceUpload.End(m_commandQueue.Get());
-    uploadResourcesFinished.wait();
+static std::shared_future<void> GetReadyFuture()
+{
+    std::promise<void> ready;
+    ready.set_value();
+    return ready.get_future().share();
+}
 
-    ExecuteCommandList();
-    WaitForGpu();
-    OpenCommandList();
+std::vector<EfgTexture> EfgContext::AcquireTextures2D(const std::vector<std::wstring>& filenames)
+{
+    std::vector<EfgTexture> textures(filenames.size());
+    std::vector<std::vector<std::wstring>> misses;
+    std::vector<EfgTextureCache::Key> missKeys;
+    // Keys of the later files in the batch that share a miss, by path or by contents.
+    std::vector<std::vector<EfgTextureCache::Key>> missRepeats;
+    std::vector<size_t> missOf(filenames.size(), SIZE_MAX);
+    std::unordered_map<std::string, size_t> batchMisses;
+    for (size_t i = 0; i < filenames.size(); ++i)
+    {
+        EfgTextureCache::Key key;
+        EfgCachedTexture* cached = m_textureCache.Acquire({ filenames[i] }, false, m_vfs, key);
+        if (cached != nullptr)
+        {
+            textures[i] = cached->texture;
+            continue;
+        }
+        // Files missing more than once in the batch are decoded once.
+        std::string batchKey = (key.contentHash != 0) ? std::to_string(key.contentHash) : key.path;
+        auto batchMiss = batchMisses.emplace(batchKey, misses.size());
+        if (batchMiss.second)
+        {
+            misses.push_back({ filenames[i] });
+            missKeys.push_back(key);
+            missRepeats.emplace_back();
+        }
+        else
+        {
+            missRepeats[batchMiss.first->second].push_back(key);
+        }
+        missOf[i] = batchMiss.first->second;
+    }
 
-    for (int i = 0; i < 6; ++i) {
-        // Transition the resource state to COPY_SOURCE
-        CD3DX12_RESOURCE_BARRIER transitionBarrier = CD3DX12_RESOURCE_BARRIER::Transition(
-            textureResources[i].Get(),
-            D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
-            D3D12_RESOURCE_STATE_COPY_SOURCE
-        );
-        m_commandList->ResourceBarrier(1, &transitionBarrier);
+    std::vector<EfgTexture> decoded = DecodeTextures(misses, false);
+    for (size_t m = 0; m < decoded.size(); ++m)
+    {
+        EfgCachedTexture cached;
+        cached.texture = decoded[m];
+        cached.loaded = GetReadyFuture();
+        m_textureCache.Insert(missKeys[m], cached);
+        for (const EfgTextureCache::Key& repeat : missRepeats[m])
+            m_textureCache.AddRepeat(repeat, decoded[m].handle);
+    }
+    for (size_t i = 0; i < filenames.size(); ++i)
+    {
+        if (missOf[i] != SIZE_MAX)
+            textures[i] = decoded[missOf[i]];
+    }
+    return textures;
+}
 
-        D3D12_TEXTURE_COPY_LOCATION dst = {};
-        dst.pResource = textureInternal->Get();
-        dst.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
-        dst.SubresourceIndex = D3D12CalcSubresource(0, i, 0, 1, 6);
-    
-        D3D12_TEXTURE_COPY_LOCATION src = {};
-        src.pResource = textureResources[i].Get();
-        src.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
-        src.SubresourceIndex = 0;
-    
-        m_commandList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+EfgStreamedTexture EfgContext::AcquireStreamedTexture2D(const wchar_t* filename, float priority)
+{
+    EfgTextureCache::Key key;
+    EfgCachedTexture* cached = m_textureCache.Acquire({ filename }, false, m_vfs, key);
+    if (cached == nullptr)
+    {
+        EfgStreamedTexture streamed = StreamTexture2DFromFile(filename, priority);
+        EfgCachedTexture texture;
+        texture.texture = streamed.texture;
+        texture.loaded = streamed.loaded;
+        texture.request = streamed.request;
+        texture.priority = priority;
+        m_textureCache.Insert(key, texture);
+        return streamed;
     }
-    
-    CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(
-        textureInternal->Get(),
-        D3D12_RESOURCE_STATE_COPY_DEST,
-        D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE
-    );
-    m_commandList->ResourceBarrier(1, &barrier);
 
-    ExecuteCommandList();
-    WaitForGpu();
-    OpenCommandList();
+    // A more urgent user moves the shared load up the queue.
+    if (cached->request != 0 && priority < cached->priority)
+    {
+        cached->priority = priority;
+        m_assetStreamer.SetPriority(cached->request, priority);
+    }
+    EfgStreamedTexture streamed;
+    streamed.texture = cached->texture;
+    streamed.loaded = cached->loaded;
+    streamed.request = cached->request;
+    return streamed;
+}
 
-    texture.index = m_textureCount;
-    m_textureCubes.push_back(textureInternal);
-    m_textureCubeCount++;
-    return texture;
+void EfgContext::ReleaseTexture(EfgTexture texture)
+{
+    auto mipStreamed = m_mipStreamedTextures.find(texture.handle);
+    if (mipStreamed != m_mipStreamedTextures.end())
+    {
+        ReleaseMipStreamedTexture(mipStreamed->second, texture.handle);
+        m_mipStreamedTextures.erase(mipStreamed);
+        return;
+    }
+    EfgCachedTexture released;
+    if (!m_textureCache.Release(texture.handle, released))
+        return;
+    // A load that already started still swaps its texture in, only queued loads can be dropped.
+    bool loading = released.loaded.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+    if (loading && !m_assetStreamer.Cancel(released.request))
+        return;
+    // Descriptors are never freed, so the slot keeps a valid view of the placeholder.
+    SwapStreamedTexture(reinterpret_cast<EfgTextureInternal*>(texture.handle), GetPlaceholderTexture(released.cube), released.cube);
 }
 
-EfgTexture EfgContext::CreateCubeShadowMap(uint32_t width, uint32_t height)
+EfgTexture EfgContext::AddTexture(EfgTextureInternal* textureInternal, bool cube)
 {
     EfgTexture texture = {};
-    EfgTextureInternal* textureInternal = new EfgTextureInternal();
     texture.handle = reinterpret_cast<uint64_t>(textureInternal);
-
-    D3D12_RESOURCE_DESC shadowCubeDesc = {};
-    shadowCubeDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-    shadowCubeDesc.Width = width;
-    shadowCubeDesc.Height = height;
-    shadowCubeDesc.DepthOrArraySize = 6;
-    shadowCubeDesc.MipLevels = 1;
-    shadowCubeDesc.SampleDesc.Count = 1;
-    shadowCubeDesc.Format = DXGI_FORMAT_D32_FLOAT;
-    shadowCubeDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
-
-    D3D12_CLEAR_VALUE clearValue = {};
-    clearValue.Format = DXGI_FORMAT_D32_FLOAT;
-    clearValue.DepthStencil.Depth = 1.0f;
-    clearValue.DepthStencil.Stencil = 0;
-    
-    CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_DEFAULT);
-    m_device->CreateCommittedResource(
-        &heapProperties,
-        D3D12_HEAP_FLAG_NONE,
-        &shadowCubeDesc,
-        D3D12_RESOURCE_STATE_DEPTH_WRITE,
-        &clearValue,
-        IID_PPV_ARGS(&textureInternal->Ptr())
-    );
-
-    D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
-    dsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
-    dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
-    dsvDesc.Flags = D3D12_DSV_FLAG_NONE;
-
-    textureInternal->dsvHandle = dsvHeap->GetCPUDescriptorHandleForHeapStart();
-    textureInternal->dsvHandle.Offset(m_dsvDescriptorCount, m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_DSV));
-    m_dsvDescriptorCount++;
-    
-    CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle = textureInternal->dsvHandle;
-    for (int i = 0; i < 6; ++i) {
-        D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
-        dsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
-        dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2DARRAY;
-        dsvDesc.Flags = D3D12_DSV_FLAG_NONE;
-        dsvDesc.Texture2DArray.FirstArraySlice = i;
-        dsvDesc.Texture2DArray.ArraySize = 1;
-        dsvDesc.Texture2DArray.MipSlice = 0;
-    
-        m_device->CreateDepthStencilView(textureInternal->Get(), &dsvDesc, dsvHandle);
-        dsvHandle.ptr += m_dsvDescriptorSize;
+    texture.index = m_textureCount;
+    if (cube)
+    {
+        m_textureCubes.push_back(textureInternal);
+        m_textureCubeCount++;
     }
-
-    textureInternal->format = DXGI_FORMAT_R32_FLOAT;
-    textureInternal->is3D = true;
-    textureInternal->currState = D3D12_RESOURCE_STATE_DEPTH_WRITE;
-    m_textureCubes.push_back(textureInternal);
-    m_textureCubeCount++;
-
+    else
+    {
+        m_textures.push_back(textureInternal);
+        m_textureCount++;
+    }
+    CreateLateTextureView(textureInternal, cube);
     return texture;
 }
 
-EfgSampler EfgContext::CreateTextureSampler()
+uint8_t* EfgContext::ReserveTextureStaging(UINT64 size)
 {
-    EfgSampler sampler = {};
-    EfgSamplerInternal* samplerInternal = new EfgSamplerInternal();
-    sampler.handle = reinterpret_cast<uint64_t>(samplerInternal);
-    samplerInternal->desc.Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR;
-    samplerInternal->desc.AddressU = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
-    samplerInternal->desc.AddressV = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
-    samplerInternal->desc.AddressW = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
-    samplerInternal->desc.MipLODBias = 0.0f;
-    samplerInternal->desc.MaxAnisotropy = 1;
-    samplerInternal->desc.ComparisonFunc = D3D12_COMPARISON_FUNC_ALWAYS;
-    samplerInternal->desc.BorderColor[0] = 1.0f;
-    samplerInternal->desc.BorderColor[1] = 1.0f;
-    samplerInternal->desc.BorderColor[2] = 1.0f;
-    samplerInternal->desc.BorderColor[3] = 1.0f;
-    samplerInternal->desc.MinLOD = 0.0f;
-    samplerInternal->desc.MaxLOD = D3D12_FLOAT32_MAX;
-    m_samplers.push_back(samplerInternal);
-    m_samplerCount++;
-
-    return sampler;
+    // Every batch waits for its copies, so the buffer is free again by the next one and only grows.
+    if (size > m_textureStagingSize)
+    {
+        m_textureStaging = CreateBufferResource(EFG_CPU_WRITE, static_cast<UINT>(size));
+        CD3DX12_RANGE readRange(0, 0);
+        EFG_D3D_TRY(m_textureStaging->Map(0, &readRange, reinterpret_cast<void**>(&m_textureStagingData)));
+        m_textureStagingSize = size;
+    }
+    return m_textureStagingData;
 }
 
-EfgSampler EfgContext::CreateDepthCubeSampler()
+// A texture of a decode batch: one image, six cube faces or a DDS file with all of its subresources.
+struct TextureLoad
 {
-    EfgSampler sampler = {};
-    EfgSamplerInternal* samplerInternal = new EfgSamplerInternal();
-    sampler.handle = reinterpret_cast<uint64_t>(samplerInternal);
-    samplerInternal->desc.Filter = D3D12_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT;
-    samplerInternal->desc.AddressU = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
-    samplerInternal->desc.AddressV = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
-    samplerInternal->desc.AddressW = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
-    samplerInternal->desc.MipLODBias = 0.0f;
-    samplerInternal->desc.MaxAnisotropy = 1;
-    samplerInternal->desc.ComparisonFunc = D3D12_COMPARISON_FUNC_LESS_EQUAL;
-    samplerInternal->desc.BorderColor[0] = 1.0f;
-    samplerInternal->desc.BorderColor[1] = 1.0f;
-    samplerInternal->desc.BorderColor[2] = 1.0f;
-    samplerInternal->desc.BorderColor[3] = 1.0f;
-    samplerInternal->desc.MinLOD = 0.0f;
-    samplerInternal->desc.MaxLOD = D3D12_FLOAT32_MAX;
-    m_samplers.push_back(samplerInternal);
-    m_samplerCount++;
+    const std::vector<std::wstring>* files = nullptr;
+    // Set instead of files for an embedded image.
+    const EfgEmbeddedImage* embedded = nullptr;
+    bool dds = false;
+    // Read through the VFS, the decoders and the DDS subresources point into them.
+    EfgVfsFile contents[6];
+    EfgImageDecoder faces[6];
+    std::vector<D3D12_SUBRESOURCE_DATA> ddsSubresources;
+    ComPtr<ID3D12Resource> resource;
+    // Where each subresource lives in the staging buffer.
+    std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints;
+    std::vector<UINT> rowCounts;
+    std::vector<UINT64> rowSizes;
 
-    return sampler;
-}
+    const std::wstring& GetName(size_t face) const { return (embedded != nullptr) ? embedded->name : (*files)[face]; }
+};
 
-EfgSampler EfgContext::CreateDepthSampler()
+// Reads the header of one image, or creates the texture of a DDS file.
+static void OpenTextureLoad(ID3D12Device* device, TextureLoad& load, size_t face, const uint8_t* data, size_t size, bool cube)
 {
-    EfgSampler sampler = {};
-    EfgSamplerInternal* samplerInternal = new EfgSamplerInternal();
-    sampler.handle = reinterpret_cast<uint64_t>(samplerInternal);
-    samplerInternal->desc.Filter = D3D12_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT;
-    samplerInternal->desc.AddressU = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
-    samplerInternal->desc.AddressV = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
-    samplerInternal->desc.AddressW = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
-    samplerInternal->desc.ComparisonFunc = D3D12_COMPARISON_FUNC_LESS_EQUAL;
-    samplerInternal->desc.MinLOD = 0;
-    samplerInternal->desc.MaxLOD = D3D12_FLOAT32_MAX;
-    m_samplers.push_back(samplerInternal);
-    m_samplerCount++;
-
-    return sampler;
+    if (load.dds)
+    {
+        bool isCubeMap = false;
+        EFG_D3D_TRY(LoadDDSTextureFromMemory(device, data, size, load.resource.ReleaseAndGetAddressOf(), load.ddsSubresources, 0, nullptr, &isCubeMap));
+        if (isCubeMap != cube)
+            throw std::runtime_error(cube ? "DDS file is not a cube map" : "DDS cube map loaded as a 2D texture");
+    }
+    else if (!load.faces[face].Open(data, size))
+    {
+        std::wcerr << L"DecodeTextures: could not decode " << load.GetName(face) << std::endl;
+        throw std::runtime_error("Failed to open image");
+    }
 }
 
-void EfgContext::UpdateConstantBuffer(EfgBuffer& buffer, void const* data, UINT size)
+// Waits for every task before rethrowing, they all reference the loads.
+static void WaitForTasks(std::vector<std::future<void>>& tasks)
 {
-    EfgConstantBuffer* bufferInternal = reinterpret_cast<EfgConstantBuffer*>(buffer.handle);
-    void* mappedData = nullptr;
-    D3D12_RANGE readRange = { 0, 0 };
-    D3D12_RANGE writeRange = { 0, size };
-    bufferInternal->Get()->Map(0, &readRange, &mappedData);
-    if (mappedData)
-        memcpy(mappedData, data, (size_t)size);
-    bufferInternal->Get()->Unmap(0, &writeRange);
+    for (std::future<void>& task : tasks)
+        task.wait();
+    for (std::future<void>& task : tasks)
+        task.get();
+    tasks.clear();
 }
 
-void EfgContext::UpdateStructuredBuffer(EfgBuffer& buffer, void const* data, UINT size)
+std::vector<EfgTexture> EfgContext::DecodeTextures(const std::vector<std::vector<std::wstring>>& textures, bool cube,
+    const std::vector<EfgEmbeddedImage>& embedded)
 {
-    EfgStructuredBuffer* bufferInternal = reinterpret_cast<EfgStructuredBuffer*>(buffer.handle);
-    void* mappedData = nullptr;
-    D3D12_RANGE readRange = { 0, 0 };
-    D3D12_RANGE writeRange = { 0, size };
-    bufferInternal->Get()->Map(0, &readRange, &mappedData);
-    if (mappedData)
-        memcpy(mappedData, data, (size_t)size);
-    bufferInternal->Get()->Unmap(0, &writeRange);
-}
+    if (textures.empty() && embedded.empty())
+        return {};
+    if (cube && !embedded.empty())
+        throw std::runtime_error("Embedded images can't be loaded as texture cubes");
+    auto start = std::chrono::steady_clock::now();
+    std::vector<TextureLoad> loads(textures.size() + embedded.size());
+    std::vector<std::future<void>> tasks;
 
-void EfgContext::WaitForGpu()
-{
-    m_fenceValue++;
-    m_commandQueue->Signal(m_fence.Get(), m_fenceValue);
-    if (m_fence->GetCompletedValue() < m_fenceValue)
+    // Headers first, so the batch can be laid out before any pixels are decoded. DDS files
+    // need no decoding, their loader reads them whole and creates the texture.
+    for (size_t t = 0; t < textures.size(); ++t)
     {
-        HANDLE eventHandle = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
-        if (eventHandle == NULL)
-            EFG_D3D_TRY(HRESULT_FROM_WIN32(GetLastError()));
-        EFG_D3D_TRY(m_fence->SetEventOnCompletion(m_fenceValue, eventHandle));
-        WaitForSingleObject(eventHandle, INFINITE);
-        CloseHandle(eventHandle);
+        TextureLoad& load = loads[t];
+        load.files = &textures[t];
+        load.dds = textures[t].size() == 1 && IsDdsFile(textures[t][0]);
+        if (!load.dds && textures[t].size() != (cube ? 6u : 1u))
+            throw std::runtime_error(cube ? "Six filenames required for a texture cube" : "One filename required per texture");
+        for (size_t f = 0; f < textures[t].size(); ++f)
+        {
+            tasks.push_back(m_threadPool.Submit([this, &load, f, cube]() {
+                const std::wstring& file = (*load.files)[f];
+                EfgVfsFile& contents = load.contents[f];
+                if (!m_vfs.Open(file, contents))
+                {
+                    std::wcerr << L"DecodeTextures: could not open " << file << std::endl;
+                    throw std::runtime_error("Failed to open image");
+                }
+                OpenTextureLoad(m_device.Get(), load, f, contents.GetData(), contents.GetSize(), cube);
+            }));
+        }
+    }
+    for (size_t e = 0; e < embedded.size(); ++e)
+    {
+        TextureLoad& load = loads[textures.size() + e];
+        load.embedded = &embedded[e];
+        load.dds = IsDdsData(embedded[e].data, embedded[e].size);
+        tasks.push_back(m_threadPool.Submit([this, &load]() {
+            OpenTextureLoad(m_device.Get(), load, 0, load.embedded->data, load.embedded->size, false);
+        }));
+    }
+    WaitForTasks(tasks);
+
+    // Each subresource gets its place in one staging allocation for the whole batch.
+    UINT64 stagingSize = 0;
+    for (TextureLoad& load : loads)
+    {
+        if (!load.dds)
+        {
+            uint32_t faceCount = cube ? 6 : 1;
+            for (uint32_t face = 1; face < faceCount; ++face)
+            {
+                if (load.faces[face].GetWidth() != load.faces[0].GetWidth() || load.faces[face].GetHeight() != load.faces[0].GetHeight())
+                    throw std::runtime_error("Texture cube faces differ in size");
+            }
+            CD3DX12_RESOURCE_DESC textureDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, load.faces[0].GetWidth(), load.faces[0].GetHeight(),
+                static_cast<UINT16>(faceCount), 1);
+            CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_DEFAULT);
+            EFG_D3D_TRY(m_device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &textureDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
+                IID_PPV_ARGS(&load.resource)));
+        }
+        D3D12_RESOURCE_DESC desc = load.resource->GetDesc();
+        UINT subresourceCount = desc.MipLevels * desc.DepthOrArraySize;
+        load.footprints.resize(subresourceCount);
+        load.rowCounts.resize(subresourceCount);
+        load.rowSizes.resize(subresourceCount);
+        UINT64 size = 0;
+        m_device->GetCopyableFootprints(&desc, 0, subresourceCount, stagingSize, load.footprints.data(), load.rowCounts.data(), load.rowSizes.data(), &size);
+        stagingSize = (stagingSize + size + D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1) & ~UINT64(D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1);
+    }
+    uint8_t* staging = ReserveTextureStaging(stagingSize);
+
+    // Images decode straight into the staging buffer, DDS subresources are copied row by row.
+    for (TextureLoad& load : loads)
+    {
+        for (size_t s = 0; s < load.footprints.size(); ++s)
+        {
+            tasks.push_back(m_threadPool.Submit([&load, s, staging]() {
+                const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint = load.footprints[s];
+                uint8_t* destination = staging + footprint.Offset;
+                if (!load.dds)
+                {
+                    if (!load.faces[s].Decode(destination, footprint.Footprint.RowPitch))
+                    {
+                        std::wcerr << L"DecodeTextures: could not decode " << load.GetName(s) << std::endl;
+                        throw std::runtime_error("Failed to decode image");
+                    }
+                    return;
+                }
+                const D3D12_SUBRESOURCE_DATA& source = load.ddsSubresources[s];
+                for (UINT row = 0; row < load.rowCounts[s]; ++row)
+                    memcpy(destination + row * footprint.Footprint.RowPitch, static_cast<const uint8_t*>(source.pData) + row * source.RowPitch, load.rowSizes[s]);
+            }));
+        }
+    }
+    WaitForTasks(tasks);
+
+    // One submission for every copy of the batch.
+    std::vector<CD3DX12_RESOURCE_BARRIER> barriers;
+    for (TextureLoad& load : loads)
+    {
+        for (UINT s = 0; s < load.footprints.size(); ++s)
+        {
+            CD3DX12_TEXTURE_COPY_LOCATION destination(load.resource.Get(), s);
+            CD3DX12_TEXTURE_COPY_LOCATION source(m_textureStaging.Get(), load.footprints[s]);
+            m_commandList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+        }
+        barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(load.resource.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+    }
+    m_commandList->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+    ExecuteCommandList();
+    WaitForGpu();
+    OpenCommandList();
+
+    std::vector<EfgTexture> created;
+    for (TextureLoad& load : loads)
+    {
+        EfgTextureInternal* textureInternal = new EfgTextureInternal();
+        textureInternal->Set(load.resource);
+        textureInternal->format = load.resource->GetDesc().Format;
+        textureInternal->currState = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+        created.push_back(AddTexture(textureInternal, cube));
+    }
+    if (loads.size() > 1)
+    {
+        std::chrono::duration<double, std::milli> loadMs = std::chrono::steady_clock::now() - start;
+        std::cout << "DecodeTextures: " << loads.size() << " textures, " << stagingSize / (1024 * 1024) << " MB in "
+            << loadMs.count() << " ms on " << max(m_threadPool.GetThreadCount(), 1u) << " threads" << std::endl;
+    }
+    return created;
+}
+
+// A streamed image decoded by a worker. The subresources point into decoded, one
+// buffer per WIC face, or into the DDS file read through the VFS.
+struct StreamedImage
+{
+    ComPtr<ID3D12Resource> resource;
+    std::vector<std::unique_ptr<uint8_t[]>> decoded;
+    EfgVfsFile dds;
+    std::vector<D3D12_SUBRESOURCE_DATA> subresources;
+};
+
+static uint64_t GetImageSize(const StreamedImage& image)
+{
+    uint64_t size = 0;
+    for (const D3D12_SUBRESOURCE_DATA& subresource : image.subresources)
+        size += subresource.SlicePitch;
+    return size;
+}
+
+// Decodes six face images on a streaming worker into one RGBA8 cube of their size.
+static void LoadStreamedFaces(ID3D12Device* device, const EfgVfs& vfs, const std::vector<std::wstring>& filenames, StreamedImage& image)
+{
+    image.decoded.resize(6);
+    image.subresources.resize(6);
+    uint32_t width = 0;
+    uint32_t height = 0;
+    for (uint32_t face = 0; face < 6; ++face)
+    {
+        EfgVfsFile contents;
+        EfgImageDecoder decoder;
+        if (!vfs.Open(filenames[face], contents) || !decoder.Open(contents.GetData(), contents.GetSize()))
+            throw std::runtime_error("Failed to open image");
+        if (face == 0)
+        {
+            width = decoder.GetWidth();
+            height = decoder.GetHeight();
+        }
+        else if (decoder.GetWidth() != width || decoder.GetHeight() != height)
+        {
+            throw std::runtime_error("Texture cube faces differ in size");
+        }
+        uint32_t rowPitch = width * 4;
+        image.decoded[face] = std::make_unique<uint8_t[]>(size_t(rowPitch) * height);
+        if (!decoder.Decode(image.decoded[face].get(), rowPitch))
+            throw std::runtime_error("Failed to decode image");
+        image.subresources[face] = { image.decoded[face].get(), static_cast<LONG_PTR>(rowPitch), static_cast<LONG_PTR>(rowPitch) * height };
+    }
+
+    CD3DX12_RESOURCE_DESC textureDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, width, height, 6, 1);
+    CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_DEFAULT);
+    EFG_D3D_TRY(device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &textureDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
+        IID_PPV_ARGS(&image.resource)));
+}
+
+// Loads a DDS on a streaming worker. The loader creates the texture with all of its mips.
+static void LoadStreamedDds(ID3D12Device* device, const EfgVfs& vfs, const std::wstring& filename, bool cube, StreamedImage& image)
+{
+    bool isCubeMap = false;
+    if (!vfs.Open(filename, image.dds))
+        throw std::runtime_error("Failed to open DDS file");
+    EFG_D3D_TRY(LoadDDSTextureFromMemory(device, image.dds.GetData(), image.dds.GetSize(), image.resource.ReleaseAndGetAddressOf(), image.subresources,
+        0, nullptr, &isCubeMap));
+    if (isCubeMap != cube)
+        throw std::runtime_error(cube ? "DDS file is not a cube map" : "DDS cube map streamed as a 2D texture");
+}
+
+void EfgContext::CreateLateTextureView(EfgTextureInternal* texture, bool cube)
+{
+    // Until CommitShaderResources the view is created along with all the others.
+    if (!m_shaderResourcesCommitted)
+        return;
+    if (m_nextReservedDescriptor == m_reservedDescriptorEnd)
+        throw("Out of texture descriptors, reserve more with ReserveTextureDescriptors!");
+    if (cube)
+        CreateTextureCubeView(texture, m_nextReservedDescriptor++);
+    else
+        CreateTextureView(texture, m_nextReservedDescriptor++);
+}
+
+ComPtr<ID3D12Resource> EfgContext::GetPlaceholderTexture(bool cube)
+{
+    ComPtr<ID3D12Resource>& placeholder = cube ? m_placeholderCube : m_placeholderTexture;
+    if (placeholder)
+        return placeholder;
+
+    uint32_t faceCount = cube ? 6 : 1;
+    CD3DX12_RESOURCE_DESC textureDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, 1, 1, static_cast<UINT16>(faceCount), 1);
+    CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_DEFAULT);
+    EFG_D3D_TRY(m_device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &textureDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&placeholder)));
+
+    // Copied ahead of the streamed uploads, so it is filled before any draw can sample it.
+    ComPtr<ID3D12Resource> resource = placeholder;
+    std::lock_guard<std::mutex> lock(m_streamMutex);
+    m_streamedUploads.push_front({ 0, [this, resource, faceCount]() {
+        static const uint32_t grey = 0xff808080;
+        D3D12_SUBRESOURCE_DATA faces[6] = {};
+        for (uint32_t face = 0; face < faceCount; ++face)
+            faces[face] = { &grey, sizeof(grey), sizeof(grey) };
+        RecordTextureCopy(resource.Get(), faces, faceCount);
+    } });
+    return placeholder;
+}
+
+EfgTextureInternal* EfgContext::TrackStreamedTexture(EfgTexture& texture, bool cube)
+{
+    EfgTextureInternal* textureInternal = new EfgTextureInternal();
+    textureInternal->Set(GetPlaceholderTexture(cube));
+    textureInternal->format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    textureInternal->currState = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+    texture = AddTexture(textureInternal, cube);
+    return textureInternal;
+}
+
+void EfgContext::RecordTextureCopy(ID3D12Resource* resource, const D3D12_SUBRESOURCE_DATA* subresources, uint32_t subresourceCount)
+{
+    UINT64 uploadSize = GetRequiredIntermediateSize(resource, 0, subresourceCount);
+    ComPtr<ID3D12Resource> uploadBuffer = CreateBufferResource(EFG_CPU_WRITE, static_cast<UINT>(uploadSize));
+    UpdateSubresources(m_commandList.Get(), resource, uploadBuffer.Get(), 0, 0, subresourceCount, subresources);
+    CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(resource, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    m_commandList->ResourceBarrier(1, &barrier);
+    m_streamStaging.push_back(uploadBuffer);
+}
+
+void EfgContext::SwapStreamedTexture(EfgTextureInternal* texture, ComPtr<ID3D12Resource> resource, bool cube)
+{
+    texture->Set(resource);
+    texture->format = resource->GetDesc().Format;
+    texture->currState = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+    // No frame is in flight during Frame(), so the descriptor is rewritten in place.
+    if (!m_shaderResourcesCommitted)
+        return;
+    if (cube)
+        CreateTextureCubeView(texture, texture->heapOffset);
+    else
+        CreateTextureView(texture, texture->heapOffset);
+}
+
+EfgStreamedTexture EfgContext::StreamTexture2DFromFile(const wchar_t* filename, float priority)
+{
+    EfgStreamedTexture streamed;
+    EfgTextureInternal* textureInternal = TrackStreamedTexture(streamed.texture, false);
+    auto loaded = std::make_shared<std::promise<void>>();
+    streamed.loaded = loaded->get_future().share();
+    std::wstring file = filename;
+    streamed.request = m_assetStreamer.Submit(priority, [this, textureInternal, loaded, file]() {
+        // The device is free threaded, the loader creates the texture here and leaves the copy to Frame().
+        auto image = std::make_shared<StreamedImage>();
+        try
+        {
+            if (IsDdsFile(file))
+            {
+                LoadStreamedDds(m_device.Get(), m_vfs, file, false, *image);
+            }
+            else
+            {
+                EfgVfsFile contents;
+                if (!m_vfs.Open(file, contents))
+                    throw std::runtime_error("Failed to open image");
+                image->decoded.resize(1);
+                image->subresources.resize(1);
+                EFG_D3D_TRY(LoadWICTextureFromMemory(m_device.Get(), contents.GetData(), contents.GetSize(), image->resource.ReleaseAndGetAddressOf(),
+                    image->decoded[0], image->subresources[0]));
+            }
+        }
+        catch (...)
+        {
+            std::wcerr << L"StreamTexture2DFromFile: could not load " << file << std::endl;
+            loaded->set_exception(std::current_exception());
+            return;
+        }
+        QueueStreamedUpload(GetImageSize(*image), [this, textureInternal, loaded, image]() {
+            RecordTextureCopy(image->resource.Get(), image->subresources.data(), static_cast<uint32_t>(image->subresources.size()));
+            SwapStreamedTexture(textureInternal, image->resource, false);
+            loaded->set_value();
+        });
+    });
+    return streamed;
+}
+
+EfgStreamedTexture EfgContext::StreamTextureCube(const std::vector<std::wstring>& filenames, float priority)
+{
+    bool dds = filenames.size() == 1 && IsDdsFile(filenames[0]);
+    if (!dds && filenames.size() != 6) throw std::runtime_error("Six filenames required for a texture cube");
+
+    EfgStreamedTexture streamed;
+    EfgTextureInternal* textureInternal = TrackStreamedTexture(streamed.texture, true);
+    auto loaded = std::make_shared<std::promise<void>>();
+    streamed.loaded = loaded->get_future().share();
+    streamed.request = m_assetStreamer.Submit(priority, [this, textureInternal, loaded, filenames, dds]() {
+        auto image = std::make_shared<StreamedImage>();
+        try
+        {
+            if (dds)
+                LoadStreamedDds(m_device.Get(), m_vfs, filenames[0], true, *image);
+            else
+                LoadStreamedFaces(m_device.Get(), m_vfs, filenames, *image);
+        }
+        catch (...)
+        {
+            std::wcerr << L"StreamTextureCube: could not load " << filenames[0] << (dds ? L"" : L" and its faces") << std::endl;
+            loaded->set_exception(std::current_exception());
+            return;
+        }
+        QueueStreamedUpload(GetImageSize(*image), [this, textureInternal, loaded, image]() {
+            RecordTextureCopy(image->resource.Get(), image->subresources.data(), static_cast<uint32_t>(image->subresources.size()));
+            SwapStreamedTexture(textureInternal, image->resource, true);
+            loaded->set_value();
+        });
+    });
+    return streamed;
+}
+
+void EfgContext::SetStreamingPriority(EfgAssetStreamer::Request request, float priority)
+{
+    m_assetStreamer.SetPriority(request, priority);
+}
+
+bool EfgContext::CancelStreaming(EfgAssetStreamer::Request request)
+{
+    return m_assetStreamer.Cancel(request);
+}
+
+void EfgContext::QueueStreamedUpload(uint64_t size, std::function<void()> upload)
+{
+    std::lock_guard<std::mutex> lock(m_streamMutex);
+    m_streamedUploads.push_back({ size, std::move(upload) });
+}
+
+void EfgContext::ProcessStreamedUploads()
+{
+    // Render() waited for the previous frame, so its copies are done.
+    m_streamStaging.clear();
+
+    uint64_t uploadedSize = 0;
+    m_recordBufferCopies = true;
+    for (;;)
+    {
+        EfgStreamedUpload upload;
+        {
+            std::lock_guard<std::mutex> lock(m_streamMutex);
+            if (m_streamedUploads.empty())
+                break;
+            // The first upload always goes through, so an asset larger than the budget isn't stuck.
+            // Placeholders have no size, they may be queued by an upload of this frame.
+            uint64_t size = m_streamedUploads.front().size;
+            if (size > 0 && uploadedSize > 0 && uploadedSize + size > m_streamUploadBudget)
+                break;
+            upload = std::move(m_streamedUploads.front());
+            m_streamedUploads.pop_front();
+        }
+        uploadedSize += upload.size;
+        upload.upload();
+    }
+    m_recordBufferCopies = false;
+}
+
+static UINT GetTileCount(const D3D12_SUBRESOURCE_TILING& tiling)
+{
+    return tiling.WidthInTiles * tiling.HeightInTiles * tiling.DepthInTiles;
+}
+
+EfgTexture EfgContext::CreateMipStreamedTexture2D(const wchar_t* filename)
+{
+    D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+    EFG_D3D_TRY(m_device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options)));
+    auto file = std::make_shared<EfgDdsFile>();
+    if (options.TiledResourcesTier == D3D12_TILED_RESOURCES_TIER_NOT_SUPPORTED || !IsDdsFile(filename) || !file->Open(m_vfs, filename)
+        || file->GetFaceCount() != 1 || file->GetMipCount() < 2)
+        return CreateTexture2DFromFile(filename);
+
+    uint32_t mipCount = file->GetMipCount();
+    CD3DX12_RESOURCE_DESC textureDesc = CD3DX12_RESOURCE_DESC::Tex2D(static_cast<DXGI_FORMAT>(file->GetFormat()), file->GetWidth(), file->GetHeight(), 1,
+        static_cast<UINT16>(mipCount), 1, 0, D3D12_RESOURCE_FLAG_NONE, D3D12_TEXTURE_LAYOUT_64KB_UNDEFINED_SWIZZLE);
+    ComPtr<ID3D12Resource> resource;
+    EFG_D3D_TRY(m_device->CreateReservedResource(&textureDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&resource)));
+
+    EfgMipStreamedTexture streamed;
+    streamed.file = file;
+    streamed.size = max(file->GetWidth(), file->GetHeight());
+    streamed.tilings.resize(mipCount);
+    streamed.mipHeaps.resize(mipCount);
+    UINT tileCount = 0;
+    UINT subresourceCount = mipCount;
+    D3D12_TILE_SHAPE tileShape = {};
+    m_device->GetResourceTiling(resource.Get(), &tileCount, &streamed.packedMips, &tileShape, &subresourceCount, 0, streamed.tilings.data());
+    const D3D12_PACKED_MIP_INFO& packed = streamed.packedMips;
+
+    // The packed tail can only be mapped as a whole, it stays resident along with the standard
+    // mips from the base mip on. Without a tail the coarsest mip is the base.
+    uint32_t baseMip = packed.NumPackedMips > 0 ? packed.NumStandardMips : mipCount - 1;
+    std::vector<uint64_t> mipSizes(mipCount, 0);
+    for (uint32_t mip = 0; mip < packed.NumStandardMips; ++mip)
+        mipSizes[mip] = uint64_t(GetTileCount(streamed.tilings[mip])) * D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES;
+    if (packed.NumPackedMips > 0)
+        mipSizes[packed.NumStandardMips] = uint64_t(packed.NumTilesForPackedMips) * D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES;
+
+    UINT baseTiles = packed.NumTilesForPackedMips;
+    for (uint32_t mip = baseMip; mip < packed.NumStandardMips; ++mip)
+        baseTiles += GetTileCount(streamed.tilings[mip]);
+    CD3DX12_HEAP_DESC heapDesc(uint64_t(baseTiles) * D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES, D3D12_HEAP_TYPE_DEFAULT, 0,
+        D3D12_HEAP_FLAG_DENY_BUFFERS | D3D12_HEAP_FLAG_DENY_RT_DS_TEXTURES);
+    EFG_D3D_TRY(m_device->CreateHeap(&heapDesc, IID_PPV_ARGS(&streamed.baseHeap)));
+    UINT heapOffset = 0;
+    for (uint32_t mip = baseMip; mip < packed.NumStandardMips; ++mip)
+    {
+        MapTiles(resource.Get(), mip, GetTileCount(streamed.tilings[mip]), streamed.baseHeap.Get(), heapOffset);
+        heapOffset += GetTileCount(streamed.tilings[mip]);
+    }
+    if (packed.NumPackedMips > 0)
+        MapTiles(resource.Get(), packed.NumStandardMips, packed.NumTilesForPackedMips, streamed.baseHeap.Get(), heapOffset);
+
+    // The base mips are copied right away through the decode batches' staging buffer.
+    uint32_t baseCount = mipCount - baseMip;
+    std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints(baseCount);
+    std::vector<UINT> rowCounts(baseCount);
+    std::vector<UINT64> rowSizes(baseCount);
+    UINT64 stagingSize = 0;
+    m_device->GetCopyableFootprints(&textureDesc, baseMip, baseCount, 0, footprints.data(), rowCounts.data(), rowSizes.data(), &stagingSize);
+    uint8_t* staging = ReserveTextureStaging(stagingSize);
+    for (uint32_t i = 0; i < baseCount; ++i)
+    {
+        const EfgDdsSurface& surface = file->GetSurface(0, baseMip + i);
+        for (UINT row = 0; row < rowCounts[i]; ++row)
+            memcpy(staging + footprints[i].Offset + row * footprints[i].Footprint.RowPitch, surface.data + row * surface.rowPitch, rowSizes[i]);
+        CD3DX12_TEXTURE_COPY_LOCATION destination(resource.Get(), baseMip + i);
+        CD3DX12_TEXTURE_COPY_LOCATION source(m_textureStaging.Get(), footprints[i]);
+        m_commandList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+    }
+    CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(resource.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    m_commandList->ResourceBarrier(1, &barrier);
+    ExecuteCommandList();
+    WaitForGpu();
+    OpenCommandList();
+
+    EfgTextureInternal* textureInternal = new EfgTextureInternal();
+    textureInternal->Set(resource);
+    textureInternal->format = textureDesc.Format;
+    textureInternal->currState = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+    textureInternal->minLodClamp = static_cast<float>(baseMip);
+    EfgTexture texture = AddTexture(textureInternal, false);
+    m_mipStreamedTextures[texture.handle] = std::move(streamed);
+    m_mipResidency.Add(texture.handle, baseMip, mipSizes);
+    return texture;
+}
+
+void EfgContext::ReportTextureUsage(EfgTexture texture, float pixelsPerUv)
+{
+    auto streamed = m_mipStreamedTextures.find(texture.handle);
+    if (streamed == m_mipStreamedTextures.end())
+        return;
+    // Mip n has size >> n texels across one repeat, the sampler wants about one per pixel.
+    float mip = std::log2(static_cast<float>(streamed->second.size) / max(pixelsPerUv, 1e-3f));
+    m_mipResidency.Report(texture.handle, mip);
+}
+
+void EfgContext::ReleaseMipStreamedTexture(EfgMipStreamedTexture& streamed, uint64_t handle)
+{
+    // Gives back the budget of its resident mips and of a load in flight, which finds the
+    // texture gone and drops its data.
+    m_mipResidency.Remove(handle);
+    // The last frame may still sample the tiles, the heaps go with the evicted ones on the next Frame().
+    m_retiredMipHeaps.push_back(std::move(streamed.baseHeap));
+    for (ComPtr<ID3D12Heap>& heap : streamed.mipHeaps)
+    {
+        if (heap)
+            m_retiredMipHeaps.push_back(std::move(heap));
+    }
+    EfgTextureInternal* texture = reinterpret_cast<EfgTextureInternal*>(handle);
+    texture->minLodClamp = 0.0f;
+    SwapStreamedTexture(texture, GetPlaceholderTexture(false), false);
+}
+
+void EfgContext::MapTiles(ID3D12Resource* resource, UINT subresource, UINT tileCount, ID3D12Heap* heap, UINT heapOffset)
+{
+    // Packed mips are mapped from their first subresource on, without a heap the tiles are unmapped.
+    D3D12_TILED_RESOURCE_COORDINATE coordinate = {};
+    coordinate.Subresource = subresource;
+    D3D12_TILE_REGION_SIZE region = {};
+    region.NumTiles = tileCount;
+    D3D12_TILE_RANGE_FLAGS rangeFlags = heap ? D3D12_TILE_RANGE_FLAG_NONE : D3D12_TILE_RANGE_FLAG_NULL;
+    m_commandQueue->UpdateTileMappings(resource, 1, &coordinate, &region, heap, 1, &rangeFlags, &heapOffset, &tileCount, D3D12_TILE_MAPPING_FLAG_NONE);
+}
+
+void EfgContext::UpdateMipStreaming()
+{
+    // The GPU is idle during Frame(), last frame's unmapping is done.
+    m_retiredMipHeaps.clear();
+    if (m_mipStreamedTextures.empty())
+        return;
+
+    std::vector<EfgMipResidency::Eviction> evictions;
+    std::vector<EfgMipResidency::Load> loads;
+    m_mipResidency.Update(m_streamUploadBudget, evictions, loads);
+    for (const EfgMipResidency::Eviction& eviction : evictions)
+    {
+        // The clamp goes up before the tiles go away, no draw of this frame reaches them.
+        EfgTextureInternal* texture = reinterpret_cast<EfgTextureInternal*>(eviction.texture);
+        EfgMipStreamedTexture& streamed = m_mipStreamedTextures[eviction.texture];
+        texture->minLodClamp = static_cast<float>(eviction.mip + 1);
+        if (m_shaderResourcesCommitted)
+            CreateTextureView(texture, texture->heapOffset);
+        MapTiles(texture->Get(), eviction.mip, GetTileCount(streamed.tilings[eviction.mip]), nullptr);
+        m_retiredMipHeaps.push_back(std::move(streamed.mipHeaps[eviction.mip]));
+    }
+    for (const EfgMipResidency::Load& load : loads)
+        LoadStreamedMip(load.texture, load.mip, -load.urgency);
+}
+
+void EfgContext::LoadStreamedMip(uint64_t handle, uint32_t mip, float priority)
+{
+    std::shared_ptr<EfgDdsFile> file = m_mipStreamedTextures[handle].file;
+    m_assetStreamer.Submit(priority, [this, handle, mip, file]() {
+        // Copying the mip out of the mapping pages it in here instead of on the main thread.
+        const EfgDdsSurface& surface = file->GetSurface(0, mip);
+        auto data = std::make_shared<std::vector<uint8_t>>(surface.data, surface.data + surface.size);
+        QueueStreamedUpload(data->size(), [this, handle, mip, data]() {
+            FinishStreamedMip(handle, mip, *data);
+        });
+    });
+}
+
+void EfgContext::FinishStreamedMip(uint64_t handle, uint32_t mip, const std::vector<uint8_t>& data)
+{
+    auto found = m_mipStreamedTextures.find(handle);
+    if (found == m_mipStreamedTextures.end())
+        return;
+    EfgTextureInternal* texture = reinterpret_cast<EfgTextureInternal*>(handle);
+    EfgMipStreamedTexture& streamed = found->second;
+    UINT tileCount = GetTileCount(streamed.tilings[mip]);
+    CD3DX12_HEAP_DESC heapDesc(uint64_t(tileCount) * D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES, D3D12_HEAP_TYPE_DEFAULT, 0,
+        D3D12_HEAP_FLAG_DENY_BUFFERS | D3D12_HEAP_FLAG_DENY_RT_DS_TEXTURES);
+    if (FAILED(m_device->CreateHeap(&heapDesc, IID_PPV_ARGS(&streamed.mipHeaps[mip]))))
+    {
+        std::cerr << "FinishStreamedMip: could not allocate " << heapDesc.SizeInBytes / 1024 << " KB for mip " << mip << std::endl;
+        m_mipResidency.CompleteLoad(handle, false);
+        return;
+    }
+    // Queued ahead of this frame's command list, so the copy lands in mapped tiles.
+    MapTiles(texture->Get(), mip, tileCount, streamed.mipHeaps[mip].Get());
+
+    const EfgDdsSurface& surface = streamed.file->GetSurface(0, mip);
+    D3D12_SUBRESOURCE_DATA subresource = { data.data(), static_cast<LONG_PTR>(surface.rowPitch), static_cast<LONG_PTR>(surface.size) };
+    UINT64 uploadSize = GetRequiredIntermediateSize(texture->Get(), mip, 1);
+    ComPtr<ID3D12Resource> uploadBuffer = CreateBufferResource(EFG_CPU_WRITE, static_cast<UINT>(uploadSize));
+    CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(texture->Get(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST, mip);
+    m_commandList->ResourceBarrier(1, &barrier);
+    UpdateSubresources(m_commandList.Get(), texture->Get(), uploadBuffer.Get(), 0, mip, 1, &subresource);
+    barrier = CD3DX12_RESOURCE_BARRIER::Transition(texture->Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, mip);
+    m_commandList->ResourceBarrier(1, &barrier);
+    m_streamStaging.push_back(uploadBuffer);
+
+    // Copied before any draw of this frame, so the clamp comes down at once.
+    m_mipResidency.CompleteLoad(handle, true);
+    texture->minLodClamp = static_cast<float>(m_mipResidency.GetResidentMip(handle));
+    if (m_shaderResourcesCommitted)
+        CreateTextureView(texture, texture->heapOffset);
+}
+
+EfgTexture EfgContext::CreateCubeShadowMap(uint32_t width, uint32_t height)
+{
+    EfgTexture texture = {};
+    EfgTextureInternal* textureInternal = new EfgTextureInternal();
+    texture.handle = reinterpret_cast<uint64_t>(textureInternal);
+
+    D3D12_RESOURCE_DESC shadowCubeDesc = {};
+    shadowCubeDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    shadowCubeDesc.Width = width;
+    shadowCubeDesc.Height = height;
+    shadowCubeDesc.DepthOrArraySize = 6;
+    shadowCubeDesc.MipLevels = 1;
+    shadowCubeDesc.SampleDesc.Count = 1;
+    shadowCubeDesc.Format = DXGI_FORMAT_D32_FLOAT;
+    shadowCubeDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
+
+    D3D12_CLEAR_VALUE clearValue = {};
+    clearValue.Format = DXGI_FORMAT_D32_FLOAT;
+    clearValue.DepthStencil.Depth = 1.0f;
+    clearValue.DepthStencil.Stencil = 0;
+    
+    CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_DEFAULT);
+    m_device->CreateCommittedResource(
+        &heapProperties,
+        D3D12_HEAP_FLAG_NONE,
+        &shadowCubeDesc,
+        D3D12_RESOURCE_STATE_DEPTH_WRITE,
+        &clearValue,
+        IID_PPV_ARGS(&textureInternal->Ptr())
+    );
+
+    D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+    dsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
+    dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
+    dsvDesc.Flags = D3D12_DSV_FLAG_NONE;
+
+    textureInternal->dsvHandle = dsvHeap->GetCPUDescriptorHandleForHeapStart();
+    textureInternal->dsvHandle.Offset(m_dsvDescriptorCount, m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_DSV));
+    m_dsvDescriptorCount++;
+    
+    CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle = textureInternal->dsvHandle;
+    for (int i = 0; i < 6; ++i) {
+        D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+        dsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
+        dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2DARRAY;
+        dsvDesc.Flags = D3D12_DSV_FLAG_NONE;
+        dsvDesc.Texture2DArray.FirstArraySlice = i;
+        dsvDesc.Texture2DArray.ArraySize = 1;
+        dsvDesc.Texture2DArray.MipSlice = 0;
+    
+        m_device->CreateDepthStencilView(textureInternal->Get(), &dsvDesc, dsvHandle);
+        dsvHandle.ptr += m_dsvDescriptorSize;
+    }
+
+    textureInternal->format = DXGI_FORMAT_R32_FLOAT;
+    textureInternal->is3D = true;
+    textureInternal->currState = D3D12_RESOURCE_STATE_DEPTH_WRITE;
+    m_textureCubes.push_back(textureInternal);
+    m_textureCubeCount++;
+
+    return texture;
+}
+
+EfgSampler EfgContext::CreateTextureSampler()
+{
+    EfgSampler sampler = {};
+    EfgSamplerInternal* samplerInternal = new EfgSamplerInternal();
+    sampler.handle = reinterpret_cast<uint64_t>(samplerInternal);
+    samplerInternal->desc.Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR;
+    samplerInternal->desc.AddressU = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+    samplerInternal->desc.AddressV = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+    samplerInternal->desc.AddressW = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+    samplerInternal->desc.MipLODBias = 0.0f;
+    samplerInternal->desc.MaxAnisotropy = 1;
+    samplerInternal->desc.ComparisonFunc = D3D12_COMPARISON_FUNC_ALWAYS;
+    samplerInternal->desc.BorderColor[0] = 1.0f;
+    samplerInternal->desc.BorderColor[1] = 1.0f;
+    samplerInternal->desc.BorderColor[2] = 1.0f;
+    samplerInternal->desc.BorderColor[3] = 1.0f;
+    samplerInternal->desc.MinLOD = 0.0f;
+    samplerInternal->desc.MaxLOD = D3D12_FLOAT32_MAX;
+    m_samplers.push_back(samplerInternal);
+    m_samplerCount++;
+
+    return sampler;
+}
+
+EfgSampler EfgContext::CreateDepthCubeSampler()
+{
+    EfgSampler sampler = {};
+    EfgSamplerInternal* samplerInternal = new EfgSamplerInternal();
+    sampler.handle = reinterpret_cast<uint64_t>(samplerInternal);
+    samplerInternal->desc.Filter = D3D12_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT;
+    samplerInternal->desc.AddressU = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+    samplerInternal->desc.AddressV = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+    samplerInternal->desc.AddressW = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+    samplerInternal->desc.MipLODBias = 0.0f;
+    samplerInternal->desc.MaxAnisotropy = 1;
+    samplerInternal->desc.ComparisonFunc = D3D12_COMPARISON_FUNC_LESS_EQUAL;
+    samplerInternal->desc.BorderColor[0] = 1.0f;
+    samplerInternal->desc.BorderColor[1] = 1.0f;
+    samplerInternal->desc.BorderColor[2] = 1.0f;
+    samplerInternal->desc.BorderColor[3] = 1.0f;
+    samplerInternal->desc.MinLOD = 0.0f;
+    samplerInternal->desc.MaxLOD = D3D12_FLOAT32_MAX;
+    m_samplers.push_back(samplerInternal);
+    m_samplerCount++;
+
+    return sampler;
+}
+
+EfgSampler EfgContext::CreateDepthSampler()
+{
+    EfgSampler sampler = {};
+    EfgSamplerInternal* samplerInternal = new EfgSamplerInternal();
+    sampler.handle = reinterpret_cast<uint64_t>(samplerInternal);
+    samplerInternal->desc.Filter = D3D12_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT;
+    samplerInternal->desc.AddressU = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+    samplerInternal->desc.AddressV = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+    samplerInternal->desc.AddressW = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+    samplerInternal->desc.ComparisonFunc = D3D12_COMPARISON_FUNC_LESS_EQUAL;
+    samplerInternal->desc.MinLOD = 0;
+    samplerInternal->desc.MaxLOD = D3D12_FLOAT32_MAX;
+    m_samplers.push_back(samplerInternal);
+    m_samplerCount++;
+
+    return sampler;
+}
+
+void EfgContext::UpdateConstantBuffer(EfgBuffer& buffer, void const* data, UINT size)
+{
+    EfgConstantBuffer* bufferInternal = reinterpret_cast<EfgConstantBuffer*>(buffer.handle);
+    void* mappedData = nullptr;
+    D3D12_RANGE readRange = { 0, 0 };
+    D3D12_RANGE writeRange = { 0, size };
+    bufferInternal->Get()->Map(0, &readRange, &mappedData);
+    if (mappedData)
+        memcpy(mappedData, data, (size_t)size);
+    bufferInternal->Get()->Unmap(0, &writeRange);
+}
+
+void EfgContext::UpdateStructuredBuffer(EfgBuffer& buffer, void const* data, UINT size)
+{
+    EfgStructuredBuffer* bufferInternal = reinterpret_cast<EfgStructuredBuffer*>(buffer.handle);
+    void* mappedData = nullptr;
+    D3D12_RANGE readRange = { 0, 0 };
+    D3D12_RANGE writeRange = { 0, size };
+    bufferInternal->Get()->Map(0, &readRange, &mappedData);
+    if (mappedData)
+        memcpy(mappedData, data, (size_t)size);
+    bufferInternal->Get()->Unmap(0, &writeRange);
+}
+
+void EfgContext::WaitForGpu()
+{
+    m_fenceValue++;
+    m_commandQueue->Signal(m_fence.Get(), m_fenceValue);
+    if (m_fence->GetCompletedValue() < m_fenceValue)
+    {
+        HANDLE eventHandle = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
+        if (eventHandle == NULL)
+            EFG_D3D_TRY(HRESULT_FROM_WIN32(GetLastError()));
+        EFG_D3D_TRY(m_fence->SetEventOnCompletion(m_fenceValue, eventHandle));
+        WaitForSingleObject(eventHandle, INFINITE);
+        CloseHandle(eventHandle);
     }
 }
 
@@ -1202,115 +1990,629 @@ void EfgContext::OpenCommandList()
 {
     EFG_D3D_TRY(m_commandAllocator->Reset());
     EFG_D3D_TRY(m_commandList->Reset(m_commandAllocator.Get(), nullptr));
+    m_boundPSO = nullptr;
 }
 
-EfgShader EfgContext::CreateShader(LPCWSTR fileName, LPCSTR target, LPCSTR entryPoint)
+// Shared by every PSO, so desc.InputLayout stays valid after creation.
+static const D3D12_INPUT_ELEMENT_DESC positionInputElementDescs[] =
+{
+    { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
+};
+
+static const D3D12_INPUT_ELEMENT_DESC inputElementDescs[] =
+{
+    { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+    //{ "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+    { "NORMAL",   0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+    { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,    0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
+};
+
+// EfgCompressedVertex, the vertex shaders dequantize them with EFG_COMPRESSED_VERTEX.
+static const D3D12_INPUT_ELEMENT_DESC halfInputElementDescs[] =
+{
+    { "POSITION", 0, DXGI_FORMAT_R16G16B16A16_FLOAT, 0, 0,  D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+    { "NORMAL",   0, DXGI_FORMAT_R16G16_SNORM,       0, 8,  D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+    { "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT,       0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
+};
+
+static const D3D12_INPUT_ELEMENT_DESC unorm16InputElementDescs[] =
+{
+    { "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0,  D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+    { "NORMAL",   0, DXGI_FORMAT_R16G16_SNORM,       0, 8,  D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+    { "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT,       0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
+};
+
+EfgShader EfgContext::CreateShader(LPCWSTR fileName, LPCSTR target, LPCSTR entryPoint, const std::vector<EfgShaderDefine>& defines)
 {
     EfgShader shader = {};
-    shader.source = GetAssetFullPath(fileName);
-    CompileShader(shader, entryPoint, target);
+    shader.source = GetShaderPath(fileName);
+    shader.entryPoint = entryPoint;
+    shader.target = target;
+    shader.defines = defines;
+    // The archive was built from the sources at build time, a shader edited since is compiled.
+    bool edited = false;
+    if (m_hotReloadEnabled)
+    {
+        std::vector<std::filesystem::path> sourceFiles = m_shaderCache.GetSourceFiles(shader.source);
+        for (const std::filesystem::path& file : sourceFiles)
+            m_fileWatcher.Watch(file);
+        std::lock_guard<std::mutex> lock(m_reloadMutex);
+        for (const std::filesystem::path& file : sourceFiles)
+            edited = edited || m_editedShaderFiles.count(file.wstring()) > 0;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    const EfgShaderArchiveEntry* archived = edited ? nullptr : m_shaderArchive.Find(std::filesystem::path(fileName).u8string(), entryPoint, target, efgShaderPermutationKey(defines));
+    if (archived != nullptr)
+    {
+        shader.byteCode = m_shaderArchive.CreateBlob(*archived);
+        m_shaderArchive.GetBindings(*archived, shader.bindings);
+        m_shaderArchive.RecordLoad(*archived, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+        return shader;
+    }
+
+    CompileShader(shader, entryPoint, target, defines);
+    efgReflectShader(shader.byteCode.Get(), shader.bindings);
     return shader;
 }
 
-EfgPSO EfgContext::CreateGraphicsPipelineState(EfgProgram program, EfgRootSignature& rootSignature)
+std::shared_future<EfgShader> EfgContext::CreateShaderAsync(LPCWSTR fileName, LPCSTR target, LPCSTR entryPoint, const std::vector<EfgShaderDefine>& defines)
+{
+    std::wstring file = fileName;
+    std::string shaderTarget = target;
+    std::string shaderEntryPoint = entryPoint;
+    return m_threadPool.Submit([this, file, shaderTarget, shaderEntryPoint, defines]() {
+        return CreateShader(file.c_str(), shaderTarget.c_str(), shaderEntryPoint.c_str(), defines);
+    }).share();
+}
+
+EfgPSO EfgContext::CreateGraphicsPipelineState(EfgProgram program, EfgRootSignature& rootSignature, const EfgPipelineStateDesc& state)
 {
-    EfgPSO pso = {};
     EfgPSOInternal* psoInternal = new EfgPSOInternal();
+    CompilePipelineState(psoInternal, program, rootSignature, state);
+    return TrackPipelineState(psoInternal);
+}
+
+EfgPSO EfgContext::CreateShadowMapPSO(EfgProgram program, EfgRootSignature& rootSignature)
+{
+    return CreateGraphicsPipelineState(program, rootSignature, EfgPipelineStateDesc().ShadowMap());
+}
+
+EfgPSO EfgContext::CreateGraphicsPipelineStateAsync(std::shared_future<EfgShader> vertexShader, std::shared_future<EfgShader> pixelShader, EfgRootSignature& rootSignature, EFG_PSO_POLICY policy, const EfgPipelineStateDesc& state)
+{
+    EfgPSOInternal* psoInternal = new EfgPSOInternal();
+    psoInternal->policy = policy;
+    // The shader tasks were queued first, so blocking on them here cannot starve the pool.
+    psoInternal->ready = m_threadPool.Submit([this, psoInternal, vertexShader, pixelShader, &rootSignature, state]() {
+        EfgProgram program;
+        program.vertexShader = vertexShader.get();
+        if (pixelShader.valid())
+            program.pixelShader = pixelShader.get();
+        CreateRootSignatureOnce(rootSignature, program);
+        CompilePipelineState(psoInternal, program, rootSignature, state);
+    }).share();
+    return TrackPipelineState(psoInternal);
+}
+
+EfgPSO EfgContext::CreateShadowMapPSOAsync(std::shared_future<EfgShader> vertexShader, EfgRootSignature& rootSignature, EFG_PSO_POLICY policy)
+{
+    return CreateGraphicsPipelineStateAsync(vertexShader, {}, rootSignature, policy, EfgPipelineStateDesc().ShadowMap());
+}
+
+void EfgContext::CreateRootSignatureOnce(EfgRootSignature& rootSignature, const EfgProgram& program)
+{
+    std::lock_guard<std::mutex> lock(m_rootSignatureMutex);
+    if (!rootSignature.Get())
+        CreateRootSignature(rootSignature, program);
+}
+
+EfgPSO EfgContext::TrackPipelineState(EfgPSOInternal* psoInternal)
+{
+    EfgPSO pso = {};
     pso.handle = reinterpret_cast<uint64_t>(psoInternal);
-    D3D12_INPUT_ELEMENT_DESC inputElementDescs[] =
+    std::lock_guard<std::mutex> lock(m_objectMutex);
+    m_pipelineStates.push_back(psoInternal);
+    return pso;
+}
+
+bool EfgContext::IsPipelineStateReady(EfgPSO pso)
+{
+    EfgPSOInternal* psoInternal = reinterpret_cast<EfgPSOInternal*>(pso.handle);
+    return !psoInternal->ready.valid() || psoInternal->ready.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+static uint32_t GetKeywordMask(const EfgProgramVariantsDesc& desc)
+{
+    return (desc.keywords.size() >= 32) ? ~0u : (1u << desc.keywords.size()) - 1;
+}
+
+static std::vector<EfgShaderDefine> GetKeywordDefines(const EfgProgramVariantsDesc& desc, uint32_t mask)
+{
+    std::vector<EfgShaderDefine> defines;
+    for (size_t i = 0; i < desc.keywords.size(); ++i)
     {
-        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        //{ "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "NORMAL",   0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,    0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
-    };
+        if (mask & (1u << i))
+            defines.push_back({ desc.keywords[i], "1" });
+    }
+    return defines;
+}
+
+// Callers hold variants->mutex. compressed only applies to the vertex stage.
+std::shared_future<EfgShader> EfgContext::GetVariantShader(EfgPSOVariantsInternal* variants, bool pixelStage, uint32_t mask, bool compressed)
+{
+    const EfgProgramVariantsDesc& desc = variants->desc;
+    mask &= pixelStage ? desc.pixelKeywords : desc.vertexKeywords;
+    if (pixelStage)
+    {
+        auto shader = variants->pixelShaders.find(mask);
+        if (shader != variants->pixelShaders.end())
+            return shader->second;
+        std::shared_future<EfgShader> compiled =
+            CreateShaderAsync(desc.pixelShader.c_str(), desc.pixelTarget.c_str(), desc.pixelEntryPoint.c_str(), GetKeywordDefines(desc, mask));
+        variants->pixelShaders[mask] = compiled;
+        return compiled;
+    }
 
+    uint64_t key = mask | (static_cast<uint64_t>(compressed) << 32);
+    auto shader = variants->vertexShaders.find(key);
+    if (shader != variants->vertexShaders.end())
+        return shader->second;
+    // Half and UNORM16 positions both arrive as floats, they only differ in the quantization constants.
+    std::vector<EfgShaderDefine> defines = GetKeywordDefines(desc, mask);
+    if (compressed)
+        defines.push_back({ "EFG_COMPRESSED_VERTEX", "1" });
+    std::shared_future<EfgShader> compiled =
+        CreateShaderAsync(desc.vertexShader.c_str(), desc.vertexTarget.c_str(), desc.vertexEntryPoint.c_str(), defines);
+    variants->vertexShaders[key] = compiled;
+    return compiled;
+}
+
+EfgPSOVariants EfgContext::CreatePipelineVariants(const EfgProgramVariantsDesc& desc, EfgRootSignature& rootSignature, EFG_PSO_POLICY policy)
+{
+    if (desc.keywords.size() > 32)
+        throw("Too many shader keywords!");
+
+    EfgPSOVariantsInternal* variantsInternal = new EfgPSOVariantsInternal();
+    variantsInternal->desc = desc;
+    variantsInternal->rootSignature = &rootSignature;
+    variantsInternal->policy = policy;
+
+    // Keywords may add or remove bindings, so the shared root signature is generated
+    // from both ends of the range. Neither variant is wasted, they are also cached.
+    uint32_t allKeywords = GetKeywordMask(desc);
+    std::vector<std::shared_future<EfgShader>> vertexShaders;
+    std::vector<std::shared_future<EfgShader>> pixelShaders;
+    {
+        std::lock_guard<std::mutex> lock(variantsInternal->mutex);
+        for (uint32_t mask : { 0u, allKeywords })
+        {
+            vertexShaders.push_back(GetVariantShader(variantsInternal, false, mask));
+            if (!desc.pixelShader.empty())
+                pixelShaders.push_back(GetVariantShader(variantsInternal, true, mask));
+        }
+        if (desc.compressedVertices)
+            vertexShaders.push_back(GetVariantShader(variantsInternal, false, allKeywords, true));
+    }
+    variantsInternal->rootSignatureReady = m_threadPool.Submit([this, vertexShaders, pixelShaders, &rootSignature]() {
+        EfgProgram program;
+        for (const std::shared_future<EfgShader>& shader : vertexShaders)
+        {
+            const std::vector<EfgShaderBinding>& bindings = shader.get().bindings;
+            program.vertexShader.bindings.insert(program.vertexShader.bindings.end(), bindings.begin(), bindings.end());
+        }
+        for (const std::shared_future<EfgShader>& shader : pixelShaders)
+        {
+            const std::vector<EfgShaderBinding>& bindings = shader.get().bindings;
+            program.pixelShader.bindings.insert(program.pixelShader.bindings.end(), bindings.begin(), bindings.end());
+        }
+        CreateRootSignatureOnce(rootSignature, program);
+    }).share();
+
+    EfgPSOVariants variants = {};
+    variants.handle = reinterpret_cast<uint64_t>(variantsInternal);
+    std::lock_guard<std::mutex> lock(m_objectMutex);
+    m_pipelineVariants.push_back(variantsInternal);
+    return variants;
+}
+
+EfgPSO EfgContext::GetPipelineVariant(EfgPSOVariants variants, uint32_t mask)
+{
+    EfgPSOVariantsInternal* variantsInternal = reinterpret_cast<EfgPSOVariantsInternal*>(variants.handle);
+    return GetPipelineVariant(variants, mask, variantsInternal->desc.state.inputLayout);
+}
+
+EfgPSO EfgContext::GetPipelineVariant(EfgPSOVariants variants, uint32_t mask, EFG_INPUT_LAYOUT inputLayout)
+{
+    EfgPSOVariantsInternal* variantsInternal = reinterpret_cast<EfgPSOVariantsInternal*>(variants.handle);
+    mask &= GetKeywordMask(variantsInternal->desc);
+    bool compressed = (inputLayout == efgInputLayout_COMPRESSED_HALF || inputLayout == efgInputLayout_COMPRESSED_UNORM16);
+    if (compressed && !variantsInternal->desc.compressedVertices)
+        throw("Compressed input layout requested from variants created without compressedVertices!");
+
+    std::lock_guard<std::mutex> lock(variantsInternal->mutex);
+    uint64_t key = mask | (static_cast<uint64_t>(inputLayout) << 32);
+    auto variant = variantsInternal->variants.find(key);
+    if (variant != variantsInternal->variants.end())
+        return variant->second;
+    if (variantsInternal->variants.size() >= variantsInternal->desc.maxVariants)
+        throw("Shader variant limit reached!");
+
+    std::shared_future<EfgShader> vertexShader = GetVariantShader(variantsInternal, false, mask, compressed);
+    std::shared_future<EfgShader> pixelShader;
+    if (!variantsInternal->desc.pixelShader.empty())
+        pixelShader = GetVariantShader(variantsInternal, true, mask);
+
+    EfgPSOInternal* psoInternal = new EfgPSOInternal();
+    psoInternal->policy = variantsInternal->policy;
+    std::shared_future<void> rootSignatureReady = variantsInternal->rootSignatureReady;
+    EfgRootSignature& rootSignature = *variantsInternal->rootSignature;
+    EfgPipelineStateDesc state = variantsInternal->desc.state;
+    state.inputLayout = inputLayout;
+    psoInternal->ready = m_threadPool.Submit([this, psoInternal, vertexShader, pixelShader, rootSignatureReady, &rootSignature, state]() {
+        rootSignatureReady.get();
+        EfgProgram program;
+        program.vertexShader = vertexShader.get();
+        if (pixelShader.valid())
+            program.pixelShader = pixelShader.get();
+        CompilePipelineState(psoInternal, program, rootSignature, state);
+    }).share();
+
+    EfgPSO pso = TrackPipelineState(psoInternal);
+    variantsInternal->variants[key] = pso;
+    return pso;
+}
+
+static DXGI_FORMAT GetFormat(EFG_FORMAT format)
+{
+    switch (format)
+    {
+    case efgFormat_R8G8B8A8_UNORM:
+        return DXGI_FORMAT_R8G8B8A8_UNORM;
+    case efgFormat_R8G8B8A8_UNORM_SRGB:
+        return DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+    case efgFormat_R16G16B16A16_FLOAT:
+        return DXGI_FORMAT_R16G16B16A16_FLOAT;
+    case efgFormat_R11G11B10_FLOAT:
+        return DXGI_FORMAT_R11G11B10_FLOAT;
+    case efgFormat_R32_FLOAT:
+        return DXGI_FORMAT_R32_FLOAT;
+    case efgFormat_D32_FLOAT:
+        return DXGI_FORMAT_D32_FLOAT;
+    case efgFormat_D24_UNORM_S8_UINT:
+        return DXGI_FORMAT_D24_UNORM_S8_UINT;
+    default:
+        return DXGI_FORMAT_UNKNOWN;
+    }
+}
+
+static D3D12_COMPARISON_FUNC GetComparisonFunc(EFG_COMPARISON comparison)
+{
+    // Same order as D3D12_COMPARISON_FUNC, which starts at 1.
+    return static_cast<D3D12_COMPARISON_FUNC>(comparison + 1);
+}
+
+static D3D12_GRAPHICS_PIPELINE_STATE_DESC BuildPipelineStateDesc(const EfgPipelineStateDesc& state, const EfgProgram& program, ID3D12RootSignature* rootSignature)
+{
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC desc = {};
+    desc.pRootSignature = rootSignature;
+    desc.VS = CD3DX12_SHADER_BYTECODE(program.vertexShader.byteCode.Get());
+    if (program.pixelShader.byteCode)
+        desc.PS = CD3DX12_SHADER_BYTECODE(program.pixelShader.byteCode.Get());
+
+    switch (state.inputLayout)
+    {
+    case efgInputLayout_POSITION:
+        desc.InputLayout = { positionInputElementDescs, _countof(positionInputElementDescs) };
+        break;
+    case efgInputLayout_COMPRESSED_HALF:
+        desc.InputLayout = { halfInputElementDescs, _countof(halfInputElementDescs) };
+        break;
+    case efgInputLayout_COMPRESSED_UNORM16:
+        desc.InputLayout = { unorm16InputElementDescs, _countof(unorm16InputElementDescs) };
+        break;
+    default:
+        desc.InputLayout = { inputElementDescs, _countof(inputElementDescs) };
+        break;
+    }
+    desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+
+    desc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+    desc.RasterizerState.FillMode = (state.fillMode == efgFill_WIREFRAME) ? D3D12_FILL_MODE_WIREFRAME : D3D12_FILL_MODE_SOLID;
+    desc.RasterizerState.CullMode = static_cast<D3D12_CULL_MODE>(state.cullMode + D3D12_CULL_MODE_NONE);
+    desc.RasterizerState.DepthBias = state.depthBias;
+    desc.RasterizerState.DepthBiasClamp = 0.0f;
+    desc.RasterizerState.SlopeScaledDepthBias = state.slopeScaledDepthBias;
+
+    desc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+    if (state.blendMode != efgBlend_OPAQUE)
+    {
+        for (uint32_t i = 0; i < state.renderTargetCount; ++i)
+        {
+            D3D12_RENDER_TARGET_BLEND_DESC& target = desc.BlendState.RenderTarget[i];
+            target.BlendEnable = TRUE;
+            target.SrcBlend = (state.blendMode == efgBlend_ALPHA) ? D3D12_BLEND_SRC_ALPHA : D3D12_BLEND_ONE;
+            target.DestBlend = (state.blendMode == efgBlend_ALPHA) ? D3D12_BLEND_INV_SRC_ALPHA : D3D12_BLEND_ONE;
+            target.BlendOp = D3D12_BLEND_OP_ADD;
+            target.SrcBlendAlpha = D3D12_BLEND_ONE;
+            target.DestBlendAlpha = (state.blendMode == efgBlend_ALPHA) ? D3D12_BLEND_INV_SRC_ALPHA : D3D12_BLEND_ONE;
+            target.BlendOpAlpha = D3D12_BLEND_OP_ADD;
+        }
+    }
+    desc.SampleMask = UINT_MAX;
+
+    desc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
+    desc.DepthStencilState.DepthEnable = state.depthTest ? TRUE : FALSE;
+    desc.DepthStencilState.DepthWriteMask = state.depthWrite ? D3D12_DEPTH_WRITE_MASK_ALL : D3D12_DEPTH_WRITE_MASK_ZERO;
+    desc.DepthStencilState.DepthFunc = GetComparisonFunc(state.depthFunc);
+    desc.DSVFormat = GetFormat(state.depthFormat);
+
+    desc.NumRenderTargets = (state.renderTargetCount < EfgPipelineStateDesc::MaxRenderTargets) ? state.renderTargetCount : EfgPipelineStateDesc::MaxRenderTargets;
+    for (UINT i = 0; i < desc.NumRenderTargets; ++i)
+        desc.RTVFormats[i] = GetFormat(state.renderTargetFormats[i]);
+    desc.SampleDesc.Count = 1;
+    return desc;
+}
+
+static bool IsSameByteCode(const ComPtr<ID3DBlob>& a, const ComPtr<ID3DBlob>& b)
+{
+    if (!a || !b)
+        return a == b;
+    return a->GetBufferSize() == b->GetBufferSize() && memcmp(a->GetBufferPointer(), b->GetBufferPointer(), a->GetBufferSize()) == 0;
+}
+
+void EfgContext::CompilePipelineState(EfgPSOInternal* psoInternal, const EfgProgram& program, EfgRootSignature& rootSignature, const EfgPipelineStateDesc& state)
+{
+    psoInternal->program = program;
+    psoInternal->state = state;
     psoInternal->rootSignature = rootSignature.Get();
+    psoInternal->rootSignatureHash = rootSignature.hash;
+    psoInternal->desc = BuildPipelineStateDesc(state, psoInternal->program, rootSignature.Get().Get());
+
+    EfgHash hash;
+    hash.Add(state.Hash());
+    hash.Add(rootSignature.hash);
+    for (const EfgShader* shader : { &program.vertexShader, &program.pixelShader })
+    {
+        if (shader->byteCode)
+            hash.AddBytes(shader->byteCode->GetBufferPointer(), shader->byteCode->GetBufferSize());
+        hash.Add<uint8_t>(0);
+    }
+    uint64_t key = hash.Get();
+
+    // Identical pipelines share one pipeline object.
+    {
+        std::lock_guard<std::mutex> lock(m_pipelineLookupMutex);
+        auto bucket = m_pipelineLookup.equal_range(key);
+        for (auto entry = bucket.first; entry != bucket.second; ++entry)
+        {
+            const EfgPipelineLookupEntry& existing = entry->second;
+            if (existing.state == state && existing.rootSignatureHash == rootSignature.hash &&
+                IsSameByteCode(existing.vertexShader, program.vertexShader.byteCode) &&
+                IsSameByteCode(existing.pixelShader, program.pixelShader.byteCode))
+            {
+                psoInternal->pipelineState = existing.pipelineState;
+                return;
+            }
+        }
+    }
+
+    psoInternal->pipelineState = m_pipelineCache.CreateGraphicsPipelineState(psoInternal->desc, rootSignature.hash);
+
+    EfgPipelineLookupEntry entry;
+    entry.state = state;
+    entry.rootSignatureHash = rootSignature.hash;
+    entry.vertexShader = program.vertexShader.byteCode;
+    entry.pixelShader = program.pixelShader.byteCode;
+    entry.pipelineState = psoInternal->pipelineState;
+    std::lock_guard<std::mutex> lock(m_pipelineLookupMutex);
+    m_pipelineLookup.emplace(key, entry);
+}
+
+void EfgContext::SetPipelineState(EfgPSO pso)
+{
+    EfgPSOInternal* psoInternal = reinterpret_cast<EfgPSOInternal*>(pso.handle);
+    if (psoInternal->ready.valid())
+    {
+        if (psoInternal->policy == efgPSO_SKIP && !IsPipelineStateReady(pso))
+        {
+            m_pipelineSkipped = true;
+            return;
+        }
+        // Blocks until created, rethrows if creation failed.
+        psoInternal->ready.get();
+    }
+    m_pipelineSkipped = false;
+    // Variants share a root signature, keeping it keeps the bound root arguments.
+    if (m_boundPSO == nullptr || m_boundPSO->rootSignature != psoInternal->rootSignature)
+        m_commandList->SetGraphicsRootSignature(psoInternal->rootSignature.Get());
+    m_commandList->RSSetViewports(1, &m_viewport);
+    m_commandList->RSSetScissorRects(1, &m_scissorRect);
+    // Identical descriptions share a pipeline object.
+    if (m_boundPSO == nullptr || m_boundPSO->pipelineState != psoInternal->pipelineState)
+        m_commandList->SetPipelineState(psoInternal->pipelineState.Get());
+    m_boundPSO = psoInternal;
+}
+
+void EfgContext::SetPipelineState(EfgPSOVariants variants, uint32_t mask)
+{
+    SetPipelineState(GetPipelineVariant(variants, mask));
+}
+
+void EfgContext::SetPipelineState(EfgPSOVariants variants, uint32_t mask, EFG_INPUT_LAYOUT inputLayout)
+{
+    SetPipelineState(GetPipelineVariant(variants, mask, inputLayout));
+}
+
+void EfgContext::EnableShaderHotReload(const std::wstring& shaderDirectory)
+{
+    if (m_fileWatcher.IsRunning())
+        return;
+    m_shaderDirectory = shaderDirectory;
+    m_hotReloadEnabled = true;
+    m_fileWatcher.Initialize([this](const std::vector<std::filesystem::path>& changedFiles) {
+        ReloadShaders(changedFiles);
+    });
+}
+
+// Runs on the file watcher thread. Nothing the render thread uses is modified here,
+// rebuilt pipelines wait in m_pendingReloads for the next frame.
+void EfgContext::ReloadShaders(const std::vector<std::filesystem::path>& changedFiles)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    // Before the variants are cleared, shaders created again must skip the archive.
+    {
+        std::lock_guard<std::mutex> lock(m_reloadMutex);
+        for (const std::filesystem::path& file : changedFiles)
+            m_editedShaderFiles.insert(file.wstring());
+    }
+    auto dependsOnChanges = [&](const std::wstring& source) {
+        for (const std::filesystem::path& file : m_shaderCache.GetSourceFiles(source))
+        {
+            if (std::find(changedFiles.begin(), changedFiles.end(), file) != changedFiles.end())
+                return true;
+        }
+        return false;
+    };
+
+    // Variants compiled from now on must not reuse stale stages.
+    std::vector<EfgPSOVariantsInternal*> pipelineVariants;
+    std::vector<EfgPSOInternal*> pipelineStates;
+    {
+        std::lock_guard<std::mutex> lock(m_objectMutex);
+        pipelineVariants.assign(m_pipelineVariants.begin(), m_pipelineVariants.end());
+        pipelineStates.assign(m_pipelineStates.begin(), m_pipelineStates.end());
+    }
+    for (EfgPSOVariantsInternal* variants : pipelineVariants)
+    {
+        std::lock_guard<std::mutex> lock(variants->mutex);
+        if (dependsOnChanges(GetShaderPath(variants->desc.vertexShader.c_str())))
+            variants->vertexShaders.clear();
+        if (!variants->desc.pixelShader.empty() && dependsOnChanges(GetShaderPath(variants->desc.pixelShader.c_str())))
+            variants->pixelShaders.clear();
+    }
+
+    // A shader shared by several pipelines is compiled once.
+    std::unordered_map<uint64_t, EfgShader> recompiled;
+    uint32_t reloadedCount = 0;
+    uint32_t failedCount = 0;
+    for (EfgPSOInternal* psoInternal : pipelineStates)
+    {
+        EfgPSO pso = {};
+        pso.handle = reinterpret_cast<uint64_t>(psoInternal);
+        if (!IsPipelineStateReady(pso))
+            continue;
+
+        // Builds on a pending reload that hasn't been swapped in yet.
+        EfgProgram program;
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC desc = {};
+        {
+            std::lock_guard<std::mutex> lock(m_reloadMutex);
+            auto pending = m_pendingReloads.find(psoInternal);
+            program = (pending != m_pendingReloads.end()) ? pending->second.program : psoInternal->program;
+            desc = (pending != m_pendingReloads.end()) ? pending->second.desc : psoInternal->desc;
+        }
+
+        bool changed = false;
+        try
+        {
+            for (EfgShader* shader : { &program.vertexShader, &program.pixelShader })
+            {
+                if (!shader->byteCode || !dependsOnChanges(shader->source))
+                    continue;
+                EfgHash hash;
+                hash.AddBytes(shader->source.data(), shader->source.size() * sizeof(wchar_t));
+                hash.AddString(shader->entryPoint.c_str());
+                hash.AddString(shader->target.c_str());
+                hash.Add(efgShaderPermutationKey(shader->defines));
+                uint64_t key = hash.Get();
+                auto compiled = recompiled.find(key);
+                if (compiled == recompiled.end())
+                {
+                    EfgShader reloaded = *shader;
+                    reloaded.bindings.clear();
+                    CompileShader(reloaded, reloaded.entryPoint.c_str(), reloaded.target.c_str(), reloaded.defines);
+                    efgReflectShader(reloaded.byteCode.Get(), reloaded.bindings);
+                    compiled = recompiled.emplace(key, reloaded).first;
+                }
+                *shader = compiled->second;
+                changed = true;
+            }
+            if (!changed)
+                continue;
+
+            desc.VS = CD3DX12_SHADER_BYTECODE(program.vertexShader.byteCode.Get());
+            if (program.pixelShader.byteCode)
+                desc.PS = CD3DX12_SHADER_BYTECODE(program.pixelShader.byteCode.Get());
+            // Fails if the new shaders no longer match the root signature.
+            ComPtr<ID3D12PipelineState> pipelineState = m_pipelineCache.CreateGraphicsPipelineState(desc, psoInternal->rootSignatureHash);
+
+            std::lock_guard<std::mutex> lock(m_reloadMutex);
+            EfgReloadedPSO& reloaded = m_pendingReloads[psoInternal];
+            reloaded.pipelineState = pipelineState;
+            reloaded.desc = desc;
+            reloaded.program = program;
+            reloadedCount++;
+        }
+        catch (const EfgException& exception)
+        {
+            exception.Print();
+            failedCount++;
+        }
+        catch (const char* message)
+        {
+            EFG_SHOW_ERROR(message);
+            failedCount++;
+        }
+        // Editors that save by delete and rename leave the source missing for a moment.
+        catch (const std::exception& exception)
+        {
+            std::cerr << "Shader reload: " << exception.what() << std::endl;
+            failedCount++;
+        }
+    }
 
-    // Define the rasterizer state description
-    D3D12_RASTERIZER_DESC rasterizerDesc = {};
-    rasterizerDesc.FillMode = D3D12_FILL_MODE_SOLID; // Fill solid polygons
-    rasterizerDesc.CullMode = D3D12_CULL_MODE_BACK;  // Cull back-facing polygons
-    rasterizerDesc.FrontCounterClockwise = FALSE;    // Counter-clockwise vertices define the front
-    rasterizerDesc.DepthBias = D3D12_DEFAULT_DEPTH_BIAS;
-    rasterizerDesc.DepthBiasClamp = D3D12_DEFAULT_DEPTH_BIAS_CLAMP;
-    rasterizerDesc.SlopeScaledDepthBias = D3D12_DEFAULT_SLOPE_SCALED_DEPTH_BIAS;
-    rasterizerDesc.DepthClipEnable = TRUE;           // Enable depth clipping
-    rasterizerDesc.MultisampleEnable = FALSE;        // Disable multisampling
-    rasterizerDesc.AntialiasedLineEnable = FALSE;    // Disable antialiased lines
-    rasterizerDesc.ForcedSampleCount = 0;
-    rasterizerDesc.ConservativeRaster = D3D12_CONSERVATIVE_RASTERIZATION_MODE_OFF;
-
-    // Describe and create the graphics pipeline state object (PSO).
-    psoInternal->desc.InputLayout = { inputElementDescs, _countof(inputElementDescs) };
-    psoInternal->desc.pRootSignature = rootSignature.Get().Get();
-    psoInternal->desc.VS = CD3DX12_SHADER_BYTECODE(program.vertexShader.byteCode.Get());
-    psoInternal->desc.PS = CD3DX12_SHADER_BYTECODE(program.pixelShader.byteCode.Get());
-    psoInternal->desc.RasterizerState = rasterizerDesc;
-    psoInternal->desc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
-    psoInternal->desc.DepthStencilState.DepthEnable = TRUE;
-    psoInternal->desc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL;
-    psoInternal->desc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_LESS;
-    psoInternal->desc.DepthStencilState.StencilEnable = FALSE;
-    psoInternal->desc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
-    psoInternal->desc.SampleMask = UINT_MAX;
-    psoInternal->desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-    psoInternal->desc.NumRenderTargets = 1;
-    psoInternal->desc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
-    psoInternal->desc.SampleDesc.Count = 1;
-    EFG_D3D_TRY(m_device->CreateGraphicsPipelineState(&psoInternal->desc, IID_PPV_ARGS(&psoInternal->pipelineState)));
-    m_pipelineStates.push_back(psoInternal);
-    return pso;
+    std::cout << "Shader reload: " << reloadedCount << " pipelines rebuilt, " << failedCount << " kept their previous version, "
+        << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms" << std::endl;
 }
 
-EfgPSO EfgContext::CreateShadowMapPSO(EfgProgram program, EfgRootSignature rootSignature)
+// Called at the start of a frame, before anything is recorded.
+void EfgContext::ApplyShaderReloads()
 {
-    EfgPSO pso = {};
-    EfgPSOInternal* psoInternal = new EfgPSOInternal();
-    pso.handle = reinterpret_cast<uint64_t>(psoInternal);
-    D3D12_INPUT_ELEMENT_DESC inputElementDescs[] =
+    // Replaced pipelines may still be used by frames in flight.
+    UINT64 completedValue = m_fence->GetCompletedValue();
+    m_retiredPipelineStates.erase(std::remove_if(m_retiredPipelineStates.begin(), m_retiredPipelineStates.end(),
+        [completedValue](const EfgRetiredPSO& retired) { return retired.fenceValue <= completedValue; }), m_retiredPipelineStates.end());
+
+    std::lock_guard<std::mutex> lock(m_reloadMutex);
+    std::vector<ID3D12PipelineState*> replaced;
+    for (auto& pending : m_pendingReloads)
     {
-        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        //{ "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "NORMAL",   0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,    0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
-    };
-    ZeroMemory(&psoInternal->desc, sizeof(D3D12_GRAPHICS_PIPELINE_STATE_DESC));
-    psoInternal->rootSignature = rootSignature.Get();
-    psoInternal->desc.pRootSignature = rootSignature.Get().Get();
-    psoInternal->desc.VS = CD3DX12_SHADER_BYTECODE(program.vertexShader.byteCode.Get());
-    psoInternal->desc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
-    psoInternal->desc.SampleMask = UINT_MAX;
-    psoInternal->desc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
-    psoInternal->desc.RasterizerState.CullMode = D3D12_CULL_MODE_BACK;
-    psoInternal->desc.RasterizerState.DepthBias = 50;
-    psoInternal->desc.RasterizerState.DepthBiasClamp = 0.0f;
-    psoInternal->desc.RasterizerState.SlopeScaledDepthBias = 1.0f;
-    psoInternal->desc.RasterizerState.MultisampleEnable = FALSE;
-    psoInternal->desc.RasterizerState.AntialiasedLineEnable = FALSE;
-    psoInternal->desc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
-    psoInternal->desc.DepthStencilState.DepthEnable = TRUE;
-    psoInternal->desc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL;
-    psoInternal->desc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_LESS;
-    psoInternal->desc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
-    psoInternal->desc.NumRenderTargets = 0;
-    psoInternal->desc.InputLayout = { inputElementDescs, _countof(inputElementDescs) };
-    psoInternal->desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-    psoInternal->desc.SampleDesc.Count = 1;
-    psoInternal->desc.SampleDesc.Quality = 0;
-    EFG_D3D_TRY(m_device->CreateGraphicsPipelineState(&psoInternal->desc, IID_PPV_ARGS(&psoInternal->pipelineState)));
-    m_pipelineStates.push_back(psoInternal);
-    return pso;
-}
+        EfgPSOInternal* psoInternal = pending.first;
+        replaced.push_back(psoInternal->pipelineState.Get());
+        EfgRetiredPSO retired = {};
+        retired.pipelineState = psoInternal->pipelineState;
+        // Signaled once the frame being recorded, and every frame before it, is done.
+        retired.fenceValue = m_fenceValue;
+        m_retiredPipelineStates.push_back(retired);
+
+        psoInternal->pipelineState = pending.second.pipelineState;
+        psoInternal->program = pending.second.program;
+        psoInternal->desc = pending.second.desc;
+    }
+    m_pendingReloads.clear();
 
-void EfgContext::SetPipelineState(EfgPSO pso)
-{
-    EfgPSOInternal* psoInternal = reinterpret_cast<EfgPSOInternal*>(pso.handle);
-    m_commandList->SetGraphicsRootSignature(psoInternal->rootSignature.Get());
-    m_commandList->RSSetViewports(1, &m_viewport);
-    m_commandList->RSSetScissorRects(1, &m_scissorRect);
-    m_commandList->SetPipelineState(psoInternal->pipelineState.Get());
-    m_boundPSO = psoInternal;
+    // Lookup entries of replaced pipelines would keep them and their bytecode alive past
+    // retirement. PSOs that still share one keep their own reference.
+    if (replaced.empty())
+        return;
+    std::lock_guard<std::mutex> lookupLock(m_pipelineLookupMutex);
+    for (auto entry = m_pipelineLookup.begin(); entry != m_pipelineLookup.end();)
+    {
+        if (std::find(replaced.begin(), replaced.end(), entry->second.pipelineState.Get()) != replaced.end())
+            entry = m_pipelineLookup.erase(entry);
+        else
+            ++entry;
+    }
 }
 
 void EfgContext::SetRenderTarget(EfgTexture texture, uint32_t offset, EfgTexture* depthStencil)
@@ -1414,6 +2716,8 @@ void EfgContext::BindIndexBuffer(EfgBuffer buffer)
 
 void EfgContext::Bind2DTexture(uint32_t index, const EfgTexture& texture)
 {
+    if (m_pipelineSkipped)
+        return;
     m_boundTexture = &texture;
     EfgTextureInternal* textureInternal = reinterpret_cast<EfgTextureInternal*>(texture.handle);
     if (textureInternal->currState != D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE)
@@ -1427,17 +2731,135 @@ void EfgContext::Bind2DTexture(uint32_t index, const EfgTexture& texture)
 
 void EfgContext::BindConstantBuffer(uint32_t index, const EfgBuffer& buffer)
 {
+    if (m_pipelineSkipped)
+        return;
     EfgBufferInternal* bufferInternal = reinterpret_cast<EfgBufferInternal*>(buffer.handle);
     m_commandList->SetGraphicsRootConstantBufferView(index, bufferInternal->Get()->GetGPUVirtualAddress());
 }
 
 void EfgContext::BindStructuredBuffer(uint32_t index, const EfgBuffer& buffer)
 {
+    if (m_pipelineSkipped)
+        return;
     EfgBufferInternal* bufferInternal = reinterpret_cast<EfgBufferInternal*>(buffer.handle);
     m_commandList->SetGraphicsRootShaderResourceView(index, bufferInternal->Get()->GetGPUVirtualAddress());
 }
 
-void EfgContext::CompileShader(EfgShader& shader, LPCSTR entryPoint, LPCSTR target)
+void EfgContext::BindRootConstants(uint32_t index, void const* data, uint32_t num32BitValues, uint32_t offset)
+{
+    if (m_pipelineSkipped)
+        return;
+    m_commandList->SetGraphicsRoot32BitConstants(index, num32BitValues, data, offset);
+}
+
+void EfgContext::Bind2DTexture(const EfgRootSignature& rootSignature, const char* name, const EfgTexture& texture)
+{
+    // The root signature may still be under construction on a worker.
+    if (m_pipelineSkipped)
+        return;
+    const EfgRootSignature::Binding* binding = rootSignature.FindBinding(name);
+    if (binding == nullptr)
+        return;
+    if (binding->type != D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE)
+        throw("Binding is not a descriptor table!");
+    Bind2DTexture(binding->index, texture);
+}
+
+void EfgContext::BindConstantBuffer(const EfgRootSignature& rootSignature, const char* name, const EfgBuffer& buffer)
+{
+    if (m_pipelineSkipped)
+        return;
+    const EfgRootSignature::Binding* binding = rootSignature.FindBinding(name);
+    if (binding == nullptr)
+        return;
+    if (binding->type != D3D12_ROOT_PARAMETER_TYPE_CBV)
+        throw("Binding is not a root constant buffer!");
+    BindConstantBuffer(binding->index, buffer);
+}
+
+void EfgContext::BindStructuredBuffer(const EfgRootSignature& rootSignature, const char* name, const EfgBuffer& buffer)
+{
+    if (m_pipelineSkipped)
+        return;
+    const EfgRootSignature::Binding* binding = rootSignature.FindBinding(name);
+    if (binding == nullptr)
+        return;
+    if (binding->type != D3D12_ROOT_PARAMETER_TYPE_SRV)
+        throw("Binding is not a root shader resource!");
+    BindStructuredBuffer(binding->index, buffer);
+}
+
+void EfgContext::BindRootConstants(const EfgRootSignature& rootSignature, const char* name, void const* data, uint32_t num32BitValues)
+{
+    if (m_pipelineSkipped)
+        return;
+    const EfgRootSignature::Binding* binding = rootSignature.FindBinding(name);
+    if (binding == nullptr)
+        return;
+    if (binding->type != D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS)
+        throw("Binding is not a root constant!");
+    BindRootConstants(binding->index, data, num32BitValues);
+}
+
+// Resolves #include through the VFS like D3D_COMPILE_STANDARD_FILE_INCLUDE does on disk:
+// relative to the including file, then to the root shader.
+class EfgVfsInclude : public ID3DInclude
+{
+public:
+    EfgVfsInclude(const EfgVfs& vfs, const std::filesystem::path& source)
+        : m_vfs(vfs), m_rootDirectory(source.parent_path())
+    {
+    }
+
+    HRESULT __stdcall Open(D3D_INCLUDE_TYPE includeType, LPCSTR fileName, LPCVOID parentData, LPCVOID* data, UINT* bytes) override
+    {
+        std::filesystem::path directory = m_rootDirectory;
+        for (const Opened& opened : m_opened)
+        {
+            if (opened.file->GetData() == parentData)
+                directory = opened.directory;
+        }
+        Opened opened = { std::make_unique<EfgVfsFile>() };
+        std::filesystem::path path = directory / fileName;
+        if (!m_vfs.Open(path, *opened.file))
+        {
+            path = m_rootDirectory / fileName;
+            if (!m_vfs.Open(path, *opened.file))
+                return E_FAIL;
+        }
+        opened.directory = path.parent_path();
+        *data = opened.file->GetData();
+        *bytes = static_cast<UINT>(opened.file->GetSize());
+        m_opened.push_back(std::move(opened));
+        return S_OK;
+    }
+
+    HRESULT __stdcall Close(LPCVOID data) override
+    {
+        // The same packed file included twice has the same data, either entry can go.
+        for (auto opened = m_opened.rbegin(); opened != m_opened.rend(); ++opened)
+        {
+            if (opened->file->GetData() == data)
+            {
+                m_opened.erase(std::next(opened).base());
+                break;
+            }
+        }
+        return S_OK;
+    }
+
+private:
+    struct Opened
+    {
+        std::unique_ptr<EfgVfsFile> file;
+        std::filesystem::path directory;
+    };
+    const EfgVfs& m_vfs;
+    std::filesystem::path m_rootDirectory;
+    std::vector<Opened> m_opened;
+};
+
+void EfgContext::CompileShader(EfgShader& shader, LPCSTR entryPoint, LPCSTR target, const std::vector<EfgShaderDefine>& defines)
 {
 #if defined(_DEBUG)
     UINT compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
@@ -1448,10 +2870,36 @@ void EfgContext::CompileShader(EfgShader& shader, LPCSTR entryPoint, LPCSTR targ
     ComPtr<ID3DBlob> shaderBlob;
     ComPtr<ID3DBlob> errorBlob;
 
-    HRESULT hr = D3DCompileFromFile(
-        shader.source.c_str(),
-        nullptr,           // Optional macros
-        nullptr,           // Optional include files
+    uint64_t cacheKey = m_shaderCache.ComputeKey(shader.source, defines, entryPoint, target, compileFlags, D3D_COMPILER_VERSION);
+    std::vector<uint8_t> cachedByteCode;
+    if (m_shaderCache.Find(cacheKey, cachedByteCode))
+    {
+        EFG_D3D_TRY(D3DCreateBlob(cachedByteCode.size(), &shaderBlob));
+        memcpy(shaderBlob->GetBufferPointer(), cachedByteCode.data(), cachedByteCode.size());
+        shader.byteCode = shaderBlob;
+        return;
+    }
+
+    std::vector<D3D_SHADER_MACRO> macros;
+    for (const EfgShaderDefine& define : defines)
+        macros.push_back({ define.name.c_str(), define.value.c_str() });
+    macros.push_back({ nullptr, nullptr });
+
+    EfgVfsFile source;
+    if (!m_vfs.Open(shader.source, source))
+    {
+        std::wcerr << L"CompileShader: could not open " << shader.source << std::endl;
+        throw std::runtime_error("Failed to open shader source");
+    }
+    EfgVfsInclude include(m_vfs, shader.source);
+    std::string sourceName = std::filesystem::path(shader.source).string();
+
+    HRESULT hr = D3DCompile(
+        source.GetData(),
+        source.GetSize(),
+        sourceName.c_str(), // Named in errors
+        macros.data(),     // Keyword defines
+        &include,          // Includes relative to the shader
         entryPoint,        // Entry point for shader
         target,            // Shader model (vs_5_0, ps_5_0, etc.)
         compileFlags,      // Compile options
@@ -1463,10 +2911,12 @@ void EfgContext::CompileShader(EfgShader& shader, LPCSTR entryPoint, LPCSTR targ
     {
         if (errorBlob) {
             OutputDebugStringA((char*)errorBlob->GetBufferPointer());
+            std::cerr << (char*)errorBlob->GetBufferPointer() << std::endl;
         }
         EFG_D3D_TRY(hr);
     }
     
+    m_shaderCache.Store(cacheKey, shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize());
     shader.byteCode = shaderBlob;
 }
 
@@ -1493,9 +2943,9 @@ void EfgContext::CheckD3DErrors()
     }
 }
 
-D3D12_DESCRIPTOR_RANGE EfgDescriptorRange::Commit(UINT offset)
+D3D12_DESCRIPTOR_RANGE1 EfgDescriptorRange::Commit(UINT offset)
 {
-    D3D12_DESCRIPTOR_RANGE descriptorRange = {};
+    D3D12_DESCRIPTOR_RANGE1 descriptorRange = {};
     switch (rangeType)
     {
     case efgRange_CBV:
@@ -1504,29 +2954,37 @@ D3D12_DESCRIPTOR_RANGE EfgDescriptorRange::Commit(UINT offset)
     case efgRange_SRV:
         descriptorRange.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
         break;
+    case efgRange_UAV:
+        descriptorRange.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
+        break;
     case efgRange_SAMPLER:
         descriptorRange.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER;
+        if (flags & ~D3D12_DESCRIPTOR_RANGE_FLAG_DESCRIPTORS_VOLATILE)
+            throw("Sampler ranges only support DESCRIPTORS_VOLATILE!");
         break;
     }
     descriptorRange.NumDescriptors = numDescriptors;
     descriptorRange.BaseShaderRegister = baseShaderRegister;
-    descriptorRange.RegisterSpace = 0;
+    descriptorRange.RegisterSpace = registerSpace;
+    descriptorRange.Flags = flags;
     descriptorRange.OffsetInDescriptorsFromTableStart = offset;
     
     return descriptorRange;
 }
 
-D3D12_ROOT_PARAMETER EfgRootParameter::Commit(ShaderRegisters& registers)
+D3D12_ROOT_PARAMETER1 EfgRootParameter::Commit(ShaderRegisters& registers)
 {
-    D3D12_ROOT_PARAMETER rootParameter = {};
+    D3D12_ROOT_PARAMETER1 rootParameter = {};
     rootParameter.ParameterType = type;
-    rootParameter.ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+    rootParameter.ShaderVisibility = visibility;
 
     switch (type)
     {
     case D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE:
         rootParameter.DescriptorTable.NumDescriptorRanges = static_cast<UINT>(ranges.size());
         rootParameter.DescriptorTable.pDescriptorRanges = ranges.data();
+        if (explicitRegisters)
+            break;
         for (size_t i = 0; i < ranges.size(); ++i)
         {
             switch (ranges[i].RangeType)
@@ -1551,34 +3009,96 @@ D3D12_ROOT_PARAMETER EfgRootParameter::Commit(ShaderRegisters& registers)
         }
         break;
     case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+        rootParameter.Constants.ShaderRegister = explicitRegisters ? data.shaderRegister : registers.CBV++;
+        rootParameter.Constants.RegisterSpace = data.registerSpace;
+        rootParameter.Constants.Num32BitValues = data.num32BitValues;
         break;
     case D3D12_ROOT_PARAMETER_TYPE_CBV:
-        rootParameter.Descriptor.ShaderRegister = registers.CBV;
-        registers.CBV++;
+        rootParameter.Descriptor.ShaderRegister = explicitRegisters ? data.shaderRegister : registers.CBV++;
+        rootParameter.Descriptor.RegisterSpace = data.registerSpace;
+        rootParameter.Descriptor.Flags = descriptorFlags;
         break;
     case D3D12_ROOT_PARAMETER_TYPE_SRV:
-        rootParameter.Descriptor.ShaderRegister = registers.SRV;
-        registers.SRV++;
+        rootParameter.Descriptor.ShaderRegister = explicitRegisters ? data.shaderRegister : registers.SRV++;
+        rootParameter.Descriptor.RegisterSpace = data.registerSpace;
+        rootParameter.Descriptor.Flags = descriptorFlags;
         break;
     case D3D12_ROOT_PARAMETER_TYPE_UAV:
-        rootParameter.Descriptor.ShaderRegister = registers.UAV;
-        registers.UAV++;
+        rootParameter.Descriptor.ShaderRegister = explicitRegisters ? data.shaderRegister : registers.UAV++;
+        rootParameter.Descriptor.RegisterSpace = data.registerSpace;
+        rootParameter.Descriptor.Flags = descriptorFlags;
         break;
     }
     return rootParameter;
 }
 
-ComPtr<ID3DBlob> EfgRootSignature::Serialize()
+void EfgRootSignature::insert(EfgSampler& sampler, D3D12_SHADER_VISIBILITY visibility, int32_t shaderRegister, uint32_t space)
 {
-    rootSignatureDesc.NumParameters = static_cast<UINT>(rootParameters.size());
-    rootSignatureDesc.pParameters = rootParameters.data();
-    rootSignatureDesc.NumStaticSamplers = 0;
-    rootSignatureDesc.pStaticSamplers = nullptr;
-    rootSignatureDesc.Flags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT;
+    EfgSamplerInternal* samplerInternal = reinterpret_cast<EfgSamplerInternal*>(sampler.handle);
+    const D3D12_SAMPLER_DESC& desc = samplerInternal->desc;
+
+    D3D12_STATIC_SAMPLER_DESC staticSampler = {};
+    staticSampler.Filter = desc.Filter;
+    staticSampler.AddressU = desc.AddressU;
+    staticSampler.AddressV = desc.AddressV;
+    staticSampler.AddressW = desc.AddressW;
+    staticSampler.MipLODBias = desc.MipLODBias;
+    staticSampler.MaxAnisotropy = (desc.MaxAnisotropy > 0) ? desc.MaxAnisotropy : 1;
+    staticSampler.ComparisonFunc = desc.ComparisonFunc;
+    staticSampler.MinLOD = desc.MinLOD;
+    staticSampler.MaxLOD = desc.MaxLOD;
+
+    // Static samplers only support the three fixed border colors.
+    if (desc.BorderColor[3] == 0.0f)
+        staticSampler.BorderColor = D3D12_STATIC_BORDER_COLOR_TRANSPARENT_BLACK;
+    else if (desc.BorderColor[0] == 1.0f && desc.BorderColor[1] == 1.0f && desc.BorderColor[2] == 1.0f)
+        staticSampler.BorderColor = D3D12_STATIC_BORDER_COLOR_OPAQUE_WHITE;
+    else
+        staticSampler.BorderColor = D3D12_STATIC_BORDER_COLOR_OPAQUE_BLACK;
+
+    staticSampler.ShaderRegister = (shaderRegister < 0) ? registers.SAMPLER++ : static_cast<UINT>(shaderRegister);
+    staticSampler.RegisterSpace = space;
+    staticSampler.ShaderVisibility = visibility;
+
+    staticSamplers.push_back(staticSampler);
+}
 
+ComPtr<ID3DBlob> EfgRootSignature::Serialize(D3D_ROOT_SIGNATURE_VERSION maxVersion)
+{
+    // Tables cost 1 DWORD, root descriptors 2 and constants 1 per value, out of 64.
+    UINT rootSignatureCost = 0;
+    for (const D3D12_ROOT_PARAMETER1& parameter : rootParameters)
+    {
+        switch (parameter.ParameterType)
+        {
+        case D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE:
+            rootSignatureCost += 1;
+            break;
+        case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+            rootSignatureCost += parameter.Constants.Num32BitValues;
+            break;
+        default:
+            rootSignatureCost += 2;
+            break;
+        }
+    }
+    if (rootSignatureCost > D3D12_MAX_ROOT_COST)
+        throw("Root signature exceeds 64 DWORDs!");
+
+    rootSignatureDesc.Version = D3D_ROOT_SIGNATURE_VERSION_1_1;
+    rootSignatureDesc.Desc_1_1.NumParameters = static_cast<UINT>(rootParameters.size());
+    rootSignatureDesc.Desc_1_1.pParameters = rootParameters.data();
+    rootSignatureDesc.Desc_1_1.NumStaticSamplers = static_cast<UINT>(staticSamplers.size());
+    rootSignatureDesc.Desc_1_1.pStaticSamplers = staticSamplers.data();
+    rootSignatureDesc.Desc_1_1.Flags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT |
+        D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS |
+        D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS |
+        D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS;
+
+    // Converts down to a 1.0 blob (dropping the 1.1 flags) when the runtime does not support 1.1.
     ComPtr<ID3DBlob> serializedRootSignature;
     ComPtr<ID3DBlob> errorBlob;
-    HRESULT hr = D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &serializedRootSignature, &errorBlob);
+    HRESULT hr = D3DX12SerializeVersionedRootSignature(&rootSignatureDesc, maxVersion, &serializedRootSignature, &errorBlob);
     if (FAILED(hr))
     {
         if (errorBlob)
@@ -1592,13 +3112,120 @@ ComPtr<ID3DBlob> EfgRootSignature::Serialize()
 
 void EfgContext::CreateRootSignature(EfgRootSignature& rootSignature)
 {
-    ComPtr<ID3DBlob> serializedRootSignature = rootSignature.Serialize();
+    ComPtr<ID3DBlob> serializedRootSignature = rootSignature.Serialize(m_rootSignatureVersion);
     ThrowIfFailed(m_device->CreateRootSignature(0, serializedRootSignature->GetBufferPointer(), serializedRootSignature->GetBufferSize(), IID_PPV_ARGS(&rootSignature.Get())));
+    rootSignature.hash = efgHash(serializedRootSignature->GetBufferPointer(), serializedRootSignature->GetBufferSize());
+    std::lock_guard<std::mutex> lock(m_objectMutex);
     m_rootSignatures.push_back(&rootSignature);
 }
 
+static EFG_RANGE_TYPE GetBindingRangeType(D3D_SHADER_INPUT_TYPE type)
+{
+    switch (type)
+    {
+    case D3D_SIT_CBUFFER:
+        return efgRange_CBV;
+    case D3D_SIT_SAMPLER:
+        return efgRange_SAMPLER;
+    case D3D_SIT_UAV_RWTYPED:
+    case D3D_SIT_UAV_RWSTRUCTURED:
+    case D3D_SIT_UAV_RWBYTEADDRESS:
+    case D3D_SIT_UAV_APPEND_STRUCTURED:
+    case D3D_SIT_UAV_CONSUME_STRUCTURED:
+    case D3D_SIT_UAV_RWSTRUCTURED_WITH_COUNTER:
+        return efgRange_UAV;
+    default:
+        return efgRange_SRV;
+    }
+}
+
+void EfgContext::CreateRootSignature(EfgRootSignature& rootSignature, const EfgProgram& program)
+{
+    // Per-draw constant buffers up to this size are passed inline as root constants.
+    const uint32_t maxRootConstantBytes = 16;
+
+    // Merge both stages. A resource read by both becomes visible to all stages.
+    std::vector<EfgShaderBinding> shaderBindings;
+    for (const EfgShader* shader : { &program.vertexShader, &program.pixelShader })
+    {
+        for (const EfgShaderBinding& binding : shader->bindings)
+        {
+            auto existing = std::find_if(shaderBindings.begin(), shaderBindings.end(), [&](const EfgShaderBinding& other) {
+                return GetBindingRangeType(other.type) == GetBindingRangeType(binding.type) &&
+                    other.shaderRegister == binding.shaderRegister && other.registerSpace == binding.registerSpace;
+            });
+            if (existing == shaderBindings.end())
+                shaderBindings.push_back(binding);
+            else if (existing->visibility != binding.visibility)
+                existing->visibility = D3D12_SHADER_VISIBILITY_ALL;
+        }
+    }
+
+    auto frequencyOf = [&](const EfgShaderBinding& binding) {
+        auto frequency = rootSignature.frequencies.find(binding.name);
+        return (frequency != rootSignature.frequencies.end()) ? frequency->second : efgUpdate_PER_FRAME;
+    };
+    // Most frequently changed parameters first.
+    std::stable_sort(shaderBindings.begin(), shaderBindings.end(), [&](const EfgShaderBinding& a, const EfgShaderBinding& b) {
+        return frequencyOf(a) < frequencyOf(b);
+    });
+
+    // Parameters must stay alive until serialization, their tables point into them.
+    std::vector<EfgRootParameter> parameters;
+    std::vector<std::string> parameterNames;
+    parameters.reserve(shaderBindings.size());
+    for (const EfgShaderBinding& binding : shaderBindings)
+    {
+        EFG_RANGE_TYPE rangeType = GetBindingRangeType(binding.type);
+        if (rangeType == efgRange_SAMPLER)
+        {
+            auto sampler = rootSignature.samplers.find(binding.name);
+            if (sampler == rootSignature.samplers.end())
+                throw("No static sampler set for shader sampler!");
+            rootSignature.insert(sampler->second, binding.visibility, binding.shaderRegister, binding.registerSpace);
+            continue;
+        }
+
+        bool isRawOrStructured = binding.type == D3D_SIT_STRUCTURED || binding.type == D3D_SIT_BYTEADDRESS ||
+            binding.type == D3D_SIT_UAV_RWSTRUCTURED || binding.type == D3D_SIT_UAV_RWBYTEADDRESS;
+        EFG_ROOT_PARAMETER_TYPE parameterType = efgRootParamter_DESCRIPTOR_TABLE;
+        if (rangeType == efgRange_CBV)
+        {
+            bool inlineConstants = frequencyOf(binding) == efgUpdate_PER_DRAW && binding.size <= maxRootConstantBytes;
+            parameterType = inlineConstants ? efgRootParameter_CONSTANT : efgRootParameter_CBV;
+        }
+        else if (isRawOrStructured && binding.count == 1)
+        {
+            // Only raw and structured buffers can be root descriptors, everything else needs a table.
+            parameterType = (rangeType == efgRange_UAV) ? efgRootParamter_UAV : efgRootParamter_SRV;
+        }
+
+        EfgRootParameter parameter(parameterType, binding.visibility);
+        if (parameterType == efgRootParameter_CONSTANT)
+            parameter.data.num32BitValues = binding.size / sizeof(uint32_t);
+        if (parameterType == efgRootParamter_DESCRIPTOR_TABLE)
+        {
+            EfgDescriptorRange range(rangeType, binding.shaderRegister, binding.count);
+            range.registerSpace = binding.registerSpace;
+            parameter.insert(range);
+        }
+        parameter.SetRegister(binding.shaderRegister, binding.registerSpace);
+        parameters.push_back(parameter);
+        parameterNames.push_back(binding.name);
+    }
+
+    for (size_t i = 0; i < parameters.size(); ++i)
+    {
+        rootSignature.insert(parameters[i]);
+        rootSignature.bindings[parameterNames[i]] = { parameters[i].data.index, parameters[i].type };
+    }
+    CreateRootSignature(rootSignature);
+}
+
 void EfgContext::BindRootDescriptorTable(EfgRootSignature& rootSignature)
 {
+    if (m_pipelineSkipped)
+        return;
     uint32_t offset = 0;
     ComPtr<ID3D12DescriptorHeap> heap = {};
     for (int i = 0; i < rootSignature.descriptorTables.size(); i++)
@@ -1623,42 +3250,156 @@ void EfgContext::BindRootDescriptorTable(EfgRootSignature& rootSignature)
     }
 }
 
-EfgImportMesh EfgContext::LoadFromObj(const char* basePath, const char* file)
+std::wstring EfgContext::GetMeshCachePath(const char* basePath, const char* file, EFG_VERTEX_FORMAT vertexFormat)
+{
+    std::error_code error;
+    std::filesystem::path path = std::filesystem::weakly_canonical(file, error);
+    if (error)
+        path = file;
+    // Each vertex format of a file has its own cache. The cached texture paths are built
+    // from basePath, so it is part of the key too.
+    EfgHash hash;
+    hash.AddString(path.generic_string().c_str());
+    hash.AddString((basePath != nullptr) ? basePath : "");
+    hash.Add(static_cast<uint32_t>(vertexFormat));
+    char name[32] = {};
+    snprintf(name, sizeof(name), "%016llx.efgmesh", static_cast<unsigned long long>(hash.Get()));
+    std::string narrowName = name;
+    return GetAssetFullPath(L"meshcache\\") + std::wstring(narrowName.begin(), narrowName.end());
+}
+
+void EfgContext::AddImportMaterials(EfgImportMesh& mesh, const std::vector<EfgMaterialBuffer>& materials, const std::vector<std::string>& diffuseTextures,
+    bool streamTextures, float priority)
+{
+    // Materials sharing an image share its texture through the cache. Loaded textures are
+    // decoded as one batch, so a scene's textures decode in parallel.
+    EfgTextureCache::Stats before = m_textureCache.GetStats();
+    std::vector<std::wstring> decodeFiles;
+    std::vector<size_t> decodeMaterials;
+    for (size_t m = 0; m < materials.size(); m++)
+    {
+        EfgMaterialTextures textures;
+        const std::string& diffuseTexture = diffuseTextures[m];
+        if (!diffuseTexture.empty())
+        {
+            std::wstring w_texPath(diffuseTexture.begin(), diffuseTexture.end());
+            if (streamTextures)
+            {
+                textures.diffuse_map = AcquireStreamedTexture2D(w_texPath.c_str(), priority).texture;
+            }
+            else
+            {
+                decodeFiles.push_back(w_texPath);
+                decodeMaterials.push_back(m);
+            }
+        }
+
+        EfgBuffer materialBuffer = CreateConstantBuffer<EfgMaterialBuffer>(&materials[m], 1);
+        mesh.materialBuffers.push_back(materialBuffer);
+        mesh.textures.push_back(textures);
+    }
+
+    std::vector<EfgTexture> decoded = AcquireTextures2D(decodeFiles);
+    for (size_t t = 0; t < decoded.size(); t++)
+        mesh.textures[decodeMaterials[t]].diffuse_map = decoded[t];
+
+    const EfgTextureCache::Stats& after = m_textureCache.GetStats();
+    uint64_t lookups = after.lookups - before.lookups;
+    uint64_t hits = (after.pathHits - before.pathHits) + (after.contentHits - before.contentHits);
+    if (lookups > 0)
+    {
+        std::cout << "AddImportMaterials: " << lookups << " material textures, " << hits << " shared through the texture cache ("
+            << 100.0 * hits / lookups << "% hit rate, " << after.textureCount << " textures cached)" << std::endl;
+    }
+}
+
+EfgImportMesh EfgContext::LoadFromMeshCache(const EfgObjImport& import)
 {
+    const EfgMeshCache& cache = import.cache;
     EfgImportMesh mesh;
-    tinyobj::ObjReaderConfig readerConfig;
-    if(basePath != nullptr)
-        readerConfig.mtl_search_path = basePath;
+    mesh.constants.isInstanced = false;
+    mesh.constants.useTransform = false;
 
-    tinyobj::ObjReader reader;
+    std::vector<EfgMaterialBuffer> materials;
+    std::vector<std::string> diffuseTextures;
+    for (uint32_t m = 0; m < cache.GetMaterialCount(); m++)
+    {
+        const EfgMeshCacheMaterial& material = cache.GetMaterial(m);
+        const char* diffuseTexture = cache.GetDiffuseTexture(material);
+        materials.push_back(material.constants);
+        diffuseTextures.push_back((diffuseTexture != nullptr) ? diffuseTexture : "");
+    }
+    AddImportMaterials(mesh, materials, diffuseTextures, import.streamTextures, import.priority);
 
-    if (!reader.ParseFromFile(file, readerConfig))
+    // Streams are uploaded straight from the mapping, the CPU copies stay empty.
+    for (uint32_t b = 0; b < cache.GetBatchCount(); b++)
     {
-        if (!reader.Error().empty())
-        {
-            std::cerr << "TinyObjReader: " << reader.Error();
-        }
-        exit(1);
+        const EfgMeshCacheBatch& cached = cache.GetBatch(b);
+        mesh.materialBatches.emplace_back();
+        EfgInstanceBatch& batch = mesh.materialBatches.back();
+        batch.materialId = cached.materialId;
+        batch.vertexFormat = static_cast<EFG_VERTEX_FORMAT>(cached.vertexFormat);
+        batch.quantization = cached.quantization;
+        batch.vertexBuffer = CreateVertexBuffer(cache.GetVertices(cached), cached.vertexCount * cached.vertexStride, cached.vertexStride);
+        batch.indexBuffer = CreateIndexBuffer<uint32_t>(cache.GetIndices(cached), cached.indexCount);
+        batch.lodCount = cached.lodCount;
+        memcpy(batch.lods, cached.lods, sizeof(batch.lods));
+        batch.indexCount = batch.lods[0].indexCount;
+        batch.boundsMin = cached.boundsMin;
+        batch.boundsMax = cached.boundsMax;
+        const EfgMeshlet* meshlets = cache.GetMeshlets(cached);
+        const uint32_t* meshletVertices = cache.GetMeshletVertices(cached);
+        const uint8_t* meshletTriangles = cache.GetMeshletTriangles(cached);
+        batch.meshlets.meshlets.assign(meshlets, meshlets + cached.meshletCount);
+        batch.meshlets.vertices.assign(meshletVertices, meshletVertices + cached.meshletVertexCount);
+        batch.meshlets.triangles.assign(meshletTriangles, meshletTriangles + size_t(cached.meshletTriangleCount) * 3);
     }
+    return mesh;
+}
 
-    if (!reader.Warning().empty())
+EfgImportMesh EfgContext::LoadFromObj(const char* basePath, const char* file, EFG_VERTEX_FORMAT vertexFormat)
+{
+    auto loadStart = std::chrono::steady_clock::now();
+    EfgObjImport import;
+    std::string error;
+    if (!ImportObj(basePath, file, vertexFormat, import, error))
+    {
+        std::cerr << "LoadFromObj: " << error << std::endl;
+        exit(1);
+    }
+    bool cached = import.cache.IsOpen();
+    EfgImportMesh mesh = CreateImportMesh(import);
+    if (cached)
     {
-        std::cout << "TinyObjReader: " << reader.Warning();
+        std::chrono::duration<double, std::milli> loadMs = std::chrono::steady_clock::now() - loadStart;
+        std::cout << "LoadFromObj: " << file << " loaded from the mesh cache in " << loadMs.count() << " ms" << std::endl;
     }
+    return mesh;
+}
 
-    auto& attrib = reader.GetAttrib();
-    auto shapes = reader.GetShapes();
-    auto materials = reader.GetMaterials();
+// Touches no D3D objects, so it can run on a streaming worker.
+bool EfgContext::ImportObj(const char* basePath, const char* file, EFG_VERTEX_FORMAT vertexFormat, EfgObjImport& import, std::string& error)
+{
+    auto loadStart = std::chrono::steady_clock::now();
+    std::wstring cachePath = GetMeshCachePath(basePath, file, vertexFormat);
+    if (import.cache.Open(cachePath, m_vfs))
+        return true;
+
+    EfgImportMesh& mesh = import.mesh;
+    EfgMeshCacheWriter cacheWriter;
+    EfgObjMesh obj;
+    if (!efgParseObj(file, (basePath != nullptr) ? basePath : "", m_vfs, m_threadPool, obj, error))
+        return false;
+    std::chrono::duration<double, std::milli> parseMs = std::chrono::steady_clock::now() - loadStart;
+    std::cout << "LoadFromObj: parsed " << file << " in " << parseMs.count() << " ms" << std::endl;
 
     mesh.constants.isInstanced = false;
     mesh.constants.useTransform = false;
-    mesh.constantsBuffer = CreateConstantBuffer<ObjectConstants>(&mesh.constants, 1);
 
-    for (size_t m = 0; m < materials.size(); m++)
+    for (const EfgObjMaterial& importMat : obj.materials)
     {
         EfgMaterialBuffer material;
-        EfgMaterialTextures textures;
-        tinyobj::material_t importMat = materials[m];
+        std::string texPath;
         material.ambient= XMFLOAT4(importMat.ambient[0], importMat.ambient[1], importMat.ambient[2], 0.0f);
         material.diffuse = XMFLOAT4(importMat.diffuse[0], importMat.diffuse[1], importMat.diffuse[2], 0.0f);
         material.specular = XMFLOAT4(importMat.specular[0],importMat.specular[1], importMat.specular[2], 0.0f);
@@ -1669,73 +3410,391 @@ EfgImportMesh EfgContext::LoadFromObj(const char* basePath, const char* file)
         material.metallic = importMat.metallic;
         material.ior = importMat.ior;
         material.dissolve = importMat.dissolve;
-        material.clearcoat = importMat.clearcoat_thickness;
-        material.clearcoat_roughness = importMat.clearcoat_roughness;
-        if (!materials[m].diffuse_texname.empty())
+        material.clearcoat = importMat.clearcoatThickness;
+        material.clearcoat_roughness = importMat.clearcoatRoughness;
+        if (!importMat.diffuseTexture.empty())
         {
             material.diffuseMapFlag = 1;
-            std::string texPath;
             if (basePath != nullptr)
-                texPath = std::string(basePath) + "\\" + materials[m].diffuse_texname;
+                texPath = (std::filesystem::path(basePath) / importMat.diffuseTexture).string();
             else
-                texPath = materials[m].diffuse_texname;
-            std::wstring w_texPath(texPath.begin(), texPath.end());
-            textures.diffuse_map = CreateTexture2DFromFile(w_texPath.c_str());
+                texPath = importMat.diffuseTexture;
         }
 
-        EfgBuffer materialBuffer = CreateConstantBuffer<EfgMaterialBuffer>(&material, 1);
-        mesh.materialBuffers.push_back(materialBuffer);
-        mesh.textures.push_back(textures);
+        import.materials.push_back(material);
+        import.diffuseTextures.push_back(texPath);
+        cacheWriter.AddMaterial(material, texPath);
     }
 
-    // Loop over shapes
-    for (size_t s = 0; s < shapes.size(); s++) {
-      // Loop over faces(polygon)
-      size_t index_offset = 0;
-      for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
-        size_t fv = size_t(shapes[s].mesh.num_face_vertices[f]);
-        // Loop over vertices in the face.
-        for (size_t v = 0; v < fv; v++) {
-          Vertex vertex;
-          // access to vertex
-          tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
-          vertex.position.x = attrib.vertices[3*size_t(idx.vertex_index)+0];
-          vertex.position.y = attrib.vertices[3*size_t(idx.vertex_index)+1];
-          vertex.position.z = attrib.vertices[3*size_t(idx.vertex_index)+2];
-    
-          // Check if `normal_index` is zero or positive. negative = no normal data
-          if (idx.normal_index >= 0) {
-            vertex.normal.x = attrib.normals[3*size_t(idx.normal_index)+0];
-            vertex.normal.y = attrib.normals[3*size_t(idx.normal_index)+1];
-            vertex.normal.z = attrib.normals[3*size_t(idx.normal_index)+2];
-          }
-    
-          // Check if `texcoord_index` is zero or positive. negative = no texcoord data
-          if (idx.texcoord_index >= 0) {
-            vertex.uv.x = attrib.texcoords[2*size_t(idx.texcoord_index)+0];
-            vertex.uv.y = attrib.texcoords[2*size_t(idx.texcoord_index)+1];
-          }
-    
-          // Optional: vertex colors
-          // tinyobj::real_t red   = attrib.colors[3*size_t(idx.vertex_index)+0];
-          // tinyobj::real_t green = attrib.colors[3*size_t(idx.vertex_index)+1];
-          // tinyobj::real_t blue  = attrib.colors[3*size_t(idx.vertex_index)+2];
-          mesh.materialBatches[shapes[s].mesh.material_ids[f]].vertices.push_back(vertex);
-          mesh.materialBatches[shapes[s].mesh.material_ids[f]].indices.push_back(static_cast<uint32_t>(mesh.materialBatches[shapes[s].mesh.material_ids[f]].indices.size()));
+    // Counting pass, then a fill pass that sorts the triangles into per material
+    // buckets. Bucket 0 holds the triangles without a material.
+    size_t cornerCount = obj.indices.size();
+    size_t bucketCount = obj.materials.size() + 1;
+    std::vector<uint32_t> bucketOffsets(bucketCount + 1, 0);
+    for (int32_t materialId : obj.materialIds)
+        bucketOffsets[materialId + 2]++;
+    for (size_t b = 1; b <= bucketCount; b++)
+        bucketOffsets[b] += bucketOffsets[b - 1];
+    std::vector<uint32_t> bucketTriangles(obj.materialIds.size());
+    std::vector<uint32_t> bucketCursors(bucketOffsets.begin(), bucketOffsets.end() - 1);
+    for (uint32_t triangle = 0; triangle < obj.materialIds.size(); triangle++)
+        bucketTriangles[bucketCursors[obj.materialIds[triangle] + 1]++] = triangle;
+
+    for (size_t b = 0; b < bucketCount; b++)
+    {
+        if (bucketOffsets[b + 1] > bucketOffsets[b])
+        {
+            mesh.materialBatches.emplace_back();
+            mesh.materialBatches.back().materialId = static_cast<int32_t>(b) - 1;
+        }
+    }
+
+    // Batches are welded independently, corners with the same position, normal and uv share a vertex.
+    // Each batch is then reordered for the post-transform cache, overdraw and vertex fetch,
+    // given a chain of simplified levels, split into meshlets in that order, and compressed when a
+    // compressed format was requested.
+    std::vector<EfgMeshOptimizeStats> optimizeStats(mesh.materialBatches.size());
+    std::vector<std::vector<EfgCompressedVertex>>& compressedVertices = import.compressedVertices;
+    compressedVertices.resize(mesh.materialBatches.size());
+    auto weldBatch = [&](size_t b) {
+        EfgInstanceBatch& batch = mesh.materialBatches[b];
+        size_t bucket = static_cast<size_t>(batch.materialId + 1);
+        size_t batchCorners = size_t(bucketOffsets[bucket + 1] - bucketOffsets[bucket]) * 3;
+        EfgVertexWelder welder(batch.vertices, batchCorners);
+        batch.indices.reserve(batchCorners);
+        for (uint32_t t = bucketOffsets[bucket]; t < bucketOffsets[bucket + 1]; t++)
+        {
+            for (size_t corner = size_t(bucketTriangles[t]) * 3; corner < size_t(bucketTriangles[t]) * 3 + 3; corner++)
+            {
+                const EfgObjIndex& index = obj.indices[corner];
+                Vertex vertex;
+                vertex.position = XMFLOAT3(&obj.positions[3 * size_t(index.position)]);
+                if (index.normal >= 0)
+                    vertex.normal = XMFLOAT3(&obj.normals[3 * size_t(index.normal)]);
+                if (index.texcoord >= 0)
+                    vertex.uv = XMFLOAT2(&obj.texcoords[2 * size_t(index.texcoord)]);
+                batch.indices.push_back(welder.Add(vertex));
+            }
+        }
+        optimizeStats[b] = efgOptimizeMesh(batch.vertices, batch.indices);
+        batch.lodCount = efgBuildLods(batch.lods, EfgMaxLods, batch.indices, batch.vertices.data(), batch.vertices.size());
+        efgBuildMeshlets(batch.meshlets, batch.indices.data(), batch.lods[0].indexCount, batch.vertices.data(), batch.vertices.size());
+        batch.vertexFormat = vertexFormat;
+        if (vertexFormat != efgVertexFormat_FLOAT)
+        {
+            batch.quantization = efgComputeVertexQuantization(batch.vertices.data(), batch.vertices.size(), vertexFormat);
+            compressedVertices[b].resize(batch.vertices.size());
+            efgCompressVertices(compressedVertices[b].data(), batch.vertices.data(), batch.vertices.size(), vertexFormat, batch.quantization);
+        }
+    };
+    std::vector<std::future<void>> weldTasks;
+    for (size_t b = 1; b < mesh.materialBatches.size(); b++)
+        weldTasks.push_back(m_threadPool.Submit([&weldBatch, b]() { weldBatch(b); }));
+    if (!mesh.materialBatches.empty())
+        weldBatch(0);
+    for (std::future<void>& task : weldTasks)
+        task.get();
+
+    size_t vertexCount = 0;
+    size_t meshletCount = 0;
+    size_t lodTriangles[EfgMaxLods] = {};
+    uint32_t vertexStride = efgGetVertexStride(vertexFormat);
+    for (size_t b = 0; b < mesh.materialBatches.size(); b++)
+    {
+        EfgInstanceBatch& batch = mesh.materialBatches[b];
+        const void* vertices = (vertexFormat != efgVertexFormat_FLOAT) ?
+            static_cast<const void*>(compressedVertices[b].data()) : static_cast<const void*>(batch.vertices.data());
+        batch.indexCount = batch.lods[0].indexCount;
+        vertexCount += batch.vertices.size();
+        meshletCount += batch.meshlets.meshlets.size();
+        for (uint32_t l = 0; l < batch.lodCount; l++)
+            lodTriangles[l] += batch.lods[l].indexCount / 3;
+
+        XMVECTOR boundsMin = XMLoadFloat3(&batch.vertices[0].position);
+        XMVECTOR boundsMax = boundsMin;
+        for (const Vertex& vertex : batch.vertices)
+        {
+            XMVECTOR position = XMLoadFloat3(&vertex.position);
+            boundsMin = XMVectorMin(boundsMin, position);
+            boundsMax = XMVectorMax(boundsMax, position);
+        }
+        XMStoreFloat3(&batch.boundsMin, boundsMin);
+        XMStoreFloat3(&batch.boundsMax, boundsMax);
+        cacheWriter.AddBatch(batch.materialId, vertexFormat, batch.quantization, vertices, static_cast<uint32_t>(batch.vertices.size()),
+            batch.indices, batch.lodCount, batch.lods, batch.meshlets, batch.boundsMin, batch.boundsMax);
+    }
+
+    if (vertexCount > 0)
+    {
+        std::cout << "LoadFromObj: welded " << cornerCount << " corners into " << vertexCount << " vertices ("
+            << static_cast<double>(cornerCount) / vertexCount << " corners per vertex)" << std::endl;
+
+        EfgMeshOptimizeStats totalStats;
+        for (const EfgMeshOptimizeStats& stats : optimizeStats)
+        {
+            totalStats.before.Add(stats.before);
+            totalStats.after.Add(stats.after);
+        }
+        std::cout << "LoadFromObj: vertex cache ACMR " << totalStats.before.acmr << " -> " << totalStats.after.acmr
+            << ", ATVR " << totalStats.before.atvr << " -> " << totalStats.after.atvr << std::endl;
+        std::cout << "LoadFromObj: " << meshletCount << " meshlets, " << static_cast<double>(cornerCount) / 3 / meshletCount
+            << " triangles per meshlet" << std::endl;
+        // Batches that stop simplifying early leave the later levels short.
+        std::cout << "LoadFromObj: LOD triangles";
+        for (uint32_t l = 0; l < EfgMaxLods && lodTriangles[l] > 0; l++)
+            std::cout << ((l == 0) ? " " : " / ") << lodTriangles[l];
+        std::cout << std::endl;
+        if (vertexFormat != efgVertexFormat_FLOAT)
+        {
+            std::cout << "LoadFromObj: vertex buffers compressed from " << vertexCount * sizeof(Vertex) / 1024 << " KB to "
+                << vertexCount * vertexStride / 1024 << " KB" << std::endl;
+        }
+    }
+
+    // A cache missing a source would never be invalidated, so it isn't written then.
+    bool sourcesStamped = cacheWriter.AddSource(m_vfs, file);
+    for (const std::filesystem::path& library : obj.materialLibraries)
+        sourcesStamped = cacheWriter.AddSource(m_vfs, library) && sourcesStamped;
+    if (!sourcesStamped || !cacheWriter.Write(cachePath))
+        std::cerr << "LoadFromObj: could not write the mesh cache for " << file << std::endl;
+
+    return true;
+}
+
+EfgImportMesh EfgContext::CreateImportMesh(EfgObjImport& import)
+{
+    if (import.cache.IsOpen())
+    {
+        EfgImportMesh cachedMesh = LoadFromMeshCache(import);
+        import.cache.Close();
+        return cachedMesh;
+    }
+
+    // GPU buffers are created once, after every batch is complete.
+    EfgImportMesh mesh = std::move(import.mesh);
+    AddImportMaterials(mesh, import.materials, import.diffuseTextures, import.streamTextures, import.priority);
+    for (size_t b = 0; b < mesh.materialBatches.size(); b++)
+    {
+        EfgInstanceBatch& batch = mesh.materialBatches[b];
+        uint32_t vertexStride = efgGetVertexStride(batch.vertexFormat);
+        const void* vertices = (batch.vertexFormat != efgVertexFormat_FLOAT) ?
+            static_cast<const void*>(import.compressedVertices[b].data()) : static_cast<const void*>(batch.vertices.data());
+        batch.vertexBuffer = CreateVertexBuffer(vertices, static_cast<UINT>(batch.vertices.size() * vertexStride), vertexStride);
+        batch.indexBuffer = CreateIndexBuffer<uint32_t>(batch.indices.data(), static_cast<uint32_t>(batch.indices.size()));
+    }
+    return mesh;
+}
+
+EfgImportMesh EfgContext::LoadFromGlb(const char* file, EFG_VERTEX_FORMAT vertexFormat)
+{
+    auto loadStart = std::chrono::steady_clock::now();
+    EfgGltfScene scene;
+    std::string error;
+    if (!efgParseGltf(file, m_vfs, scene, error))
+    {
+        std::cerr << "LoadFromGlb: " << error << std::endl;
+        exit(1);
+    }
+    std::chrono::duration<double, std::milli> parseMs = std::chrono::steady_clock::now() - loadStart;
+
+    EfgImportMesh mesh;
+    mesh.constants.isInstanced = true;
+    mesh.constants.useTransform = true;
+
+    std::vector<EfgMaterialBuffer> materials;
+    std::vector<std::string> diffuseTextures;
+    std::vector<EfgEmbeddedImage> embeddedImages;
+    std::vector<size_t> embeddedOf(scene.images.size(), SIZE_MAX);
+    std::vector<size_t> materialEmbedded(scene.materials.size(), SIZE_MAX);
+    for (const EfgGltfMaterial& gltfMaterial : scene.materials)
+    {
+        EfgMaterialBuffer material;
+        material.diffuse = XMFLOAT4(gltfMaterial.baseColor[0], gltfMaterial.baseColor[1], gltfMaterial.baseColor[2], 0.0f);
+        material.emission = XMFLOAT4(gltfMaterial.emissive[0], gltfMaterial.emissive[1], gltfMaterial.emissive[2], 0.0f);
+        material.dissolve = gltfMaterial.baseColor[3];
+        material.metallic = gltfMaterial.metallic;
+        material.roughness = gltfMaterial.roughness;
+        std::string texPath;
+        if (gltfMaterial.baseColorImage >= 0)
+        {
+            material.diffuseMapFlag = 1;
+            const EfgGltfImage& image = scene.images[gltfMaterial.baseColorImage];
+            if (image.data != nullptr)
+            {
+                size_t& embedded = embeddedOf[gltfMaterial.baseColorImage];
+                if (embedded == SIZE_MAX)
+                {
+                    std::string name = std::string(file) + " image " + std::to_string(gltfMaterial.baseColorImage);
+                    embedded = embeddedImages.size();
+                    embeddedImages.push_back({ image.data, image.size, std::wstring(name.begin(), name.end()) });
+                }
+                materialEmbedded[materials.size()] = embedded;
+            }
+            else
+            {
+                texPath = image.path.string();
+            }
         }
-        index_offset += fv;
-      }
+        materials.push_back(material);
+        diffuseTextures.push_back(texPath);
+    }
+    AddImportMaterials(mesh, materials, diffuseTextures, false, 0.0f);
+    // Embedded images have no file to share them by, so they skip the texture cache and
+    // are only shared within the file.
+    std::vector<EfgTexture> embeddedTextures = DecodeTextures({}, false, embeddedImages);
+    for (size_t m = 0; m < materialEmbedded.size(); m++)
+    {
+        if (materialEmbedded[m] != SIZE_MAX)
+            mesh.textures[m].diffuse_map = embeddedTextures[materialEmbedded[m]];
+    }
 
-      for (size_t m = 0; m < mesh.materialBatches.size(); m++)
-      {
-        if (mesh.materialBatches[m].vertices.size() > 0)
+    std::vector<std::vector<XMMATRIX>> meshInstances(scene.meshes.size());
+    for (const EfgGltfInstance& instance : scene.instances)
+        meshInstances[instance.mesh].push_back(XMLoadFloat4x4(reinterpret_cast<const XMFLOAT4X4*>(instance.transform)));
+
+    // Streams laid out like Vertex and 32-bit indices are uploaded from the file as they are.
+    size_t streamCount = 0;
+    size_t zeroCopyStreams = 0;
+    size_t vertexCount = 0;
+    size_t triangleCount = 0;
+    std::vector<Vertex> vertices;
+    std::vector<EfgCompressedVertex> compressedVertices;
+    std::vector<uint32_t> indices;
+    for (size_t m = 0; m < scene.meshes.size(); m++)
+    {
+        // Meshes no node of the scene places are left out.
+        if (meshInstances[m].empty())
+            continue;
+        uint32_t instanceCount = static_cast<uint32_t>(meshInstances[m].size());
+        EfgBuffer instanceBuffer = CreateStructuredBuffer<XMMATRIX>(meshInstances[m].data(), instanceCount);
+        for (const EfgGltfPrimitive& primitive : scene.meshes[m].primitives)
         {
-            mesh.materialBatches[m].vertexBuffer = CreateVertexBuffer<Vertex>(mesh.materialBatches[m].vertices.data(), static_cast<uint32_t>(mesh.materialBatches[m].vertices.size()));
-            mesh.materialBatches[m].indexBuffer = CreateIndexBuffer<uint32_t>(mesh.materialBatches[m].indices.data(), static_cast<uint32_t>(mesh.materialBatches[m].indices.size()));
-            mesh.materialBatches[m].indexCount = static_cast<uint32_t>(mesh.materialBatches[m].indices.size());
+            uint32_t primitiveVertexCount = primitive.positions.count;
+            if (primitiveVertexCount == 0)
+                continue;
+            mesh.materialBatches.emplace_back();
+            EfgInstanceBatch& batch = mesh.materialBatches.back();
+            batch.materialId = primitive.material;
+            batch.vertexFormat = vertexFormat;
+            batch.instanceCount = instanceCount;
+            batch.instanceBuffer = instanceBuffer;
+
+            const void* vertexData = (vertexFormat == efgVertexFormat_FLOAT) ?
+                efgGetGltfInterleavedVertices(primitive, static_cast<uint32_t>(sizeof(Vertex)), static_cast<uint32_t>(offsetof(Vertex, normal)), static_cast<uint32_t>(offsetof(Vertex, uv))) : nullptr;
+            if (vertexData != nullptr)
+            {
+                zeroCopyStreams++;
+            }
+            else
+            {
+                vertices.resize(primitiveVertexCount);
+                for (uint32_t v = 0; v < primitiveVertexCount; v++)
+                {
+                    Vertex& vertex = vertices[v];
+                    vertex.position = XMFLOAT3(efgReadGltfFloat(primitive.positions, v, 0), efgReadGltfFloat(primitive.positions, v, 1), efgReadGltfFloat(primitive.positions, v, 2));
+                    vertex.normal = XMFLOAT3(efgReadGltfFloat(primitive.normals, v, 0), efgReadGltfFloat(primitive.normals, v, 1), efgReadGltfFloat(primitive.normals, v, 2));
+                    vertex.uv = XMFLOAT2(efgReadGltfFloat(primitive.texcoords, v, 0), efgReadGltfFloat(primitive.texcoords, v, 1));
+                }
+                vertexData = vertices.data();
+                if (vertexFormat != efgVertexFormat_FLOAT)
+                {
+                    batch.quantization = efgComputeVertexQuantization(vertices.data(), vertices.size(), vertexFormat);
+                    compressedVertices.resize(vertices.size());
+                    efgCompressVertices(compressedVertices.data(), vertices.data(), vertices.size(), vertexFormat, batch.quantization);
+                    vertexData = compressedVertices.data();
+                }
+            }
+            uint32_t vertexStride = efgGetVertexStride(vertexFormat);
+            batch.vertexBuffer = CreateVertexBuffer(vertexData, primitiveVertexCount * vertexStride, vertexStride);
+
+            const uint32_t* indexData = efgGetGltfIndices32(primitive);
+            batch.indexCount = (primitive.indices.count > 0) ? primitive.indices.count : primitiveVertexCount;
+            if (indexData != nullptr)
+            {
+                zeroCopyStreams++;
+            }
+            else
+            {
+                // Narrower indices are widened, unindexed primitives draw their vertices in order.
+                indices.resize(batch.indexCount);
+                for (uint32_t i = 0; i < batch.indexCount; i++)
+                    indices[i] = (primitive.indices.count > 0) ? efgReadGltfIndex(primitive.indices, i) : i;
+                indexData = indices.data();
+            }
+            batch.indexBuffer = CreateIndexBuffer<uint32_t>(indexData, batch.indexCount);
+            batch.lods[0].indexCount = batch.indexCount;
+            batch.boundsMin = XMFLOAT3(primitive.positions.min);
+            batch.boundsMax = XMFLOAT3(primitive.positions.max);
+
+            streamCount += 2;
+            vertexCount += primitiveVertexCount;
+            triangleCount += batch.indexCount / 3;
         }
-      }
     }
 
+    std::chrono::duration<double, std::milli> loadMs = std::chrono::steady_clock::now() - loadStart;
+    std::cout << "LoadFromGlb: " << file << " parsed in " << parseMs.count() << " ms, loaded in " << loadMs.count() << " ms, "
+        << mesh.materialBatches.size() << " batches, " << vertexCount << " vertices, " << triangleCount << " triangles, "
+        << scene.instances.size() << " instances" << std::endl;
+    if (streamCount > 0)
+        std::cout << "LoadFromGlb: " << zeroCopyStreams << " of " << streamCount << " streams uploaded straight from the file" << std::endl;
+    if (scene.skippedPrimitives > 0)
+        std::cout << "LoadFromGlb: skipped " << scene.skippedPrimitives << " point and line primitives" << std::endl;
     return mesh;
 }
+
+static uint64_t GetImportSize(const EfgObjImport& import)
+{
+    uint64_t size = 0;
+    if (import.cache.IsOpen())
+    {
+        for (uint32_t b = 0; b < import.cache.GetBatchCount(); b++)
+        {
+            const EfgMeshCacheBatch& cached = import.cache.GetBatch(b);
+            size += uint64_t(cached.vertexCount) * cached.vertexStride + uint64_t(cached.indexCount) * sizeof(uint32_t);
+        }
+        return size;
+    }
+    for (const EfgInstanceBatch& batch : import.mesh.materialBatches)
+        size += uint64_t(batch.vertices.size()) * efgGetVertexStride(batch.vertexFormat) + uint64_t(batch.indices.size()) * sizeof(uint32_t);
+    return size;
+}
+
+EfgStreamedMesh EfgContext::StreamFromObj(const char* basePath, const char* file, EFG_VERTEX_FORMAT vertexFormat, float priority)
+{
+    EfgStreamedMesh streamed;
+    auto mesh = std::make_shared<std::promise<EfgImportMesh>>();
+    streamed.mesh = mesh->get_future().share();
+    bool hasBasePath = (basePath != nullptr);
+    std::string base = hasBasePath ? basePath : "";
+    std::string path = file;
+    streamed.request = m_assetStreamer.Submit(priority, [this, mesh, hasBasePath, base, path, vertexFormat, priority]() {
+        auto import = std::make_shared<EfgObjImport>();
+        import->streamTextures = true;
+        import->priority = priority;
+        std::string error;
+        try
+        {
+            if (!ImportObj(hasBasePath ? base.c_str() : nullptr, path.c_str(), vertexFormat, *import, error))
+                throw std::runtime_error(error);
+        }
+        catch (...)
+        {
+            std::cerr << "StreamFromObj: could not import " << path << " " << error << std::endl;
+            mesh->set_exception(std::current_exception());
+            return;
+        }
+        QueueStreamedUpload(GetImportSize(*import), [this, mesh, import]() {
+            // Runs out of reserved descriptors when the materials have more textures than were reserved.
+            try
+            {
+                mesh->set_value(CreateImportMesh(*import));
+            }
+            catch (...)
+            {
+                mesh->set_exception(std::current_exception());
+            }
+        });
+    });
+    return streamed;
+}
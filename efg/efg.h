@@ -8,14 +8,22 @@
 #include <d3d12.h>
 #include <dxgi1_6.h>
 #include <D3Dcompiler.h>
+#include <d3d12shader.h>
 #include <DirectXMath.h>
-#include <ResourceUploadBatch.h>
+#include <DDSTextureLoader.h>
 #include <WICTextureLoader.h>
 #include <string>
 #include <wrl.h>
 #include <shellapi.h>
 #include <memory>
 #include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
 
 #include "../DirectX-Headers/include/directx/d3dx12.h"
 #include "DXHelper.h"
@@ -24,6 +32,22 @@
 #include "efg_resources.h"
 #include "efg_lighting.h"
 #include "efg_gameObject.h"
+#include "efg_pipelineCache.h"
+#include "efg_threadPool.h"
+#include "efg_shaderCache.h"
+#include "efg_shaderReflection.h"
+#include "efg_shaderArchive.h"
+#include "efg_fileWatcher.h"
+#include "efg_pipelineState.h"
+#include "efg_meshCache.h"
+#include "efg_meshlet.h"
+#include "efg_meshSimplifier.h"
+#include "efg_vertexCompression.h"
+#include "efg_assetStreamer.h"
+#include "efg_textureCache.h"
+#include "efg_ddsFile.h"
+#include "efg_mipResidency.h"
+#include "efg_vfs.h"
 
 using namespace DirectX;
 using Microsoft::WRL::ComPtr;
@@ -42,6 +66,7 @@ enum EFG_RANGE_TYPE
 {
     efgRange_CBV,
     efgRange_SRV,
+    efgRange_UAV,
     efgRange_SAMPLER
 };
 
@@ -54,11 +79,20 @@ enum EFG_ROOT_PARAMETER_TYPE
     efgRootParamter_UAV
 };
 
-struct EfgPSOInternal
+// What a draw does with a pipeline that is still being created asynchronously.
+enum EFG_PSO_POLICY
 {
-    ComPtr<ID3D12RootSignature> rootSignature;
-    ComPtr<ID3D12PipelineState> pipelineState;
-    D3D12_GRAPHICS_PIPELINE_STATE_DESC desc = {};
+    efgPSO_WAIT,
+    efgPSO_SKIP
+};
+
+// How often a resource is rebound. Generated root signatures place the
+// most frequently changing parameters first.
+enum EFG_UPDATE_FREQUENCY
+{
+    efgUpdate_PER_DRAW,
+    efgUpdate_PER_MATERIAL,
+    efgUpdate_PER_FRAME
 };
 
 struct EfgPSO
@@ -69,7 +103,11 @@ struct EfgPSO
 struct EfgShader
 {
     std::wstring source;
+    std::string entryPoint;
+    std::string target;
+    std::vector<EfgShaderDefine> defines;
     ComPtr<ID3DBlob> byteCode;
+    std::vector<EfgShaderBinding> bindings;
 };
 
 struct EfgProgram
@@ -78,22 +116,186 @@ struct EfgProgram
     EfgShader pixelShader;
 };
 
+struct EfgPSOInternal
+{
+    ComPtr<ID3D12RootSignature> rootSignature;
+    ComPtr<ID3D12PipelineState> pipelineState;
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC desc = {};
+    // Owns the bytecode desc points at.
+    EfgProgram program;
+    // Only valid for pipelines created asynchronously.
+    std::shared_future<void> ready;
+    EFG_PSO_POLICY policy = efgPSO_WAIT;
+    uint64_t rootSignatureHash = 0;
+    EfgPipelineStateDesc state;
+};
+
+// Pipelines created so far, so identical descriptions share one pipeline object.
+// Keeps its own copy of the bytecode, hot reload may replace the program of the PSO.
+// Entries of pipelines replaced by a reload are removed when the new one is swapped in.
+struct EfgPipelineLookupEntry
+{
+    EfgPipelineStateDesc state;
+    uint64_t rootSignatureHash = 0;
+    ComPtr<ID3DBlob> vertexShader;
+    ComPtr<ID3DBlob> pixelShader;
+    ComPtr<ID3D12PipelineState> pipelineState;
+};
+
+// A pipeline rebuilt by hot reload, waiting for the next frame boundary.
+struct EfgReloadedPSO
+{
+    ComPtr<ID3D12PipelineState> pipelineState;
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC desc = {};
+    EfgProgram program;
+};
+
+struct EfgRetiredPSO
+{
+    ComPtr<ID3D12PipelineState> pipelineState;
+    UINT64 fenceValue = 0;
+};
+
+struct EfgPSOVariants
+{
+    uint64_t handle = 0;
+};
+
+// A program specialized on feature keywords. Bit i of a variant mask compiles it with
+// keywords[i] defined, so per-object branches are resolved when the shader is compiled.
+struct EfgProgramVariantsDesc
+{
+    std::wstring vertexShader;
+    std::string vertexEntryPoint = "Main";
+    std::string vertexTarget = "vs_5_0";
+    std::wstring pixelShader;
+    std::string pixelEntryPoint = "Main";
+    std::string pixelTarget = "ps_5_0";
+    std::vector<std::string> keywords;
+    // Keywords each stage reads. The others are stripped, so a stage is compiled once
+    // for all variants that only differ in keywords of the other stage.
+    uint32_t vertexKeywords = ~0u;
+    uint32_t pixelKeywords = ~0u;
+    // Compiling more variants than this throws, it catches masks built from per-object data.
+    uint32_t maxVariants = 16;
+    EfgPipelineStateDesc state;
+    // Also builds the root signature for the EFG_COMPRESSED_VERTEX vertex stage, so
+    // variants can be requested with a compressed input layout.
+    bool compressedVertices = false;
+};
+
+class EfgRootSignature;
+
+struct EfgPSOVariantsInternal
+{
+    EfgProgramVariantsDesc desc;
+    EfgRootSignature* rootSignature = nullptr;
+    EFG_PSO_POLICY policy = efgPSO_WAIT;
+    // All variants share the root signature, it is built from the bindings of the
+    // variants without and with every keyword.
+    std::shared_future<void> rootSignatureReady;
+    std::mutex mutex;
+    // Vertex shaders are keyed by mask and compressed input, variants by mask and input layout.
+    std::unordered_map<uint64_t, std::shared_future<EfgShader>> vertexShaders;
+    std::unordered_map<uint32_t, std::shared_future<EfgShader>> pixelShaders;
+    std::unordered_map<uint64_t, EfgPSO> variants;
+};
+
 struct EfgInstanceBatch
 {
+    // Index into the materialBuffers and textures of the mesh, -1 for faces without a material.
+    int32_t materialId = -1;
     EfgBuffer vertexBuffer = {};
     EfgBuffer indexBuffer = {};
     uint32_t indexCount = 0;
+    // Compressed batches are drawn with efgGetInputLayout(vertexFormat) and bind quantization
+    // as the VertexQuantization cbuffer.
+    EFG_VERTEX_FORMAT vertexFormat = efgVertexFormat_FLOAT;
+    EfgVertexQuantization quantization;
+    // Only filled on OBJ import, batches loaded from the mesh cache or a GLB upload straight from the file.
+    // Always full precision, the vertex buffer holds the compressed copy.
     std::vector<Vertex> vertices;
     std::vector<uint32_t> indices;
+    XMFLOAT3 boundsMin = XMFLOAT3(0.0f, 0.0f, 0.0f);
+    XMFLOAT3 boundsMax = XMFLOAT3(0.0f, 0.0f, 0.0f);
+    // The index buffer holds every level, indexCount is the first. Draw a level with
+    // DrawIndexedInstanced(lod.indexCount, instances, lod.firstIndex).
+    uint32_t lodCount = 1;
+    EfgMeshLod lods[EfgMaxLods] = {};
+    // Clusters of the full detail level with their culling bounds, also loaded from the mesh cache.
+    EfgMeshlets meshlets;
+    // Placements of GLB meshes, XMMATRIX transforms for the instances buffer of an
+    // instanced draw, DrawIndexedInstanced(indexCount, instanceCount). Shared by the
+    // batches of one glTF mesh. OBJ batches have none.
+    uint32_t instanceCount = 1;
+    EfgBuffer instanceBuffer = {};
 };
 
 struct EfgImportMesh
 {
     std::vector<EfgBuffer> materialBuffers;
     std::vector<EfgMaterialTextures> textures;
-    std::unordered_map<size_t, EfgInstanceBatch> materialBatches;
+    // One batch per material that has faces, in material order, or one per primitive of a GLB.
+    std::vector<EfgInstanceBatch> materialBatches;
     ObjectConstants constants;
-    EfgBuffer constantsBuffer;
+};
+
+// An image file already in memory, e.g. in a GLB. The name is only used in errors.
+struct EfgEmbeddedImage
+{
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    std::wstring name;
+};
+
+// CPU half of an OBJ load, either an open mesh cache or the processed batches without
+// their buffers. Filled on a streaming worker for StreamFromObj.
+struct EfgObjImport
+{
+    EfgMeshCache cache;
+    EfgImportMesh mesh;
+    std::vector<EfgMaterialBuffer> materials;
+    std::vector<std::string> diffuseTextures;
+    std::vector<std::vector<EfgCompressedVertex>> compressedVertices;
+    // Material textures of streamed meshes are streamed as well, at the mesh's priority.
+    bool streamTextures = false;
+    float priority = 0.0f;
+};
+
+// A texture that shows a 1x1 grey placeholder until its file is loaded.
+struct EfgStreamedTexture
+{
+    EfgTexture texture;
+    // Ready in the Frame() that records the copy, holds the error when the file could not be loaded.
+    std::shared_future<void> loaded;
+    EfgAssetStreamer::Request request = 0;
+};
+
+struct EfgStreamedMesh
+{
+    // Ready in the Frame() that records the copies, draws from then on see the buffers.
+    std::shared_future<EfgImportMesh> mesh;
+    EfgAssetStreamer::Request request = 0;
+};
+
+// A streamed asset decoded by a worker, waiting for Frame() to record its copy.
+struct EfgStreamedUpload
+{
+    uint64_t size = 0;
+    std::function<void()> upload;
+};
+
+// A reserved texture whose finer mips stream in and out, each mapped to a heap of its own.
+struct EfgMipStreamedTexture
+{
+    std::shared_ptr<EfgDdsFile> file;
+    // Larger side of mip 0, for turning reported pixels into mips.
+    uint32_t size = 0;
+    D3D12_PACKED_MIP_INFO packedMips = {};
+    std::vector<D3D12_SUBRESOURCE_TILING> tilings;
+    // Holds the packed mip tail and the standard mips from the base mip on.
+    ComPtr<ID3D12Heap> baseHeap;
+    std::vector<ComPtr<ID3D12Heap>> mipHeaps;
 };
 
 struct ShaderRegisters
@@ -107,7 +309,8 @@ struct ShaderRegisters
 class EfgDescriptorRange
 {
 public:
-    EfgDescriptorRange(EFG_RANGE_TYPE type, uint32_t baseRegister, uint32_t descriptors = 0) : rangeType(type), baseShaderRegister(baseRegister), numDescriptors(descriptors) {};
+    EfgDescriptorRange(EFG_RANGE_TYPE type, uint32_t baseRegister, uint32_t descriptors = 0, D3D12_DESCRIPTOR_RANGE_FLAGS rangeFlags = D3D12_DESCRIPTOR_RANGE_FLAG_NONE)
+        : rangeType(type), baseShaderRegister(baseRegister), numDescriptors(descriptors), flags(rangeFlags) {};
     template<typename TYPE> void insert(TYPE& efgResource) {
         EfgResource* resource = reinterpret_cast<EfgResource*>(efgResource.handle);
         if (numDescriptors == 0)
@@ -116,12 +319,16 @@ public:
             heapOffset = resource->heapOffset;
         numDescriptors++;
     };
-    D3D12_DESCRIPTOR_RANGE Commit(uint32_t rangeOffset);
+    D3D12_DESCRIPTOR_RANGE1 Commit(uint32_t rangeOffset);
     EFG_RANGE_TYPE GetType() { return rangeType; }
 
     uint32_t numDescriptors = 0;
     UINT heapOffset = 0;
     UINT rangeOffset = 0;
+    // Root signature 1.1 volatility hints. NONE keeps the 1.1 defaults
+    // (static descriptors, data static while set at execute).
+    D3D12_DESCRIPTOR_RANGE_FLAGS flags = D3D12_DESCRIPTOR_RANGE_FLAG_NONE;
+    uint32_t registerSpace = 0;
 private:
     EFG_RANGE_TYPE rangeType;
     uint32_t baseShaderRegister = 0;
@@ -130,7 +337,8 @@ private:
 class EfgRootParameter
 {
 public:
-    EfgRootParameter(EFG_ROOT_PARAMETER_TYPE efgType)
+    EfgRootParameter(EFG_ROOT_PARAMETER_TYPE efgType, D3D12_SHADER_VISIBILITY shaderVisibility = D3D12_SHADER_VISIBILITY_ALL)
+        : visibility(shaderVisibility)
     {
         switch (efgType)
         {
@@ -166,6 +374,7 @@ public:
             {
             case efgRange_CBV:
             case efgRange_SRV:
+            case efgRange_UAV:
                 data.heapType = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
                 break;
             case efgRange_SAMPLER:
@@ -181,20 +390,41 @@ public:
         ranges.push_back(range.Commit((UINT)ranges.size()));
         data.descriptorSize += range.numDescriptors;
     };
-    D3D12_ROOT_PARAMETER Commit(ShaderRegisters& registerIndex);
+    // Reserves TYPE as inline 32-bit root constants. Only valid on efgRootParameter_CONSTANT.
+    template<typename TYPE> void insertConstants() {
+        static_assert(sizeof(TYPE) % sizeof(uint32_t) == 0, "Root constants must be a multiple of 4 bytes");
+        if (type != D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS)
+            throw("Root parameter is not a constant parameter!");
+        data.num32BitValues += sizeof(TYPE) / sizeof(uint32_t);
+    };
+    // Uses the given register (and the ranges' own base registers) instead of
+    // assigning the next free ones.
+    void SetRegister(uint32_t shaderRegister, uint32_t space = 0) {
+        explicitRegisters = true;
+        data.shaderRegister = shaderRegister;
+        data.registerSpace = space;
+    };
+    D3D12_ROOT_PARAMETER1 Commit(ShaderRegisters& registerIndex);
 
     struct Data {
         UINT offset = 0;
         UINT index = 0;
         UINT descriptorSize = 0;
+        UINT num32BitValues = 0;
+        UINT shaderRegister = 0;
+        UINT registerSpace = 0;
         D3D12_DESCRIPTOR_HEAP_TYPE heapType = {};
     };
 
     D3D12_ROOT_PARAMETER_TYPE type;
+    D3D12_SHADER_VISIBILITY visibility = D3D12_SHADER_VISIBILITY_ALL;
+    // Only used by root CBV/SRV/UAV parameters.
+    D3D12_ROOT_DESCRIPTOR_FLAGS descriptorFlags = D3D12_ROOT_DESCRIPTOR_FLAG_NONE;
     Data data;
 
 private:
-    std::vector<D3D12_DESCRIPTOR_RANGE> ranges;
+    bool explicitRegisters = false;
+    std::vector<D3D12_DESCRIPTOR_RANGE1> ranges;
 };
 
 class EfgRootSignature
@@ -206,13 +436,38 @@ public:
         if(parameter.type == D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE)
             descriptorTables.push_back(parameter);
     };
-    ComPtr<ID3DBlob> Serialize();
+    // Bakes the sampler into the root signature; it no longer needs a sampler heap table.
+    // A negative register assigns the next free one.
+    void insert(EfgSampler& sampler, D3D12_SHADER_VISIBILITY visibility = D3D12_SHADER_VISIBILITY_PIXEL, int32_t shaderRegister = -1, uint32_t space = 0);
+    ComPtr<ID3DBlob> Serialize(D3D_ROOT_SIGNATURE_VERSION maxVersion);
+
+    // Hints for EfgContext::CreateRootSignature(rootSignature, program). Resources
+    // without a hint are treated as per-frame.
+    void SetUpdateFrequency(const char* name, EFG_UPDATE_FREQUENCY frequency) { frequencies[name] = frequency; };
+    void SetStaticSampler(const char* name, EfgSampler sampler) { samplers[name] = sampler; };
+
+    struct Binding {
+        UINT index = 0;
+        D3D12_ROOT_PARAMETER_TYPE type = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+    };
+    // Returns nullptr for names the program does not use, e.g. ones the compiler stripped.
+    const Binding* FindBinding(const char* name) const {
+        auto binding = bindings.find(name);
+        return (binding != bindings.end()) ? &binding->second : nullptr;
+    };
+
     void Destroy() { rootSignature.Reset(); };
     ComPtr<ID3D12RootSignature>& Get() { return rootSignature; }
+    // Hash of the serialized blob, part of the pipeline cache key.
+    uint64_t hash = 0;
     std::vector<EfgRootParameter> descriptorTables = {};
-    std::vector<D3D12_ROOT_PARAMETER> rootParameters = {};
+    std::vector<D3D12_ROOT_PARAMETER1> rootParameters = {};
+    std::vector<D3D12_STATIC_SAMPLER_DESC> staticSamplers = {};
+    std::unordered_map<std::string, EFG_UPDATE_FREQUENCY> frequencies = {};
+    std::unordered_map<std::string, EfgSampler> samplers = {};
+    std::unordered_map<std::string, Binding> bindings = {};
 private:
-    D3D12_ROOT_SIGNATURE_DESC rootSignatureDesc = {};
+    D3D12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc = {};
     ComPtr<ID3D12RootSignature> rootSignature;
     ShaderRegisters registers = {};
 };
@@ -221,15 +476,35 @@ class EfgContext
 {
 public:
 	void initialize(HWND window);
-    EfgBuffer CreateVertexBuffer(void const* data, UINT size);
+    // Meshes, textures and shaders under mountPoint are read from the archive efgPacker
+    // wrote, the rest from disk. Mount before loading anything, hot reloading only sees
+    // shaders that aren't packed.
+    bool MountArchive(const std::filesystem::path& archive, const std::filesystem::path& mountPoint = {}) { return m_vfs.Mount(archive, mountPoint); }
+    EfgVfsStats GetVfsStats() const { return m_vfs.GetStats(); }
+    EfgBuffer CreateVertexBuffer(void const* data, UINT size, UINT stride = sizeof(Vertex));
     EfgBuffer CreateIndexBuffer(void const* data, UINT size);
     EfgBuffer CreateConstantBuffer(void const* data, UINT size);
     EfgBuffer CreateStructuredBuffer(void const* data, UINT size, uint32_t numElements, size_t stride);
     EfgTexture CreateDepthBuffer(uint32_t width, uint32_t height);
     EfgTexture CreateShadowMap(uint32_t width, uint32_t height);
     EfgTexture CreateTexture2D();
+    // .dds files from efgTextureCooker upload their block compressed mips as they are.
     EfgTexture CreateTexture2DFromFile(const wchar_t* filename);
+    // Decodes every file at once on the thread pool, then uploads them with one submission.
+    std::vector<EfgTexture> CreateTextures2DFromFiles(const std::vector<std::wstring>& filenames);
+    // Six face images, or a single cube map .dds.
     EfgTexture CreateTextureCube(const std::vector<std::wstring>& filenames);
+    // Cached loads share one texture per file, each call adds a reference. Misses of one call
+    // are decoded as a batch, see CreateTextures2DFromFiles.
+    EfgTexture AcquireTexture2D(const wchar_t* filename);
+    std::vector<EfgTexture> AcquireTextures2D(const std::vector<std::wstring>& filenames);
+    EfgStreamedTexture AcquireStreamedTexture2D(const wchar_t* filename, float priority = 0.0f);
+    // The last reference frees the texture's memory, its descriptor keeps showing the
+    // placeholder. Mip streamed textures have a single reference and give their tiles back
+    // to the mip budget. Other textures that weren't acquired are left alone.
+    void ReleaseTexture(EfgTexture texture);
+    void SetTextureContentHashing(bool enabled) { m_textureCache.SetContentHashing(enabled); }
+    const EfgTextureCache::Stats& GetTextureCacheStats() const { return m_textureCache.GetStats(); }
     EfgTexture CreateCubeShadowMap(uint32_t width, uint32_t height);
     EfgSampler CreateTextureSampler();
     EfgSampler CreateDepthCubeSampler();
@@ -239,6 +514,7 @@ public:
     void ClearRenderTargetView(EfgTexture texture);
     void ClearDepthStencilView(EfgTexture texture);
     void CreateRootSignature(EfgRootSignature& rootSignature);
+    void CreateRootSignature(EfgRootSignature& rootSignature, const EfgProgram& program);
     void UpdateConstantBuffer(EfgBuffer& buffer, void const* data, UINT size);
     void UpdateStructuredBuffer(EfgBuffer& buffer, void const* data, UINT size);
     void BindVertexBuffer(EfgBuffer buffer);
@@ -246,17 +522,72 @@ public:
     void Bind2DTexture(uint32_t index, const EfgTexture& texture);
     void BindConstantBuffer(uint32_t index, const EfgBuffer& buffer);
     void BindStructuredBuffer(uint32_t index, const EfgBuffer& buffer);
+    void BindRootConstants(uint32_t index, void const* data, uint32_t num32BitValues, uint32_t offset = 0);
     void BindRootDescriptorTable(EfgRootSignature& rootSignature);
+    void Bind2DTexture(const EfgRootSignature& rootSignature, const char* name, const EfgTexture& texture);
+    void BindConstantBuffer(const EfgRootSignature& rootSignature, const char* name, const EfgBuffer& buffer);
+    void BindStructuredBuffer(const EfgRootSignature& rootSignature, const char* name, const EfgBuffer& buffer);
+    void BindRootConstants(const EfgRootSignature& rootSignature, const char* name, void const* data, uint32_t num32BitValues);
     EfgResult CommitShaderResources();
-    EfgShader CreateShader(LPCWSTR fileName, LPCSTR target, LPCSTR entryPoint = "Main");
-    EfgPSO CreateGraphicsPipelineState(EfgProgram program, EfgRootSignature& rootSignature);
-    EfgPSO CreateShadowMapPSO(EfgProgram program, EfgRootSignature rootSignature);
+    EfgShader CreateShader(LPCWSTR fileName, LPCSTR target, LPCSTR entryPoint = "Main", const std::vector<EfgShaderDefine>& defines = {});
+    EfgPSO CreateGraphicsPipelineState(EfgProgram program, EfgRootSignature& rootSignature, const EfgPipelineStateDesc& state = EfgPipelineStateDesc());
+    EfgPSO CreateShadowMapPSO(EfgProgram program, EfgRootSignature& rootSignature);
+    // Async variants run on the worker pool. A PSO is created as soon as its shaders are
+    // compiled, and its root signature is generated from them if it wasn't created yet.
+    // The root signature must outlive the task.
+    std::shared_future<EfgShader> CreateShaderAsync(LPCWSTR fileName, LPCSTR target, LPCSTR entryPoint = "Main", const std::vector<EfgShaderDefine>& defines = {});
+    EfgPSO CreateGraphicsPipelineStateAsync(std::shared_future<EfgShader> vertexShader, std::shared_future<EfgShader> pixelShader, EfgRootSignature& rootSignature, EFG_PSO_POLICY policy = efgPSO_WAIT,
+        const EfgPipelineStateDesc& state = EfgPipelineStateDesc());
+    EfgPSO CreateShadowMapPSOAsync(std::shared_future<EfgShader> vertexShader, EfgRootSignature& rootSignature, EFG_PSO_POLICY policy = efgPSO_WAIT);
+    bool IsPipelineStateReady(EfgPSO pso);
+    // Variants are compiled on first use, or ahead of time by calling GetPipelineVariant
+    // at load. The root signature must outlive the variants.
+    EfgPSOVariants CreatePipelineVariants(const EfgProgramVariantsDesc& desc, EfgRootSignature& rootSignature, EFG_PSO_POLICY policy = efgPSO_WAIT);
+    EfgPSO GetPipelineVariant(EfgPSOVariants variants, uint32_t mask);
+    // Overrides the input layout of the desc, compressed layouts need compressedVertices.
+    EfgPSO GetPipelineVariant(EfgPSOVariants variants, uint32_t mask, EFG_INPUT_LAYOUT inputLayout);
+    // With efgPSO_SKIP and a pipeline that isn't ready, binds and draws are ignored
+    // until the next SetPipelineState.
     void SetPipelineState(EfgPSO pso);
+    void SetPipelineState(EfgPSOVariants variants, uint32_t mask);
+    void SetPipelineState(EfgPSOVariants variants, uint32_t mask, EFG_INPUT_LAYOUT inputLayout);
     void SetRenderTarget(EfgTexture texture, uint32_t offset = 0, EfgTexture* depthStencil = nullptr);
     void SetRenderTargetResolution(uint32_t width, uint32_t height);
     void DrawInstanced(uint32_t vertexCount);
-    void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount = 1);
-    EfgImportMesh LoadFromObj(const char* basePath, const char* file);
+    void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount = 1, uint32_t firstIndex = 0);
+    // Imports once, later loads map the binary mesh cache until the OBJ or its MTL files change.
+    // Compressed formats halve the vertex buffers, the draw needs a matching input layout.
+    EfgImportMesh LoadFromObj(const char* basePath, const char* file, EFG_VERTEX_FORMAT vertexFormat = efgVertexFormat_FLOAT);
+    // glTF 2.0 binaries, e.g. from efgObjToGlb, and .gltf files. Primitives interleaved like
+    // Vertex with 32-bit indices upload straight from the file, others are converted. Every
+    // batch is drawn instanced with its mesh's node transforms, it has one LOD and no meshlets.
+    EfgImportMesh LoadFromGlb(const char* file, EFG_VERTEX_FORMAT vertexFormat = efgVertexFormat_FLOAT);
+    // Streamed loads read, decode and process their files on the streaming workers, lowest
+    // priority first, e.g. the distance to the camera. Frame() records their copies within the
+    // upload budget, so the main thread never waits for a load. Textures are usable at once.
+    EfgStreamedTexture StreamTexture2DFromFile(const wchar_t* filename, float priority = 0.0f);
+    EfgStreamedTexture StreamTextureCube(const std::vector<std::wstring>& filenames, float priority = 0.0f);
+    EfgStreamedMesh StreamFromObj(const char* basePath, const char* file, EFG_VERTEX_FORMAT vertexFormat = efgVertexFormat_FLOAT, float priority = 0.0f);
+    // Only affects loads that haven't started yet.
+    void SetStreamingPriority(EfgAssetStreamer::Request request, float priority);
+    bool CancelStreaming(EfgAssetStreamer::Request request);
+    // Bytes Frame() copies per frame, at least one asset is handed off every frame.
+    void SetStreamingUploadBudget(uint64_t bytesPerFrame) { m_streamUploadBudget = bytesPerFrame; }
+    // Loads only the coarse mips of a .dds from efgTextureCooker. The finer ones stream in
+    // as ReportTextureUsage asks for them and are evicted for more wanted ones once the mip
+    // budget is used up, the view's ResourceMinLODClamp follows them. Without tiled resources
+    // the whole texture is loaded by CreateTexture2DFromFile.
+    EfgTexture CreateMipStreamedTexture2D(const wchar_t* filename);
+    // Screen pixels that one repeat of the texture covers where it is drawn largest this
+    // frame, like pixels per world unit times world units per UV unit. Textures that aren't
+    // reported for a while give up their finer mips first.
+    void ReportTextureUsage(EfgTexture texture, float pixelsPerUv);
+    // Bytes of tiles the mip streamed textures may keep, their coarse mips included.
+    void SetMipStreamingBudget(uint64_t bytes) { m_mipResidency.SetBudget(bytes); }
+    uint64_t GetMipStreamingUsage() const { return m_mipResidency.GetUsage(); }
+    // Textures created after CommitShaderResources, like the materials of streamed meshes,
+    // take their descriptor from this reserve. Call before CommitShaderResources.
+    void ReserveTextureDescriptors(uint32_t count) { m_reservedTextureDescriptors += count; }
     void Frame();
     void Render();
     void OpenCommandList();
@@ -264,11 +595,18 @@ public:
     void WaitForGpu();
     void Destroy();
     void CheckD3DErrors();
+    const EfgPipelineCacheStats& GetPipelineCacheStats() const { return m_pipelineCache.GetStats(); }
+    // Watches the sources of every shader created from now on. Edited shaders are
+    // recompiled in the background and their pipelines swapped in by Frame(). A
+    // pipeline that fails to rebuild keeps its previous version. Shaders whose sources were
+    // edited since are compiled, the others still come from the shader archive.
+    // Shaders are read from shaderDirectory instead of the assets path when it is set.
+    void EnableShaderHotReload(const std::wstring& shaderDirectory = L"");
 
     template<typename TYPE>
     EfgBuffer CreateVertexBuffer(void const* data, uint32_t count)
     {
-        EfgBuffer buffer = CreateVertexBuffer(data, count * sizeof(TYPE));
+        EfgBuffer buffer = CreateVertexBuffer(data, count * sizeof(TYPE), sizeof(TYPE));
         return buffer;
     }
     
@@ -292,6 +630,20 @@ public:
         return CreateStructuredBuffer(data, count * sizeof(TYPE), count, stride);
     }
 
+    template<typename TYPE>
+    void BindRootConstants(uint32_t index, const TYPE& data)
+    {
+        static_assert(sizeof(TYPE) % sizeof(uint32_t) == 0, "Root constants must be a multiple of 4 bytes");
+        BindRootConstants(index, &data, sizeof(TYPE) / sizeof(uint32_t));
+    }
+
+    template<typename TYPE>
+    void BindRootConstants(const EfgRootSignature& rootSignature, const char* name, const TYPE& data)
+    {
+        static_assert(sizeof(TYPE) % sizeof(uint32_t) == 0, "Root constants must be a multiple of 4 bytes");
+        BindRootConstants(rootSignature, name, &data, sizeof(TYPE) / sizeof(uint32_t));
+    }
+
 private:
     void GetHardwareAdapter(
         _In_ IDXGIFactory1* pFactory,
@@ -299,16 +651,48 @@ private:
         bool requestHighPerformanceAdapter = false
     );
     std::wstring GetAssetFullPath(LPCWSTR assetName);
+    std::wstring GetShaderPath(LPCWSTR fileName);
+    std::wstring GetMeshCachePath(const char* basePath, const char* file, EFG_VERTEX_FORMAT vertexFormat);
+    void AddImportMaterials(EfgImportMesh& mesh, const std::vector<EfgMaterialBuffer>& materials, const std::vector<std::string>& diffuseTextures,
+        bool streamTextures, float priority);
+    EfgImportMesh LoadFromMeshCache(const EfgObjImport& import);
+    bool ImportObj(const char* basePath, const char* file, EFG_VERTEX_FORMAT vertexFormat, EfgObjImport& import, std::string& error);
+    EfgImportMesh CreateImportMesh(EfgObjImport& import);
+    ComPtr<ID3D12Resource> GetPlaceholderTexture(bool cube);
+    void QueueStreamedUpload(uint64_t size, std::function<void()> upload);
+    void ProcessStreamedUploads();
+    EfgTextureInternal* TrackStreamedTexture(EfgTexture& texture, bool cube);
+    EfgTexture AddTexture(EfgTextureInternal* textureInternal, bool cube);
+    // Each inner vector holds the files of one texture, see CreateTextureCube. Embedded images
+    // follow as 2D textures, their bytes must stay valid until it returns.
+    std::vector<EfgTexture> DecodeTextures(const std::vector<std::vector<std::wstring>>& textures, bool cube,
+        const std::vector<EfgEmbeddedImage>& embedded = {});
+    uint8_t* ReserveTextureStaging(UINT64 size);
+    void RecordTextureCopy(ID3D12Resource* resource, const D3D12_SUBRESOURCE_DATA* subresources, uint32_t subresourceCount);
+    void SwapStreamedTexture(EfgTextureInternal* texture, ComPtr<ID3D12Resource> resource, bool cube);
+    void MapTiles(ID3D12Resource* resource, UINT subresource, UINT tileCount, ID3D12Heap* heap, UINT heapOffset = 0);
+    void UpdateMipStreaming();
+    void LoadStreamedMip(uint64_t handle, uint32_t mip, float priority);
+    void FinishStreamedMip(uint64_t handle, uint32_t mip, const std::vector<uint8_t>& data);
+    void ReleaseMipStreamedTexture(EfgMipStreamedTexture& streamed, uint64_t handle);
+    void CreateLateTextureView(EfgTextureInternal* texture, bool cube);
     void LoadPipeline();
     void LoadAssets();
     void WaitForPreviousFrame();
 
-    void CompileShader(EfgShader& shader, LPCSTR entryPoint, LPCSTR target);
+    void CompileShader(EfgShader& shader, LPCSTR entryPoint, LPCSTR target, const std::vector<EfgShaderDefine>& defines);
+    std::shared_future<EfgShader> GetVariantShader(EfgPSOVariantsInternal* variants, bool pixelStage, uint32_t mask, bool compressed = false);
+    void CompilePipelineState(EfgPSOInternal* psoInternal, const EfgProgram& program, EfgRootSignature& rootSignature, const EfgPipelineStateDesc& state);
+    EfgPSO TrackPipelineState(EfgPSOInternal* psoInternal);
+    void ReloadShaders(const std::vector<std::filesystem::path>& changedFiles);
+    void ApplyShaderReloads();
+    void CreateRootSignatureOnce(EfgRootSignature& rootSignature, const EfgProgram& program);
     ComPtr<ID3D12DescriptorHeap> CreateDescriptorHeap(uint32_t numDescriptors, D3D12_DESCRIPTOR_HEAP_TYPE type);
 
 
     void CreateBuffer(void const* data, EfgBufferInternal& buffer, EFG_CPU_ACCESS cpuAccess, D3D12_RESOURCE_STATES finalState);
     void CopyBuffer(EfgResource* dest, ComPtr<ID3D12Resource> src, UINT size, D3D12_RESOURCE_STATES current, D3D12_RESOURCE_STATES final);
+    void RecordBufferCopy(EfgResource* dest, ComPtr<ID3D12Resource> src, UINT size, D3D12_RESOURCE_STATES final);
     ComPtr<ID3D12Resource> CreateBufferResource(EFG_CPU_ACCESS cpuAccess, UINT size);
     void TransitionResourceState(EfgResource* resource, D3D12_RESOURCE_STATES currentState, D3D12_RESOURCE_STATES newState);
     EfgResult CreateCbvSrvDescriptorHeap(uint32_t numDescriptors);
@@ -348,6 +732,7 @@ private:
     UINT m_cbvSrvDescriptorSize = 0;
     UINT m_samplerDescriptorSize = 0;
     UINT m_dsvDescriptorSize = 0;
+    D3D_ROOT_SIGNATURE_VERSION m_rootSignatureVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
     uint32_t m_cbvDescriptorCount = 0;
     uint32_t m_srvDescriptorCount = 0;
     uint32_t m_dsvDescriptorCount = 0;
@@ -365,6 +750,53 @@ private:
     std::list<EfgBufferInternal*> m_indexBuffers = {};
     std::list<EfgBufferInternal*> m_vertexBuffers = {};
     std::list<EfgPSOInternal*> m_pipelineStates = {};
+    std::list<EfgPSOVariantsInternal*> m_pipelineVariants = {};
+    EfgVfs m_vfs;
+    EfgPipelineCache m_pipelineCache;
+    EfgShaderCache m_shaderCache;
+    EfgShaderArchive m_shaderArchive;
+    EfgThreadPool m_threadPool;
+    // Guards the object lists and root signature creation from pool workers.
+    std::mutex m_objectMutex;
+    std::mutex m_rootSignatureMutex;
+    EfgFileWatcher m_fileWatcher;
+    std::atomic<bool> m_hotReloadEnabled = false;
+    std::wstring m_shaderDirectory;
+    // Guards the pending reloads, the edited sources and the program and desc of reloadable pipelines.
+    std::mutex m_reloadMutex;
+    // Sources the watcher has seen change, the archive holds their old bytecode.
+    std::unordered_set<std::wstring> m_editedShaderFiles;
+    std::unordered_map<EfgPSOInternal*, EfgReloadedPSO> m_pendingReloads;
+    std::vector<EfgRetiredPSO> m_retiredPipelineStates;
+    std::unordered_multimap<uint64_t, EfgPipelineLookupEntry> m_pipelineLookup;
+    std::mutex m_pipelineLookupMutex;
+    bool m_pipelineSkipped = false;
+
+    EfgAssetStreamer m_assetStreamer;
+    // Guards the uploads the streaming workers hand to Frame().
+    std::mutex m_streamMutex;
+    std::deque<EfgStreamedUpload> m_streamedUploads;
+    // Upload buffers of the copies recorded last frame, the next Frame() releases them.
+    std::vector<ComPtr<ID3D12Resource>> m_streamStaging;
+    uint64_t m_streamUploadBudget = 32ull << 20;
+    // Buffers created while Frame() hands off streamed assets record their copy on the
+    // frame's command list instead of waiting for the GPU.
+    bool m_recordBufferCopies = false;
+    ComPtr<ID3D12Resource> m_placeholderTexture;
+    ComPtr<ID3D12Resource> m_placeholderCube;
+    bool m_shaderResourcesCommitted = false;
+    uint32_t m_reservedTextureDescriptors = 0;
+    uint32_t m_nextReservedDescriptor = 0;
+    uint32_t m_reservedDescriptorEnd = 0;
+    EfgTextureCache m_textureCache;
+    std::unordered_map<uint64_t, EfgMipStreamedTexture> m_mipStreamedTextures;
+    EfgMipResidency m_mipResidency;
+    // Heaps of mips evicted last frame, their tiles are unmapped by the next Frame().
+    std::vector<ComPtr<ID3D12Heap>> m_retiredMipHeaps;
+    // Persistently mapped upload buffer that texture decode batches reuse.
+    ComPtr<ID3D12Resource> m_textureStaging;
+    uint8_t* m_textureStagingData = nullptr;
+    UINT64 m_textureStagingSize = 0;
 
     EfgPSOInternal* m_boundPSO = {};
     EfgVertexBuffer* m_boundVertexBuffer = {};
@@ -0,0 +1,105 @@
+#include "efg_assetStreamer.h"
+
+void EfgAssetStreamer::Initialize(uint32_t threadCount, std::function<void()> threadStart, std::function<void()> threadExit)
+{
+    m_stopping = false;
+    for (uint32_t i = 0; i < threadCount; ++i)
+        m_threads.emplace_back(&EfgAssetStreamer::WorkerLoop, this, threadStart, threadExit);
+}
+
+void EfgAssetStreamer::Destroy()
+{
+    std::unordered_map<Request, Load> dropped;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+        dropped.swap(m_loads);
+        m_queue = {};
+    }
+    m_condition.notify_all();
+    for (std::thread& thread : m_threads)
+        thread.join();
+    m_threads.clear();
+}
+
+EfgAssetStreamer::Request EfgAssetStreamer::Submit(float priority, std::function<void()> load)
+{
+    Request request = 0;
+    bool queued = !m_threads.empty();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        request = m_nextRequest++;
+        if (queued)
+        {
+            m_loads[request] = { priority, m_sequence, std::move(load) };
+            m_queue.push({ priority, m_sequence++, request });
+        }
+    }
+    if (queued)
+        m_condition.notify_one();
+    else
+        load();
+    return request;
+}
+
+bool EfgAssetStreamer::SetPriority(Request request, float priority)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto load = m_loads.find(request);
+    if (load == m_loads.end())
+        return false;
+    if (load->second.priority != priority)
+    {
+        load->second.priority = priority;
+        load->second.sequence = m_sequence;
+        m_queue.push({ priority, m_sequence++, request });
+    }
+    return true;
+}
+
+bool EfgAssetStreamer::Cancel(Request request)
+{
+    Load cancelled;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto load = m_loads.find(request);
+        if (load == m_loads.end())
+            return false;
+        cancelled = std::move(load->second);
+        m_loads.erase(load);
+    }
+    // Destroyed outside the lock, the load may own promises and resources.
+    return true;
+}
+
+size_t EfgAssetStreamer::GetQueuedCount()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_loads.size();
+}
+
+void EfgAssetStreamer::WorkerLoop(std::function<void()> threadStart, std::function<void()> threadExit)
+{
+    if (threadStart)
+        threadStart();
+    for (;;)
+    {
+        std::function<void()> load;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_stopping || !m_queue.empty(); });
+            if (m_stopping)
+                break;
+            Entry entry = m_queue.top();
+            m_queue.pop();
+            auto queued = m_loads.find(entry.request);
+            if (queued == m_loads.end() || queued->second.sequence != entry.sequence)
+                continue;
+            load = std::move(queued->second.function);
+            m_loads.erase(queued);
+        }
+        load();
+    }
+    if (threadExit)
+        threadExit();
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Runs asset loads on its own workers, lowest priority value first, so callers can
+// rank them by distance to the camera. Unlike EfgThreadPool a queued load can still
+// be reprioritized or cancelled. Loads report their own errors and must not throw.
+class EfgAssetStreamer
+{
+public:
+    typedef uint64_t Request;
+
+    // threadStart and threadExit run on every worker, e.g. to set up COM for WIC.
+    void Initialize(uint32_t threadCount, std::function<void()> threadStart = {}, std::function<void()> threadExit = {});
+    // Drops the queued loads, then joins the workers once their current load returns.
+    void Destroy();
+
+    // Runs inline when the streamer has no workers.
+    Request Submit(float priority, std::function<void()> load);
+    // Both return false once the load has started.
+    bool SetPriority(Request request, float priority);
+    bool Cancel(Request request);
+    size_t GetQueuedCount();
+
+private:
+    struct Entry
+    {
+        float priority = 0.0f;
+        uint64_t sequence = 0;
+        Request request = 0;
+    };
+    // Orders the heap lowest priority first, equal priorities in submission order.
+    struct Later
+    {
+        bool operator()(const Entry& a, const Entry& b) const
+        {
+            return (a.priority != b.priority) ? a.priority > b.priority : a.sequence > b.sequence;
+        }
+    };
+    struct Load
+    {
+        float priority = 0.0f;
+        // Of the latest heap entry, earlier ones are stale.
+        uint64_t sequence = 0;
+        std::function<void()> function;
+    };
+
+    void WorkerLoop(std::function<void()> threadStart, std::function<void()> threadExit);
+
+    std::vector<std::thread> m_threads;
+    // Reprioritizing pushes another entry, the stale one is skipped when popped, by
+    // sequence so a priority set back and forth still runs the load once, in order.
+    std::priority_queue<Entry, std::vector<Entry>, Later> m_queue;
+    std::unordered_map<Request, Load> m_loads;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    Request m_nextRequest = 1;
+    uint64_t m_sequence = 0;
+    bool m_stopping = false;
+};
@@ -10,7 +10,7 @@ const float zoomSpeed = 0.1f;
 bool rmbDown = false;
 int prevMouseX, prevMouseY;
 
-Camera efgCreateCamera(EfgContext efg, const XMFLOAT3& eye, const XMFLOAT3& center)
+Camera efgCreateCamera(EfgContext& efg, const XMFLOAT3& eye, const XMFLOAT3& center)
 {
 	Camera camera = {};
 
@@ -35,7 +35,7 @@ Camera efgCreateCamera(EfgContext efg, const XMFLOAT3& eye, const XMFLOAT3& cent
 	return camera;
 }
 
-void efgUpdateCamera(EfgContext efg, EfgWindow window, Camera& camera)
+void efgUpdateCamera(EfgContext& efg, EfgWindow window, Camera& camera)
 {
     // Update camera history
     camera.preView = camera.view;
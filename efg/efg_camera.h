@@ -21,5 +21,5 @@ struct Camera
     float prevYaw, prevPitch;
 };
 
-Camera efgCreateCamera(EfgContext efg, const XMFLOAT3& eye, const XMFLOAT3& center);
-void efgUpdateCamera(EfgContext efg, EfgWindow window, Camera& camera);
+Camera efgCreateCamera(EfgContext& efg, const XMFLOAT3& eye, const XMFLOAT3& center);
+void efgUpdateCamera(EfgContext& efg, EfgWindow window, Camera& camera);
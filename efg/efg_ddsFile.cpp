@@ -0,0 +1,128 @@
+#include "efg_ddsFile.h"
+#include <cstring>
+
+static uint32_t MakeFourCC(char a, char b, char c, char d)
+{
+    return uint32_t(uint8_t(a)) | (uint32_t(uint8_t(b)) << 8) | (uint32_t(uint8_t(c)) << 16) | (uint32_t(uint8_t(d)) << 24);
+}
+
+// Bytes per 4x4 block for block compressed DXGI formats, 0 otherwise.
+static uint32_t GetBlockBytes(uint32_t format)
+{
+    if ((format >= 70 && format <= 72) || (format >= 79 && format <= 81))
+        return 8;  // BC1, BC4
+    if ((format >= 73 && format <= 78) || (format >= 82 && format <= 84) || (format >= 94 && format <= 99))
+        return 16; // BC2, BC3, BC5, BC6H, BC7
+    return 0;
+}
+
+static uint32_t GetTexelBytes(uint32_t format)
+{
+    switch (format)
+    {
+    case 2:  // R32G32B32A32_FLOAT
+        return 16;
+    case 10: // R16G16B16A16_FLOAT
+        return 8;
+    case 27: case 28: case 29: case 30: case 31: case 32: // R8G8B8A8
+    case 87: case 88: case 90: case 91:                   // B8G8R8A8, B8G8R8X8
+        return 4;
+    }
+    return 0;
+}
+
+static uint32_t GetLegacyFormat(const uint32_t* pixelFormat)
+{
+    const uint32_t flags = pixelFormat[1];
+    const uint32_t fourCC = pixelFormat[2];
+    if (flags & 0x4) // DDPF_FOURCC
+    {
+        if (fourCC == MakeFourCC('D', 'X', 'T', '1'))
+            return 71;
+        if (fourCC == MakeFourCC('D', 'X', 'T', '3'))
+            return 74;
+        if (fourCC == MakeFourCC('D', 'X', 'T', '5'))
+            return 77;
+        if (fourCC == MakeFourCC('A', 'T', 'I', '1') || fourCC == MakeFourCC('B', 'C', '4', 'U'))
+            return 80;
+        if (fourCC == MakeFourCC('A', 'T', 'I', '2') || fourCC == MakeFourCC('B', 'C', '5', 'U'))
+            return 83;
+        return 0;
+    }
+    // DDPF_RGB with 32 bits, told apart by where red sits.
+    if ((flags & 0x40) && pixelFormat[3] == 32)
+    {
+        if (pixelFormat[4] == 0x000000ff)
+            return 28;
+        if (pixelFormat[4] == 0x00ff0000)
+            return 87;
+    }
+    return 0;
+}
+
+bool EfgDdsFile::Open(const EfgVfs& vfs, const std::filesystem::path& path)
+{
+    m_surfaces.clear();
+    if (!vfs.Open(path, m_file) || m_file.GetSize() < 128)
+        return false;
+    const uint8_t* data = m_file.GetData();
+    uint32_t header[32];
+    memcpy(header, data, sizeof(header));
+    if (header[0] != MakeFourCC('D', 'D', 'S', ' ') || header[1] != 124)
+        return false;
+
+    m_height = header[3];
+    m_width = header[4];
+    m_mipCount = (header[7] > 0) ? header[7] : 1;
+    bool cube = (header[28] & 0x200) != 0; // DDSCAPS2_CUBEMAP
+    size_t offset = 128;
+    if ((header[20] & 0x4) && header[21] == MakeFourCC('D', 'X', '1', '0'))
+    {
+        if (m_file.GetSize() < 148)
+            return false;
+        uint32_t dx10[5];
+        memcpy(dx10, data + 128, sizeof(dx10));
+        // Only single 2D textures or cubes, no arrays or volumes.
+        if (dx10[1] != 3 || dx10[3] != 1)
+            return false;
+        m_format = dx10[0];
+        cube = (dx10[2] & 0x4) != 0;
+        offset = 148;
+    }
+    else
+    {
+        m_format = GetLegacyFormat(&header[19]);
+    }
+    m_faceCount = cube ? 6 : 1;
+
+    uint32_t blockBytes = GetBlockBytes(m_format);
+    uint32_t texelBytes = GetTexelBytes(m_format);
+    if ((blockBytes == 0 && texelBytes == 0) || m_width == 0 || m_height == 0)
+        return false;
+    for (uint32_t face = 0; face < m_faceCount; ++face)
+    {
+        for (uint32_t mip = 0; mip < m_mipCount; ++mip)
+        {
+            EfgDdsSurface surface;
+            surface.width = (m_width >> mip) > 0 ? (m_width >> mip) : 1;
+            surface.height = (m_height >> mip) > 0 ? (m_height >> mip) : 1;
+            if (blockBytes > 0)
+            {
+                surface.rowPitch = ((surface.width + 3) / 4) * blockBytes;
+                surface.rowCount = (surface.height + 3) / 4;
+            }
+            else
+            {
+                surface.rowPitch = surface.width * texelBytes;
+                surface.rowCount = surface.height;
+            }
+            surface.size = size_t(surface.rowPitch) * surface.rowCount;
+            if (offset + surface.size > m_file.GetSize())
+                return false;
+            surface.data = data + offset;
+            offset += surface.size;
+            m_surfaces.push_back(surface);
+        }
+    }
+    return true;
+}
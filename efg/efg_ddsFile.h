@@ -0,0 +1,42 @@
+#pragma once
+#include "efg_vfs.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One mip of one face, pointing into the mapping.
+struct EfgDdsSurface
+{
+    const uint8_t* data = nullptr;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // Rows of texels, or of 4x4 blocks for block compressed formats.
+    uint32_t rowPitch = 0;
+    uint32_t rowCount = 0;
+    size_t size = 0;
+};
+
+// Maps a DDS file and finds its surfaces without copying them, so single mips can be read
+// on their own. Opened through the VFS, a DDS packed uncompressed stays mapped. Takes 2D textures and cube maps with a DX10 header, as efgTextureCooker
+// writes them, and the common legacy DXTn, ATIn and 32-bit RGBA headers.
+class EfgDdsFile
+{
+public:
+    bool Open(const EfgVfs& vfs, const std::filesystem::path& path);
+    // A DXGI_FORMAT value.
+    uint32_t GetFormat() const { return m_format; }
+    uint32_t GetWidth() const { return m_width; }
+    uint32_t GetHeight() const { return m_height; }
+    uint32_t GetMipCount() const { return m_mipCount; }
+    uint32_t GetFaceCount() const { return m_faceCount; }
+    const EfgDdsSurface& GetSurface(uint32_t face, uint32_t mip) const { return m_surfaces[face * m_mipCount + mip]; }
+
+private:
+    EfgVfsFile m_file;
+    uint32_t m_format = 0;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint32_t m_mipCount = 0;
+    uint32_t m_faceCount = 0;
+    std::vector<EfgDdsSurface> m_surfaces;
+};
@@ -0,0 +1,70 @@
+#include "efg_fileWatcher.h"
+
+namespace fs = std::filesystem;
+
+void EfgFileWatcher::Initialize(Callback callback, std::chrono::milliseconds interval)
+{
+    m_callback = callback;
+    m_interval = interval;
+    m_stopping = false;
+    m_thread = std::thread(&EfgFileWatcher::Run, this);
+}
+
+void EfgFileWatcher::Destroy()
+{
+    if (!m_thread.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+    m_thread.join();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_files.clear();
+}
+
+void EfgFileWatcher::Watch(const fs::path& path)
+{
+    std::error_code error;
+    fs::path canonical = fs::weakly_canonical(path, error);
+    if (error)
+        canonical = path;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::string key = canonical.generic_string();
+    if (m_files.find(key) != m_files.end())
+        return;
+    File file = {};
+    file.path = canonical;
+    file.writeTime = fs::last_write_time(canonical, error);
+    m_files[key] = file;
+}
+
+void EfgFileWatcher::Run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_condition.wait_for(lock, m_interval, [this]() { return m_stopping; }))
+    {
+        std::vector<fs::path> changedFiles;
+        for (auto& entry : m_files)
+        {
+            File& file = entry.second;
+            std::error_code error;
+            fs::file_time_type writeTime = fs::last_write_time(file.path, error);
+            // A file that is missing mid-save is picked up on a later poll.
+            if (error || writeTime == file.writeTime)
+                continue;
+            file.writeTime = writeTime;
+            changedFiles.push_back(file.path);
+        }
+        if (changedFiles.empty())
+            continue;
+
+        // Unlocked, so the callback can watch new files.
+        lock.unlock();
+        m_callback(changedFiles);
+        lock.lock();
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Polls a set of files for changes on its own thread. Polling instead of change
+// notifications also catches editors that save by writing aside and renaming.
+class EfgFileWatcher
+{
+public:
+    using Callback = std::function<void(const std::vector<std::filesystem::path>& changedFiles)>;
+
+    // The callback runs on the watcher thread.
+    void Initialize(Callback callback, std::chrono::milliseconds interval = std::chrono::milliseconds(250));
+    void Destroy();
+    bool IsRunning() const { return m_thread.joinable(); }
+    // Thread safe. Watching a file twice is harmless.
+    void Watch(const std::filesystem::path& path);
+
+private:
+    void Run();
+
+    struct File
+    {
+        std::filesystem::path path;
+        std::filesystem::file_time_type writeTime;
+    };
+
+    Callback m_callback;
+    std::chrono::milliseconds m_interval = {};
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stopping = false;
+    std::unordered_map<std::string, File> m_files;
+};
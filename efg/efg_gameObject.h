@@ -4,11 +4,11 @@
 
 using namespace DirectX;
 
+// Bound as root constants, so no padding to a 16 byte constant buffer slot.
 struct ObjectConstants
 {
 	uint32_t isInstanced = false;
 	uint32_t useTransform = false;
-	float padding[2];
 };
 
 class Transform
@@ -34,7 +34,6 @@ public:
 	EfgBuffer vertexBuffer;
 	EfgBuffer indexBuffer;
 	EfgBuffer transformBuffer;
-	EfgBuffer constantsBuffer;
 };
 
 class InstanceableObject : public GameObject
@@ -0,0 +1,758 @@
+#include "efg_gltf.h"
+#include "efg_json.h"
+#include <cstring>
+
+namespace fs = std::filesystem;
+
+static const uint32_t GlbMagic = 0x46546C67;     // "glTF"
+static const uint32_t GlbChunkJson = 0x4E4F534A; // "JSON"
+static const uint32_t GlbChunkBin = 0x004E4942;  // "BIN\0"
+
+static const char* const SupportedExtensions[] = { "EXT_mesh_gpu_instancing", "KHR_mesh_quantization", "MSFT_texture_dds" };
+
+struct GltfSpan
+{
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
+struct GltfReader
+{
+    const EfgJsonValue& document;
+    fs::path directory;
+    GltfSpan bin;
+    std::vector<GltfSpan> buffers = {};
+    std::string error = {};
+
+    bool Fail(const std::string& message)
+    {
+        if (error.empty())
+            error = message;
+        return false;
+    }
+};
+
+static uint32_t GetComponentSize(uint32_t componentType)
+{
+    switch (componentType)
+    {
+    case efgGltfComponent_BYTE:
+    case efgGltfComponent_UNSIGNED_BYTE:
+        return 1;
+    case efgGltfComponent_SHORT:
+    case efgGltfComponent_UNSIGNED_SHORT:
+        return 2;
+    case efgGltfComponent_UNSIGNED_INT:
+    case efgGltfComponent_FLOAT:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+static uint32_t GetComponentCount(const std::string& type)
+{
+    if (type == "SCALAR")
+        return 1;
+    if (type == "VEC2")
+        return 2;
+    if (type == "VEC3")
+        return 3;
+    if (type == "VEC4")
+        return 4;
+    if (type == "MAT4")
+        return 16;
+    return 0;
+}
+
+static uint32_t GetCount(const EfgJsonValue& value)
+{
+    double count = value.GetNumber(0.0);
+    return (count > 0.0 && count <= 4294967295.0) ? static_cast<uint32_t>(count) : 0;
+}
+
+static int Base64Value(char c)
+{
+    if (c >= 'A' && c <= 'Z')
+        return c - 'A';
+    if (c >= 'a' && c <= 'z')
+        return c - 'a' + 26;
+    if (c >= '0' && c <= '9')
+        return c - '0' + 52;
+    if (c == '+')
+        return 62;
+    if (c == '/')
+        return 63;
+    return -1;
+}
+
+static bool DecodeBase64(const char* p, const char* end, std::vector<uint8_t>& bytes)
+{
+    bytes.reserve((end - p) / 4 * 3);
+    uint32_t bits = 0;
+    int bitCount = 0;
+    for (; p < end && *p != '='; ++p)
+    {
+        int value = Base64Value(*p);
+        if (value < 0)
+            return false;
+        bits = (bits << 6) | static_cast<uint32_t>(value);
+        bitCount += 6;
+        if (bitCount >= 8)
+        {
+            bitCount -= 8;
+            bytes.push_back(static_cast<uint8_t>(bits >> bitCount));
+        }
+    }
+    return true;
+}
+
+static int HexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+// Relative URIs may escape characters like spaces as %20.
+static std::string DecodeUri(const std::string& uri)
+{
+    std::string decoded;
+    for (size_t i = 0; i < uri.size(); ++i)
+    {
+        int high = (uri[i] == '%' && i + 2 < uri.size()) ? HexValue(uri[i + 1]) : -1;
+        int low = (high >= 0) ? HexValue(uri[i + 2]) : -1;
+        if (low >= 0)
+        {
+            decoded += static_cast<char>(high * 16 + low);
+            i += 2;
+        }
+        else
+        {
+            decoded += uri[i];
+        }
+    }
+    return decoded;
+}
+
+// Decodes "data:[mime];base64,..." URIs, others are opened relative to the glTF file.
+static bool LoadUri(GltfReader& reader, const std::string& uri, const EfgVfs& vfs, EfgGltfScene& scene, GltfSpan& span, fs::path* path)
+{
+    if (uri.compare(0, 5, "data:") == 0)
+    {
+        size_t base64 = uri.find(";base64,");
+        if (base64 == std::string::npos)
+            return reader.Fail("data URIs must be base64");
+        scene.dataUris.emplace_back();
+        if (!DecodeBase64(uri.data() + base64 + 8, uri.data() + uri.size(), scene.dataUris.back()))
+            return reader.Fail("invalid base64 in a data URI");
+        span = { scene.dataUris.back().data(), scene.dataUris.back().size() };
+        return true;
+    }
+    fs::path file = reader.directory / fs::u8path(DecodeUri(uri));
+    if (path != nullptr)
+    {
+        *path = file;
+        return true;
+    }
+    scene.bufferFiles.emplace_back();
+    if (!vfs.Open(file, scene.bufferFiles.back()))
+        return reader.Fail("could not open " + file.string());
+    span = { scene.bufferFiles.back().GetData(), scene.bufferFiles.back().GetSize() };
+    return true;
+}
+
+static bool LoadBuffers(GltfReader& reader, const EfgVfs& vfs, EfgGltfScene& scene)
+{
+    const EfgJsonValue& buffers = reader.document["buffers"];
+    reader.buffers.resize(buffers.GetSize());
+    // Spans point into these, they must not reallocate.
+    scene.bufferFiles.reserve(buffers.GetSize());
+    scene.dataUris.reserve(buffers.GetSize());
+    for (size_t b = 0; b < buffers.GetSize(); ++b)
+    {
+        const EfgJsonValue& buffer = buffers[b];
+        uint32_t byteLength = GetCount(buffer["byteLength"]);
+        GltfSpan& span = reader.buffers[b];
+        if (buffer["uri"].IsNull())
+        {
+            // Only the first buffer of a GLB may leave out its URI, it is the BIN chunk.
+            if (b != 0 || reader.bin.data == nullptr)
+                return reader.Fail("buffer " + std::to_string(b) + " has no data");
+            span = reader.bin;
+        }
+        else if (!LoadUri(reader, buffer["uri"].GetString(), vfs, scene, span, nullptr))
+        {
+            return false;
+        }
+        if (span.size < byteLength)
+            return reader.Fail("buffer " + std::to_string(b) + " is shorter than its byteLength");
+        span.size = byteLength;
+    }
+    return true;
+}
+
+static bool GetBufferView(GltfReader& reader, int32_t index, GltfSpan& span, uint32_t& stride)
+{
+    const EfgJsonValue& view = reader.document["bufferViews"][static_cast<size_t>(index)];
+    int32_t buffer = view["buffer"].GetInt();
+    if (view.IsNull() || buffer < 0 || static_cast<size_t>(buffer) >= reader.buffers.size())
+        return reader.Fail("invalid buffer view " + std::to_string(index));
+    uint64_t offset = GetCount(view["byteOffset"]);
+    uint64_t length = GetCount(view["byteLength"]);
+    const GltfSpan& data = reader.buffers[buffer];
+    if (offset + length > data.size)
+        return reader.Fail("buffer view " + std::to_string(index) + " is out of its buffer");
+    span = { data.data + offset, static_cast<size_t>(length) };
+    stride = GetCount(view["byteStride"]);
+    return true;
+}
+
+static bool ReadAccessor(GltfReader& reader, int32_t index, EfgGltfAccessor& accessor)
+{
+    const EfgJsonValue& json = reader.document["accessors"][static_cast<size_t>(index)];
+    std::string name = "accessor " + std::to_string(index);
+    if (index < 0 || json.IsNull())
+        return reader.Fail("missing " + name);
+    if (!json["sparse"].IsNull())
+        return reader.Fail(name + " is sparse, sparse accessors are not supported");
+    uint32_t componentSize = GetComponentSize(json["componentType"].GetInt());
+    accessor.componentCount = GetComponentCount(json["type"].GetString());
+    if (componentSize == 0 || accessor.componentCount == 0)
+        return reader.Fail(name + " has an unsupported type");
+    accessor.componentType = static_cast<EFG_GLTF_COMPONENT>(json["componentType"].GetInt());
+    accessor.count = GetCount(json["count"]);
+    accessor.normalized = json["normalized"].GetBool();
+    uint32_t elementSize = componentSize * accessor.componentCount;
+    accessor.stride = elementSize;
+
+    accessor.bufferView = json["bufferView"].GetInt();
+    if (accessor.bufferView >= 0)
+    {
+        GltfSpan view;
+        uint32_t stride = 0;
+        if (!GetBufferView(reader, accessor.bufferView, view, stride))
+            return false;
+        if (stride != 0)
+        {
+            if (stride < elementSize)
+                return reader.Fail(name + " overlaps itself");
+            accessor.stride = stride;
+        }
+        uint64_t offset = GetCount(json["byteOffset"]);
+        uint64_t end = offset + (accessor.count > 0 ? uint64_t(accessor.stride) * (accessor.count - 1) + elementSize : 0);
+        if (end > view.size)
+            return reader.Fail(name + " is out of its buffer view");
+        accessor.data = view.data + offset;
+    }
+
+    const EfgJsonValue& min = json["min"];
+    const EfgJsonValue& max = json["max"];
+    accessor.hasBounds = min.GetSize() >= accessor.componentCount && max.GetSize() >= accessor.componentCount && accessor.componentCount <= 3;
+    if (accessor.hasBounds)
+    {
+        min.GetFloats(accessor.min, accessor.componentCount);
+        max.GetFloats(accessor.max, accessor.componentCount);
+    }
+    return true;
+}
+
+float efgReadGltfFloat(const EfgGltfAccessor& accessor, uint32_t element, uint32_t component)
+{
+    if (accessor.data == nullptr)
+        return 0.0f;
+    const uint8_t* p = accessor.data + size_t(element) * accessor.stride + size_t(component) * GetComponentSize(accessor.componentType);
+    switch (accessor.componentType)
+    {
+    case efgGltfComponent_BYTE:
+    {
+        float value = static_cast<int8_t>(*p);
+        return accessor.normalized ? ((value / 127.0f > -1.0f) ? value / 127.0f : -1.0f) : value;
+    }
+    case efgGltfComponent_UNSIGNED_BYTE:
+        return accessor.normalized ? *p / 255.0f : *p;
+    case efgGltfComponent_SHORT:
+    {
+        int16_t value;
+        memcpy(&value, p, sizeof(value));
+        return accessor.normalized ? ((value / 32767.0f > -1.0f) ? value / 32767.0f : -1.0f) : value;
+    }
+    case efgGltfComponent_UNSIGNED_SHORT:
+    {
+        uint16_t value;
+        memcpy(&value, p, sizeof(value));
+        return accessor.normalized ? value / 65535.0f : value;
+    }
+    case efgGltfComponent_UNSIGNED_INT:
+    {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return static_cast<float>(value);
+    }
+    default:
+    {
+        float value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+    }
+}
+
+uint32_t efgReadGltfIndex(const EfgGltfAccessor& accessor, uint32_t element)
+{
+    if (accessor.data == nullptr)
+        return 0;
+    const uint8_t* p = accessor.data + size_t(element) * accessor.stride;
+    switch (accessor.componentType)
+    {
+    case efgGltfComponent_UNSIGNED_BYTE:
+        return *p;
+    case efgGltfComponent_UNSIGNED_SHORT:
+    {
+        uint16_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+    default:
+    {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+    }
+}
+
+const uint8_t* efgGetGltfInterleavedVertices(const EfgGltfPrimitive& primitive, uint32_t stride, uint32_t normalOffset, uint32_t texcoordOffset)
+{
+    const EfgGltfAccessor& positions = primitive.positions;
+    const EfgGltfAccessor& normals = primitive.normals;
+    const EfgGltfAccessor& texcoords = primitive.texcoords;
+    bool floats = positions.componentType == efgGltfComponent_FLOAT && normals.componentType == efgGltfComponent_FLOAT
+        && texcoords.componentType == efgGltfComponent_FLOAT;
+    bool present = positions.data != nullptr && normals.data != nullptr && texcoords.data != nullptr;
+    bool interleaved = positions.bufferView == normals.bufferView && positions.bufferView == texcoords.bufferView
+        && positions.stride == stride && normals.stride == stride && texcoords.stride == stride;
+    // The accessors were checked to stay inside the view, so the whole last vertex is in it.
+    if (!floats || !present || !interleaved || normals.data != positions.data + normalOffset || texcoords.data != positions.data + texcoordOffset)
+        return nullptr;
+    return positions.data;
+}
+
+const uint32_t* efgGetGltfIndices32(const EfgGltfPrimitive& primitive)
+{
+    const EfgGltfAccessor& indices = primitive.indices;
+    bool packed = indices.componentType == efgGltfComponent_UNSIGNED_INT && indices.stride == sizeof(uint32_t);
+    // Buffer views and accessors of indices are 4 byte aligned by the spec, mapped files start on a page.
+    if (!packed || indices.data == nullptr || reinterpret_cast<uintptr_t>(indices.data) % alignof(uint32_t) != 0)
+        return nullptr;
+    return reinterpret_cast<const uint32_t*>(indices.data);
+}
+
+static bool ReadPrimitive(GltfReader& reader, const EfgJsonValue& json, size_t materialCount, EfgGltfPrimitive& primitive)
+{
+    const EfgJsonValue& attributes = json["attributes"];
+    if (!ReadAccessor(reader, attributes["POSITION"].GetInt(), primitive.positions))
+        return false;
+    uint32_t vertexCount = primitive.positions.count;
+    if (primitive.positions.componentCount != 3)
+        return reader.Fail("positions must be VEC3");
+    if (!attributes["NORMAL"].IsNull())
+    {
+        if (!ReadAccessor(reader, attributes["NORMAL"].GetInt(), primitive.normals))
+            return false;
+        if (primitive.normals.componentCount != 3 || primitive.normals.count != vertexCount)
+            return reader.Fail("normals must be VEC3, one per position");
+    }
+    if (!attributes["TEXCOORD_0"].IsNull())
+    {
+        if (!ReadAccessor(reader, attributes["TEXCOORD_0"].GetInt(), primitive.texcoords))
+            return false;
+        if (primitive.texcoords.componentCount != 2 || primitive.texcoords.count != vertexCount)
+            return reader.Fail("texcoords must be VEC2, one per position");
+    }
+
+    // Required by the spec, but cheap to recover.
+    if (!primitive.positions.hasBounds && vertexCount > 0)
+    {
+        for (uint32_t c = 0; c < 3; ++c)
+            primitive.positions.min[c] = primitive.positions.max[c] = efgReadGltfFloat(primitive.positions, 0, c);
+        for (uint32_t v = 1; v < vertexCount; ++v)
+        {
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                float value = efgReadGltfFloat(primitive.positions, v, c);
+                primitive.positions.min[c] = (value < primitive.positions.min[c]) ? value : primitive.positions.min[c];
+                primitive.positions.max[c] = (value > primitive.positions.max[c]) ? value : primitive.positions.max[c];
+            }
+        }
+        primitive.positions.hasBounds = true;
+    }
+
+    if (!json["indices"].IsNull())
+    {
+        EfgGltfAccessor& indices = primitive.indices;
+        if (!ReadAccessor(reader, json["indices"].GetInt(), indices))
+            return false;
+        bool unsignedType = indices.componentType == efgGltfComponent_UNSIGNED_BYTE || indices.componentType == efgGltfComponent_UNSIGNED_SHORT
+            || indices.componentType == efgGltfComponent_UNSIGNED_INT;
+        if (indices.componentCount != 1 || !unsignedType || indices.normalized || indices.count % 3 != 0)
+            return reader.Fail("indices must be unsigned scalars, three per triangle");
+        // Checked once here, so loaders can upload the indices as they are.
+        for (uint32_t i = 0; i < indices.count; ++i)
+        {
+            if (efgReadGltfIndex(indices, i) >= vertexCount)
+                return reader.Fail("index out of range");
+        }
+    }
+    else if (vertexCount % 3 != 0)
+    {
+        return reader.Fail("unindexed triangles need three positions each");
+    }
+
+    primitive.material = json["material"].GetInt();
+    if (primitive.material < -1 || (primitive.material >= 0 && static_cast<size_t>(primitive.material) >= materialCount))
+        return reader.Fail("invalid material index");
+    return true;
+}
+
+static bool ReadMaterials(GltfReader& reader, EfgGltfScene& scene)
+{
+    const EfgJsonValue& materials = reader.document["materials"];
+    const EfgJsonValue& textures = reader.document["textures"];
+    size_t imageCount = reader.document["images"].GetSize();
+    for (size_t m = 0; m < materials.GetSize(); ++m)
+    {
+        const EfgJsonValue& json = materials[m];
+        const EfgJsonValue& pbr = json["pbrMetallicRoughness"];
+        EfgGltfMaterial material;
+        material.name = json["name"].GetString();
+        pbr["baseColorFactor"].GetFloats(material.baseColor, 4);
+        material.metallic = pbr["metallicFactor"].GetFloat(1.0f);
+        material.roughness = pbr["roughnessFactor"].GetFloat(1.0f);
+        json["emissiveFactor"].GetFloats(material.emissive, 3);
+        int32_t texture = pbr["baseColorTexture"]["index"].GetInt();
+        if (texture >= 0)
+        {
+            const EfgJsonValue& textureJson = textures[static_cast<size_t>(texture)];
+            // A DDS source is used over the PNG or JPEG fallback, it uploads without decoding.
+            int32_t image = textureJson["extensions"]["MSFT_texture_dds"]["source"].GetInt(textureJson["source"].GetInt());
+            if (textureJson.IsNull() || image < 0 || static_cast<size_t>(image) >= imageCount)
+                return reader.Fail("invalid texture " + std::to_string(texture));
+            material.baseColorImage = image;
+        }
+        scene.materials.push_back(material);
+    }
+    return true;
+}
+
+static bool ReadImages(GltfReader& reader, const EfgVfs& vfs, EfgGltfScene& scene)
+{
+    const EfgJsonValue& images = reader.document["images"];
+    for (size_t i = 0; i < images.GetSize(); ++i)
+    {
+        const EfgJsonValue& json = images[i];
+        EfgGltfImage image;
+        image.mimeType = json["mimeType"].GetString();
+        if (!json["uri"].IsNull())
+        {
+            GltfSpan span;
+            if (!LoadUri(reader, json["uri"].GetString(), vfs, scene, span, &image.path))
+                return false;
+            image.data = span.data;
+            image.size = span.size;
+        }
+        else
+        {
+            GltfSpan span;
+            uint32_t stride = 0;
+            if (!GetBufferView(reader, json["bufferView"].GetInt(), span, stride))
+                return false;
+            image.data = span.data;
+            image.size = span.size;
+        }
+        scene.images.push_back(image);
+    }
+    return true;
+}
+
+static void Multiply(const float* a, const float* b, float* result)
+{
+    for (int row = 0; row < 4; ++row)
+    {
+        for (int column = 0; column < 4; ++column)
+        {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; ++k)
+                sum += a[row * 4 + k] * b[k * 4 + column];
+            result[row * 4 + column] = sum;
+        }
+    }
+}
+
+// Scale, then rotate by the quaternion xyzw, then translate, for row vectors.
+static void ComposeTransform(const float* t, const float* r, const float* s, float* transform)
+{
+    float x = r[0], y = r[1], z = r[2], w = r[3];
+    float rotation[3][3] = {
+        { 1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + z * w), 2.0f * (x * z - y * w) },
+        { 2.0f * (x * y - z * w), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + x * w) },
+        { 2.0f * (x * z + y * w), 2.0f * (y * z - x * w), 1.0f - 2.0f * (x * x + y * y) }
+    };
+    for (int row = 0; row < 3; ++row)
+    {
+        for (int column = 0; column < 3; ++column)
+            transform[row * 4 + column] = s[row] * rotation[row][column];
+        transform[row * 4 + 3] = 0.0f;
+    }
+    transform[12] = t[0];
+    transform[13] = t[1];
+    transform[14] = t[2];
+    transform[15] = 1.0f;
+}
+
+static bool AddInstances(GltfReader& reader, const EfgJsonValue& node, const float* world, EfgGltfScene& scene)
+{
+    uint32_t mesh = static_cast<uint32_t>(node["mesh"].GetInt());
+    if (mesh >= scene.meshes.size())
+        return reader.Fail("invalid mesh index");
+    const EfgJsonValue& instancing = node["extensions"]["EXT_mesh_gpu_instancing"]["attributes"];
+    if (instancing.IsNull())
+    {
+        EfgGltfInstance instance;
+        instance.mesh = mesh;
+        memcpy(instance.transform, world, sizeof(instance.transform));
+        scene.instances.push_back(instance);
+        return true;
+    }
+
+    // Each instance is placed in the node's space, so the node transform comes last.
+    const char* names[3] = { "TRANSLATION", "ROTATION", "SCALE" };
+    const uint32_t componentCounts[3] = { 3, 4, 3 };
+    EfgGltfAccessor attributes[3];
+    uint32_t count = UINT32_MAX;
+    for (int a = 0; a < 3; ++a)
+    {
+        if (instancing[names[a]].IsNull())
+            continue;
+        if (!ReadAccessor(reader, instancing[names[a]].GetInt(), attributes[a]))
+            return false;
+        if (attributes[a].componentCount != componentCounts[a] || (count != UINT32_MAX && attributes[a].count != count))
+            return reader.Fail("invalid EXT_mesh_gpu_instancing attributes");
+        count = attributes[a].count;
+    }
+    if (count == UINT32_MAX)
+        return reader.Fail("EXT_mesh_gpu_instancing without attributes");
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        float values[3][4] = { { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 1.0f, 1.0f, 1.0f } };
+        for (int a = 0; a < 3; ++a)
+        {
+            for (uint32_t c = 0; attributes[a].count > 0 && c < componentCounts[a]; ++c)
+                values[a][c] = efgReadGltfFloat(attributes[a], i, c);
+        }
+        float local[16];
+        ComposeTransform(values[0], values[1], values[2], local);
+        EfgGltfInstance instance;
+        instance.mesh = mesh;
+        Multiply(local, world, instance.transform);
+        scene.instances.push_back(instance);
+    }
+    return true;
+}
+
+static bool ReadNodes(GltfReader& reader, EfgGltfScene& scene)
+{
+    const EfgJsonValue& nodes = reader.document["nodes"];
+    std::vector<int32_t> roots;
+    const EfgJsonValue& scenes = reader.document["scenes"];
+    if (scenes.GetSize() > 0)
+    {
+        const EfgJsonValue& sceneJson = scenes[static_cast<size_t>(reader.document["scene"].GetInt(0))];
+        for (size_t n = 0; n < sceneJson["nodes"].GetSize(); ++n)
+            roots.push_back(sceneJson["nodes"][n].GetInt());
+    }
+    else
+    {
+        // Without scenes every node that isn't a child is drawn.
+        std::vector<bool> isChild(nodes.GetSize(), false);
+        for (size_t n = 0; n < nodes.GetSize(); ++n)
+        {
+            const EfgJsonValue& children = nodes[n]["children"];
+            for (size_t c = 0; c < children.GetSize(); ++c)
+            {
+                int32_t child = children[c].GetInt();
+                if (child >= 0 && static_cast<size_t>(child) < isChild.size())
+                    isChild[child] = true;
+            }
+        }
+        for (size_t n = 0; n < nodes.GetSize(); ++n)
+        {
+            if (!isChild[n])
+                roots.push_back(static_cast<int32_t>(n));
+        }
+    }
+
+    // Depth first with an explicit stack, a node seen twice means the file has a cycle.
+    struct Visit
+    {
+        int32_t node = -1;
+        float parent[16] = {};
+    };
+    static const float Identity[16] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+    std::vector<bool> visited(nodes.GetSize(), false);
+    std::vector<Visit> stack;
+    for (auto root = roots.rbegin(); root != roots.rend(); ++root)
+    {
+        stack.push_back({ *root });
+        memcpy(stack.back().parent, Identity, sizeof(Identity));
+    }
+    while (!stack.empty())
+    {
+        Visit visit = stack.back();
+        stack.pop_back();
+        if (visit.node < 0 || static_cast<size_t>(visit.node) >= nodes.GetSize() || visited[visit.node])
+            return reader.Fail("invalid node hierarchy");
+        visited[visit.node] = true;
+        const EfgJsonValue& node = nodes[static_cast<size_t>(visit.node)];
+
+        float local[16];
+        if (!node["matrix"].IsNull())
+        {
+            // Column major for column vectors is the same memory as row major for row vectors.
+            memcpy(local, Identity, sizeof(local));
+            node["matrix"].GetFloats(local, 16);
+        }
+        else
+        {
+            float t[3] = { 0.0f, 0.0f, 0.0f };
+            float r[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+            float s[3] = { 1.0f, 1.0f, 1.0f };
+            node["translation"].GetFloats(t, 3);
+            node["rotation"].GetFloats(r, 4);
+            node["scale"].GetFloats(s, 3);
+            ComposeTransform(t, r, s, local);
+        }
+        float world[16];
+        Multiply(local, visit.parent, world);
+
+        if (!node["mesh"].IsNull() && !AddInstances(reader, node, world, scene))
+            return false;
+        const EfgJsonValue& children = node["children"];
+        for (size_t c = children.GetSize(); c-- > 0;)
+        {
+            stack.push_back({ children[c].GetInt() });
+            memcpy(stack.back().parent, world, sizeof(world));
+        }
+    }
+    return true;
+}
+
+static bool ReadDocument(GltfReader& reader, const EfgVfs& vfs, EfgGltfScene& scene)
+{
+    const EfgJsonValue& document = reader.document;
+    if (document["asset"]["version"].GetString().compare(0, 2, "2.") != 0)
+        return reader.Fail("only glTF 2.0 is supported");
+    const EfgJsonValue& required = document["extensionsRequired"];
+    for (size_t e = 0; e < required.GetSize(); ++e)
+    {
+        bool supported = false;
+        for (const char* extension : SupportedExtensions)
+            supported = supported || required[e].GetString() == extension;
+        if (!supported)
+            return reader.Fail("requires unsupported extension " + required[e].GetString());
+    }
+
+    if (!LoadBuffers(reader, vfs, scene) || !ReadMaterials(reader, scene) || !ReadImages(reader, vfs, scene))
+        return false;
+
+    const EfgJsonValue& meshes = document["meshes"];
+    for (size_t m = 0; m < meshes.GetSize(); ++m)
+    {
+        scene.meshes.emplace_back();
+        EfgGltfMesh& mesh = scene.meshes.back();
+        mesh.name = meshes[m]["name"].GetString();
+        const EfgJsonValue& primitives = meshes[m]["primitives"];
+        for (size_t p = 0; p < primitives.GetSize(); ++p)
+        {
+            // Mode 4 is a triangle list, the default.
+            if (primitives[p]["mode"].GetInt(4) != 4)
+            {
+                scene.skippedPrimitives++;
+                continue;
+            }
+            mesh.primitives.emplace_back();
+            if (!ReadPrimitive(reader, primitives[p], scene.materials.size(), mesh.primitives.back()))
+            {
+                reader.error = "mesh " + std::to_string(m) + ": " + reader.error;
+                return false;
+            }
+        }
+    }
+    return ReadNodes(reader, scene);
+}
+
+bool efgParseGltf(const fs::path& path, const EfgVfs& vfs, EfgGltfScene& scene, std::string& error)
+{
+    scene = EfgGltfScene();
+    if (!vfs.Open(path, scene.file))
+    {
+        error = "could not open " + path.string();
+        return false;
+    }
+    const uint8_t* data = scene.file.GetData();
+    size_t size = scene.file.GetSize();
+
+    // A GLB is a header and chunks, the JSON chunk first and an optional BIN chunk.
+    GltfSpan json = { data, size };
+    GltfSpan bin;
+    uint32_t header[3] = {};
+    if (size >= sizeof(header))
+        memcpy(header, data, sizeof(header));
+    if (header[0] == GlbMagic)
+    {
+        if (header[1] != 2 || header[2] > size)
+        {
+            error = "unsupported or truncated GLB header in " + path.string();
+            return false;
+        }
+        size = header[2];
+        json = {};
+        for (size_t offset = sizeof(header); offset + 8 <= size;)
+        {
+            uint32_t chunk[2];
+            memcpy(chunk, data + offset, sizeof(chunk));
+            offset += sizeof(chunk);
+            if (chunk[0] > size - offset)
+                break;
+            if (chunk[1] == GlbChunkJson && json.data == nullptr)
+                json = { data + offset, chunk[0] };
+            else if (chunk[1] == GlbChunkBin && bin.data == nullptr)
+                bin = { data + offset, chunk[0] };
+            // Chunks are padded to 4 bytes.
+            offset += (size_t(chunk[0]) + 3) & ~size_t(3);
+        }
+        if (json.data == nullptr)
+        {
+            error = "GLB without a JSON chunk in " + path.string();
+            return false;
+        }
+    }
+
+    EfgJsonValue document;
+    if (!efgParseJson(reinterpret_cast<const char*>(json.data), json.size, document, error))
+    {
+        error = path.string() + ": " + error;
+        return false;
+    }
+    GltfReader reader = { document, path.parent_path(), bin };
+    if (!ReadDocument(reader, vfs, scene))
+    {
+        error = path.string() + ": " + reader.error;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "efg_vfs.h"
+
+// glTF componentType values.
+enum EFG_GLTF_COMPONENT
+{
+    efgGltfComponent_BYTE = 5120,
+    efgGltfComponent_UNSIGNED_BYTE = 5121,
+    efgGltfComponent_SHORT = 5122,
+    efgGltfComponent_UNSIGNED_SHORT = 5123,
+    efgGltfComponent_UNSIGNED_INT = 5125,
+    efgGltfComponent_FLOAT = 5126
+};
+
+// An accessor resolved to where its first element lives in a buffer, checked to stay inside
+// its buffer view. Loaders can upload from data as it is when the layout suits them.
+struct EfgGltfAccessor
+{
+    // Null for accessors without a buffer view, their elements are all zero.
+    const uint8_t* data = nullptr;
+    uint32_t count = 0;
+    EFG_GLTF_COMPONENT componentType = efgGltfComponent_FLOAT;
+    // 1 for SCALAR up to 4 for VEC4.
+    uint32_t componentCount = 0;
+    bool normalized = false;
+    // Bytes from one element to the next, the element size when the view is tightly packed.
+    uint32_t stride = 0;
+    int32_t bufferView = -1;
+    // Positions always have them, other accessors only when the file says so.
+    bool hasBounds = false;
+    float min[3] = { 0.0f, 0.0f, 0.0f };
+    float max[3] = { 0.0f, 0.0f, 0.0f };
+};
+
+// Normalized integers are mapped to [0, 1] or [-1, 1] as the spec says.
+float efgReadGltfFloat(const EfgGltfAccessor& accessor, uint32_t element, uint32_t component);
+uint32_t efgReadGltfIndex(const EfgGltfAccessor& accessor, uint32_t element);
+
+// A triangle list. Missing normals and texcoords have no data and a count of 0.
+struct EfgGltfPrimitive
+{
+    int32_t material = -1;
+    EfgGltfAccessor positions;
+    EfgGltfAccessor normals;
+    EfgGltfAccessor texcoords;
+    // Unindexed primitives have no data and a count of 0, their vertices form the triangles in order.
+    EfgGltfAccessor indices;
+};
+
+// The first vertex when positions, normals and texcoords are floats interleaved in one
+// buffer view, stride bytes per vertex with the normal and texcoord at the given offsets
+// from the position. Null when the vertices have to be converted.
+const uint8_t* efgGetGltfInterleavedVertices(const EfgGltfPrimitive& primitive, uint32_t stride, uint32_t normalOffset, uint32_t texcoordOffset);
+// The indices when they are tightly packed 32-bit values, null when they have to be converted.
+const uint32_t* efgGetGltfIndices32(const EfgGltfPrimitive& primitive);
+
+struct EfgGltfMesh
+{
+    std::string name;
+    std::vector<EfgGltfPrimitive> primitives;
+};
+
+// The metallic roughness model, texture transforms and the other maps are not read.
+struct EfgGltfMaterial
+{
+    std::string name;
+    float baseColor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    float emissive[3] = { 0.0f, 0.0f, 0.0f };
+    float metallic = 1.0f;
+    float roughness = 1.0f;
+    // Index into images, the MSFT_texture_dds source when the texture has one.
+    int32_t baseColorImage = -1;
+};
+
+// An image file next to the glTF, or one embedded in a buffer or data URI.
+struct EfgGltfImage
+{
+    // Resolved against the directory of the glTF file, empty for embedded images.
+    std::filesystem::path path;
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    std::string mimeType;
+};
+
+// One placement of a mesh. Transforms are row major and multiply row vectors like
+// DirectXMath, so they load straight into an XMMATRIX.
+struct EfgGltfInstance
+{
+    uint32_t mesh = 0;
+    float transform[16] = {};
+};
+
+// Accessor and image data point into the files and buffers the scene holds, keep it
+// alive and don't copy it while they are in use.
+struct EfgGltfScene
+{
+    std::vector<EfgGltfMesh> meshes;
+    std::vector<EfgGltfMaterial> materials;
+    std::vector<EfgGltfImage> images;
+    // Every node of the default scene with a mesh, with the parent transforms applied.
+    // EXT_mesh_gpu_instancing nodes add one instance per instanced transform.
+    std::vector<EfgGltfInstance> instances;
+    // Points, lines and strips are skipped.
+    uint32_t skippedPrimitives = 0;
+
+    EfgVfsFile file;
+    std::vector<EfgVfsFile> bufferFiles;
+    std::vector<std::vector<uint8_t>> dataUris;
+};
+
+// Reads a .glb, or a .gltf with external or data URI buffers, through vfs. Coordinates
+// are taken as they are, like OBJ files. Fails on sparse accessors and on required
+// extensions other than EXT_mesh_gpu_instancing, KHR_mesh_quantization and MSFT_texture_dds.
+bool efgParseGltf(const std::filesystem::path& path, const EfgVfs& vfs, EfgGltfScene& scene, std::string& error);
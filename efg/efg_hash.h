@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// 64-bit FNV-1a. Stable across runs and builds, so it can key on-disk caches.
+class EfgHash
+{
+public:
+    void AddBytes(const void* data, size_t size)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            value ^= bytes[i];
+            value *= 1099511628211ull;
+        }
+    }
+
+    // Only for scalars, structs would pull their padding into the hash.
+    template<typename TYPE> void Add(const TYPE& data)
+    {
+        static_assert(std::is_arithmetic<TYPE>::value || std::is_enum<TYPE>::value, "Hash struct members individually");
+        AddBytes(&data, sizeof(TYPE));
+    }
+
+    // Includes the terminator so "ab" + "c" differs from "a" + "bc".
+    void AddString(const char* string)
+    {
+        if (string != nullptr)
+            AddBytes(string, strlen(string));
+        Add<uint8_t>(0);
+    }
+
+    uint64_t Get() const { return value; }
+
+private:
+    uint64_t value = 14695981039346656037ull;
+};
+
+inline uint64_t efgHash(const void* data, size_t size)
+{
+    EfgHash hash;
+    hash.AddBytes(data, size);
+    return hash.Get();
+}
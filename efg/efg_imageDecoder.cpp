@@ -0,0 +1,47 @@
+#include "efg_imageDecoder.h"
+
+using Microsoft::WRL::ComPtr;
+
+bool EfgImageDecoder::Open(const uint8_t* data, size_t size)
+{
+    if (size > MAXDWORD)
+        return false;
+    // The factory is free threaded, every decoder shares it.
+    static ComPtr<IWICImagingFactory> factory;
+    static HRESULT factoryResult = CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory));
+    if (FAILED(factoryResult))
+        return false;
+
+    ComPtr<IWICStream> stream;
+    ComPtr<IWICBitmapDecoder> decoder;
+    ComPtr<IWICBitmapFrameDecode> frame;
+    if (FAILED(factory->CreateStream(&stream)))
+        return false;
+    if (FAILED(stream->InitializeFromMemory(const_cast<BYTE*>(data), static_cast<DWORD>(size))))
+        return false;
+    if (FAILED(factory->CreateDecoderFromStream(stream.Get(), nullptr, WICDecodeMetadataCacheOnDemand, &decoder)))
+        return false;
+    if (FAILED(decoder->GetFrame(0, &frame)))
+        return false;
+    // Converting is deferred, nothing is decoded until CopyPixels.
+    if (FAILED(WICConvertBitmapSource(GUID_WICPixelFormat32bppRGBA, frame.Get(), &m_source)))
+        return false;
+    UINT width = 0;
+    UINT height = 0;
+    if (FAILED(m_source->GetSize(&width, &height)) || width == 0 || height == 0)
+        return false;
+    m_width = width;
+    m_height = height;
+    return true;
+}
+
+bool EfgImageDecoder::Decode(uint8_t* destination, uint32_t rowPitch)
+{
+    if (!m_source)
+        return false;
+    // The last row ends after its pixels, not at the pitch.
+    HRESULT hr = m_source->CopyPixels(nullptr, rowPitch, rowPitch * (m_height - 1) + m_width * 4, destination);
+    // The source reads from the caller's memory until it is released.
+    m_source.Reset();
+    return SUCCEEDED(hr);
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <wincodec.h>
+#include <wrl.h>
+
+// Decodes an image file to RGBA8 with WIC in two steps. Open only reads the header, so
+// the caller can place the pixels, e.g. in a mapped upload buffer, before Decode writes
+// them there. The thread calling either needs COM initialized. The encoded file is read
+// from memory, e.g. an EfgVfsFile, which must stay alive until Decode returns.
+class EfgImageDecoder
+{
+public:
+    bool Open(const uint8_t* data, size_t size);
+    uint32_t GetWidth() const { return m_width; }
+    uint32_t GetHeight() const { return m_height; }
+    // Rows are rowPitch bytes apart, at least GetWidth() * 4.
+    bool Decode(uint8_t* destination, uint32_t rowPitch);
+
+private:
+    Microsoft::WRL::ComPtr<IWICBitmapSource> m_source;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+};
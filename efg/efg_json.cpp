@@ -0,0 +1,298 @@
+#include "efg_json.h"
+#include <charconv>
+#include <cstring>
+
+// Deeper documents are rejected instead of overflowing the stack.
+static const uint32_t MaxDepth = 256;
+
+class EfgJsonParser
+{
+public:
+    EfgJsonParser(const char* text, size_t size) : m_begin(text), m_p(text), m_end(text + size) {}
+
+    bool Parse(EfgJsonValue& root, std::string& error)
+    {
+        if (m_end - m_p >= 3 && memcmp(m_p, "\xEF\xBB\xBF", 3) == 0)
+            m_p += 3;
+        bool parsed = ParseValue(root, 0);
+        SkipSpaces();
+        if (parsed && m_p != m_end)
+            parsed = Fail("unexpected data after the document");
+        if (!parsed)
+            error = m_error + " at offset " + std::to_string(m_p - m_begin);
+        return parsed;
+    }
+
+private:
+    bool Fail(const char* message)
+    {
+        if (m_error.empty())
+            m_error = message;
+        return false;
+    }
+
+    void SkipSpaces()
+    {
+        while (m_p < m_end && (*m_p == ' ' || *m_p == '\t' || *m_p == '\n' || *m_p == '\r'))
+            ++m_p;
+    }
+
+    bool Consume(const char* literal)
+    {
+        size_t length = strlen(literal);
+        if (static_cast<size_t>(m_end - m_p) < length || memcmp(m_p, literal, length) != 0)
+            return false;
+        m_p += length;
+        return true;
+    }
+
+    bool ParseValue(EfgJsonValue& value, uint32_t depth)
+    {
+        SkipSpaces();
+        if (m_p == m_end)
+            return Fail("unexpected end of the document");
+        switch (*m_p)
+        {
+        case '{':
+            return ParseObject(value, depth + 1);
+        case '[':
+            return ParseArray(value, depth + 1);
+        case '"':
+            value.m_type = efgJson_STRING;
+            return ParseString(value.m_string);
+        case 't':
+        case 'f':
+            value.m_type = efgJson_BOOL;
+            value.m_bool = (*m_p == 't');
+            return Consume(value.m_bool ? "true" : "false") || Fail("invalid literal");
+        case 'n':
+            return Consume("null") || Fail("invalid literal");
+        default:
+            value.m_type = efgJson_NUMBER;
+            return ParseNumber(value.m_number);
+        }
+    }
+
+    bool ParseObject(EfgJsonValue& value, uint32_t depth)
+    {
+        if (depth > MaxDepth)
+            return Fail("nested too deeply");
+        value.m_type = efgJson_OBJECT;
+        ++m_p;
+        SkipSpaces();
+        if (m_p < m_end && *m_p == '}')
+        {
+            ++m_p;
+            return true;
+        }
+        for (;;)
+        {
+            SkipSpaces();
+            if (m_p == m_end || *m_p != '"')
+                return Fail("expected a member name");
+            value.m_keys.emplace_back();
+            if (!ParseString(value.m_keys.back()))
+                return false;
+            SkipSpaces();
+            if (m_p == m_end || *m_p++ != ':')
+                return Fail("expected ':'");
+            value.m_elements.emplace_back();
+            if (!ParseValue(value.m_elements.back(), depth))
+                return false;
+            SkipSpaces();
+            if (m_p == m_end)
+                return Fail("unterminated object");
+            char c = *m_p++;
+            if (c == '}')
+                return true;
+            if (c != ',')
+                return Fail("expected ',' or '}'");
+        }
+    }
+
+    bool ParseArray(EfgJsonValue& value, uint32_t depth)
+    {
+        if (depth > MaxDepth)
+            return Fail("nested too deeply");
+        value.m_type = efgJson_ARRAY;
+        ++m_p;
+        SkipSpaces();
+        if (m_p < m_end && *m_p == ']')
+        {
+            ++m_p;
+            return true;
+        }
+        for (;;)
+        {
+            value.m_elements.emplace_back();
+            if (!ParseValue(value.m_elements.back(), depth))
+                return false;
+            SkipSpaces();
+            if (m_p == m_end)
+                return Fail("unterminated array");
+            char c = *m_p++;
+            if (c == ']')
+                return true;
+            if (c != ',')
+                return Fail("expected ',' or ']'");
+        }
+    }
+
+    bool ParseHex4(uint32_t& codePoint)
+    {
+        if (m_end - m_p < 4)
+            return Fail("truncated \\u escape");
+        codePoint = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            char c = *m_p++;
+            codePoint <<= 4;
+            if (c >= '0' && c <= '9')
+                codePoint |= c - '0';
+            else if (c >= 'a' && c <= 'f')
+                codePoint |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F')
+                codePoint |= c - 'A' + 10;
+            else
+                return Fail("invalid \\u escape");
+        }
+        return true;
+    }
+
+    static void AppendUtf8(std::string& text, uint32_t codePoint)
+    {
+        if (codePoint < 0x80)
+        {
+            text += static_cast<char>(codePoint);
+        }
+        else if (codePoint < 0x800)
+        {
+            text += static_cast<char>(0xC0 | (codePoint >> 6));
+            text += static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+        else if (codePoint < 0x10000)
+        {
+            text += static_cast<char>(0xE0 | (codePoint >> 12));
+            text += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            text += static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+        else
+        {
+            text += static_cast<char>(0xF0 | (codePoint >> 18));
+            text += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+            text += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            text += static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+    }
+
+    bool ParseString(std::string& text)
+    {
+        ++m_p;
+        for (;;)
+        {
+            // Runs without escapes are appended at once, glTF strings rarely have any.
+            const char* run = m_p;
+            while (m_p < m_end && *m_p != '"' && *m_p != '\\' && static_cast<unsigned char>(*m_p) >= 0x20)
+                ++m_p;
+            text.append(run, m_p);
+            if (m_p == m_end)
+                return Fail("unterminated string");
+            char c = *m_p++;
+            if (c == '"')
+                return true;
+            if (c != '\\')
+                return Fail("control character in a string");
+            if (m_p == m_end)
+                return Fail("unterminated string");
+            c = *m_p++;
+            switch (c)
+            {
+            case '"': text += '"'; break;
+            case '\\': text += '\\'; break;
+            case '/': text += '/'; break;
+            case 'b': text += '\b'; break;
+            case 'f': text += '\f'; break;
+            case 'n': text += '\n'; break;
+            case 'r': text += '\r'; break;
+            case 't': text += '\t'; break;
+            case 'u':
+            {
+                uint32_t codePoint = 0;
+                if (!ParseHex4(codePoint))
+                    return false;
+                // Characters outside the BMP are escaped as a surrogate pair.
+                if (codePoint >= 0xD800 && codePoint < 0xDC00)
+                {
+                    uint32_t low = 0;
+                    if (!Consume("\\u") || !ParseHex4(low) || low < 0xDC00 || low >= 0xE000)
+                        return Fail("unpaired surrogate");
+                    codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                }
+                else if (codePoint >= 0xDC00 && codePoint < 0xE000)
+                {
+                    return Fail("unpaired surrogate");
+                }
+                AppendUtf8(text, codePoint);
+                break;
+            }
+            default:
+                return Fail("invalid escape");
+            }
+        }
+    }
+
+    bool ParseNumber(double& number)
+    {
+        // from_chars takes no leading '+' and reads hex and inf, JSON has neither.
+        const char* start = m_p;
+        const char* digits = (m_p < m_end && *m_p == '-') ? m_p + 1 : m_p;
+        if (digits == m_end || *digits < '0' || *digits > '9')
+            return Fail("invalid value");
+        std::from_chars_result result = std::from_chars(start, m_end, number);
+        if (result.ec != std::errc())
+            return Fail("invalid number");
+        m_p = result.ptr;
+        return true;
+    }
+
+    const char* m_begin;
+    const char* m_p;
+    const char* m_end;
+    std::string m_error;
+};
+
+static const EfgJsonValue NullValue;
+
+const EfgJsonValue& EfgJsonValue::operator[](size_t index) const
+{
+    if (m_type != efgJson_ARRAY || index >= m_elements.size())
+        return NullValue;
+    return m_elements[index];
+}
+
+const EfgJsonValue& EfgJsonValue::operator[](const char* key) const
+{
+    if (m_type != efgJson_OBJECT)
+        return NullValue;
+    for (size_t i = 0; i < m_keys.size(); ++i)
+    {
+        if (m_keys[i] == key)
+            return m_elements[i];
+    }
+    return NullValue;
+}
+
+void EfgJsonValue::GetFloats(float* values, size_t count) const
+{
+    if (m_type != efgJson_ARRAY)
+        return;
+    for (size_t i = 0; i < count && i < m_elements.size(); ++i)
+        values[i] = m_elements[i].GetFloat(values[i]);
+}
+
+bool efgParseJson(const char* text, size_t size, EfgJsonValue& root, std::string& error)
+{
+    root = EfgJsonValue();
+    EfgJsonParser parser(text, size);
+    return parser.Parse(root, error);
+}
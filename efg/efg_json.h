@@ -0,0 +1,56 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum EFG_JSON_TYPE
+{
+    efgJson_NULL,
+    efgJson_BOOL,
+    efgJson_NUMBER,
+    efgJson_STRING,
+    efgJson_ARRAY,
+    efgJson_OBJECT
+};
+
+// A parsed JSON document, enough for glTF. Lookups that miss return a null value, so
+// optional properties read as their fallback without checks at every level.
+class EfgJsonValue
+{
+public:
+    EFG_JSON_TYPE GetType() const { return m_type; }
+    bool IsNull() const { return m_type == efgJson_NULL; }
+    bool GetBool(bool fallback = false) const { return (m_type == efgJson_BOOL) ? m_bool : fallback; }
+    double GetNumber(double fallback = 0.0) const { return (m_type == efgJson_NUMBER) ? m_number : fallback; }
+    float GetFloat(float fallback = 0.0f) const { return static_cast<float>(GetNumber(fallback)); }
+    // Negative fallbacks mark missing indices.
+    int32_t GetInt(int32_t fallback = -1) const
+    {
+        bool inRange = m_type == efgJson_NUMBER && m_number >= -2147483648.0 && m_number <= 2147483647.0;
+        return inRange ? static_cast<int32_t>(m_number) : fallback;
+    }
+    const std::string& GetString() const { return m_string; }
+
+    // Elements of an array or members of an object.
+    size_t GetSize() const { return m_elements.size(); }
+    const EfgJsonValue& operator[](size_t index) const;
+    const EfgJsonValue& operator[](const char* key) const;
+    // Name of member index of an object.
+    const std::string& GetKey(size_t index) const { return m_keys[index]; }
+    // Fills count floats from an array, keeping values when the array is shorter.
+    void GetFloats(float* values, size_t count) const;
+
+private:
+    friend class EfgJsonParser;
+    EFG_JSON_TYPE m_type = efgJson_NULL;
+    bool m_bool = false;
+    double m_number = 0.0;
+    std::string m_string;
+    std::vector<EfgJsonValue> m_elements;
+    std::vector<std::string> m_keys;
+};
+
+// RFC 8259 JSON after an optional UTF-8 byte order mark. Numbers are read with from_chars,
+// which also takes a few malformed ones like 01.
+bool efgParseJson(const char* text, size_t size, EfgJsonValue& root, std::string& error);
@@ -0,0 +1,177 @@
+#include "efg_lz4.h"
+#include <cstring>
+#include <vector>
+
+static const uint32_t MinMatch = 4;
+// The format ends every block with at least 5 literals, and the last match starts at
+// least 12 bytes before the end.
+static const size_t LastLiterals = 5;
+static const size_t MatchFindLimit = 12;
+static const size_t MaxOffset = 65535;
+// Small inputs get a smaller table, clearing it dominates for small files.
+static const uint32_t MinHashLog = 10;
+static const uint32_t MaxHashLog = 16;
+
+static uint32_t Read32(const uint8_t* p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t HashSequence(uint32_t sequence, uint32_t hashLog)
+{
+    return (sequence * 2654435761u) >> (32 - hashLog);
+}
+
+static uint8_t* WriteLength(uint8_t* out, size_t length)
+{
+    for (; length >= 255; length -= 255)
+        *out++ = 255;
+    *out++ = static_cast<uint8_t>(length);
+    return out;
+}
+
+size_t efgLz4CompressBound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+size_t efgLz4Compress(const uint8_t* source, size_t size, uint8_t* destination, size_t capacity)
+{
+    const uint8_t* end = source + size;
+    const uint8_t* anchor = source;
+    uint8_t* out = destination;
+    uint8_t* outEnd = destination + capacity;
+
+    if (size > MatchFindLimit)
+    {
+        const uint8_t* matchLimit = end - LastLiterals;
+        const uint8_t* searchLimit = end - MatchFindLimit;
+        // Positions are stored relative to source, stale or empty slots fail the compare below.
+        uint32_t hashLog = MinHashLog;
+        while (hashLog < MaxHashLog && (size_t(1) << hashLog) < size)
+            ++hashLog;
+        std::vector<uint32_t> table(size_t(1) << hashLog, 0);
+        const uint8_t* ip = source + 1;
+        while (ip <= searchLimit)
+        {
+            uint32_t sequence = Read32(ip);
+            uint32_t& slot = table[HashSequence(sequence, hashLog)];
+            const uint8_t* match = source + slot;
+            slot = static_cast<uint32_t>(ip - source);
+            if (match >= ip || size_t(ip - match) > MaxOffset || Read32(match) != sequence)
+            {
+                // Skips faster through data that doesn't compress.
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+            while (ip > anchor && match > source && ip[-1] == match[-1])
+            {
+                --ip;
+                --match;
+            }
+            const uint8_t* matchEnd = ip + MinMatch;
+            const uint8_t* reference = match + MinMatch;
+            while (matchEnd < matchLimit && *matchEnd == *reference)
+            {
+                ++matchEnd;
+                ++reference;
+            }
+
+            size_t literalLength = ip - anchor;
+            size_t matchLength = matchEnd - ip - MinMatch;
+            if (size_t(outEnd - out) < 1 + literalLength / 255 + 1 + literalLength + 2 + matchLength / 255 + 1)
+                return 0;
+            uint8_t* token = out++;
+            *token = static_cast<uint8_t>(((literalLength < 15) ? literalLength : 15) << 4);
+            if (literalLength >= 15)
+                out = WriteLength(out, literalLength - 15);
+            memcpy(out, anchor, literalLength);
+            out += literalLength;
+            size_t offset = ip - match;
+            *out++ = static_cast<uint8_t>(offset);
+            *out++ = static_cast<uint8_t>(offset >> 8);
+            *token |= static_cast<uint8_t>((matchLength < 15) ? matchLength : 15);
+            if (matchLength >= 15)
+                out = WriteLength(out, matchLength - 15);
+
+            ip = matchEnd;
+            anchor = ip;
+            if (ip <= searchLimit)
+                table[HashSequence(Read32(ip - 2), hashLog)] = static_cast<uint32_t>(ip - 2 - source);
+        }
+    }
+
+    size_t literalLength = end - anchor;
+    if (size_t(outEnd - out) < 1 + literalLength / 255 + 1 + literalLength)
+        return 0;
+    *out++ = static_cast<uint8_t>(((literalLength < 15) ? literalLength : 15) << 4);
+    if (literalLength >= 15)
+        out = WriteLength(out, literalLength - 15);
+    if (literalLength > 0)
+        memcpy(out, anchor, literalLength);
+    out += literalLength;
+    return out - destination;
+}
+
+static bool ReadLength(const uint8_t*& ip, const uint8_t* ipEnd, size_t& length)
+{
+    uint8_t byte = 0;
+    do
+    {
+        if (ip >= ipEnd)
+            return false;
+        byte = *ip++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+bool efgLz4Decompress(const uint8_t* source, size_t sourceSize, uint8_t* destination, size_t size)
+{
+    const uint8_t* ip = source;
+    const uint8_t* ipEnd = source + sourceSize;
+    uint8_t* op = destination;
+    uint8_t* opEnd = destination + size;
+    while (ip < ipEnd)
+    {
+        uint8_t token = *ip++;
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !ReadLength(ip, ipEnd, literalLength))
+            return false;
+        if (literalLength > size_t(ipEnd - ip) || literalLength > size_t(opEnd - op))
+            return false;
+        if (literalLength > 0)
+            memcpy(op, ip, literalLength);
+        op += literalLength;
+        ip += literalLength;
+        // The last sequence has no match.
+        if (ip == ipEnd)
+            break;
+
+        if (ipEnd - ip < 2)
+            return false;
+        size_t offset = ip[0] | (size_t(ip[1]) << 8);
+        ip += 2;
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !ReadLength(ip, ipEnd, matchLength))
+            return false;
+        matchLength += MinMatch;
+        if (offset == 0 || offset > size_t(op - destination) || matchLength > size_t(opEnd - op))
+            return false;
+        const uint8_t* match = op - offset;
+        if (offset >= matchLength)
+        {
+            memcpy(op, match, matchLength);
+            op += matchLength;
+        }
+        else
+        {
+            // Overlapping matches repeat the last offset bytes.
+            for (size_t i = 0; i < matchLength; ++i)
+                *op++ = match[i];
+        }
+    }
+    return op == opEnd;
+}
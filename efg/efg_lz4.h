@@ -0,0 +1,15 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// LZ4 block format, compatible with liblz4's LZ4_compress_default and
+// LZ4_decompress_safe. Greedy matching with a single hash table, which trades some
+// ratio for speed like liblz4's fast mode. Decompression is the part that runs at load.
+
+// Worst case size of incompressible input.
+size_t efgLz4CompressBound(size_t size);
+// Returns the compressed size, 0 when it doesn't fit in capacity.
+size_t efgLz4Compress(const uint8_t* source, size_t size, uint8_t* destination, size_t capacity);
+// destination receives exactly size bytes. Fails on malformed input without reading or
+// writing out of bounds.
+bool efgLz4Decompress(const uint8_t* source, size_t sourceSize, uint8_t* destination, size_t size);
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+// Read-only mapping of a whole file. The OS pages it in on first touch.
+class EfgMappedFile
+{
+public:
+    EfgMappedFile() = default;
+    ~EfgMappedFile();
+    EfgMappedFile(const EfgMappedFile&) = delete;
+    EfgMappedFile& operator=(const EfgMappedFile&) = delete;
+
+    // Fails on missing or empty files.
+    bool Open(const std::filesystem::path& path);
+    void Close();
+    bool IsOpen() const { return m_data != nullptr; }
+    const uint8_t* GetData() const { return m_data; }
+    size_t GetSize() const { return m_size; }
+
+private:
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    // HANDLEs, kept as void* so the header doesn't need Windows.h.
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#else
+    int m_descriptor = -1;
+#endif
+};
@@ -0,0 +1,339 @@
+#include "efg_meshCache.h"
+#include "efg_hash.h"
+#include <cstddef>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+static const uint32_t MeshCacheMagic = 0x4D534645; // "EFSM"
+// Bump when the layout or the import that produces the streams changes.
+static const uint32_t MeshCacheVersion = 6;
+static const uint64_t StreamAlignment = 16;
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static bool HashFile(const EfgVfs& vfs, const fs::path& path, uint64_t size, uint64_t& hash)
+{
+    if (size == 0)
+    {
+        hash = efgHash(nullptr, 0);
+        return true;
+    }
+    EfgVfsFile file;
+    if (!vfs.Open(path, file))
+        return false;
+    hash = efgHash(file.GetData(), file.GetSize());
+    return true;
+}
+
+// writeTime receives the current time of the file, it differs from the stamp when the
+// file was touched but its content hash still matches.
+static bool IsSourceCurrent(const EfgVfs& vfs, const EfgMeshCacheSource& source, const char* path, int64_t& writeTime)
+{
+    uint64_t size = 0;
+    if (!vfs.Stat(path, size, writeTime) || size != source.size)
+        return false;
+    if (writeTime == source.writeTime)
+        return true;
+    uint64_t hash = 0;
+    return HashFile(vfs, path, size, hash) && hash == source.hash;
+}
+
+// Written so a corrupt offset can't wrap around and pass.
+static bool IsRangeInFile(uint64_t offset, uint64_t size, uint64_t fileSize)
+{
+    return offset <= fileSize && size <= fileSize - offset;
+}
+
+static bool AreIndicesInRange(const uint32_t* indices, uint64_t count, uint32_t limit)
+{
+    uint32_t largest = 0;
+    for (uint64_t i = 0; i < count; ++i)
+        largest = (indices[i] > largest) ? indices[i] : largest;
+    return count == 0 || largest < limit;
+}
+
+// Meshlet ranges stay inside the meshlet streams and every local triangle index inside
+// its meshlet, the culling walks them without further checks.
+static bool AreMeshletsInRange(const uint8_t* data, const EfgMeshCacheBatch& batch)
+{
+    const EfgMeshlet* meshlets = reinterpret_cast<const EfgMeshlet*>(data + batch.meshletOffset);
+    const uint8_t* triangles = data + batch.meshletTriangleOffset;
+    for (uint32_t m = 0; m < batch.meshletCount; ++m)
+    {
+        const EfgMeshlet& meshlet = meshlets[m];
+        if (uint64_t(meshlet.vertexOffset) + meshlet.vertexCount > batch.meshletVertexCount ||
+            uint64_t(meshlet.triangleOffset) + meshlet.triangleCount > batch.meshletTriangleCount)
+        {
+            return false;
+        }
+        const uint8_t* local = triangles + uint64_t(meshlet.triangleOffset) * 3;
+        for (uint32_t i = 0; i < meshlet.triangleCount * 3; ++i)
+        {
+            if (local[i] >= meshlet.vertexCount)
+                return false;
+        }
+    }
+    return true;
+}
+
+uint32_t EfgMeshCacheWriter::AddString(const std::string& string)
+{
+    uint32_t offset = static_cast<uint32_t>(m_strings.size());
+    m_strings.append(string);
+    m_strings.push_back('\0');
+    return offset;
+}
+
+bool EfgMeshCacheWriter::AddSource(const EfgVfs& vfs, const fs::path& path)
+{
+    EfgMeshCacheSource source = {};
+    if (!vfs.Stat(path, source.size, source.writeTime) || !HashFile(vfs, path, source.size, source.hash))
+        return false;
+    source.pathOffset = AddString(path.string());
+    m_sources.push_back(source);
+    return true;
+}
+
+void EfgMeshCacheWriter::AddMaterial(const EfgMaterialBuffer& constants, const std::string& diffuseTexture)
+{
+    EfgMeshCacheMaterial material = {};
+    material.constants = constants;
+    if (!diffuseTexture.empty())
+        material.diffuseTextureOffset = AddString(diffuseTexture);
+    m_materials.push_back(material);
+}
+
+void EfgMeshCacheWriter::AddBatch(int32_t materialId, EFG_VERTEX_FORMAT vertexFormat, const EfgVertexQuantization& quantization,
+    const void* vertices, uint32_t vertexCount, const std::vector<uint32_t>& indices, uint32_t lodCount, const EfgMeshLod* lods,
+    const EfgMeshlets& meshlets,
+    const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax)
+{
+    Batch batch = {};
+    batch.batch.materialId = materialId;
+    batch.batch.vertexFormat = vertexFormat;
+    batch.batch.vertexStride = efgGetVertexStride(vertexFormat);
+    batch.batch.quantization = quantization;
+    batch.batch.vertexCount = vertexCount;
+    batch.batch.indexCount = static_cast<uint32_t>(indices.size());
+    batch.batch.lodCount = lodCount;
+    for (uint32_t l = 0; l < lodCount; ++l)
+        batch.batch.lods[l] = lods[l];
+    batch.batch.meshletCount = static_cast<uint32_t>(meshlets.meshlets.size());
+    batch.batch.meshletVertexCount = static_cast<uint32_t>(meshlets.vertices.size());
+    batch.batch.meshletTriangleCount = static_cast<uint32_t>(meshlets.triangles.size() / 3);
+    batch.batch.boundsMin = boundsMin;
+    batch.batch.boundsMax = boundsMax;
+    batch.vertices = vertices;
+    batch.indices = &indices;
+    batch.meshlets = &meshlets;
+    m_batches.push_back(batch);
+}
+
+bool EfgMeshCacheWriter::Write(const fs::path& path) const
+{
+    EfgMeshCacheHeader header = {};
+    header.magic = MeshCacheMagic;
+    header.version = MeshCacheVersion;
+    header.sourceCount = static_cast<uint32_t>(m_sources.size());
+    header.materialCount = static_cast<uint32_t>(m_materials.size());
+    header.batchCount = static_cast<uint32_t>(m_batches.size());
+    header.sourcesOffset = sizeof(EfgMeshCacheHeader);
+    header.materialsOffset = header.sourcesOffset + m_sources.size() * sizeof(EfgMeshCacheSource);
+    header.batchesOffset = header.materialsOffset + m_materials.size() * sizeof(EfgMeshCacheMaterial);
+    header.stringsOffset = header.batchesOffset + m_batches.size() * sizeof(EfgMeshCacheBatch);
+    header.stringsSize = m_strings.size();
+
+    std::vector<EfgMeshCacheBatch> batches;
+    uint64_t offset = header.stringsOffset + header.stringsSize;
+    for (const Batch& batch : m_batches)
+    {
+        EfgMeshCacheBatch entry = batch.batch;
+        entry.vertexOffset = AlignUp(offset, StreamAlignment);
+        entry.indexOffset = AlignUp(entry.vertexOffset + uint64_t(entry.vertexCount) * entry.vertexStride, StreamAlignment);
+        entry.meshletOffset = AlignUp(entry.indexOffset + uint64_t(entry.indexCount) * sizeof(uint32_t), StreamAlignment);
+        entry.meshletVertexOffset = AlignUp(entry.meshletOffset + uint64_t(entry.meshletCount) * sizeof(EfgMeshlet), StreamAlignment);
+        entry.meshletTriangleOffset = AlignUp(entry.meshletVertexOffset + uint64_t(entry.meshletVertexCount) * sizeof(uint32_t), StreamAlignment);
+        offset = entry.meshletTriangleOffset + uint64_t(entry.meshletTriangleCount) * 3;
+        batches.push_back(entry);
+    }
+
+    std::error_code error;
+    fs::create_directories(path.parent_path(), error);
+    fs::path temporaryPath = path;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(m_sources.data()), m_sources.size() * sizeof(EfgMeshCacheSource));
+        file.write(reinterpret_cast<const char*>(m_materials.data()), m_materials.size() * sizeof(EfgMeshCacheMaterial));
+        file.write(reinterpret_cast<const char*>(batches.data()), batches.size() * sizeof(EfgMeshCacheBatch));
+        file.write(m_strings.data(), m_strings.size());
+        uint64_t written = header.stringsOffset + header.stringsSize;
+        const char padding[StreamAlignment] = {};
+        auto writeStream = [&](uint64_t streamOffset, const void* data, uint64_t size) {
+            file.write(padding, streamOffset - written);
+            file.write(reinterpret_cast<const char*>(data), size);
+            written = streamOffset + size;
+        };
+        for (size_t i = 0; i < batches.size(); ++i)
+        {
+            const EfgMeshCacheBatch& entry = batches[i];
+            const EfgMeshlets& meshlets = *m_batches[i].meshlets;
+            writeStream(entry.vertexOffset, m_batches[i].vertices, uint64_t(entry.vertexCount) * entry.vertexStride);
+            writeStream(entry.indexOffset, m_batches[i].indices->data(), uint64_t(entry.indexCount) * sizeof(uint32_t));
+            writeStream(entry.meshletOffset, meshlets.meshlets.data(), uint64_t(entry.meshletCount) * sizeof(EfgMeshlet));
+            writeStream(entry.meshletVertexOffset, meshlets.vertices.data(), uint64_t(entry.meshletVertexCount) * sizeof(uint32_t));
+            writeStream(entry.meshletTriangleOffset, meshlets.triangles.data(), uint64_t(entry.meshletTriangleCount) * 3);
+        }
+        if (!file)
+        {
+            file.close();
+            fs::remove(temporaryPath, error);
+            return false;
+        }
+    }
+    fs::rename(temporaryPath, path, error);
+    if (error)
+    {
+        fs::remove(temporaryPath, error);
+        return false;
+    }
+    return true;
+}
+
+// Patches the stamps in place, a write cut short only costs another hash on the next open.
+static void WriteSourceTimes(const fs::path& path, uint64_t sourcesOffset, const std::vector<std::pair<uint32_t, int64_t>>& writeTimes)
+{
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    for (const auto& writeTime : writeTimes)
+    {
+        file.seekp(sourcesOffset + uint64_t(writeTime.first) * sizeof(EfgMeshCacheSource) + offsetof(EfgMeshCacheSource, writeTime));
+        file.write(reinterpret_cast<const char*>(&writeTime.second), sizeof(writeTime.second));
+    }
+}
+
+bool EfgMeshCache::Open(const fs::path& path, const EfgVfs& vfs)
+{
+    std::vector<std::pair<uint32_t, int64_t>> writeTimes;
+    if (!Map(path, vfs, writeTimes))
+        return false;
+    if (writeTimes.empty())
+        return true;
+
+    // Sources that were touched but not changed are stamped with their new time, so later
+    // opens don't hash them again. The mapping is read only and closed while patching.
+    uint64_t sourcesOffset = m_header->sourcesOffset;
+    Close();
+    WriteSourceTimes(path, sourcesOffset, writeTimes);
+    writeTimes.clear();
+    return Map(path, vfs, writeTimes);
+}
+
+bool EfgMeshCache::Map(const fs::path& path, const EfgVfs& vfs, std::vector<std::pair<uint32_t, int64_t>>& writeTimes)
+{
+    Close();
+    if (!m_file.Open(path) || m_file.GetSize() < sizeof(EfgMeshCacheHeader))
+    {
+        m_file.Close();
+        return false;
+    }
+
+    const uint8_t* data = m_file.GetData();
+    uint64_t size = m_file.GetSize();
+    const EfgMeshCacheHeader* header = reinterpret_cast<const EfgMeshCacheHeader*>(data);
+    // The tables are read in place, misaligned offsets are as corrupt as out of range ones.
+    bool valid = header->magic == MeshCacheMagic && header->version == MeshCacheVersion &&
+        header->sourcesOffset % alignof(EfgMeshCacheSource) == 0 && header->materialsOffset % alignof(EfgMeshCacheMaterial) == 0 &&
+        header->batchesOffset % alignof(EfgMeshCacheBatch) == 0 &&
+        IsRangeInFile(header->sourcesOffset, uint64_t(header->sourceCount) * sizeof(EfgMeshCacheSource), size) &&
+        IsRangeInFile(header->materialsOffset, uint64_t(header->materialCount) * sizeof(EfgMeshCacheMaterial), size) &&
+        IsRangeInFile(header->batchesOffset, uint64_t(header->batchCount) * sizeof(EfgMeshCacheBatch), size) &&
+        IsRangeInFile(header->stringsOffset, header->stringsSize, size) &&
+        (header->stringsSize == 0 || data[header->stringsOffset + header->stringsSize - 1] == '\0');
+
+    const EfgMeshCacheBatch* batches = reinterpret_cast<const EfgMeshCacheBatch*>(data + header->batchesOffset);
+    for (uint32_t i = 0; valid && i < header->batchCount; ++i)
+    {
+        valid = batches[i].vertexFormat <= efgVertexFormat_UNORM16 &&
+            batches[i].vertexStride == efgGetVertexStride(static_cast<EFG_VERTEX_FORMAT>(batches[i].vertexFormat)) &&
+            IsRangeInFile(batches[i].vertexOffset, uint64_t(batches[i].vertexCount) * batches[i].vertexStride, size) &&
+            IsRangeInFile(batches[i].indexOffset, uint64_t(batches[i].indexCount) * sizeof(uint32_t), size) &&
+            IsRangeInFile(batches[i].meshletOffset, uint64_t(batches[i].meshletCount) * sizeof(EfgMeshlet), size) &&
+            IsRangeInFile(batches[i].meshletVertexOffset, uint64_t(batches[i].meshletVertexCount) * sizeof(uint32_t), size) &&
+            IsRangeInFile(batches[i].meshletTriangleOffset, uint64_t(batches[i].meshletTriangleCount) * 3, size) &&
+            batches[i].lodCount >= 1 && batches[i].lodCount <= EfgMaxLods;
+        for (uint32_t l = 0; valid && l < batches[i].lodCount; ++l)
+            valid = uint64_t(batches[i].lods[l].firstIndex) + batches[i].lods[l].indexCount <= batches[i].indexCount;
+        // Indices past the vertices would read out of the vertex buffer on the GPU.
+        valid = valid && AreIndicesInRange(reinterpret_cast<const uint32_t*>(data + batches[i].indexOffset), batches[i].indexCount, batches[i].vertexCount) &&
+            AreIndicesInRange(reinterpret_cast<const uint32_t*>(data + batches[i].meshletVertexOffset), batches[i].meshletVertexCount, batches[i].vertexCount) &&
+            AreMeshletsInRange(data, batches[i]);
+    }
+
+    const char* strings = reinterpret_cast<const char*>(data + header->stringsOffset);
+    const EfgMeshCacheSource* sources = reinterpret_cast<const EfgMeshCacheSource*>(data + header->sourcesOffset);
+    for (uint32_t i = 0; valid && i < header->sourceCount; ++i)
+    {
+        int64_t writeTime = 0;
+        valid = sources[i].pathOffset < header->stringsSize && IsSourceCurrent(vfs, sources[i], strings + sources[i].pathOffset, writeTime);
+        if (valid && writeTime != sources[i].writeTime)
+            writeTimes.emplace_back(i, writeTime);
+    }
+
+    if (!valid)
+    {
+        m_file.Close();
+        return false;
+    }
+
+    m_header = header;
+    m_materials = reinterpret_cast<const EfgMeshCacheMaterial*>(data + header->materialsOffset);
+    m_batches = batches;
+    m_strings = strings;
+    return true;
+}
+
+void EfgMeshCache::Close()
+{
+    m_file.Close();
+    m_header = nullptr;
+    m_materials = nullptr;
+    m_batches = nullptr;
+    m_strings = nullptr;
+}
+
+const char* EfgMeshCache::GetDiffuseTexture(const EfgMeshCacheMaterial& material) const
+{
+    if (material.diffuseTextureOffset >= m_header->stringsSize)
+        return nullptr;
+    return m_strings + material.diffuseTextureOffset;
+}
+
+const void* EfgMeshCache::GetVertices(const EfgMeshCacheBatch& batch) const
+{
+    return m_file.GetData() + batch.vertexOffset;
+}
+
+const uint32_t* EfgMeshCache::GetIndices(const EfgMeshCacheBatch& batch) const
+{
+    return reinterpret_cast<const uint32_t*>(m_file.GetData() + batch.indexOffset);
+}
+
+const EfgMeshlet* EfgMeshCache::GetMeshlets(const EfgMeshCacheBatch& batch) const
+{
+    return reinterpret_cast<const EfgMeshlet*>(m_file.GetData() + batch.meshletOffset);
+}
+
+const uint32_t* EfgMeshCache::GetMeshletVertices(const EfgMeshCacheBatch& batch) const
+{
+    return reinterpret_cast<const uint32_t*>(m_file.GetData() + batch.meshletVertexOffset);
+}
+
+const uint8_t* EfgMeshCache::GetMeshletTriangles(const EfgMeshCacheBatch& batch) const
+{
+    return m_file.GetData() + batch.meshletTriangleOffset;
+}
@@ -0,0 +1,141 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "efg_mappedFile.h"
+#include "efg_meshlet.h"
+#include "efg_meshSimplifier.h"
+#include "efg_resources.h"
+#include "efg_vertexCompression.h"
+#include "efg_vfs.h"
+#include "Shapes.h"
+
+// Binary cache of an imported mesh, written on the first import and mapped on later
+// loads. Vertex and index streams are stored ready to upload, so loading is a copy.
+//
+// Header | Source[sourceCount] | Material[materialCount] | Batch[batchCount] | strings | streams
+
+// Stamp of a file the mesh was imported from. The size and modification time are
+// checked first, the content hash only when the time changed, so a touched but
+// unchanged source keeps its cache.
+struct EfgMeshCacheSource
+{
+    uint32_t pathOffset = 0;
+    uint32_t padding = 0;
+    uint64_t size = 0;
+    int64_t writeTime = 0;
+    uint64_t hash = 0;
+};
+
+struct EfgMeshCacheMaterial
+{
+    EfgMaterialBuffer constants;
+    uint32_t diffuseTextureOffset = UINT32_MAX; // UINT32_MAX when there is no diffuse map
+    uint32_t padding[3] = {};
+};
+
+struct EfgMeshCacheBatch
+{
+    int32_t materialId = -1;
+    uint32_t vertexFormat = efgVertexFormat_FLOAT;
+    uint64_t vertexOffset = 0; // vertexCount vertices of vertexStride bytes
+    uint64_t indexOffset = 0;  // uint32_t[indexCount]
+    uint32_t vertexCount = 0;
+    uint32_t indexCount = 0;
+    XMFLOAT3 boundsMin = XMFLOAT3(0.0f, 0.0f, 0.0f);
+    XMFLOAT3 boundsMax = XMFLOAT3(0.0f, 0.0f, 0.0f);
+    uint32_t vertexStride = 0;
+    uint32_t meshletCount = 0;
+    EfgVertexQuantization quantization;
+    uint64_t meshletOffset = 0;         // EfgMeshlet[meshletCount]
+    uint64_t meshletVertexOffset = 0;   // uint32_t[meshletVertexCount]
+    uint64_t meshletTriangleOffset = 0; // uint8_t[meshletTriangleCount * 3]
+    uint32_t meshletVertexCount = 0;
+    uint32_t meshletTriangleCount = 0;
+    uint32_t lodCount = 1;
+    uint32_t padding = 0;
+    EfgMeshLod lods[EfgMaxLods] = {}; // Ranges of the index stream
+};
+
+struct EfgMeshCacheHeader
+{
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint32_t sourceCount = 0;
+    uint32_t materialCount = 0;
+    uint32_t batchCount = 0;
+    uint32_t padding = 0;
+    uint64_t sourcesOffset = 0;
+    uint64_t materialsOffset = 0;
+    uint64_t batchesOffset = 0;
+    uint64_t stringsOffset = 0;
+    uint64_t stringsSize = 0;
+};
+
+class EfgMeshCacheWriter
+{
+public:
+    // Stamps the file as it is now, packed sources with the stamp of the file that was
+    // packed. Returns false when it can't be read.
+    bool AddSource(const EfgVfs& vfs, const std::filesystem::path& path);
+    void AddMaterial(const EfgMaterialBuffer& constants, const std::string& diffuseTexture);
+    // vertices are in vertexFormat and must stay alive until Write().
+    void AddBatch(int32_t materialId, EFG_VERTEX_FORMAT vertexFormat, const EfgVertexQuantization& quantization,
+        const void* vertices, uint32_t vertexCount, const std::vector<uint32_t>& indices, uint32_t lodCount, const EfgMeshLod* lods,
+        const EfgMeshlets& meshlets,
+        const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax);
+    // Creates the directory. Written aside and renamed, a failed write leaves no cache.
+    bool Write(const std::filesystem::path& path) const;
+
+private:
+    struct Batch
+    {
+        EfgMeshCacheBatch batch;
+        const void* vertices = nullptr;
+        const std::vector<uint32_t>* indices = nullptr;
+        const EfgMeshlets* meshlets = nullptr;
+    };
+    uint32_t AddString(const std::string& string);
+
+    std::vector<EfgMeshCacheSource> m_sources;
+    std::vector<EfgMeshCacheMaterial> m_materials;
+    std::vector<Batch> m_batches;
+    std::string m_strings;
+};
+
+class EfgMeshCache
+{
+public:
+    // Fails quietly when the file is missing, not a valid cache or any source changed.
+    // Every index and meshlet range is checked against the batch, a corrupt cache is a miss.
+    // The cache itself is always a loose file, its sources are looked up through vfs.
+    bool Open(const std::filesystem::path& path, const EfgVfs& vfs);
+    void Close();
+    bool IsOpen() const { return m_file.IsOpen(); }
+
+    uint32_t GetMaterialCount() const { return m_header->materialCount; }
+    const EfgMeshCacheMaterial& GetMaterial(uint32_t index) const { return m_materials[index]; }
+    // nullptr when the material has no diffuse map.
+    const char* GetDiffuseTexture(const EfgMeshCacheMaterial& material) const;
+    uint32_t GetBatchCount() const { return m_header->batchCount; }
+    const EfgMeshCacheBatch& GetBatch(uint32_t index) const { return m_batches[index]; }
+    // Point into the mapping, valid until Close().
+    const void* GetVertices(const EfgMeshCacheBatch& batch) const;
+    const uint32_t* GetIndices(const EfgMeshCacheBatch& batch) const;
+    const EfgMeshlet* GetMeshlets(const EfgMeshCacheBatch& batch) const;
+    const uint32_t* GetMeshletVertices(const EfgMeshCacheBatch& batch) const;
+    const uint8_t* GetMeshletTriangles(const EfgMeshCacheBatch& batch) const;
+
+private:
+    // Validates the mapping, writeTimes receives the sources whose stamp is out of date.
+    bool Map(const std::filesystem::path& path, const EfgVfs& vfs, std::vector<std::pair<uint32_t, int64_t>>& writeTimes);
+
+    EfgMappedFile m_file;
+    const EfgMeshCacheHeader* m_header = nullptr;
+    const EfgMeshCacheMaterial* m_materials = nullptr;
+    const EfgMeshCacheBatch* m_batches = nullptr;
+    const char* m_strings = nullptr;
+};
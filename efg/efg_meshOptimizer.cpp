@@ -0,0 +1,276 @@
+#include "efg_meshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+
+void EfgVertexCacheStats::Add(const EfgVertexCacheStats& other)
+{
+    triangleCount += other.triangleCount;
+    vertexCount += other.vertexCount;
+    transformCount += other.transformCount;
+    acmr = (triangleCount > 0) ? float(transformCount) / triangleCount : 0.0f;
+    atvr = (vertexCount > 0) ? float(transformCount) / vertexCount : 0.0f;
+}
+
+// FIFO cache: a vertex stays cached until cacheSize other vertices were transformed
+// after it. Advancing time by more than cacheSize flushes it.
+static bool TransformVertex(uint32_t vertex, std::vector<uint32_t>& timestamps, uint32_t& time, uint32_t cacheSize)
+{
+    if (time - timestamps[vertex] <= cacheSize)
+        return false;
+    timestamps[vertex] = time++;
+    return true;
+}
+
+EfgVertexCacheStats efgAnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+{
+    EfgVertexCacheStats stats;
+    std::vector<uint32_t> timestamps(vertexCount, 0);
+    std::vector<uint8_t> referenced(vertexCount, 0);
+    uint32_t time = cacheSize + 1;
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        uint32_t vertex = indices[i];
+        if (!referenced[vertex])
+        {
+            referenced[vertex] = 1;
+            stats.vertexCount++;
+        }
+        if (TransformVertex(vertex, timestamps, time, cacheSize))
+            stats.transformCount++;
+    }
+    stats.triangleCount = indexCount / 3;
+    stats.acmr = (stats.triangleCount > 0) ? float(stats.transformCount) / stats.triangleCount : 0.0f;
+    stats.atvr = (stats.vertexCount > 0) ? float(stats.transformCount) / stats.vertexCount : 0.0f;
+    return stats;
+}
+
+void efgOptimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount,
+    uint32_t cacheSize, std::vector<uint32_t>* clusters)
+{
+    if (clusters != nullptr)
+        clusters->clear();
+    size_t triangleCount = indexCount / 3;
+
+    // Triangles around each vertex, as ranges of one array.
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i)
+        adjacencyOffsets[indices[i] + 1]++;
+    for (size_t v = 0; v < vertexCount; ++v)
+        adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    std::vector<uint32_t> liveTriangles(vertexCount);
+    {
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; ++i)
+            adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        for (size_t v = 0; v < vertexCount; ++v)
+            liveTriangles[v] = adjacencyOffsets[v + 1] - adjacencyOffsets[v];
+    }
+
+    std::vector<uint32_t> timestamps(vertexCount, 0);
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    deadEnd.reserve(triangleCount * 3);
+    uint32_t time = cacheSize + 1;
+    uint32_t scan = 0;
+    size_t output = 0;
+
+    // Fanning out from one vertex at a time, emitting all its remaining triangles.
+    while (scan < vertexCount && liveTriangles[scan] == 0)
+        scan++;
+    int64_t current = (scan < vertexCount) ? int64_t(scan) : -1;
+    bool freshStart = true;
+    while (current >= 0)
+    {
+        if (freshStart && clusters != nullptr)
+            clusters->push_back(static_cast<uint32_t>(output / 3));
+
+        candidates.clear();
+        for (uint32_t a = adjacencyOffsets[current]; a < adjacencyOffsets[current + 1]; ++a)
+        {
+            uint32_t triangle = adjacency[a];
+            if (emitted[triangle])
+                continue;
+            emitted[triangle] = 1;
+            for (int k = 0; k < 3; ++k)
+            {
+                uint32_t vertex = indices[triangle * 3 + k];
+                destination[output++] = vertex;
+                deadEnd.push_back(vertex);
+                candidates.push_back(vertex);
+                liveTriangles[vertex]--;
+                TransformVertex(vertex, timestamps, time, cacheSize);
+            }
+        }
+
+        // The oldest cached neighbor that stays cached while its triangles are emitted.
+        current = -1;
+        int64_t bestPriority = -1;
+        for (uint32_t vertex : candidates)
+        {
+            if (liveTriangles[vertex] == 0)
+                continue;
+            int64_t priority = 0;
+            if (time - timestamps[vertex] + 2 * liveTriangles[vertex] <= cacheSize)
+                priority = time - timestamps[vertex];
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                current = vertex;
+            }
+        }
+
+        // Dead end, back to recently used vertices, then to any vertex left.
+        freshStart = current < 0;
+        while (current < 0 && !deadEnd.empty())
+        {
+            uint32_t vertex = deadEnd.back();
+            deadEnd.pop_back();
+            if (liveTriangles[vertex] > 0)
+                current = vertex;
+        }
+        while (current < 0 && scan < vertexCount)
+        {
+            if (liveTriangles[scan] > 0)
+                current = scan;
+            else
+                scan++;
+        }
+    }
+}
+
+void efgOptimizeOverdraw(uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount,
+    const std::vector<uint32_t>& clusters, float threshold, uint32_t cacheSize)
+{
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0 || vertexCount == 0)
+        return;
+
+    // Soft boundaries: a hard cluster is split where the part so far already has an
+    // ACMR within threshold of the whole cluster, restarting it costs little then.
+    std::vector<uint32_t> hardClusters = clusters;
+    if (hardClusters.empty() || hardClusters[0] != 0)
+        hardClusters.insert(hardClusters.begin(), 0);
+    std::vector<uint32_t> timestamps(vertexCount, 0);
+    uint32_t time = cacheSize + 1;
+    std::vector<uint32_t> boundaries;
+    for (size_t c = 0; c < hardClusters.size(); ++c)
+    {
+        size_t start = hardClusters[c];
+        size_t end = (c + 1 < hardClusters.size()) ? hardClusters[c + 1] : triangleCount;
+        time += cacheSize + 1;
+        size_t clusterTransforms = 0;
+        for (size_t i = start * 3; i < end * 3; ++i)
+            clusterTransforms += TransformVertex(indices[i], timestamps, time, cacheSize) ? 1 : 0;
+        float clusterAcmr = float(clusterTransforms) / float(end - start);
+
+        time += cacheSize + 1;
+        boundaries.push_back(static_cast<uint32_t>(start));
+        size_t splitStart = start;
+        size_t splitTransforms = 0;
+        for (size_t t = start; t < end; ++t)
+        {
+            for (int k = 0; k < 3; ++k)
+                splitTransforms += TransformVertex(indices[t * 3 + k], timestamps, time, cacheSize) ? 1 : 0;
+            if (t + 1 < end && float(splitTransforms) <= threshold * clusterAcmr * float(t + 1 - splitStart))
+            {
+                boundaries.push_back(static_cast<uint32_t>(t + 1));
+                splitStart = t + 1;
+                splitTransforms = 0;
+                time += cacheSize + 1;
+            }
+        }
+    }
+
+    // Clusters whose surface faces away from the mesh center are drawn first.
+    double meshCenter[3] = {};
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        meshCenter[0] += vertices[v].position.x;
+        meshCenter[1] += vertices[v].position.y;
+        meshCenter[2] += vertices[v].position.z;
+    }
+    for (double& component : meshCenter)
+        component /= double(vertexCount);
+
+    struct Cluster
+    {
+        uint32_t start;
+        uint32_t end;
+        float sortKey;
+    };
+    std::vector<Cluster> sorted(boundaries.size());
+    for (size_t c = 0; c < boundaries.size(); ++c)
+    {
+        Cluster& cluster = sorted[c];
+        cluster.start = boundaries[c];
+        cluster.end = (c + 1 < boundaries.size()) ? boundaries[c + 1] : static_cast<uint32_t>(triangleCount);
+        double center[3] = {};
+        double normal[3] = {};
+        for (uint32_t t = cluster.start; t < cluster.end; ++t)
+        {
+            const DirectX::XMFLOAT3& a = vertices[indices[t * 3 + 0]].position;
+            const DirectX::XMFLOAT3& b = vertices[indices[t * 3 + 1]].position;
+            const DirectX::XMFLOAT3& d = vertices[indices[t * 3 + 2]].position;
+            center[0] += a.x + b.x + d.x;
+            center[1] += a.y + b.y + d.y;
+            center[2] += a.z + b.z + d.z;
+            // Cross product of the edges, its length is twice the triangle area.
+            double ab[3] = { b.x - a.x, b.y - a.y, b.z - a.z };
+            double ad[3] = { d.x - a.x, d.y - a.y, d.z - a.z };
+            normal[0] += ab[1] * ad[2] - ab[2] * ad[1];
+            normal[1] += ab[2] * ad[0] - ab[0] * ad[2];
+            normal[2] += ab[0] * ad[1] - ab[1] * ad[0];
+        }
+        double cornerCount = double(cluster.end - cluster.start) * 3.0;
+        double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        double dot = 0.0;
+        for (int k = 0; k < 3; ++k)
+            dot += (center[k] / cornerCount - meshCenter[k]) * normal[k];
+        cluster.sortKey = (length > 0.0) ? float(dot / length) : 0.0f;
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+    std::vector<uint32_t> reordered;
+    reordered.reserve(triangleCount * 3);
+    for (const Cluster& cluster : sorted)
+        reordered.insert(reordered.end(), indices + cluster.start * 3, indices + cluster.end * 3);
+    std::copy(reordered.begin(), reordered.end(), indices);
+}
+
+size_t efgOptimizeVertexFetch(Vertex* destination, uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount)
+{
+    std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+    uint32_t nextVertex = 0;
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        uint32_t& vertex = remap[indices[i]];
+        if (vertex == UINT32_MAX)
+        {
+            destination[nextVertex] = vertices[indices[i]];
+            vertex = nextVertex++;
+        }
+        indices[i] = vertex;
+    }
+    return nextVertex;
+}
+
+EfgMeshOptimizeStats efgOptimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+    EfgMeshOptimizeStats stats;
+    stats.before = efgAnalyzeVertexCache(indices.data(), indices.size(), vertices.size());
+
+    std::vector<uint32_t> optimized(indices.size());
+    std::vector<uint32_t> clusters;
+    efgOptimizeVertexCache(optimized.data(), indices.data(), indices.size(), vertices.size(), EfgVertexCacheSize, &clusters);
+    efgOptimizeOverdraw(optimized.data(), optimized.size(), vertices.data(), vertices.size(), clusters);
+
+    std::vector<Vertex> fetched(vertices.size());
+    fetched.resize(efgOptimizeVertexFetch(fetched.data(), optimized.data(), optimized.size(), vertices.data(), vertices.size()));
+    vertices.swap(fetched);
+    indices.swap(optimized);
+
+    stats.after = efgAnalyzeVertexCache(indices.data(), indices.size(), vertices.size());
+    return stats;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Shapes.h"
+
+// Import-time triangle and vertex reordering, plain CPU code without D3D.
+
+// Vertex shader invocations of an index buffer on a simulated FIFO post-transform cache.
+struct EfgVertexCacheStats
+{
+    size_t triangleCount = 0;
+    size_t vertexCount = 0;    // Vertices the indices reference
+    size_t transformCount = 0; // Cache misses
+    float acmr = 0.0f;         // Transforms per triangle, 0.5 at best, 3 at worst
+    float atvr = 0.0f;         // Transforms per vertex, 1 at best
+
+    // Sums the counts of another mesh, for stats over several batches.
+    void Add(const EfgVertexCacheStats& other);
+};
+
+struct EfgMeshOptimizeStats
+{
+    EfgVertexCacheStats before;
+    EfgVertexCacheStats after;
+};
+
+static const uint32_t EfgVertexCacheSize = 16;
+
+EfgVertexCacheStats efgAnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = EfgVertexCacheSize);
+
+// Tipsify (Sander et al. 2007). destination must not alias indices. clusters receives the
+// first triangle of every run that started on a fresh vertex, for efgOptimizeOverdraw.
+void efgOptimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount,
+    uint32_t cacheSize = EfgVertexCacheSize, std::vector<uint32_t>* clusters = nullptr);
+
+// Splits the clusters further where the cache would lose little, then draws the clusters
+// facing away from the mesh center first, as they tend to occlude the others. threshold
+// is how much ACMR may grow, 1.05 allows 5%.
+void efgOptimizeOverdraw(uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount,
+    const std::vector<uint32_t>& clusters, float threshold = 1.05f, uint32_t cacheSize = EfgVertexCacheSize);
+
+// Orders vertices by first use and remaps the indices. Unused vertices are dropped,
+// returns the new vertex count. destination must not alias vertices.
+size_t efgOptimizeVertexFetch(Vertex* destination, uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount);
+
+// All of the above, in place.
+EfgMeshOptimizeStats efgOptimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
@@ -0,0 +1,547 @@
+#include "efg_meshSimplifier.h"
+#include "efg_meshOptimizer.h"
+#include "Shapes.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+
+// How a vertex may move. Seam vertices are the two wedges of a position split by a uv or
+// normal seam, border vertices lie on an open edge. Anything more complex stays in place.
+enum VertexKind
+{
+    VertexKind_MANIFOLD,
+    VertexKind_BORDER,
+    VertexKind_SEAM,
+    VertexKind_LOCKED
+};
+
+// Open borders are pinned by planes through them, weighted above the surface planes.
+static const double BorderWeight = 10.0;
+
+// Sum of squared distances to weighted planes, as a symmetric 4x4 matrix.
+struct Quadric
+{
+    double a00 = 0.0, a11 = 0.0, a22 = 0.0, a01 = 0.0, a02 = 0.0, a12 = 0.0;
+    double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+    double c = 0.0;
+    double weight = 0.0;
+};
+
+struct Collapse
+{
+    uint32_t vertex = 0;
+    uint32_t target = 0;
+    double error = 0.0;
+};
+
+// Compressed per vertex lists, entries[offsets[v]] to entries[offsets[v + 1]].
+struct VertexAdjacency
+{
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> entries;
+};
+
+static void AddPlane(Quadric& quadric, double nx, double ny, double nz, double d, double weight)
+{
+    quadric.a00 += weight * nx * nx;
+    quadric.a11 += weight * ny * ny;
+    quadric.a22 += weight * nz * nz;
+    quadric.a01 += weight * nx * ny;
+    quadric.a02 += weight * nx * nz;
+    quadric.a12 += weight * ny * nz;
+    quadric.b0 += weight * nx * d;
+    quadric.b1 += weight * ny * d;
+    quadric.b2 += weight * nz * d;
+    quadric.c += weight * d * d;
+    quadric.weight += weight;
+}
+
+static void AddQuadric(Quadric& quadric, const Quadric& other)
+{
+    quadric.a00 += other.a00;
+    quadric.a11 += other.a11;
+    quadric.a22 += other.a22;
+    quadric.a01 += other.a01;
+    quadric.a02 += other.a02;
+    quadric.a12 += other.a12;
+    quadric.b0 += other.b0;
+    quadric.b1 += other.b1;
+    quadric.b2 += other.b2;
+    quadric.c += other.c;
+    quadric.weight += other.weight;
+}
+
+// Weighted mean squared distance of the point to the planes.
+static double EvaluateQuadric(const Quadric& quadric, const XMFLOAT3& position)
+{
+    double x = position.x;
+    double y = position.y;
+    double z = position.z;
+    double error = quadric.a00 * x * x + quadric.a11 * y * y + quadric.a22 * z * z +
+        2.0 * (quadric.a01 * x * y + quadric.a02 * x * z + quadric.a12 * y * z) +
+        2.0 * (quadric.b0 * x + quadric.b1 * y + quadric.b2 * z) + quadric.c;
+    return (quadric.weight > 0.0) ? std::fabs(error) / quadric.weight : 0.0;
+}
+
+static void Cross(double* result, const XMFLOAT3& a, const XMFLOAT3& b, const XMFLOAT3& c)
+{
+    double ux = double(b.x) - a.x, uy = double(b.y) - a.y, uz = double(b.z) - a.z;
+    double vx = double(c.x) - a.x, vy = double(c.y) - a.y, vz = double(c.z) - a.z;
+    result[0] = uy * vz - uz * vy;
+    result[1] = uz * vx - ux * vz;
+    result[2] = ux * vy - uy * vx;
+}
+
+// Outgoing half edges of every vertex, a -> b for each triangle edge in winding order.
+static void BuildEdgeAdjacency(VertexAdjacency& adjacency, const uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+    adjacency.offsets.assign(vertexCount + 1, 0);
+    for (size_t i = 0; i < indexCount; ++i)
+        adjacency.offsets[indices[i] + 1]++;
+    for (size_t v = 0; v < vertexCount; ++v)
+        adjacency.offsets[v + 1] += adjacency.offsets[v];
+    adjacency.entries.resize(indexCount);
+    std::vector<uint32_t> cursors(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+    for (size_t i = 0; i < indexCount; i += 3)
+    {
+        for (size_t k = 0; k < 3; ++k)
+            adjacency.entries[cursors[indices[i + k]]++] = indices[i + (k + 1) % 3];
+    }
+}
+
+// Triangles using every vertex.
+static void BuildTriangleAdjacency(VertexAdjacency& adjacency, const uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+    adjacency.offsets.assign(vertexCount + 1, 0);
+    for (size_t i = 0; i < indexCount; ++i)
+        adjacency.offsets[indices[i] + 1]++;
+    for (size_t v = 0; v < vertexCount; ++v)
+        adjacency.offsets[v + 1] += adjacency.offsets[v];
+    adjacency.entries.resize(indexCount);
+    std::vector<uint32_t> cursors(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+    for (size_t i = 0; i < indexCount; ++i)
+        adjacency.entries[cursors[indices[i]]++] = static_cast<uint32_t>(i / 3);
+}
+
+static bool HasEdge(const VertexAdjacency& edges, uint32_t a, uint32_t b)
+{
+    for (uint32_t i = edges.offsets[a]; i < edges.offsets[a + 1]; ++i)
+    {
+        if (edges.entries[i] == b)
+            return true;
+    }
+    return false;
+}
+
+// Groups the referenced vertices by position. positionRemap is the first vertex of the
+// group, wedges links each vertex to the next of its group in a ring.
+static void BuildPositionWedges(std::vector<uint32_t>& positionRemap, std::vector<uint32_t>& wedges,
+    const uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount)
+{
+    positionRemap.resize(vertexCount);
+    wedges.resize(vertexCount);
+    std::vector<uint8_t> referenced(vertexCount, 0);
+    for (size_t i = 0; i < indexCount; ++i)
+        referenced[indices[i]] = 1;
+    std::vector<uint32_t> order;
+    for (uint32_t v = 0; v < vertexCount; ++v)
+    {
+        positionRemap[v] = v;
+        wedges[v] = v;
+        if (referenced[v])
+            order.push_back(v);
+    }
+
+    auto positionLess = [vertices](uint32_t a, uint32_t b) {
+        return memcmp(&vertices[a].position, &vertices[b].position, sizeof(XMFLOAT3)) < 0;
+    };
+    std::sort(order.begin(), order.end(), positionLess);
+    for (size_t first = 0; first < order.size();)
+    {
+        size_t last = first + 1;
+        while (last < order.size() && !positionLess(order[first], order[last]))
+            last++;
+        for (size_t i = first; i < last; ++i)
+        {
+            positionRemap[order[i]] = order[first];
+            wedges[order[i]] = order[(i + 1 < last) ? i + 1 : first];
+        }
+        first = last;
+    }
+}
+
+// An edge is open when no triangle uses it in the opposite direction.
+static void ClassifyVertices(std::vector<uint8_t>& kinds, const VertexAdjacency& edges, const std::vector<uint32_t>& positionRemap,
+    const std::vector<uint32_t>& wedges, size_t vertexCount)
+{
+    std::vector<uint32_t> openOut(vertexCount, 0);
+    std::vector<uint32_t> openIn(vertexCount, 0);
+    std::vector<uint32_t> openOutTarget(vertexCount, 0);
+    std::vector<uint32_t> openInSource(vertexCount, 0);
+    for (uint32_t a = 0; a < vertexCount; ++a)
+    {
+        for (uint32_t i = edges.offsets[a]; i < edges.offsets[a + 1]; ++i)
+        {
+            uint32_t b = edges.entries[i];
+            if (HasEdge(edges, b, a))
+                continue;
+            openOut[a]++;
+            openIn[b]++;
+            openOutTarget[a] = b;
+            openInSource[b] = a;
+        }
+    }
+
+    kinds.resize(vertexCount);
+    for (uint32_t v = 0; v < vertexCount; ++v)
+    {
+        uint32_t wedge = wedges[v];
+        if (wedge == v)
+        {
+            if (openOut[v] == 0 && openIn[v] == 0)
+                kinds[v] = VertexKind_MANIFOLD;
+            else if (openOut[v] == 1 && openIn[v] == 1)
+                kinds[v] = VertexKind_BORDER;
+            else
+                kinds[v] = VertexKind_LOCKED;
+        }
+        else if (wedges[wedge] == v && openOut[v] == 1 && openIn[v] == 1 && openOut[wedge] == 1 && openIn[wedge] == 1 &&
+            positionRemap[openOutTarget[v]] == positionRemap[openInSource[wedge]] &&
+            positionRemap[openInSource[v]] == positionRemap[openOutTarget[wedge]])
+        {
+            // Both wedges have one open edge on each side and they meet, the surface itself is closed.
+            kinds[v] = VertexKind_SEAM;
+        }
+        else
+        {
+            kinds[v] = VertexKind_LOCKED;
+        }
+    }
+}
+
+// True when some wedge of b has an edge to a wedge of a, the edge is then closed in position space.
+static bool HasPositionEdge(const VertexAdjacency& edges, const std::vector<uint32_t>& positionRemap, const std::vector<uint32_t>& wedges,
+    uint32_t a, uint32_t b)
+{
+    uint32_t wedge = b;
+    do
+    {
+        for (uint32_t i = edges.offsets[wedge]; i < edges.offsets[wedge + 1]; ++i)
+        {
+            if (positionRemap[edges.entries[i]] == positionRemap[a])
+                return true;
+        }
+        wedge = wedges[wedge];
+    } while (wedge != b);
+    return false;
+}
+
+static void ComputeQuadrics(std::vector<Quadric>& quadrics, const uint32_t* indices, size_t indexCount, const Vertex* vertices,
+    const VertexAdjacency& edges, const std::vector<uint32_t>& positionRemap, const std::vector<uint32_t>& wedges)
+{
+    for (size_t i = 0; i < indexCount; i += 3)
+    {
+        const XMFLOAT3& p0 = vertices[indices[i]].position;
+        const XMFLOAT3& p1 = vertices[indices[i + 1]].position;
+        const XMFLOAT3& p2 = vertices[indices[i + 2]].position;
+        double normal[3];
+        Cross(normal, p0, p1, p2);
+        double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        if (length == 0.0)
+            continue;
+        double nx = normal[0] / length, ny = normal[1] / length, nz = normal[2] / length;
+        double d = -(nx * p0.x + ny * p0.y + nz * p0.z);
+        for (size_t k = 0; k < 3; ++k)
+            AddPlane(quadrics[positionRemap[indices[i + k]]], nx, ny, nz, d, length * 0.5);
+
+        // A plane through each open border edge, perpendicular to the triangle.
+        for (size_t k = 0; k < 3; ++k)
+        {
+            uint32_t a = indices[i + k];
+            uint32_t b = indices[i + (k + 1) % 3];
+            if (HasPositionEdge(edges, positionRemap, wedges, a, b))
+                continue;
+            const XMFLOAT3& pa = vertices[a].position;
+            const XMFLOAT3& pb = vertices[b].position;
+            double ex = double(pb.x) - pa.x, ey = double(pb.y) - pa.y, ez = double(pb.z) - pa.z;
+            double bx = ey * nz - ez * ny, by = ez * nx - ex * nz, bz = ex * ny - ey * nx;
+            double borderLength = std::sqrt(bx * bx + by * by + bz * bz);
+            if (borderLength == 0.0)
+                continue;
+            bx /= borderLength;
+            by /= borderLength;
+            bz /= borderLength;
+            double bd = -(bx * pa.x + by * pa.y + bz * pa.z);
+            double weight = (ex * ex + ey * ey + ez * ez) * BorderWeight;
+            AddPlane(quadrics[positionRemap[a]], bx, by, bz, bd, weight);
+            AddPlane(quadrics[positionRemap[b]], bx, by, bz, bd, weight);
+        }
+    }
+}
+
+// Seams and borders only slide along their open edges, onto vertices of their own kind
+// or locked ones. Manifold vertices may collapse onto anything.
+static bool CanCollapse(const std::vector<uint8_t>& kinds, uint32_t vertex, uint32_t target, bool openEdge)
+{
+    switch (kinds[vertex])
+    {
+    case VertexKind_MANIFOLD:
+        return true;
+    case VertexKind_BORDER:
+        return openEdge && (kinds[target] == VertexKind_BORDER || kinds[target] == VertexKind_LOCKED);
+    case VertexKind_SEAM:
+        return openEdge && (kinds[target] == VertexKind_SEAM || kinds[target] == VertexKind_LOCKED);
+    default:
+        return false;
+    }
+}
+
+// The wedge of target that the other wedge of a seam vertex collapses onto, ~0u when none
+// shares an edge with it.
+static uint32_t FindSeamTarget(const VertexAdjacency& edges, const std::vector<uint32_t>& wedges, uint32_t sibling, uint32_t target)
+{
+    uint32_t wedge = target;
+    do
+    {
+        if (HasEdge(edges, sibling, wedge) || HasEdge(edges, wedge, sibling))
+            return wedge;
+        wedge = wedges[wedge];
+    } while (wedge != target);
+    return ~0u;
+}
+
+// Moving vertex onto target must not turn any remaining triangle around it over. Counts the
+// triangles the collapse removes.
+static bool CollapseFlips(const uint32_t* indices, const Vertex* vertices, const VertexAdjacency& triangles,
+    const std::vector<uint32_t>& positionRemap, uint32_t vertex, uint32_t target, size_t& removedTriangles)
+{
+    const XMFLOAT3& from = vertices[vertex].position;
+    const XMFLOAT3& to = vertices[target].position;
+    for (uint32_t i = triangles.offsets[vertex]; i < triangles.offsets[vertex + 1]; ++i)
+    {
+        const uint32_t* triangle = indices + size_t(triangles.entries[i]) * 3;
+        uint32_t corner = (triangle[0] == vertex) ? 0 : (triangle[1] == vertex) ? 1 : 2;
+        uint32_t b = triangle[(corner + 1) % 3];
+        uint32_t c = triangle[(corner + 2) % 3];
+        if (positionRemap[b] == positionRemap[target] || positionRemap[c] == positionRemap[target])
+        {
+            removedTriangles++;
+            continue;
+        }
+        double before[3];
+        double after[3];
+        Cross(before, from, vertices[b].position, vertices[c].position);
+        Cross(after, to, vertices[b].position, vertices[c].position);
+        double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+        double lengths = std::sqrt((before[0] * before[0] + before[1] * before[1] + before[2] * before[2]) *
+            (after[0] * after[0] + after[1] * after[1] + after[2] * after[2]));
+        if (dot <= 1e-2 * lengths)
+            return true;
+    }
+    return false;
+}
+
+static void TouchNeighborhood(std::vector<uint8_t>& touched, const uint32_t* indices, const VertexAdjacency& triangles,
+    const std::vector<uint32_t>& wedges, uint32_t vertex)
+{
+    for (uint32_t i = triangles.offsets[vertex]; i < triangles.offsets[vertex + 1]; ++i)
+    {
+        const uint32_t* triangle = indices + size_t(triangles.entries[i]) * 3;
+        for (size_t k = 0; k < 3; ++k)
+        {
+            uint32_t wedge = triangle[k];
+            do
+            {
+                touched[wedge] = 1;
+                wedge = wedges[wedge];
+            } while (wedge != triangle[k]);
+        }
+    }
+}
+
+size_t efgSimplifyMesh(uint32_t* destination, const uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount,
+    size_t targetIndexCount, float maxError, float* error)
+{
+    std::vector<uint32_t> result(indices, indices + indexCount);
+    std::vector<uint32_t> positionRemap;
+    std::vector<uint32_t> wedges;
+    BuildPositionWedges(positionRemap, wedges, indices, indexCount, vertices, vertexCount);
+
+    VertexAdjacency edges;
+    VertexAdjacency triangles;
+    BuildEdgeAdjacency(edges, result.data(), result.size(), vertexCount);
+    std::vector<uint8_t> kinds;
+    ClassifyVertices(kinds, edges, positionRemap, wedges, vertexCount);
+    std::vector<Quadric> quadrics(vertexCount);
+    ComputeQuadrics(quadrics, result.data(), result.size(), vertices, edges, positionRemap, wedges);
+
+    double maxCollapseError = double(maxError) * double(maxError);
+    double resultError = 0.0;
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> collapseRemap(vertexCount);
+    std::vector<uint8_t> touched(vertexCount);
+    while (result.size() > targetIndexCount)
+    {
+        BuildEdgeAdjacency(edges, result.data(), result.size(), vertexCount);
+        BuildTriangleAdjacency(triangles, result.data(), result.size(), vertexCount);
+
+        // Each edge once, in its cheaper allowed direction. The cost is the error of the
+        // merged quadrics at the target, so it grows with every collapse around a vertex.
+        collapses.clear();
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            for (size_t k = 0; k < 3; ++k)
+            {
+                uint32_t a = result[i + k];
+                uint32_t b = result[i + (k + 1) % 3];
+                bool openEdge = !HasEdge(edges, b, a);
+                if ((!openEdge && a > b) || positionRemap[a] == positionRemap[b])
+                    continue;
+
+                Quadric merged = quadrics[positionRemap[a]];
+                AddQuadric(merged, quadrics[positionRemap[b]]);
+                Collapse collapse;
+                collapse.error = DBL_MAX;
+                if (CanCollapse(kinds, a, b, openEdge))
+                {
+                    collapse.vertex = a;
+                    collapse.target = b;
+                    collapse.error = EvaluateQuadric(merged, vertices[b].position);
+                }
+                if (CanCollapse(kinds, b, a, openEdge))
+                {
+                    double reverseError = EvaluateQuadric(merged, vertices[a].position);
+                    if (reverseError < collapse.error)
+                    {
+                        collapse.vertex = b;
+                        collapse.target = a;
+                        collapse.error = reverseError;
+                    }
+                }
+                if (collapse.error <= maxCollapseError)
+                    collapses.push_back(collapse);
+            }
+        }
+        if (collapses.empty())
+            break;
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+        // A pass only takes the cheapest third, the costs around the collapsed vertices are
+        // stale afterwards. Collapses never share a neighborhood within a pass.
+        double passError = collapses[collapses.size() / 3].error;
+        size_t triangleGoal = (result.size() - targetIndexCount) / 3;
+        size_t removedTriangles = 0;
+        for (uint32_t v = 0; v < vertexCount; ++v)
+            collapseRemap[v] = v;
+        std::fill(touched.begin(), touched.end(), 0);
+        for (const Collapse& collapse : collapses)
+        {
+            if (removedTriangles >= triangleGoal || collapse.error > passError)
+                break;
+            uint32_t vertex = collapse.vertex;
+            uint32_t target = collapse.target;
+            if (touched[vertex] || touched[target])
+                continue;
+
+            uint32_t sibling = ~0u;
+            uint32_t siblingTarget = ~0u;
+            if (kinds[vertex] == VertexKind_SEAM)
+            {
+                sibling = wedges[vertex];
+                siblingTarget = FindSeamTarget(edges, wedges, sibling, target);
+                if (siblingTarget == ~0u || touched[sibling] || touched[siblingTarget])
+                    continue;
+            }
+
+            size_t removed = 0;
+            if (CollapseFlips(result.data(), vertices, triangles, positionRemap, vertex, target, removed))
+                continue;
+            if (sibling != ~0u && CollapseFlips(result.data(), vertices, triangles, positionRemap, sibling, siblingTarget, removed))
+                continue;
+
+            collapseRemap[vertex] = target;
+            TouchNeighborhood(touched, result.data(), triangles, wedges, vertex);
+            if (sibling != ~0u)
+            {
+                collapseRemap[sibling] = siblingTarget;
+                TouchNeighborhood(touched, result.data(), triangles, wedges, sibling);
+            }
+            AddQuadric(quadrics[positionRemap[target]], quadrics[positionRemap[vertex]]);
+            removedTriangles += removed;
+            if (collapse.error > resultError)
+                resultError = collapse.error;
+        }
+        if (removedTriangles == 0)
+            break;
+
+        size_t write = 0;
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            uint32_t a = collapseRemap[result[i]];
+            uint32_t b = collapseRemap[result[i + 1]];
+            uint32_t c = collapseRemap[result[i + 2]];
+            if (positionRemap[a] == positionRemap[b] || positionRemap[b] == positionRemap[c] || positionRemap[a] == positionRemap[c])
+                continue;
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    std::copy(result.begin(), result.end(), destination);
+    if (error != nullptr)
+        *error = static_cast<float>(std::sqrt(resultError));
+    return result.size();
+}
+
+uint32_t efgBuildLods(EfgMeshLod* lods, uint32_t maxLods, std::vector<uint32_t>& indices, const Vertex* vertices, size_t vertexCount,
+    float reduction)
+{
+    if (maxLods == 0)
+        return 0;
+    lods[0] = EfgMeshLod();
+    lods[0].indexCount = static_cast<uint32_t>(indices.size());
+
+    uint32_t lodCount = 1;
+    std::vector<uint32_t> simplified;
+    std::vector<uint32_t> optimized;
+    while (lodCount < maxLods)
+    {
+        // Each level starts from the previous one, errors add up along the chain.
+        const EfgMeshLod& previous = lods[lodCount - 1];
+        size_t targetIndexCount = static_cast<size_t>(previous.indexCount / 3 * reduction) * 3;
+        simplified.assign(indices.begin() + previous.firstIndex, indices.begin() + previous.firstIndex + previous.indexCount);
+        float error = 0.0f;
+        size_t indexCount = efgSimplifyMesh(simplified.data(), simplified.data(), simplified.size(), vertices, vertexCount,
+            targetIndexCount, FLT_MAX, &error);
+        // Stalled on seams and borders, the next level would hardly be cheaper to draw.
+        if (indexCount == 0 || indexCount * 10 > size_t(previous.indexCount) * 9)
+            break;
+
+        optimized.resize(indexCount);
+        efgOptimizeVertexCache(optimized.data(), simplified.data(), indexCount, vertexCount);
+        EfgMeshLod& lod = lods[lodCount++];
+        lod.firstIndex = static_cast<uint32_t>(indices.size());
+        lod.indexCount = static_cast<uint32_t>(indexCount);
+        lod.error = previous.error + error;
+        indices.insert(indices.end(), optimized.begin(), optimized.end());
+    }
+    return lodCount;
+}
+
+uint32_t efgSelectLod(const EfgMeshLod* lods, uint32_t lodCount, uint32_t currentLod, float pixelsPerUnit,
+    float maxPixelError, float hysteresis)
+{
+    if (lodCount == 0)
+        return 0;
+    uint32_t lod = (currentLod < lodCount) ? currentLod : lodCount - 1;
+    while (lod > 0 && lods[lod].error * pixelsPerUnit > maxPixelError * (1.0f + hysteresis))
+        lod--;
+    while (lod + 1 < lodCount && lods[lod + 1].error * pixelsPerUnit <= maxPixelError * (1.0f - hysteresis))
+        lod++;
+    return lod;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Quadric error edge collapse simplification and LOD chains, plain CPU code without D3D.
+// Vertices are only ever collapsed onto other vertices, so every level of a chain
+// indexes the vertex buffer of the full detail mesh.
+
+struct Vertex;
+
+static const uint32_t EfgMaxLods = 8;
+
+// A level of detail is a range of the index buffer that holds the whole chain.
+struct EfgMeshLod
+{
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+    // Geometric deviation from the full detail mesh, in mesh units.
+    float error = 0.0f;
+    uint32_t padding = 0;
+};
+
+// Collapses edges in order of quadric error until the index count reaches targetIndexCount or
+// the next collapse would move the surface by more than maxError. UV and normal seams and open
+// borders are only collapsed along themselves, so they stay intact. Returns the new index count,
+// error receives the largest deviation introduced. destination may alias indices.
+size_t efgSimplifyMesh(uint32_t* destination, const uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount,
+    size_t targetIndexCount, float maxError, float* error = nullptr);
+
+// Appends up to maxLods - 1 levels to indices, each reduction times the triangles of the
+// previous one, optimized for the vertex cache. The chain stops early once a level barely
+// shrinks. lods[0] covers the original indices. Returns the level count.
+// Single threaded: each level simplifies the one before it and the collapses of a level run
+// in global error order, so neither splits across threads without changing the result.
+// Importers get their parallelism per batch, ImportObj builds the chains of its material
+// batches on the thread pool, a mesh with one large batch builds its chain on one thread.
+uint32_t efgBuildLods(EfgMeshLod* lods, uint32_t maxLods, std::vector<uint32_t>& indices, const Vertex* vertices, size_t vertexCount,
+    float reduction = 0.5f);
+
+// Picks the coarsest level whose error projects to at most maxPixelError pixels, starting from
+// currentLod. A level only changes once its error is hysteresis past the threshold, so objects
+// near a switching distance don't flicker between levels.
+// pixelsPerUnit is viewportHeight * 0.5 * proj._22 * objectScale / distance.
+uint32_t efgSelectLod(const EfgMeshLod* lods, uint32_t lodCount, uint32_t currentLod, float pixelsPerUnit,
+    float maxPixelError = 1.0f, float hysteresis = 0.25f);
@@ -0,0 +1,180 @@
+#include "efg_meshlet.h"
+#include <cmath>
+
+using namespace DirectX;
+
+// Slot of a vertex that isn't in the meshlet being filled.
+static const uint8_t NoSlot = 0xff;
+
+static XMFLOAT3 Subtract(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+    return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z);
+}
+
+static float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+    return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+static float Length(const XMFLOAT3& a)
+{
+    return std::sqrt(Dot(a, a));
+}
+
+static float Component(const XMFLOAT3& a, uint32_t axis)
+{
+    return (&a.x)[axis];
+}
+
+void efgBuildMeshlets(EfgMeshlets& meshlets, const uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount,
+    uint32_t maxVertices, uint32_t maxTriangles)
+{
+    if (maxVertices < 3 || maxVertices >= NoSlot || maxTriangles == 0)
+        throw("Invalid meshlet limits!");
+
+    meshlets.meshlets.clear();
+    meshlets.vertices.clear();
+    meshlets.triangles.clear();
+    meshlets.meshlets.reserve(indexCount / 3 / maxTriangles + 1);
+    meshlets.vertices.reserve(indexCount / 3);
+    meshlets.triangles.reserve(indexCount);
+
+    std::vector<uint8_t> slots(vertexCount, NoSlot);
+    EfgMeshlet meshlet;
+    auto finishMeshlet = [&]() {
+        for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+            slots[meshlets.vertices[meshlet.vertexOffset + i]] = NoSlot;
+        efgComputeMeshletBounds(meshlet, meshlets, vertices);
+        meshlets.meshlets.push_back(meshlet);
+        meshlet = EfgMeshlet();
+        meshlet.vertexOffset = static_cast<uint32_t>(meshlets.vertices.size());
+        meshlet.triangleOffset = static_cast<uint32_t>(meshlets.triangles.size() / 3);
+    };
+
+    for (size_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        uint32_t a = indices[i];
+        uint32_t b = indices[i + 1];
+        uint32_t c = indices[i + 2];
+        uint32_t newVertices = (slots[a] == NoSlot) + (slots[b] == NoSlot && b != a) + (slots[c] == NoSlot && c != a && c != b);
+        if (meshlet.vertexCount + newVertices > maxVertices || meshlet.triangleCount == maxTriangles)
+            finishMeshlet();
+
+        for (uint32_t vertex : { a, b, c })
+        {
+            if (slots[vertex] == NoSlot)
+            {
+                slots[vertex] = static_cast<uint8_t>(meshlet.vertexCount++);
+                meshlets.vertices.push_back(vertex);
+            }
+            meshlets.triangles.push_back(slots[vertex]);
+        }
+        meshlet.triangleCount++;
+    }
+    if (meshlet.triangleCount > 0)
+        finishMeshlet();
+}
+
+void efgComputeMeshletBounds(EfgMeshlet& meshlet, const EfgMeshlets& meshlets, const Vertex* vertices)
+{
+    const uint32_t* meshletVertices = meshlets.vertices.data() + meshlet.vertexOffset;
+    const uint8_t* meshletTriangles = meshlets.triangles.data() + size_t(meshlet.triangleOffset) * 3;
+    meshlet.center = XMFLOAT3(0.0f, 0.0f, 0.0f);
+    meshlet.radius = 0.0f;
+    meshlet.coneAxis = XMFLOAT3(0.0f, 0.0f, 0.0f);
+    meshlet.coneCutoff = 1.0f;
+    if (meshlet.vertexCount == 0)
+        return;
+
+    // Ritter's sphere: start from the most distant pair of axis extremes, then grow
+    // the sphere over every point still outside.
+    XMFLOAT3 extremes[6];
+    for (uint32_t axis = 0; axis < 6; ++axis)
+        extremes[axis] = vertices[meshletVertices[0]].position;
+    for (uint32_t i = 1; i < meshlet.vertexCount; ++i)
+    {
+        const XMFLOAT3& position = vertices[meshletVertices[i]].position;
+        for (uint32_t axis = 0; axis < 3; ++axis)
+        {
+            if (Component(position, axis) < Component(extremes[axis * 2], axis))
+                extremes[axis * 2] = position;
+            if (Component(position, axis) > Component(extremes[axis * 2 + 1], axis))
+                extremes[axis * 2 + 1] = position;
+        }
+    }
+    XMFLOAT3 from = extremes[0];
+    XMFLOAT3 to = extremes[1];
+    for (uint32_t axis = 1; axis < 3; ++axis)
+    {
+        const XMFLOAT3& axisFrom = extremes[axis * 2];
+        const XMFLOAT3& axisTo = extremes[axis * 2 + 1];
+        if (Length(Subtract(axisTo, axisFrom)) > Length(Subtract(to, from)))
+        {
+            from = axisFrom;
+            to = axisTo;
+        }
+    }
+    XMFLOAT3 center((from.x + to.x) * 0.5f, (from.y + to.y) * 0.5f, (from.z + to.z) * 0.5f);
+    float radius = Length(Subtract(to, from)) * 0.5f;
+    for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+    {
+        XMFLOAT3 offset = Subtract(vertices[meshletVertices[i]].position, center);
+        float distance = Length(offset);
+        if (distance > radius)
+        {
+            float grownRadius = (radius + distance) * 0.5f;
+            float shift = (grownRadius - radius) / distance;
+            center = XMFLOAT3(center.x + offset.x * shift, center.y + offset.y * shift, center.z + offset.z * shift);
+            radius = grownRadius;
+        }
+    }
+    meshlet.center = center;
+    meshlet.radius = radius;
+
+    // The cone axis is the average face normal, its cutoff the sine of the widest
+    // angle between the axis and a face normal. Degenerate triangles don't count.
+    std::vector<XMFLOAT3> normals;
+    normals.reserve(meshlet.triangleCount);
+    XMFLOAT3 axis(0.0f, 0.0f, 0.0f);
+    for (uint32_t t = 0; t < meshlet.triangleCount; ++t)
+    {
+        const XMFLOAT3& p0 = vertices[meshletVertices[meshletTriangles[t * 3]]].position;
+        const XMFLOAT3& p1 = vertices[meshletVertices[meshletTriangles[t * 3 + 1]]].position;
+        const XMFLOAT3& p2 = vertices[meshletVertices[meshletTriangles[t * 3 + 2]]].position;
+        XMFLOAT3 normal = Cross(Subtract(p1, p0), Subtract(p2, p0));
+        float length = Length(normal);
+        if (length == 0.0f)
+            continue;
+        normal = XMFLOAT3(normal.x / length, normal.y / length, normal.z / length);
+        normals.push_back(normal);
+        axis = XMFLOAT3(axis.x + normal.x, axis.y + normal.y, axis.z + normal.z);
+    }
+    float axisLength = Length(axis);
+    if (axisLength == 0.0f)
+        return;
+    axis = XMFLOAT3(axis.x / axisLength, axis.y / axisLength, axis.z / axisLength);
+
+    float minDot = 1.0f;
+    for (const XMFLOAT3& normal : normals)
+    {
+        float dot = Dot(normal, axis);
+        if (dot < minDot)
+            minDot = dot;
+    }
+    // Past about 84 degrees the cone would hardly ever cull.
+    if (minDot <= 0.1f)
+        return;
+    meshlet.coneAxis = axis;
+    meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+bool efgIsMeshletBackfacing(const EfgMeshlet& meshlet, const XMFLOAT3& cameraPosition)
+{
+    XMFLOAT3 view = Subtract(meshlet.center, cameraPosition);
+    return Dot(view, meshlet.coneAxis) >= meshlet.coneCutoff * Length(view) + meshlet.radius;
+}
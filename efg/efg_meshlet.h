@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Shapes.h"
+
+// Splits a batch into small clusters that can be culled on their own, plain CPU code
+// without D3D. The limits fit a mesh shader thread group.
+static const uint32_t EfgMeshletMaxVertices = 64;
+static const uint32_t EfgMeshletMaxTriangles = 124;
+
+struct EfgMeshlet
+{
+    uint32_t vertexOffset = 0;   // Into EfgMeshlets::vertices
+    uint32_t triangleOffset = 0; // Into EfgMeshlets::triangles, in triangles
+    uint32_t vertexCount = 0;
+    uint32_t triangleCount = 0;
+    // Bounding sphere of the vertices.
+    DirectX::XMFLOAT3 center = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+    float radius = 0.0f;
+    // Normal cone of the triangles, see efgIsMeshletBackfacing. An axis of zero and a
+    // cutoff of one when the normals spread too far for the cone to ever cull.
+    DirectX::XMFLOAT3 coneAxis = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+    float coneCutoff = 1.0f;
+};
+
+struct EfgMeshlets
+{
+    std::vector<EfgMeshlet> meshlets;
+    // Batch vertex indices, vertexCount per meshlet.
+    std::vector<uint32_t> vertices;
+    // Three local vertex indices per triangle, into the vertices of the meshlet.
+    std::vector<uint8_t> triangles;
+};
+
+// Fills meshlets in index order, a new one starts when the next triangle would overflow
+// either limit. Expects an index buffer already ordered for the vertex cache, consecutive
+// triangles then share most of their vertices.
+void efgBuildMeshlets(EfgMeshlets& meshlets, const uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount,
+    uint32_t maxVertices = EfgMeshletMaxVertices, uint32_t maxTriangles = EfgMeshletMaxTriangles);
+
+// Computes the bounding sphere and normal cone of a meshlet from its triangles.
+void efgComputeMeshletBounds(EfgMeshlet& meshlet, const EfgMeshlets& meshlets, const Vertex* vertices);
+
+// True when every triangle of the meshlet faces away from the camera. Conservative,
+// works from the bounding sphere so it holds for any point of the meshlet.
+bool efgIsMeshletBackfacing(const EfgMeshlet& meshlet, const DirectX::XMFLOAT3& cameraPosition);
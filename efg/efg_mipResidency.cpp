@@ -0,0 +1,135 @@
+#include "efg_mipResidency.h"
+#include <algorithm>
+#include <cmath>
+
+// Frames without a report before a texture stops asking for its finer mips.
+static const uint32_t IdleFrames = 30;
+
+void EfgMipResidency::Add(uint64_t texture, uint32_t baseMip, const std::vector<uint64_t>& mipSizes)
+{
+    Remove(texture);
+    Texture& entry = m_textures[texture];
+    entry.mipSizes = mipSizes;
+    entry.baseMip = std::min(baseMip, static_cast<uint32_t>(mipSizes.size()) - 1);
+    entry.residentMip = entry.baseMip;
+    entry.wantedMip = static_cast<float>(entry.baseMip);
+    for (size_t mip = entry.baseMip; mip < mipSizes.size(); ++mip)
+        m_usage += mipSizes[mip];
+}
+
+void EfgMipResidency::Remove(uint64_t texture)
+{
+    auto entry = m_textures.find(texture);
+    if (entry == m_textures.end())
+        return;
+    // A load in progress already counts against the budget.
+    uint32_t firstMip = entry->second.loading ? entry->second.residentMip - 1 : entry->second.residentMip;
+    for (size_t mip = firstMip; mip < entry->second.mipSizes.size(); ++mip)
+        m_usage -= entry->second.mipSizes[mip];
+    m_textures.erase(entry);
+}
+
+void EfgMipResidency::Report(uint64_t texture, float mip)
+{
+    auto entry = m_textures.find(texture);
+    if (entry == m_textures.end())
+        return;
+    mip = std::max(mip, 0.0f);
+    if (!entry->second.reported || mip < entry->second.reportedMip)
+        entry->second.reportedMip = mip;
+    entry->second.reported = true;
+}
+
+EfgMipResidency::TextureMap::value_type* EfgMipResidency::FindVictim(const Texture* loading, float urgency)
+{
+    // Dropping the finest mip of a texture leaves it residentMip + 1 - wantedMip levels
+    // short, the victim is the one left shortest, and it must end up less short than the load.
+    TextureMap::value_type* victim = nullptr;
+    float victimShortfall = urgency;
+    for (auto& entry : m_textures)
+    {
+        Texture& texture = entry.second;
+        if (&texture == loading || texture.loading || texture.residentMip >= texture.baseMip)
+            continue;
+        float shortfall = static_cast<float>(texture.residentMip + 1) - texture.wantedMip;
+        if (shortfall < victimShortfall)
+        {
+            victim = &entry;
+            victimShortfall = shortfall;
+        }
+    }
+    return victim;
+}
+
+void EfgMipResidency::Update(uint64_t maxLoadBytes, std::vector<Eviction>& evictions, std::vector<Load>& loads)
+{
+    struct Candidate
+    {
+        uint64_t texture;
+        Texture* entry;
+        float urgency;
+    };
+    std::vector<Candidate> candidates;
+    for (auto& entry : m_textures)
+    {
+        Texture& texture = entry.second;
+        if (texture.reported)
+        {
+            texture.wantedMip = std::min(texture.reportedMip, static_cast<float>(texture.baseMip));
+            texture.idleFrames = 0;
+        }
+        else if (++texture.idleFrames > IdleFrames)
+        {
+            texture.wantedMip = static_cast<float>(texture.baseMip);
+        }
+        texture.reported = false;
+        // Sampling mip 2.3 reads mip 2, so that one is needed.
+        if (!texture.loading && std::floor(texture.wantedMip) < static_cast<float>(texture.residentMip))
+            candidates.push_back({ entry.first, &texture, static_cast<float>(texture.residentMip) - texture.wantedMip });
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.urgency > b.urgency; });
+
+    uint64_t loadBytes = 0;
+    for (const Candidate& candidate : candidates)
+    {
+        uint32_t mip = candidate.entry->residentMip - 1;
+        uint64_t size = candidate.entry->mipSizes[mip];
+        if (loadBytes > 0 && loadBytes + size > maxLoadBytes)
+            break;
+        while (m_usage + size > m_budget)
+        {
+            TextureMap::value_type* victim = FindVictim(candidate.entry, candidate.urgency);
+            if (!victim)
+                break;
+            Texture& evicted = victim->second;
+            evictions.push_back({ victim->first, evicted.residentMip });
+            m_usage -= evicted.mipSizes[evicted.residentMip];
+            evicted.residentMip++;
+        }
+        // A smaller mip further down may still fit.
+        if (m_usage + size > m_budget)
+            continue;
+        candidate.entry->loading = true;
+        m_usage += size;
+        loadBytes += size;
+        loads.push_back({ candidate.texture, mip, candidate.urgency });
+    }
+}
+
+void EfgMipResidency::CompleteLoad(uint64_t texture, bool loaded)
+{
+    auto entry = m_textures.find(texture);
+    if (entry == m_textures.end() || !entry->second.loading)
+        return;
+    entry->second.loading = false;
+    if (loaded)
+        entry->second.residentMip--;
+    else
+        m_usage -= entry->second.mipSizes[entry->second.residentMip - 1];
+}
+
+uint32_t EfgMipResidency::GetResidentMip(uint64_t texture) const
+{
+    auto entry = m_textures.find(texture);
+    return entry == m_textures.end() ? 0 : entry->second.residentMip;
+}
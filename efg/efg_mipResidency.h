@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Decides which mips of streamed textures stay resident under a memory budget. Only
+// bookkeeping, EfgContext maps the tiles and copies the mips it is asked for.
+//
+// Mips from a texture's base mip on are loaded with it and stay for its lifetime. The
+// finer ones come in one at a time while the renderer reports that it could use them,
+// most wanted first. A resident mip is evicted only when a load needs its memory and
+// is wanted more, so textures that went out of view keep their mips until then.
+class EfgMipResidency
+{
+public:
+    struct Load
+    {
+        uint64_t texture = 0;
+        uint32_t mip = 0;
+        // How many levels the texture is short of what was reported, higher first.
+        float urgency = 0.0f;
+    };
+    struct Eviction
+    {
+        uint64_t texture = 0;
+        // Dropped mip, the texture is resident from mip + 1 on.
+        uint32_t mip = 0;
+    };
+
+    // mipSizes holds what each mip costs while resident, its whole chain.
+    void Add(uint64_t texture, uint32_t baseMip, const std::vector<uint64_t>& mipSizes);
+    void Remove(uint64_t texture);
+    void SetBudget(uint64_t budget) { m_budget = budget; }
+    // The finest mip the renderer would sample this frame, the finest one counts when
+    // a texture is reported several times.
+    void Report(uint64_t texture, float mip);
+    // Once a frame. Evictions come first and free the memory of the loads, which stop
+    // at maxLoadBytes except for the first one.
+    void Update(uint64_t maxLoadBytes, std::vector<Eviction>& evictions, std::vector<Load>& loads);
+    // Ends a load handed out by Update. A failed load may be handed out again.
+    void CompleteLoad(uint64_t texture, bool loaded);
+
+    uint32_t GetResidentMip(uint64_t texture) const;
+    uint64_t GetUsage() const { return m_usage; }
+    uint64_t GetBudget() const { return m_budget; }
+
+private:
+    struct Texture
+    {
+        std::vector<uint64_t> mipSizes;
+        uint32_t baseMip = 0;
+        uint32_t residentMip = 0;
+        float wantedMip = 0.0f;
+        float reportedMip = 0.0f;
+        bool reported = false;
+        uint32_t idleFrames = 0;
+        bool loading = false;
+    };
+
+    typedef std::unordered_map<uint64_t, Texture> TextureMap;
+    TextureMap::value_type* FindVictim(const Texture* loading, float urgency);
+
+    TextureMap m_textures;
+    uint64_t m_budget = 256ull << 20;
+    uint64_t m_usage = 0;
+};
@@ -0,0 +1,435 @@
+#include "efg_objParser.h"
+#include <charconv>
+#include <cstring>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+// Smaller chunks cost more in task overhead than they save.
+static const size_t MinChunkSize = 1 << 20;
+
+struct ObjChunk
+{
+    const char* begin = nullptr;
+    const char* end = nullptr;
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<float> texcoords;
+    std::vector<EfgObjIndex> indices;
+    // Negative OBJ indices are stored relative to the start of the chunk, these are
+    // the corners holding them, as corner * 3 + attribute.
+    std::vector<uint32_t> relativeIndices;
+    // First triangle of the chunk each usemtl applies from.
+    std::vector<std::pair<uint32_t, std::string>> materialSwitches;
+    std::vector<std::string> materialLibraries;
+    int32_t firstMaterialId = -1;
+    size_t errorOffset = SIZE_MAX;
+};
+
+static bool IsSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const char* SkipSpaces(const char* p, const char* end)
+{
+    while (p < end && IsSpace(*p))
+        ++p;
+    return p;
+}
+
+static const char* SkipToken(const char* p, const char* end)
+{
+    while (p < end && !IsSpace(*p))
+        ++p;
+    return p;
+}
+
+static bool IsKeyword(const char* token, const char* tokenEnd, const char* keyword)
+{
+    size_t length = strlen(keyword);
+    return static_cast<size_t>(tokenEnd - token) == length && memcmp(token, keyword, length) == 0;
+}
+
+static std::string GetRestOfLine(const char* p, const char* end)
+{
+    p = SkipSpaces(p, end);
+    while (end > p && IsSpace(end[-1]))
+        --end;
+    return std::string(p, end);
+}
+
+static bool ParseFloat(const char*& p, const char* end, float& value)
+{
+    p = SkipSpaces(p, end);
+    // from_chars rejects an explicit plus sign.
+    if (p < end && *p == '+')
+        ++p;
+    std::from_chars_result result = std::from_chars(p, end, value);
+    if (result.ec != std::errc())
+        return false;
+    p = result.ptr;
+    return true;
+}
+
+static bool ParseFloats(const char* p, const char* end, std::vector<float>& values, int count, int required)
+{
+    float parsed[3] = {};
+    for (int i = 0; i < count; ++i)
+    {
+        if (!ParseFloat(p, end, parsed[i]) && i < required)
+            return false;
+    }
+    values.insert(values.end(), parsed, parsed + count);
+    return true;
+}
+
+// One attribute of a face corner. count is the number of such attributes the chunk
+// has read so far, negative indices count back from it.
+static bool ParseIndex(const char*& p, const char* end, size_t count, int32_t& index, bool& relative)
+{
+    int32_t value = 0;
+    std::from_chars_result result = std::from_chars(p, end, value);
+    if (result.ec != std::errc() || value == 0)
+        return false;
+    p = result.ptr;
+    relative = value < 0;
+    index = relative ? static_cast<int32_t>(count) + value : value - 1;
+    return true;
+}
+
+static bool ParseFace(const char* p, const char* end, ObjChunk& chunk, std::vector<EfgObjIndex>& face, std::vector<uint8_t>& faceRelative)
+{
+    face.clear();
+    faceRelative.clear();
+    size_t counts[3] = { chunk.positions.size() / 3, chunk.texcoords.size() / 2, chunk.normals.size() / 3 };
+    for (p = SkipSpaces(p, end); p < end; p = SkipSpaces(p, end))
+    {
+        // v, v/vt, v//vn or v/vt/vn
+        EfgObjIndex corner;
+        int32_t* attributes[3] = { &corner.position, &corner.texcoord, &corner.normal };
+        uint8_t relative = 0;
+        for (int attribute = 0; attribute < 3; ++attribute)
+        {
+            if (attribute > 0)
+            {
+                if (p >= end || *p != '/')
+                    break;
+                ++p;
+                if (p < end && *p == '/')
+                    continue;
+                if (p >= end || IsSpace(*p))
+                    break;
+            }
+            bool isRelative = false;
+            if (!ParseIndex(p, end, counts[attribute], *attributes[attribute], isRelative))
+                return false;
+            if (isRelative)
+                relative |= 1 << attribute;
+        }
+        if (p < end && !IsSpace(*p))
+            return false;
+        face.push_back(corner);
+        faceRelative.push_back(relative);
+    }
+
+    for (size_t i = 1; i + 1 < face.size(); ++i)
+    {
+        const size_t fan[3] = { 0, i, i + 1 };
+        for (size_t corner : fan)
+        {
+            for (uint32_t attribute = 0; attribute < 3; ++attribute)
+            {
+                if (faceRelative[corner] & (1 << attribute))
+                    chunk.relativeIndices.push_back(static_cast<uint32_t>(chunk.indices.size()) * 3 + attribute);
+            }
+            chunk.indices.push_back(face[corner]);
+        }
+    }
+    return true;
+}
+
+static void ParseChunk(ObjChunk& chunk, const char* fileBegin)
+{
+    std::vector<EfgObjIndex> face;
+    std::vector<uint8_t> faceRelative;
+    const char* line = chunk.begin;
+    while (line < chunk.end)
+    {
+        const char* lineEnd = static_cast<const char*>(memchr(line, '\n', chunk.end - line));
+        if (lineEnd == nullptr)
+            lineEnd = chunk.end;
+        const char* token = SkipSpaces(line, lineEnd);
+        const char* tokenEnd = SkipToken(token, lineEnd);
+        bool valid = true;
+
+        if (IsKeyword(token, tokenEnd, "v"))
+            valid = ParseFloats(tokenEnd, lineEnd, chunk.positions, 3, 3);
+        else if (IsKeyword(token, tokenEnd, "vn"))
+            valid = ParseFloats(tokenEnd, lineEnd, chunk.normals, 3, 3);
+        else if (IsKeyword(token, tokenEnd, "vt"))
+            valid = ParseFloats(tokenEnd, lineEnd, chunk.texcoords, 2, 1);
+        else if (IsKeyword(token, tokenEnd, "f"))
+            valid = ParseFace(tokenEnd, lineEnd, chunk, face, faceRelative);
+        else if (IsKeyword(token, tokenEnd, "usemtl"))
+            chunk.materialSwitches.emplace_back(static_cast<uint32_t>(chunk.indices.size() / 3), GetRestOfLine(tokenEnd, lineEnd));
+        else if (IsKeyword(token, tokenEnd, "mtllib"))
+        {
+            for (const char* name = SkipSpaces(tokenEnd, lineEnd); name < lineEnd; name = SkipSpaces(name, lineEnd))
+            {
+                const char* nameEnd = SkipToken(name, lineEnd);
+                chunk.materialLibraries.emplace_back(name, nameEnd);
+                name = nameEnd;
+            }
+        }
+
+        if (!valid)
+        {
+            chunk.errorOffset = line - fileBegin;
+            return;
+        }
+        line = lineEnd + 1;
+    }
+}
+
+static void ParseMtl(const EfgVfs& vfs, const fs::path& path, std::vector<EfgObjMaterial>& materials, std::unordered_map<std::string, int32_t>& materialIds)
+{
+    EfgVfsFile file;
+    if (!vfs.Open(path, file))
+        return;
+    const char* text = reinterpret_cast<const char*>(file.GetData());
+    const char* fileEnd = text + file.GetSize();
+    EfgObjMaterial* material = nullptr;
+    bool hasDissolve = false;
+    const char* nextLine = text;
+    for (const char* line = text; line < fileEnd; line = nextLine)
+    {
+        const char* end = static_cast<const char*>(memchr(line, '\n', fileEnd - line));
+        end = (end != nullptr) ? end : fileEnd;
+        nextLine = (end < fileEnd) ? end + 1 : fileEnd;
+        const char* token = SkipSpaces(line, end);
+        const char* p = SkipToken(token, end);
+        if (IsKeyword(token, p, "newmtl"))
+        {
+            EfgObjMaterial newMaterial;
+            newMaterial.name = GetRestOfLine(p, end);
+            // The first definition of a name wins, like tinyobjloader.
+            materialIds.emplace(newMaterial.name, static_cast<int32_t>(materials.size()));
+            materials.push_back(newMaterial);
+            material = &materials.back();
+            hasDissolve = false;
+            continue;
+        }
+        if (material == nullptr)
+            continue;
+
+        float* color = nullptr;
+        float* scalar = nullptr;
+        if (IsKeyword(token, p, "Ka"))
+            color = material->ambient;
+        else if (IsKeyword(token, p, "Kd"))
+            color = material->diffuse;
+        else if (IsKeyword(token, p, "Ks"))
+            color = material->specular;
+        else if (IsKeyword(token, p, "Kt") || IsKeyword(token, p, "Tf"))
+            color = material->transmittance;
+        else if (IsKeyword(token, p, "Ke"))
+            color = material->emission;
+        else if (IsKeyword(token, p, "Ns"))
+            scalar = &material->shininess;
+        else if (IsKeyword(token, p, "Ni"))
+            scalar = &material->ior;
+        else if (IsKeyword(token, p, "Pr"))
+            scalar = &material->roughness;
+        else if (IsKeyword(token, p, "Pm"))
+            scalar = &material->metallic;
+        else if (IsKeyword(token, p, "Pc"))
+            scalar = &material->clearcoatThickness;
+        else if (IsKeyword(token, p, "Pcr"))
+            scalar = &material->clearcoatRoughness;
+        else if (IsKeyword(token, p, "d"))
+        {
+            scalar = &material->dissolve;
+            hasDissolve = true;
+        }
+        else if (IsKeyword(token, p, "Tr"))
+        {
+            float transparency = 0.0f;
+            if (!hasDissolve && ParseFloat(p, end, transparency))
+                material->dissolve = 1.0f - transparency;
+        }
+        else if (IsKeyword(token, p, "map_Kd"))
+        {
+            // Options come first, the file name is the last token.
+            const char* nameEnd = end;
+            while (nameEnd > p && IsSpace(nameEnd[-1]))
+                --nameEnd;
+            const char* name = nameEnd;
+            while (name > p && !IsSpace(name[-1]))
+                --name;
+            material->diffuseTexture.assign(name, nameEnd);
+        }
+
+        if (color != nullptr)
+        {
+            for (int i = 0; i < 3; ++i)
+                ParseFloat(p, end, color[i]);
+        }
+        if (scalar != nullptr)
+            ParseFloat(p, end, *scalar);
+    }
+}
+
+template<typename TYPE>
+static void CopyAt(std::vector<TYPE>& destination, size_t offset, const std::vector<TYPE>& source)
+{
+    if (!source.empty())
+        memcpy(destination.data() + offset, source.data(), source.size() * sizeof(TYPE));
+}
+
+bool efgParseObj(const fs::path& path, const fs::path& mtlSearchPath, const EfgVfs& vfs, EfgThreadPool& threadPool, EfgObjMesh& mesh, std::string& error)
+{
+    mesh = EfgObjMesh();
+    EfgVfsFile file;
+    if (!vfs.Open(path, file))
+    {
+        error = "Could not open " + path.string();
+        return false;
+    }
+
+    // Line aligned chunks, one per worker and the calling thread.
+    const char* begin = reinterpret_cast<const char*>(file.GetData());
+    const char* end = begin + file.GetSize();
+    size_t chunkCount = file.GetSize() / MinChunkSize + 1;
+    if (chunkCount > threadPool.GetThreadCount() + 1)
+        chunkCount = threadPool.GetThreadCount() + 1;
+    std::vector<ObjChunk> chunks(chunkCount);
+    const char* chunkBegin = begin;
+    for (size_t i = 0; i < chunkCount; ++i)
+    {
+        const char* chunkEnd = (i + 1 == chunkCount) ? end : begin + file.GetSize() * (i + 1) / chunkCount;
+        if (chunkEnd < chunkBegin)
+            chunkEnd = chunkBegin;
+        const char* newline = static_cast<const char*>(memchr(chunkEnd, '\n', end - chunkEnd));
+        chunkEnd = (newline != nullptr) ? newline + 1 : end;
+        chunks[i].begin = chunkBegin;
+        chunks[i].end = chunkEnd;
+        chunkBegin = chunkEnd;
+    }
+
+    std::vector<std::future<void>> tasks;
+    for (size_t i = 1; i < chunkCount; ++i)
+        tasks.push_back(threadPool.Submit([&chunks, i, begin]() { ParseChunk(chunks[i], begin); }));
+    ParseChunk(chunks[0], begin);
+    for (std::future<void>& task : tasks)
+        task.get();
+    tasks.clear();
+
+    for (const ObjChunk& chunk : chunks)
+    {
+        if (chunk.errorOffset != SIZE_MAX)
+        {
+            error = path.string() + ": invalid line at byte " + std::to_string(chunk.errorOffset);
+            return false;
+        }
+    }
+
+    std::unordered_map<std::string, int32_t> materialIds;
+    fs::path mtlDirectory = mtlSearchPath.empty() ? path.parent_path() : mtlSearchPath;
+    for (const ObjChunk& chunk : chunks)
+    {
+        for (const std::string& library : chunk.materialLibraries)
+        {
+            mesh.materialLibraries.push_back(mtlDirectory / library);
+            ParseMtl(vfs, mesh.materialLibraries.back(), mesh.materials, materialIds);
+        }
+    }
+
+    // Prefix sums place every chunk in the merged arrays. The material in effect at
+    // the start of a chunk is the last one set by the chunks before it.
+    std::vector<size_t> positionOffsets(chunkCount + 1, 0);
+    std::vector<size_t> normalOffsets(chunkCount + 1, 0);
+    std::vector<size_t> texcoordOffsets(chunkCount + 1, 0);
+    std::vector<size_t> indexOffsets(chunkCount + 1, 0);
+    int32_t materialId = -1;
+    for (size_t i = 0; i < chunkCount; ++i)
+    {
+        positionOffsets[i + 1] = positionOffsets[i] + chunks[i].positions.size();
+        normalOffsets[i + 1] = normalOffsets[i] + chunks[i].normals.size();
+        texcoordOffsets[i + 1] = texcoordOffsets[i] + chunks[i].texcoords.size();
+        indexOffsets[i + 1] = indexOffsets[i] + chunks[i].indices.size();
+        chunks[i].firstMaterialId = materialId;
+        if (!chunks[i].materialSwitches.empty())
+        {
+            auto found = materialIds.find(chunks[i].materialSwitches.back().second);
+            materialId = (found != materialIds.end()) ? found->second : -1;
+        }
+    }
+    mesh.positions.resize(positionOffsets[chunkCount]);
+    mesh.normals.resize(normalOffsets[chunkCount]);
+    mesh.texcoords.resize(texcoordOffsets[chunkCount]);
+    mesh.indices.resize(indexOffsets[chunkCount]);
+    mesh.materialIds.resize(indexOffsets[chunkCount] / 3);
+
+    const int32_t counts[3] = { static_cast<int32_t>(mesh.positions.size() / 3), static_cast<int32_t>(mesh.texcoords.size() / 2),
+        static_cast<int32_t>(mesh.normals.size() / 3) };
+    std::vector<uint8_t> chunkValid(chunkCount, 1);
+    auto mergeChunk = [&](size_t i) {
+        const ObjChunk& chunk = chunks[i];
+        CopyAt(mesh.positions, positionOffsets[i], chunk.positions);
+        CopyAt(mesh.normals, normalOffsets[i], chunk.normals);
+        CopyAt(mesh.texcoords, texcoordOffsets[i], chunk.texcoords);
+        CopyAt(mesh.indices, indexOffsets[i], chunk.indices);
+
+        EfgObjIndex* indices = mesh.indices.data() + indexOffsets[i];
+        const int32_t chunkStarts[3] = { static_cast<int32_t>(positionOffsets[i] / 3), static_cast<int32_t>(texcoordOffsets[i] / 2),
+            static_cast<int32_t>(normalOffsets[i] / 3) };
+        for (size_t corner = 0; corner < chunk.indices.size(); ++corner)
+        {
+            int32_t* attributes[3] = { &indices[corner].position, &indices[corner].texcoord, &indices[corner].normal };
+            for (int attribute = 0; attribute < 3; ++attribute)
+            {
+                if (*attributes[attribute] >= counts[attribute])
+                    chunkValid[i] = 0;
+            }
+        }
+        for (uint32_t relative : chunk.relativeIndices)
+        {
+            EfgObjIndex& corner = indices[relative / 3];
+            int32_t* attributes[3] = { &corner.position, &corner.texcoord, &corner.normal };
+            int32_t& index = *attributes[relative % 3];
+            index += chunkStarts[relative % 3];
+            if (index < 0)
+                chunkValid[i] = 0;
+        }
+
+        int32_t* triangleMaterials = mesh.materialIds.data() + indexOffsets[i] / 3;
+        int32_t currentMaterial = chunk.firstMaterialId;
+        uint32_t triangle = 0;
+        uint32_t triangleCount = static_cast<uint32_t>(chunk.indices.size() / 3);
+        for (const auto& materialSwitch : chunk.materialSwitches)
+        {
+            for (; triangle < materialSwitch.first; ++triangle)
+                triangleMaterials[triangle] = currentMaterial;
+            auto found = materialIds.find(materialSwitch.second);
+            currentMaterial = (found != materialIds.end()) ? found->second : -1;
+        }
+        for (; triangle < triangleCount; ++triangle)
+            triangleMaterials[triangle] = currentMaterial;
+    };
+    for (size_t i = 1; i < chunkCount; ++i)
+        tasks.push_back(threadPool.Submit([&mergeChunk, i]() { mergeChunk(i); }));
+    mergeChunk(0);
+    for (std::future<void>& task : tasks)
+        task.get();
+
+    for (size_t i = 0; i < chunkCount; ++i)
+    {
+        if (!chunkValid[i])
+        {
+            error = path.string() + ": face index out of range";
+            return false;
+        }
+    }
+    return true;
+}
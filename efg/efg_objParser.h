@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "efg_threadPool.h"
+#include "efg_vfs.h"
+
+// Defaults follow tinyobjloader, the importer this replaced, so scenes keep their look.
+struct EfgObjMaterial
+{
+    std::string name;
+    float ambient[3] = { 0.0f, 0.0f, 0.0f };
+    float diffuse[3] = { 0.0f, 0.0f, 0.0f };
+    float specular[3] = { 0.0f, 0.0f, 0.0f };
+    float transmittance[3] = { 0.0f, 0.0f, 0.0f };
+    float emission[3] = { 0.0f, 0.0f, 0.0f };
+    float shininess = 1.0f;
+    float ior = 1.0f;
+    float dissolve = 1.0f;
+    float roughness = 0.0f;
+    float metallic = 0.0f;
+    float clearcoatThickness = 0.0f;
+    float clearcoatRoughness = 0.0f;
+    std::string diffuseTexture;
+};
+
+// Zero based, -1 when the corner has no such attribute.
+struct EfgObjIndex
+{
+    int32_t position = -1;
+    int32_t texcoord = -1;
+    int32_t normal = -1;
+};
+
+struct EfgObjMesh
+{
+    std::vector<float> positions; // xyz
+    std::vector<float> normals;   // xyz
+    std::vector<float> texcoords; // uv
+    // Faces are fan triangulated, three corners per triangle.
+    std::vector<EfgObjIndex> indices;
+    // Index into materials per triangle, -1 before the first usemtl or for unknown names.
+    std::vector<int32_t> materialIds;
+    std::vector<EfgObjMaterial> materials;
+    std::vector<std::filesystem::path> materialLibraries;
+};
+
+// Maps the file and parses line aligned chunks of it on the pool, then merges the
+// per-chunk attribute arrays at their prefix sum offsets. MTL files are looked up in
+// mtlSearchPath, or next to the OBJ when it is empty, both are opened through vfs.
+// Blocks on the pool, so it must not be called from one of its tasks.
+bool efgParseObj(const std::filesystem::path& path, const std::filesystem::path& mtlSearchPath, const EfgVfs& vfs, EfgThreadPool& threadPool,
+    EfgObjMesh& mesh, std::string& error);
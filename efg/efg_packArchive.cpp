@@ -0,0 +1,219 @@
+#include "efg_packArchive.h"
+#include "efg_hash.h"
+#include "efg_lz4.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static const uint32_t PackMagic = 0x4B504645; // "EFPK"
+static const uint32_t PackVersion = 1;
+// Stored entries get pages of their own, compressed ones are copied out anyway.
+static const uint64_t StoredAlignment = 4096;
+static const uint64_t CompressedAlignment = 16;
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Written so a corrupt offset can't wrap around and pass.
+static bool IsRangeInFile(uint64_t offset, uint64_t size, uint64_t fileSize)
+{
+    return offset <= fileSize && size <= fileSize - offset;
+}
+
+std::string efgPackName(const std::filesystem::path& path)
+{
+    std::string name = path.lexically_normal().generic_u8string();
+    while (name.compare(0, 2, "./") == 0)
+        name.erase(0, 2);
+    for (char& c : name)
+    {
+        if (c >= 'A' && c <= 'Z')
+            c = static_cast<char>(c - 'A' + 'a');
+    }
+    return name;
+}
+
+uint64_t efgPackKey(const std::string& name)
+{
+    EfgHash hash;
+    hash.AddString(name.c_str());
+    return hash.Get();
+}
+
+bool EfgPackArchiveWriter::Add(const std::string& name, std::vector<uint8_t> contents, int64_t writeTime, bool compress)
+{
+    Entry entry;
+    entry.name = name;
+    entry.entry.key = efgPackKey(name);
+    entry.entry.size = contents.size();
+    entry.entry.hash = efgHash(contents.data(), contents.size());
+    entry.entry.writeTime = writeTime;
+    if (compress && !contents.empty())
+    {
+        std::vector<uint8_t> compressed(efgLz4CompressBound(contents.size()));
+        size_t compressedSize = efgLz4Compress(contents.data(), contents.size(), compressed.data(), compressed.size());
+        if (compressedSize > 0 && compressedSize < contents.size() - contents.size() / 8)
+        {
+            compressed.resize(compressedSize);
+            contents.swap(compressed);
+            entry.entry.compression = efgPackCompression_LZ4;
+        }
+    }
+    entry.entry.storedSize = contents.size();
+    entry.data = std::move(contents);
+
+    // A file added twice keeps the last contents.
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto existing = m_entryIndices.emplace(entry.name, m_entries.size());
+    if (!existing.second)
+    {
+        m_entries[existing.first->second] = std::move(entry);
+        return false;
+    }
+    m_entries.push_back(std::move(entry));
+    return true;
+}
+
+bool EfgPackArchiveWriter::Write(const std::filesystem::path& path) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<const Entry*> sorted;
+    for (const Entry& entry : m_entries)
+        sorted.push_back(&entry);
+    std::sort(sorted.begin(), sorted.end(), [](const Entry* a, const Entry* b) { return a->entry.key < b->entry.key; });
+
+    EfgPackHeader header = {};
+    header.magic = PackMagic;
+    header.version = PackVersion;
+    header.entryCount = static_cast<uint32_t>(sorted.size());
+    header.entriesOffset = sizeof(EfgPackHeader);
+    header.stringsOffset = header.entriesOffset + sorted.size() * sizeof(EfgPackEntry);
+
+    std::string strings;
+    std::vector<EfgPackEntry> entries;
+    for (const Entry* entry : sorted)
+    {
+        EfgPackEntry packed = entry->entry;
+        packed.nameOffset = static_cast<uint32_t>(strings.size());
+        strings.append(entry->name);
+        strings.push_back('\0');
+        entries.push_back(packed);
+    }
+    header.stringsSize = strings.size();
+
+    uint64_t offset = header.stringsOffset + header.stringsSize;
+    for (EfgPackEntry& entry : entries)
+    {
+        offset = AlignUp(offset, entry.compression == efgPackCompression_NONE ? StoredAlignment : CompressedAlignment);
+        entry.offset = offset;
+        offset += entry.storedSize;
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(EfgPackEntry));
+    file.write(strings.data(), strings.size());
+    uint64_t written = header.stringsOffset + header.stringsSize;
+    const char padding[StoredAlignment] = {};
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        file.write(padding, entries[i].offset - written);
+        file.write(reinterpret_cast<const char*>(sorted[i]->data.data()), sorted[i]->data.size());
+        written = entries[i].offset + entries[i].storedSize;
+    }
+    return static_cast<bool>(file);
+}
+
+EfgPackWriterStats EfgPackArchiveWriter::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    EfgPackWriterStats stats;
+    for (const Entry& entry : m_entries)
+    {
+        stats.entryCount++;
+        if (entry.entry.compression != efgPackCompression_NONE)
+            stats.compressedCount++;
+        stats.size += entry.entry.size;
+        stats.storedSize += entry.entry.storedSize;
+    }
+    return stats;
+}
+
+bool EfgPackArchive::Open(const std::filesystem::path& path)
+{
+    Close();
+    auto file = std::make_shared<EfgMappedFile>();
+    if (!file->Open(path))
+        return false;
+
+    const uint8_t* data = file->GetData();
+    uint64_t size = file->GetSize();
+    const EfgPackHeader* header = reinterpret_cast<const EfgPackHeader*>(data);
+    // The entries are read in place, a misaligned offset is as corrupt as an out of range one.
+    bool valid = size >= sizeof(EfgPackHeader) && header->magic == PackMagic && header->version == PackVersion &&
+        header->entriesOffset % alignof(EfgPackEntry) == 0 &&
+        IsRangeInFile(header->entriesOffset, uint64_t(header->entryCount) * sizeof(EfgPackEntry), size) &&
+        IsRangeInFile(header->stringsOffset, header->stringsSize, size) &&
+        (header->stringsSize == 0 || data[header->stringsOffset + header->stringsSize - 1] == '\0');
+    const EfgPackEntry* entries = valid ? reinterpret_cast<const EfgPackEntry*>(data + header->entriesOffset) : nullptr;
+    for (uint32_t i = 0; valid && i < header->entryCount; ++i)
+    {
+        const EfgPackEntry& entry = entries[i];
+        valid = IsRangeInFile(entry.offset, entry.storedSize, size) && entry.nameOffset < header->stringsSize &&
+            entry.compression <= efgPackCompression_LZ4 && (entry.compression != efgPackCompression_NONE || entry.storedSize == entry.size);
+    }
+    if (!valid)
+    {
+        std::cerr << "Error: invalid pack archive " << path.string() << std::endl;
+        return false;
+    }
+
+    m_file = file;
+    m_header = header;
+    m_entries = entries;
+    m_strings = reinterpret_cast<const char*>(data + header->stringsOffset);
+    return true;
+}
+
+void EfgPackArchive::Close()
+{
+    // Files handed out keep their own reference to the mapping.
+    m_file.reset();
+    m_header = nullptr;
+    m_entries = nullptr;
+    m_strings = nullptr;
+}
+
+const EfgPackEntry* EfgPackArchive::Find(const std::string& name) const
+{
+    if (!m_file)
+        return nullptr;
+    uint64_t key = efgPackKey(name);
+    const EfgPackEntry* end = m_entries + m_header->entryCount;
+    const EfgPackEntry* entry = std::lower_bound(m_entries, end, key, [](const EfgPackEntry& e, uint64_t k) { return e.key < k; });
+    // Names are compared too, a hash collision must not return another file.
+    for (; entry != end && entry->key == key; ++entry)
+    {
+        if (name == GetName(*entry))
+            return entry;
+    }
+    return nullptr;
+}
+
+const char* EfgPackArchive::GetName(const EfgPackEntry& entry) const
+{
+    return (entry.nameOffset < m_header->stringsSize) ? m_strings + entry.nameOffset : "";
+}
+
+bool EfgPackArchive::Read(const EfgPackEntry& entry, uint8_t* destination) const
+{
+    const uint8_t* stored = GetStoredData(entry);
+    if (entry.compression == efgPackCompression_LZ4)
+        return efgLz4Decompress(stored, static_cast<size_t>(entry.storedSize), destination, static_cast<size_t>(entry.size));
+    if (entry.size > 0)
+        memcpy(destination, stored, static_cast<size_t>(entry.size));
+    return true;
+}
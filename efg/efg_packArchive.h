@@ -0,0 +1,107 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "efg_mappedFile.h"
+
+// Packed asset archive written by efgPacker, read through EfgVfs. Entries are found by
+// the hash of their name and compressed one by one, so a load only touches its own
+// pages. Stored entries start on a page, they are used straight from the mapping.
+//
+// Header | Entry[entryCount] sorted by key | strings | data
+
+enum EFG_PACK_COMPRESSION
+{
+    efgPackCompression_NONE,
+    efgPackCompression_LZ4
+};
+
+struct EfgPackHeader
+{
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint32_t entryCount = 0;
+    uint32_t reserved = 0;
+    uint64_t entriesOffset = 0;
+    uint64_t stringsOffset = 0;
+    uint64_t stringsSize = 0;
+};
+
+struct EfgPackEntry
+{
+    uint64_t key = 0;        // efgPackKey() of the name
+    uint64_t offset = 0;
+    uint64_t storedSize = 0;
+    uint64_t size = 0;       // After decompression
+    uint64_t hash = 0;       // efgHash() of the contents
+    int64_t writeTime = 0;   // Of the packed file, stamps like a loose file's
+    uint32_t nameOffset = 0; // Null terminated, into the string table
+    uint32_t compression = efgPackCompression_NONE;
+};
+
+// Relative path with forward slashes, lower case so lookups ignore case like Windows.
+std::string efgPackName(const std::filesystem::path& path);
+uint64_t efgPackKey(const std::string& name);
+
+struct EfgPackWriterStats
+{
+    uint32_t entryCount = 0;
+    uint32_t compressedCount = 0;
+    uint64_t size = 0;
+    uint64_t storedSize = 0;
+};
+
+class EfgPackArchiveWriter
+{
+public:
+    // Entries that LZ4 shrinks by less than an eighth are stored, so they can be mapped.
+    // Thread safe, the compression runs outside the lock. Returns false when it replaced a
+    // file of the same name, e.g. one that differs only in case.
+    bool Add(const std::string& name, std::vector<uint8_t> contents, int64_t writeTime, bool compress);
+    bool Write(const std::filesystem::path& path) const;
+    EfgPackWriterStats GetStats() const;
+
+private:
+    struct Entry
+    {
+        EfgPackEntry entry;
+        std::string name;
+        std::vector<uint8_t> data;
+    };
+
+    std::vector<Entry> m_entries;
+    std::unordered_map<std::string, size_t> m_entryIndices;
+    mutable std::mutex m_mutex;
+};
+
+class EfgPackArchive
+{
+public:
+    // Fails quietly when the file is missing, complains when it is not a valid archive.
+    bool Open(const std::filesystem::path& path);
+    void Close();
+    bool IsOpen() const { return m_file != nullptr; }
+
+    // name as made by efgPackName. Returns nullptr when the archive has no such file. Thread safe.
+    const EfgPackEntry* Find(const std::string& name) const;
+    const char* GetName(const EfgPackEntry& entry) const;
+    uint32_t GetEntryCount() const { return m_header ? m_header->entryCount : 0; }
+    const EfgPackEntry& GetEntry(uint32_t index) const { return m_entries[index]; }
+    // The bytes as stored, only the contents for uncompressed entries.
+    const uint8_t* GetStoredData(const EfgPackEntry& entry) const { return m_file->GetData() + entry.offset; }
+    // Decompresses into entry.size bytes.
+    bool Read(const EfgPackEntry& entry, uint8_t* destination) const;
+    // Files handed out by EfgVfs keep the mapping alive.
+    const std::shared_ptr<EfgMappedFile>& GetFile() const { return m_file; }
+
+private:
+    std::shared_ptr<EfgMappedFile> m_file;
+    const EfgPackHeader* m_header = nullptr;
+    const EfgPackEntry* m_entries = nullptr;
+    const char* m_strings = nullptr;
+};
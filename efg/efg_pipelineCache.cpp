@@ -0,0 +1,261 @@
+#include "efg_pipelineCache.h"
+#include "efg_exception.h"
+#include "efg_hash.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+static const uint32_t PipelineCacheMagic = 0x50474645; // "EFGP"
+// Bump when the key hashing changes, old entries would never be hit again.
+static const uint32_t PipelineCacheVersion = 1;
+
+static double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static bool IsSameDevice(const EfgPipelineCacheHeader& a, const EfgPipelineCacheHeader& b)
+{
+    return a.magic == b.magic && a.version == b.version &&
+        a.vendorId == b.vendorId && a.deviceId == b.deviceId && a.subSysId == b.subSysId && a.revision == b.revision &&
+        a.driverVersion == b.driverVersion;
+}
+
+static void HashShader(EfgHash& hash, const D3D12_SHADER_BYTECODE& shader)
+{
+    hash.Add(shader.BytecodeLength);
+    if (shader.pShaderBytecode != nullptr)
+        hash.AddBytes(shader.pShaderBytecode, shader.BytecodeLength);
+}
+
+// Hashed member by member, the state structs contain padding.
+static uint64_t HashPipelineDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, uint64_t rootSignatureHash)
+{
+    EfgHash hash;
+    hash.Add(rootSignatureHash);
+    HashShader(hash, desc.VS);
+    HashShader(hash, desc.PS);
+    HashShader(hash, desc.DS);
+    HashShader(hash, desc.HS);
+    HashShader(hash, desc.GS);
+
+    hash.Add(desc.StreamOutput.NumEntries);
+    for (UINT i = 0; i < desc.StreamOutput.NumEntries; ++i)
+    {
+        const D3D12_SO_DECLARATION_ENTRY& entry = desc.StreamOutput.pSODeclaration[i];
+        hash.Add(entry.Stream);
+        hash.AddString(entry.SemanticName);
+        hash.Add(entry.SemanticIndex);
+        hash.Add(entry.StartComponent);
+        hash.Add(entry.ComponentCount);
+        hash.Add(entry.OutputSlot);
+    }
+    hash.Add(desc.StreamOutput.NumStrides);
+    for (UINT i = 0; i < desc.StreamOutput.NumStrides; ++i)
+        hash.Add(desc.StreamOutput.pBufferStrides[i]);
+    hash.Add(desc.StreamOutput.RasterizedStream);
+
+    hash.Add(desc.BlendState.AlphaToCoverageEnable);
+    hash.Add(desc.BlendState.IndependentBlendEnable);
+    for (const D3D12_RENDER_TARGET_BLEND_DESC& target : desc.BlendState.RenderTarget)
+    {
+        hash.Add(target.BlendEnable);
+        hash.Add(target.LogicOpEnable);
+        hash.Add(target.SrcBlend);
+        hash.Add(target.DestBlend);
+        hash.Add(target.BlendOp);
+        hash.Add(target.SrcBlendAlpha);
+        hash.Add(target.DestBlendAlpha);
+        hash.Add(target.BlendOpAlpha);
+        hash.Add(target.LogicOp);
+        hash.Add(target.RenderTargetWriteMask);
+    }
+    hash.Add(desc.SampleMask);
+
+    const D3D12_RASTERIZER_DESC& rasterizer = desc.RasterizerState;
+    hash.Add(rasterizer.FillMode);
+    hash.Add(rasterizer.CullMode);
+    hash.Add(rasterizer.FrontCounterClockwise);
+    hash.Add(rasterizer.DepthBias);
+    hash.Add(rasterizer.DepthBiasClamp);
+    hash.Add(rasterizer.SlopeScaledDepthBias);
+    hash.Add(rasterizer.DepthClipEnable);
+    hash.Add(rasterizer.MultisampleEnable);
+    hash.Add(rasterizer.AntialiasedLineEnable);
+    hash.Add(rasterizer.ForcedSampleCount);
+    hash.Add(rasterizer.ConservativeRaster);
+
+    const D3D12_DEPTH_STENCIL_DESC& depthStencil = desc.DepthStencilState;
+    hash.Add(depthStencil.DepthEnable);
+    hash.Add(depthStencil.DepthWriteMask);
+    hash.Add(depthStencil.DepthFunc);
+    hash.Add(depthStencil.StencilEnable);
+    hash.Add(depthStencil.StencilReadMask);
+    hash.Add(depthStencil.StencilWriteMask);
+    for (const D3D12_DEPTH_STENCILOP_DESC* face : { &depthStencil.FrontFace, &depthStencil.BackFace })
+    {
+        hash.Add(face->StencilFailOp);
+        hash.Add(face->StencilDepthFailOp);
+        hash.Add(face->StencilPassOp);
+        hash.Add(face->StencilFunc);
+    }
+
+    hash.Add(desc.InputLayout.NumElements);
+    for (UINT i = 0; i < desc.InputLayout.NumElements; ++i)
+    {
+        const D3D12_INPUT_ELEMENT_DESC& element = desc.InputLayout.pInputElementDescs[i];
+        hash.AddString(element.SemanticName);
+        hash.Add(element.SemanticIndex);
+        hash.Add(element.Format);
+        hash.Add(element.InputSlot);
+        hash.Add(element.AlignedByteOffset);
+        hash.Add(element.InputSlotClass);
+        hash.Add(element.InstanceDataStepRate);
+    }
+
+    hash.Add(desc.IBStripCutValue);
+    hash.Add(desc.PrimitiveTopologyType);
+    hash.Add(desc.NumRenderTargets);
+    for (DXGI_FORMAT format : desc.RTVFormats)
+        hash.Add(format);
+    hash.Add(desc.DSVFormat);
+    hash.Add(desc.SampleDesc.Count);
+    hash.Add(desc.SampleDesc.Quality);
+    hash.Add(desc.NodeMask);
+    hash.Add(desc.Flags);
+    return hash.Get();
+}
+
+void EfgPipelineCache::Initialize(ID3D12Device* device, IDXGIAdapter* adapter, const std::wstring& fileName)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    m_device = device;
+    m_fileName = fileName;
+
+    // Pipeline libraries need ID3D12Device1, without it every PSO is compiled.
+    if (FAILED(m_device.As(&m_device1)))
+        return;
+
+    DXGI_ADAPTER_DESC adapterDesc = {};
+    EFG_D3D_TRY(adapter->GetDesc(&adapterDesc));
+    LARGE_INTEGER driverVersion = {};
+    adapter->CheckInterfaceSupport(__uuidof(IDXGIDevice), &driverVersion);
+    m_header.magic = PipelineCacheMagic;
+    m_header.version = PipelineCacheVersion;
+    m_header.vendorId = adapterDesc.VendorId;
+    m_header.deviceId = adapterDesc.DeviceId;
+    m_header.subSysId = adapterDesc.SubSysId;
+    m_header.revision = adapterDesc.Revision;
+    m_header.driverVersion = static_cast<uint64_t>(driverVersion.QuadPart);
+
+    std::ifstream file(m_fileName, std::ios::binary);
+    EfgPipelineCacheHeader header = {};
+    std::error_code error;
+    uint64_t fileSize = std::filesystem::file_size(m_fileName, error);
+    // The size is checked against the file before allocating, a corrupt header is a miss.
+    if (file.read(reinterpret_cast<char*>(&header), sizeof(header)) && !error && IsSameDevice(header, m_header) &&
+        header.dataSize == fileSize - sizeof(header))
+    {
+        m_libraryData.resize(static_cast<size_t>(header.dataSize));
+        if (file.read(reinterpret_cast<char*>(m_libraryData.data()), m_libraryData.size()) &&
+            efgHash(m_libraryData.data(), m_libraryData.size()) == header.dataHash)
+        {
+            // Still fails with D3D12_ERROR_DRIVER_VERSION_MISMATCH or D3D12_ERROR_ADAPTER_NOT_FOUND
+            // when the runtime disagrees with our header, the cache is rebuilt in that case.
+            if (FAILED(m_device1->CreatePipelineLibrary(m_libraryData.data(), m_libraryData.size(), IID_PPV_ARGS(&m_library))))
+                m_library.Reset();
+        }
+    }
+
+    if (!m_library)
+    {
+        m_libraryData.clear();
+        // Some tools (e.g. graphics debuggers) don't support libraries at all.
+        if (FAILED(m_device1->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&m_library))))
+            m_library.Reset();
+    }
+    m_stats.loadLibraryMs = MillisecondsSince(start);
+}
+
+ComPtr<ID3D12PipelineState> EfgPipelineCache::CreateGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, uint64_t rootSignatureHash)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    ComPtr<ID3D12PipelineState> pipelineState;
+
+    wchar_t name[17] = {};
+    if (m_library)
+    {
+        swprintf_s(name, L"%016llx", HashPipelineDesc(desc, rootSignatureHash));
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (SUCCEEDED(m_library->LoadGraphicsPipeline(name, &desc, IID_PPV_ARGS(&pipelineState))))
+        {
+            m_stats.hits++;
+            m_stats.loadPipelinesMs += MillisecondsSince(start);
+            return pipelineState;
+        }
+    }
+
+    EFG_D3D_TRY(m_device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pipelineState)));
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // Fails with E_INVALIDARG if the name is taken by an entry whose description no longer
+    // matches, that pipeline is just compiled every run until the cache file is rebuilt.
+    if (m_library && SUCCEEDED(m_library->StorePipeline(name, pipelineState.Get())))
+        m_dirty = true;
+
+    m_stats.misses++;
+    m_stats.compilePipelinesMs += MillisecondsSince(start);
+    return pipelineState;
+}
+
+void EfgPipelineCache::Save()
+{
+    if (!m_library || !m_dirty)
+        return;
+
+    std::vector<uint8_t> data(m_library->GetSerializedSize());
+    EFG_D3D_TRY(m_library->Serialize(data.data(), data.size()));
+
+    EfgPipelineCacheHeader header = m_header;
+    header.dataSize = data.size();
+    header.dataHash = efgHash(data.data(), data.size());
+
+    // Written aside and renamed, a crash while saving leaves the previous cache.
+    std::filesystem::path path = m_fileName;
+    std::filesystem::path temporaryPath = path;
+    temporaryPath += ".tmp";
+    std::error_code error;
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file.write(reinterpret_cast<const char*>(&header), sizeof(header)) ||
+            !file.write(reinterpret_cast<const char*>(data.data()), data.size()))
+        {
+            file.close();
+            std::filesystem::remove(temporaryPath, error);
+            EFG_SHOW_ERROR("Failed to write pipeline cache");
+            return;
+        }
+    }
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error)
+    {
+        std::filesystem::remove(temporaryPath, error);
+        EFG_SHOW_ERROR("Failed to write pipeline cache");
+        return;
+    }
+    m_dirty = false;
+}
+
+void EfgPipelineCache::Destroy()
+{
+    std::cout << "Pipeline cache: " << m_stats.hits << " hits, " << m_stats.misses << " misses, "
+        << m_stats.loadLibraryMs << " ms opening, " << m_stats.loadPipelinesMs << " ms loading, "
+        << m_stats.compilePipelinesMs << " ms compiling" << std::endl;
+
+    Save();
+    m_library.Reset();
+    m_libraryData.clear();
+    m_device1.Reset();
+    m_device.Reset();
+}
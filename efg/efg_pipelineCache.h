@@ -0,0 +1,58 @@
+#pragma once
+#include <d3d12.h>
+#include <dxgi1_6.h>
+#include <wrl.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using Microsoft::WRL::ComPtr;
+
+struct EfgPipelineCacheStats
+{
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    double loadLibraryMs = 0.0;      // Reading and validating the cache file
+    double loadPipelinesMs = 0.0;    // Pipelines served from the library
+    double compilePipelinesMs = 0.0; // Pipelines compiled by the driver
+};
+
+struct EfgPipelineCacheHeader
+{
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint32_t vendorId = 0;
+    uint32_t deviceId = 0;
+    uint32_t subSysId = 0;
+    uint32_t revision = 0;
+    uint64_t driverVersion = 0;
+    uint64_t dataSize = 0;
+    uint64_t dataHash = 0;
+};
+
+// Keeps compiled PSOs between runs in an ID3D12PipelineLibrary. Pipelines are
+// keyed by a hash of their full description and shader bytecode. The file is
+// thrown away when the adapter, driver or file version changes.
+class EfgPipelineCache
+{
+public:
+    void Initialize(ID3D12Device* device, IDXGIAdapter* adapter, const std::wstring& fileName);
+    ComPtr<ID3D12PipelineState> CreateGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, uint64_t rootSignatureHash);
+    void Save();
+    void Destroy();
+    const EfgPipelineCacheStats& GetStats() const { return m_stats; }
+
+private:
+    ComPtr<ID3D12Device> m_device;
+    ComPtr<ID3D12Device1> m_device1;
+    ComPtr<ID3D12PipelineLibrary> m_library;
+    // The library reads from this memory for its whole lifetime.
+    std::vector<uint8_t> m_libraryData;
+    EfgPipelineCacheHeader m_header = {};
+    std::wstring m_fileName;
+    bool m_dirty = false;
+    EfgPipelineCacheStats m_stats = {};
+    // PSOs are created from pool workers. Compilation itself runs unlocked.
+    std::mutex m_mutex;
+};
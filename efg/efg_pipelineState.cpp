@@ -0,0 +1,77 @@
+#include "efg_pipelineState.h"
+#include "efg_hash.h"
+
+EfgPipelineStateDesc EfgPipelineStateDesc::DepthOnly() const
+{
+    EfgPipelineStateDesc desc = *this;
+    desc.renderTargetCount = 0;
+    desc.blendMode = efgBlend_OPAQUE;
+    desc.depthTest = true;
+    desc.depthWrite = true;
+    return desc;
+}
+
+EfgPipelineStateDesc EfgPipelineStateDesc::ShadowMap() const
+{
+    EfgPipelineStateDesc desc = DepthOnly();
+    desc.depthBias = 50;
+    desc.slopeScaledDepthBias = 1.0f;
+    return desc;
+}
+
+EfgPipelineStateDesc EfgPipelineStateDesc::Wireframe() const
+{
+    EfgPipelineStateDesc desc = *this;
+    desc.fillMode = efgFill_WIREFRAME;
+    desc.cullMode = efgCull_NONE;
+    return desc;
+}
+
+EfgPipelineStateDesc EfgPipelineStateDesc::AfterDepthPrepass() const
+{
+    EfgPipelineStateDesc desc = *this;
+    desc.depthTest = true;
+    desc.depthWrite = false;
+    desc.depthFunc = efgCompare_LESS_EQUAL;
+    return desc;
+}
+
+// -0.0f and 0.0f compare equal, so they must hash equal.
+static float NormalizeZero(float value)
+{
+    return (value == 0.0f) ? 0.0f : value;
+}
+
+uint64_t EfgPipelineStateDesc::Hash() const
+{
+    EfgHash hash;
+    hash.Add(inputLayout);
+    hash.Add(fillMode);
+    hash.Add(cullMode);
+    hash.Add(depthBias);
+    hash.Add(NormalizeZero(slopeScaledDepthBias));
+    hash.Add(depthTest);
+    hash.Add(depthWrite);
+    hash.Add(depthFunc);
+    hash.Add(blendMode);
+    hash.Add(renderTargetCount);
+    for (uint32_t i = 0; i < renderTargetCount && i < MaxRenderTargets; ++i)
+        hash.Add(renderTargetFormats[i]);
+    hash.Add(depthFormat);
+    return hash.Get();
+}
+
+bool EfgPipelineStateDesc::operator==(const EfgPipelineStateDesc& other) const
+{
+    if (inputLayout != other.inputLayout || fillMode != other.fillMode || cullMode != other.cullMode ||
+        depthBias != other.depthBias || slopeScaledDepthBias != other.slopeScaledDepthBias ||
+        depthTest != other.depthTest || depthWrite != other.depthWrite || depthFunc != other.depthFunc ||
+        blendMode != other.blendMode || renderTargetCount != other.renderTargetCount || depthFormat != other.depthFormat)
+        return false;
+    for (uint32_t i = 0; i < renderTargetCount && i < MaxRenderTargets; ++i)
+    {
+        if (renderTargetFormats[i] != other.renderTargetFormats[i])
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+
+// Vertex formats a pipeline can read. The first two read Vertex buffers, the
+// compressed ones EfgCompressedVertex buffers with a float2 octahedral NORMAL.
+enum EFG_INPUT_LAYOUT
+{
+    efgInputLayout_VERTEX,             // POSITION, NORMAL, TEXCOORD
+    efgInputLayout_POSITION,           // POSITION only, for shaders that read nothing else
+    efgInputLayout_COMPRESSED_HALF,    // Half float POSITION
+    efgInputLayout_COMPRESSED_UNORM16  // 16-bit normalized POSITION
+};
+
+enum EFG_FILL_MODE
+{
+    efgFill_SOLID,
+    efgFill_WIREFRAME
+};
+
+enum EFG_CULL_MODE
+{
+    efgCull_NONE,
+    efgCull_FRONT,
+    efgCull_BACK
+};
+
+enum EFG_BLEND_MODE
+{
+    efgBlend_OPAQUE,
+    efgBlend_ALPHA,    // src * a + dst * (1 - a)
+    efgBlend_ADDITIVE  // src + dst
+};
+
+enum EFG_COMPARISON
+{
+    efgCompare_NEVER,
+    efgCompare_LESS,
+    efgCompare_EQUAL,
+    efgCompare_LESS_EQUAL,
+    efgCompare_GREATER,
+    efgCompare_NOT_EQUAL,
+    efgCompare_GREATER_EQUAL,
+    efgCompare_ALWAYS
+};
+
+enum EFG_FORMAT
+{
+    efgFormat_UNKNOWN,
+    efgFormat_R8G8B8A8_UNORM,
+    efgFormat_R8G8B8A8_UNORM_SRGB,
+    efgFormat_R16G16B16A16_FLOAT,
+    efgFormat_R11G11B10_FLOAT,
+    efgFormat_R32_FLOAT,
+    efgFormat_D32_FLOAT,
+    efgFormat_D24_UNORM_S8_UINT
+};
+
+// Fixed function state of a graphics pipeline as a plain value. Free of D3D types,
+// EfgContext translates it when the pipeline is created. Derived states are cheap
+// copies, e.g. EfgPipelineStateDesc().DepthOnly().
+struct EfgPipelineStateDesc
+{
+    static const uint32_t MaxRenderTargets = 8;
+
+    EFG_INPUT_LAYOUT inputLayout = efgInputLayout_VERTEX;
+    EFG_FILL_MODE fillMode = efgFill_SOLID;
+    EFG_CULL_MODE cullMode = efgCull_BACK;
+    int32_t depthBias = 0;
+    float slopeScaledDepthBias = 0.0f;
+    bool depthTest = true;
+    bool depthWrite = true;
+    EFG_COMPARISON depthFunc = efgCompare_LESS;
+    EFG_BLEND_MODE blendMode = efgBlend_OPAQUE;
+    // Formats past renderTargetCount are ignored, also by Hash() and ==.
+    uint32_t renderTargetCount = 1;
+    EFG_FORMAT renderTargetFormats[MaxRenderTargets] = { efgFormat_R8G8B8A8_UNORM };
+    EFG_FORMAT depthFormat = efgFormat_D32_FLOAT;
+
+    // No color targets, for depth prepasses.
+    EfgPipelineStateDesc DepthOnly() const;
+    // Depth only with the bias used by the shadow maps.
+    EfgPipelineStateDesc ShadowMap() const;
+    EfgPipelineStateDesc Wireframe() const;
+    // Depth tested against a prepass, without writing it.
+    EfgPipelineStateDesc AfterDepthPrepass() const;
+
+    // Stable across runs, can key on-disk caches.
+    uint64_t Hash() const;
+    bool operator==(const EfgPipelineStateDesc& other) const;
+    bool operator!=(const EfgPipelineStateDesc& other) const { return !(*this == other); }
+};
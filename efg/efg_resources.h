@@ -83,6 +83,8 @@ struct EfgTextureInternal : EfgResource
     bool useFaceIndex = false;
     uint32_t faceIndex = 0;
     D3D12_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+    // Finest mip the view may sample, raised while mips aren't resident.
+    float minLodClamp = 0.0f;
     CD3DX12_CPU_DESCRIPTOR_HANDLE srvHandle = {};
     CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle = {};
     CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle = {};
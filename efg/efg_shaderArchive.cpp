@@ -0,0 +1,291 @@
+#include "efg_shaderArchive.h"
+#include "efg_exception.h"
+#include "efg_hash.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+
+static const uint32_t ShaderArchiveMagic = 0x41534645; // "EFSA"
+static const uint32_t ShaderArchiveVersion = 1;
+static const uint64_t ByteCodeAlignment = 16;
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Written so a corrupt offset can't wrap around and pass.
+static bool IsRangeInFile(uint64_t offset, uint64_t size, uint64_t fileSize)
+{
+    return offset <= fileSize && size <= fileSize - offset;
+}
+
+uint64_t efgShaderPermutationKey(const std::vector<EfgShaderDefine>& defines)
+{
+    if (defines.empty())
+        return 0;
+    EfgHash hash;
+    for (const EfgShaderDefine& define : defines)
+    {
+        hash.AddString(define.name.c_str());
+        hash.AddString(define.value.c_str());
+    }
+    return hash.Get();
+}
+
+uint64_t efgShaderArchiveKey(const std::string& name, const std::string& entryPoint, const std::string& target, uint64_t permutation)
+{
+    EfgHash hash;
+    hash.AddString(name.c_str());
+    hash.AddString(entryPoint.c_str());
+    hash.AddString(target.c_str());
+    hash.Add(permutation);
+    return hash.Get();
+}
+
+uint32_t EfgShaderArchiveWriter::AddString(const std::string& string)
+{
+    uint32_t offset = static_cast<uint32_t>(m_strings.size());
+    m_strings.append(string);
+    m_strings.push_back('\0');
+    return offset;
+}
+
+void EfgShaderArchiveWriter::Add(const std::string& name, const std::string& entryPoint, const std::string& target, const std::vector<EfgShaderDefine>& defines,
+    const void* byteCode, size_t size, const std::vector<EfgShaderBinding>& bindings, float compileMs)
+{
+    Shader shader = {};
+    shader.entry.permutation = efgShaderPermutationKey(defines);
+    shader.entry.key = efgShaderArchiveKey(name, entryPoint, target, shader.entry.permutation);
+    shader.entry.nameOffset = AddString(name);
+    shader.entry.entryPointOffset = AddString(entryPoint);
+    shader.entry.targetOffset = AddString(target);
+    shader.entry.byteCodeSize = size;
+    shader.entry.compileMs = compileMs;
+    const uint8_t* bytes = static_cast<const uint8_t*>(byteCode);
+    shader.byteCode.assign(bytes, bytes + size);
+    for (const EfgShaderBinding& binding : bindings)
+    {
+        EfgShaderArchiveBinding archived = {};
+        archived.nameOffset = AddString(binding.name);
+        archived.type = binding.type;
+        archived.dimension = binding.dimension;
+        archived.shaderRegister = binding.shaderRegister;
+        archived.registerSpace = binding.registerSpace;
+        archived.count = binding.count;
+        archived.size = binding.size;
+        archived.visibility = binding.visibility;
+        shader.bindings.push_back(archived);
+    }
+
+    // A shader listed twice keeps the last compile.
+    auto existing = std::find_if(m_shaders.begin(), m_shaders.end(), [&](const Shader& other) { return other.entry.key == shader.entry.key; });
+    if (existing != m_shaders.end())
+        *existing = shader;
+    else
+        m_shaders.push_back(shader);
+}
+
+bool EfgShaderArchiveWriter::Write(const std::filesystem::path& path) const
+{
+    std::vector<Shader> shaders = m_shaders;
+    std::sort(shaders.begin(), shaders.end(), [](const Shader& a, const Shader& b) { return a.entry.key < b.entry.key; });
+
+    EfgShaderArchiveHeader header = {};
+    header.magic = ShaderArchiveMagic;
+    header.version = ShaderArchiveVersion;
+    header.entryCount = static_cast<uint32_t>(shaders.size());
+    header.entriesOffset = sizeof(EfgShaderArchiveHeader);
+    header.bindingsOffset = header.entriesOffset + shaders.size() * sizeof(EfgShaderArchiveEntry);
+
+    std::vector<EfgShaderArchiveEntry> entries;
+    std::vector<EfgShaderArchiveBinding> bindings;
+    for (const Shader& shader : shaders)
+    {
+        EfgShaderArchiveEntry entry = shader.entry;
+        entry.firstBinding = static_cast<uint32_t>(bindings.size());
+        entry.bindingCount = static_cast<uint32_t>(shader.bindings.size());
+        bindings.insert(bindings.end(), shader.bindings.begin(), shader.bindings.end());
+        entries.push_back(entry);
+    }
+    header.bindingCount = static_cast<uint32_t>(bindings.size());
+    header.stringsOffset = header.bindingsOffset + bindings.size() * sizeof(EfgShaderArchiveBinding);
+    header.stringsSize = m_strings.size();
+
+    uint64_t offset = header.stringsOffset + header.stringsSize;
+    for (EfgShaderArchiveEntry& entry : entries)
+    {
+        offset = AlignUp(offset, ByteCodeAlignment);
+        entry.byteCodeOffset = offset;
+        offset += entry.byteCodeSize;
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(EfgShaderArchiveEntry));
+    file.write(reinterpret_cast<const char*>(bindings.data()), bindings.size() * sizeof(EfgShaderArchiveBinding));
+    file.write(m_strings.data(), m_strings.size());
+    uint64_t written = header.stringsOffset + header.stringsSize;
+    const char padding[ByteCodeAlignment] = {};
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        file.write(padding, entries[i].byteCodeOffset - written);
+        file.write(reinterpret_cast<const char*>(shaders[i].byteCode.data()), shaders[i].byteCode.size());
+        written = entries[i].byteCodeOffset + entries[i].byteCodeSize;
+    }
+    return static_cast<bool>(file);
+}
+
+bool EfgShaderArchive::Open(const std::filesystem::path& path)
+{
+    Close();
+    auto file = std::make_shared<EfgMappedFile>();
+    if (!file->Open(path) || file->GetSize() < sizeof(EfgShaderArchiveHeader))
+        return false;
+
+    const uint8_t* data = file->GetData();
+    uint64_t size = file->GetSize();
+    const EfgShaderArchiveHeader* header = reinterpret_cast<const EfgShaderArchiveHeader*>(data);
+    // The tables are read in place, misaligned offsets are as corrupt as out of range ones.
+    if (header->magic != ShaderArchiveMagic || header->version != ShaderArchiveVersion ||
+        header->entriesOffset % alignof(EfgShaderArchiveEntry) != 0 || header->bindingsOffset % alignof(EfgShaderArchiveBinding) != 0 ||
+        !IsRangeInFile(header->entriesOffset, uint64_t(header->entryCount) * sizeof(EfgShaderArchiveEntry), size) ||
+        !IsRangeInFile(header->bindingsOffset, uint64_t(header->bindingCount) * sizeof(EfgShaderArchiveBinding), size) ||
+        !IsRangeInFile(header->stringsOffset, header->stringsSize, size) ||
+        (header->stringsSize > 0 && data[header->stringsOffset + header->stringsSize - 1] != '\0'))
+    {
+        EFG_SHOW_ERROR("Invalid shader archive");
+        return false;
+    }
+
+    const EfgShaderArchiveEntry* entries = reinterpret_cast<const EfgShaderArchiveEntry*>(data + header->entriesOffset);
+    for (uint32_t i = 0; i < header->entryCount; ++i)
+    {
+        const EfgShaderArchiveEntry& entry = entries[i];
+        if (!IsRangeInFile(entry.byteCodeOffset, entry.byteCodeSize, size) ||
+            uint64_t(entry.firstBinding) + entry.bindingCount > header->bindingCount)
+        {
+            EFG_SHOW_ERROR("Invalid shader archive");
+            return false;
+        }
+    }
+
+    m_file = file;
+    m_header = header;
+    m_entries = entries;
+    m_bindings = reinterpret_cast<const EfgShaderArchiveBinding*>(data + header->bindingsOffset);
+    m_strings = reinterpret_cast<const char*>(data + header->stringsOffset);
+    return true;
+}
+
+void EfgShaderArchive::Close()
+{
+    if (m_file && m_loadCount > 0)
+    {
+        std::cout << "Shader archive: " << m_loadCount << " shaders mapped in " << m_loadMs << " ms, "
+            << m_savedMs << " ms of compilation saved" << std::endl;
+    }
+    // Blobs handed out keep their own reference to the mapping.
+    m_file.reset();
+    m_header = nullptr;
+    m_entries = nullptr;
+    m_bindings = nullptr;
+    m_strings = nullptr;
+    m_loadCount = 0;
+    m_loadMs = 0.0;
+    m_savedMs = 0.0;
+}
+
+const char* EfgShaderArchive::GetString(uint32_t offset) const
+{
+    return (offset < m_header->stringsSize) ? m_strings + offset : "";
+}
+
+const EfgShaderArchiveEntry* EfgShaderArchive::Find(const std::string& name, const std::string& entryPoint, const std::string& target, uint64_t permutation) const
+{
+    if (!m_file)
+        return nullptr;
+    uint64_t key = efgShaderArchiveKey(name, entryPoint, target, permutation);
+    const EfgShaderArchiveEntry* end = m_entries + m_header->entryCount;
+    const EfgShaderArchiveEntry* entry = std::lower_bound(m_entries, end, key,
+        [](const EfgShaderArchiveEntry& entry, uint64_t key) { return entry.key < key; });
+    if (entry == end || entry->key != key)
+        return nullptr;
+    // Guard against key collisions.
+    if (name != GetString(entry->nameOffset) || entryPoint != GetString(entry->entryPointOffset) || target != GetString(entry->targetOffset))
+        return nullptr;
+    return entry;
+}
+
+// Read-only ID3DBlob over archive memory, so bytecode is never copied.
+class EfgArchiveBlob : public ID3DBlob
+{
+public:
+    EfgArchiveBlob(std::shared_ptr<EfgMappedFile> file, const void* data, size_t size)
+        : m_file(std::move(file)), m_data(data), m_size(size) {}
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object) override
+    {
+        if (object == nullptr)
+            return E_POINTER;
+        if (riid == __uuidof(IUnknown) || riid == __uuidof(ID3D10Blob))
+        {
+            *object = static_cast<ID3DBlob*>(this);
+            AddRef();
+            return S_OK;
+        }
+        *object = nullptr;
+        return E_NOINTERFACE;
+    }
+    ULONG STDMETHODCALLTYPE AddRef() override { return ++m_refCount; }
+    ULONG STDMETHODCALLTYPE Release() override
+    {
+        ULONG refCount = --m_refCount;
+        if (refCount == 0)
+            delete this;
+        return refCount;
+    }
+    LPVOID STDMETHODCALLTYPE GetBufferPointer() override { return const_cast<void*>(m_data); }
+    SIZE_T STDMETHODCALLTYPE GetBufferSize() override { return m_size; }
+
+private:
+    std::shared_ptr<EfgMappedFile> m_file;
+    const void* m_data;
+    size_t m_size;
+    std::atomic<ULONG> m_refCount = 1;
+};
+
+ComPtr<ID3DBlob> EfgShaderArchive::CreateBlob(const EfgShaderArchiveEntry& entry) const
+{
+    ComPtr<ID3DBlob> blob;
+    blob.Attach(new EfgArchiveBlob(m_file, m_file->GetData() + entry.byteCodeOffset, static_cast<size_t>(entry.byteCodeSize)));
+    return blob;
+}
+
+void EfgShaderArchive::GetBindings(const EfgShaderArchiveEntry& entry, std::vector<EfgShaderBinding>& bindings) const
+{
+    bindings.clear();
+    for (uint32_t i = 0; i < entry.bindingCount; ++i)
+    {
+        const EfgShaderArchiveBinding& archived = m_bindings[entry.firstBinding + i];
+        EfgShaderBinding binding = {};
+        binding.name = GetString(archived.nameOffset);
+        binding.type = static_cast<D3D_SHADER_INPUT_TYPE>(archived.type);
+        binding.dimension = static_cast<D3D_SRV_DIMENSION>(archived.dimension);
+        binding.shaderRegister = archived.shaderRegister;
+        binding.registerSpace = archived.registerSpace;
+        binding.count = archived.count;
+        binding.size = archived.size;
+        binding.visibility = static_cast<D3D12_SHADER_VISIBILITY>(archived.visibility);
+        bindings.push_back(binding);
+    }
+}
+
+void EfgShaderArchive::RecordLoad(const EfgShaderArchiveEntry& entry, double loadMs)
+{
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_loadCount++;
+    m_loadMs += loadMs;
+    m_savedMs += entry.compileMs;
+}
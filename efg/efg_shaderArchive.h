@@ -0,0 +1,109 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "efg_mappedFile.h"
+#include "efg_shaderCache.h"
+#include "efg_shaderReflection.h"
+
+using Microsoft::WRL::ComPtr;
+
+// Packed shader archive written by efgShaderCompiler. Everything is addressed by
+// offset from the start of the file, so the runtime uses it straight from the mapping.
+//
+// Header | Entry[entryCount] sorted by key | Binding[bindingCount] | strings | bytecode
+
+struct EfgShaderArchiveHeader
+{
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint32_t entryCount = 0;
+    uint32_t bindingCount = 0;
+    uint64_t entriesOffset = 0;
+    uint64_t bindingsOffset = 0;
+    uint64_t stringsOffset = 0;
+    uint64_t stringsSize = 0;
+};
+
+struct EfgShaderArchiveEntry
+{
+    uint64_t key = 0;         // efgShaderArchiveKey()
+    uint64_t permutation = 0; // efgShaderPermutationKey() of the defines
+    uint64_t byteCodeOffset = 0;
+    uint64_t byteCodeSize = 0;
+    uint32_t nameOffset = 0;  // Null terminated, into the string table
+    uint32_t entryPointOffset = 0;
+    uint32_t targetOffset = 0;
+    uint32_t firstBinding = 0;
+    uint32_t bindingCount = 0;
+    float compileMs = 0.0f;   // Offline compile time, what loading from the archive saves
+};
+
+struct EfgShaderArchiveBinding
+{
+    uint32_t nameOffset = 0;
+    uint32_t type = 0;
+    uint32_t dimension = 0;
+    uint32_t shaderRegister = 0;
+    uint32_t registerSpace = 0;
+    uint32_t count = 0;
+    uint32_t size = 0;
+    uint32_t visibility = 0;
+};
+
+uint64_t efgShaderPermutationKey(const std::vector<EfgShaderDefine>& defines);
+uint64_t efgShaderArchiveKey(const std::string& name, const std::string& entryPoint, const std::string& target, uint64_t permutation);
+
+class EfgShaderArchiveWriter
+{
+public:
+    // name is the path the runtime passes to CreateShader, e.g. "vertex.hlsl".
+    void Add(const std::string& name, const std::string& entryPoint, const std::string& target, const std::vector<EfgShaderDefine>& defines,
+        const void* byteCode, size_t size, const std::vector<EfgShaderBinding>& bindings, float compileMs);
+    bool Write(const std::filesystem::path& path) const;
+
+private:
+    struct Shader
+    {
+        EfgShaderArchiveEntry entry;
+        std::vector<uint8_t> byteCode;
+        std::vector<EfgShaderArchiveBinding> bindings;
+    };
+    uint32_t AddString(const std::string& string);
+
+    std::vector<Shader> m_shaders;
+    std::string m_strings;
+};
+
+class EfgShaderArchive
+{
+public:
+    // Fails quietly when the file is missing or not a valid archive.
+    bool Open(const std::filesystem::path& path);
+    void Close();
+    bool IsOpen() const { return m_file != nullptr; }
+
+    // Returns nullptr when the archive has no such shader. Thread safe.
+    const EfgShaderArchiveEntry* Find(const std::string& name, const std::string& entryPoint, const std::string& target, uint64_t permutation) const;
+    // The blob points into the mapping and keeps it alive.
+    ComPtr<ID3DBlob> CreateBlob(const EfgShaderArchiveEntry& entry) const;
+    void GetBindings(const EfgShaderArchiveEntry& entry, std::vector<EfgShaderBinding>& bindings) const;
+    void RecordLoad(const EfgShaderArchiveEntry& entry, double loadMs);
+
+private:
+    const char* GetString(uint32_t offset) const;
+
+    std::shared_ptr<EfgMappedFile> m_file;
+    const EfgShaderArchiveHeader* m_header = nullptr;
+    const EfgShaderArchiveEntry* m_entries = nullptr;
+    const EfgShaderArchiveBinding* m_bindings = nullptr;
+    const char* m_strings = nullptr;
+    std::mutex m_statsMutex;
+    uint32_t m_loadCount = 0;
+    double m_loadMs = 0.0;
+    double m_savedMs = 0.0;
+};
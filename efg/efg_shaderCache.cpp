@@ -0,0 +1,221 @@
+#include "efg_shaderCache.h"
+#include "efg_hash.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+static const uint32_t ShaderCacheMagic = 0x43534645; // "EFSC"
+// Bump when the key or entry layout changes.
+static const uint32_t ShaderCacheVersion = 1;
+
+struct EfgShaderCacheEntryHeader
+{
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint64_t key = 0;
+    uint64_t size = 0;
+    uint64_t dataHash = 0;
+};
+
+// Returns the path of an #include "file" or #include <file> directive, empty otherwise.
+static std::string ParseInclude(const std::string& line)
+{
+    size_t pos = line.find_first_not_of(" \t");
+    if (pos == std::string::npos || line[pos] != '#')
+        return {};
+    pos = line.find_first_not_of(" \t", pos + 1);
+    if (pos == std::string::npos || line.compare(pos, 7, "include") != 0)
+        return {};
+    pos = line.find_first_of("\"<", pos + 7);
+    if (pos == std::string::npos)
+        return {};
+    size_t end = line.find((line[pos] == '"') ? '"' : '>', pos + 1);
+    if (end == std::string::npos)
+        return {};
+    return line.substr(pos + 1, end - pos - 1);
+}
+
+// Mirrors the include handler of EfgContext::CompileShader: relative to the including file,
+// then to the root shader.
+static void HashSourceFile(const EfgVfs& vfs, const fs::path& path, const fs::path& rootDirectory, EfgHash& hash, std::vector<fs::path>& visited)
+{
+    std::error_code error;
+    fs::path canonical = fs::weakly_canonical(path, error);
+    if (error)
+        canonical = path;
+    for (const fs::path& file : visited)
+    {
+        if (file == canonical)
+            return;
+    }
+    visited.push_back(canonical);
+
+    EfgVfsFile file;
+    if (!vfs.Open(path, file))
+    {
+        // Missing files still change the key, compilation will report the error.
+        hash.AddString(path.generic_string().c_str());
+        return;
+    }
+    hash.Add(static_cast<uint64_t>(file.GetSize()));
+    hash.AddBytes(file.GetData(), file.GetSize());
+
+    std::istringstream lines(std::string(reinterpret_cast<const char*>(file.GetData()), file.GetSize()));
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        std::string include = ParseInclude(line);
+        if (include.empty())
+            continue;
+        hash.AddString(include.c_str());
+        fs::path includePath = path.parent_path() / include;
+        if (!vfs.Exists(includePath))
+            includePath = rootDirectory / include;
+        HashSourceFile(vfs, includePath, rootDirectory, hash, visited);
+    }
+}
+
+void EfgShaderCache::Initialize(const fs::path& directory, const EfgVfs& vfs)
+{
+    m_vfs = &vfs;
+    m_directory = directory;
+    if (m_directory.empty())
+        return;
+    std::error_code error;
+    fs::create_directories(m_directory, error);
+    if (error)
+        m_directory.clear();
+}
+
+void EfgShaderCache::Destroy()
+{
+    EfgShaderCacheStats stats = GetStats();
+    std::cout << "Shader cache: " << stats.memoryHits << " memory hits, " << stats.diskHits << " disk hits, "
+        << stats.misses << " compiled" << std::endl;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+}
+
+uint64_t EfgShaderCache::ComputeKey(const fs::path& source, const std::vector<EfgShaderDefine>& defines,
+    const std::string& entryPoint, const std::string& target, uint32_t compileFlags, uint32_t compilerVersion) const
+{
+    EfgHash hash;
+    hash.Add(ShaderCacheVersion);
+    hash.Add(compilerVersion);
+    hash.Add(compileFlags);
+    hash.AddString(entryPoint.c_str());
+    hash.AddString(target.c_str());
+    hash.Add(static_cast<uint64_t>(defines.size()));
+    for (const EfgShaderDefine& define : defines)
+    {
+        hash.AddString(define.name.c_str());
+        hash.AddString(define.value.c_str());
+    }
+
+    std::vector<fs::path> visited;
+    HashSourceFile(*m_vfs, source, source.parent_path(), hash, visited);
+    return hash.Get();
+}
+
+std::vector<fs::path> EfgShaderCache::GetSourceFiles(const fs::path& source) const
+{
+    EfgHash hash;
+    std::vector<fs::path> visited;
+    HashSourceFile(*m_vfs, source, source.parent_path(), hash, visited);
+    return visited;
+}
+
+fs::path EfgShaderCache::GetEntryPath(uint64_t key) const
+{
+    char name[32] = {};
+    snprintf(name, sizeof(name), "%016llx.cso", static_cast<unsigned long long>(key));
+    return m_directory / name;
+}
+
+bool EfgShaderCache::Find(uint64_t key, std::vector<uint8_t>& byteCode)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto entry = m_entries.find(key);
+        if (entry != m_entries.end())
+        {
+            byteCode = entry->second;
+            m_stats.memoryHits++;
+            return true;
+        }
+    }
+
+    if (!m_directory.empty())
+    {
+        fs::path path = GetEntryPath(key);
+        std::ifstream file(path, std::ios::binary);
+        EfgShaderCacheEntryHeader header = {};
+        std::error_code error;
+        uint64_t fileSize = fs::file_size(path, error);
+        // The size is checked against the file before allocating, a corrupt header is a miss.
+        if (file.read(reinterpret_cast<char*>(&header), sizeof(header)) && !error &&
+            header.magic == ShaderCacheMagic && header.version == ShaderCacheVersion && header.key == key &&
+            header.size == fileSize - sizeof(header))
+        {
+            byteCode.resize(static_cast<size_t>(header.size));
+            if (file.read(reinterpret_cast<char*>(byteCode.data()), byteCode.size()) &&
+                efgHash(byteCode.data(), byteCode.size()) == header.dataHash)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_entries[key] = byteCode;
+                m_stats.diskHits++;
+                return true;
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.misses++;
+    return false;
+}
+
+void EfgShaderCache::Store(uint64_t key, const void* byteCode, size_t size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(byteCode);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries[key].assign(bytes, bytes + size);
+    }
+    if (m_directory.empty())
+        return;
+
+    EfgShaderCacheEntryHeader header = {};
+    header.magic = ShaderCacheMagic;
+    header.version = ShaderCacheVersion;
+    header.key = key;
+    header.size = size;
+    header.dataHash = efgHash(byteCode, size);
+
+    // Written aside and renamed, so a concurrent reader never sees half an entry.
+    fs::path path = GetEntryPath(key);
+    std::ostringstream suffix;
+    suffix << ".tmp" << std::this_thread::get_id();
+    fs::path temporaryPath = path;
+    temporaryPath += suffix.str();
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file.write(reinterpret_cast<const char*>(&header), sizeof(header)) ||
+            !file.write(reinterpret_cast<const char*>(bytes), size))
+            return;
+    }
+    std::error_code error;
+    fs::rename(temporaryPath, path, error);
+    if (error)
+        fs::remove(temporaryPath, error);
+}
+
+EfgShaderCacheStats EfgShaderCache::GetStats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
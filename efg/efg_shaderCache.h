@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "efg_vfs.h"
+
+struct EfgShaderDefine
+{
+    std::string name;
+    std::string value;
+};
+
+struct EfgShaderCacheStats
+{
+    uint32_t memoryHits = 0;
+    uint32_t diskHits = 0;
+    uint32_t misses = 0;
+};
+
+// Content addressed shader bytecode cache, in memory for the process and on
+// disk across runs. Free of D3D types so offline tools can share the keys.
+class EfgShaderCache
+{
+public:
+    // An empty directory keeps the cache in memory only. Sources are read through vfs,
+    // which must outlive the cache.
+    void Initialize(const std::filesystem::path& directory, const EfgVfs& vfs);
+    void Destroy();
+
+    // Hashes the source, every file it includes (transitively), the defines and
+    // all compile options. Thread safe.
+    uint64_t ComputeKey(const std::filesystem::path& source, const std::vector<EfgShaderDefine>& defines,
+        const std::string& entryPoint, const std::string& target, uint32_t compileFlags, uint32_t compilerVersion) const;
+    // The source and every file it includes, as absolute paths. Thread safe.
+    std::vector<std::filesystem::path> GetSourceFiles(const std::filesystem::path& source) const;
+    bool Find(uint64_t key, std::vector<uint8_t>& byteCode);
+    void Store(uint64_t key, const void* byteCode, size_t size);
+    EfgShaderCacheStats GetStats();
+
+private:
+    std::filesystem::path GetEntryPath(uint64_t key) const;
+
+    const EfgVfs* m_vfs = nullptr;
+    std::filesystem::path m_directory;
+    std::unordered_map<uint64_t, std::vector<uint8_t>> m_entries;
+    std::mutex m_mutex;
+    EfgShaderCacheStats m_stats = {};
+};
@@ -0,0 +1,49 @@
+#include "efg_shaderReflection.h"
+#include "efg_exception.h"
+#include <wrl.h>
+
+using Microsoft::WRL::ComPtr;
+
+void efgReflectShader(ID3DBlob* byteCode, std::vector<EfgShaderBinding>& bindings)
+{
+    ComPtr<ID3D12ShaderReflection> reflection;
+    EFG_D3D_TRY(D3DReflect(byteCode->GetBufferPointer(), byteCode->GetBufferSize(), IID_ID3D12ShaderReflection, reinterpret_cast<void**>(reflection.GetAddressOf())));
+
+    D3D12_SHADER_DESC shaderDesc = {};
+    EFG_D3D_TRY(reflection->GetDesc(&shaderDesc));
+
+    D3D12_SHADER_VISIBILITY visibility = D3D12_SHADER_VISIBILITY_ALL;
+    switch (D3D12_SHVER_GET_TYPE(shaderDesc.Version))
+    {
+    case D3D12_SHVER_VERTEX_SHADER:
+        visibility = D3D12_SHADER_VISIBILITY_VERTEX;
+        break;
+    case D3D12_SHVER_PIXEL_SHADER:
+        visibility = D3D12_SHADER_VISIBILITY_PIXEL;
+        break;
+    }
+
+    // Only resources the compiled code references are reported.
+    bindings.clear();
+    for (UINT i = 0; i < shaderDesc.BoundResources; ++i)
+    {
+        D3D12_SHADER_INPUT_BIND_DESC bindDesc = {};
+        EFG_D3D_TRY(reflection->GetResourceBindingDesc(i, &bindDesc));
+
+        EfgShaderBinding binding = {};
+        binding.name = bindDesc.Name;
+        binding.type = bindDesc.Type;
+        binding.dimension = bindDesc.Dimension;
+        binding.shaderRegister = bindDesc.BindPoint;
+        binding.registerSpace = bindDesc.Space;
+        binding.count = bindDesc.BindCount;
+        binding.visibility = visibility;
+        if (bindDesc.Type == D3D_SIT_CBUFFER)
+        {
+            D3D12_SHADER_BUFFER_DESC bufferDesc = {};
+            EFG_D3D_TRY(reflection->GetConstantBufferByName(bindDesc.Name)->GetDesc(&bufferDesc));
+            binding.size = bufferDesc.Size;
+        }
+        bindings.push_back(binding);
+    }
+}
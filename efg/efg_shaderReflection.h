@@ -0,0 +1,29 @@
+#pragma once
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <Windows.h>
+#include <cstdint>
+#include <d3d12.h>
+#include <D3Dcompiler.h>
+#include <d3d12shader.h>
+#include <string>
+#include <vector>
+#include <wrl.h>
+
+// A resource binding reported by shader reflection.
+struct EfgShaderBinding
+{
+    std::string name;
+    D3D_SHADER_INPUT_TYPE type = D3D_SIT_CBUFFER;
+    D3D_SRV_DIMENSION dimension = D3D_SRV_DIMENSION_UNKNOWN;
+    uint32_t shaderRegister = 0;
+    uint32_t registerSpace = 0;
+    uint32_t count = 1;
+    uint32_t size = 0; // Constant buffers only
+    D3D12_SHADER_VISIBILITY visibility = D3D12_SHADER_VISIBILITY_ALL;
+};
+
+// Fills bindings from the bytecode's reflection data.
+void efgReflectShader(ID3DBlob* byteCode, std::vector<EfgShaderBinding>& bindings);
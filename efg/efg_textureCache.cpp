@@ -0,0 +1,121 @@
+#include "efg_textureCache.h"
+#include "efg_hash.h"
+#include <cctype>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+static std::string NormalizePath(const std::wstring& file)
+{
+    std::error_code error;
+    fs::path canonical = fs::weakly_canonical(file, error);
+    if (error)
+        canonical = fs::path(file).lexically_normal();
+    std::string path = canonical.generic_u8string();
+#ifdef _WIN32
+    // Windows paths are case insensitive.
+    for (char& c : path)
+        c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+#endif
+    return path;
+}
+
+static uint64_t HashContents(const std::vector<std::wstring>& files, const EfgVfs& vfs)
+{
+    EfgHash hash;
+    for (const std::wstring& file : files)
+    {
+        EfgVfsFile contents;
+        if (!vfs.Open(file, contents))
+            return 0;
+        hash.Add(static_cast<uint64_t>(contents.GetSize()));
+        hash.AddBytes(contents.GetData(), contents.GetSize());
+    }
+    return hash.Get();
+}
+
+EfgCachedTexture* EfgTextureCache::Acquire(const std::vector<std::wstring>& files, bool cube, const EfgVfs& vfs, Key& key)
+{
+    m_stats.lookups++;
+    // A DDS loaded as a cube and as a 2D texture are different textures.
+    key.path = cube ? "cube:" : "2d:";
+    for (size_t f = 0; f < files.size(); ++f)
+        key.path += ((f > 0) ? "|" : "") + NormalizePath(files[f]);
+    key.contentHash = 0;
+
+    auto path = m_paths.find(key.path);
+    if (path != m_paths.end())
+    {
+        m_stats.pathHits++;
+        return AddReference(path->second);
+    }
+    if (!m_contentHashing)
+        return nullptr;
+
+    uint64_t contents = HashContents(files, vfs);
+    if (contents == 0)
+        return nullptr;
+    EfgHash contentKey;
+    contentKey.Add(contents);
+    contentKey.Add(cube);
+    key.contentHash = contentKey.Get();
+    auto content = m_contents.find(key.contentHash);
+    if (content == m_contents.end())
+        return nullptr;
+    // Remember this path too, so the next lookup through it skips hashing.
+    m_paths[key.path] = content->second;
+    m_stats.contentHits++;
+    return AddReference(content->second);
+}
+
+EfgCachedTexture* EfgTextureCache::AddReference(uint64_t handle)
+{
+    Entry& entry = m_entries[handle];
+    entry.references++;
+    return &entry.texture;
+}
+
+EfgCachedTexture& EfgTextureCache::Insert(const Key& key, const EfgCachedTexture& texture)
+{
+    uint64_t handle = texture.texture.handle;
+    Entry& entry = m_entries[handle];
+    entry.texture = texture;
+    entry.key = key;
+    entry.references = 1;
+    m_paths[key.path] = handle;
+    if (key.contentHash != 0)
+        m_contents[key.contentHash] = handle;
+    m_stats.textureCount = m_entries.size();
+    return entry.texture;
+}
+
+EfgCachedTexture& EfgTextureCache::AddRepeat(const Key& key, uint64_t handle)
+{
+    if (m_paths.emplace(key.path, handle).second)
+        m_stats.contentHits++;
+    else
+        m_stats.pathHits++;
+    return *AddReference(handle);
+}
+
+bool EfgTextureCache::Release(uint64_t handle, EfgCachedTexture& released)
+{
+    auto entry = m_entries.find(handle);
+    if (entry == m_entries.end() || --entry->second.references > 0)
+        return false;
+
+    // Paths that reached the entry through its contents point at it as well.
+    for (auto path = m_paths.begin(); path != m_paths.end();)
+    {
+        if (path->second == handle)
+            path = m_paths.erase(path);
+        else
+            ++path;
+    }
+    if (entry->second.key.contentHash != 0)
+        m_contents.erase(entry->second.key.contentHash);
+    released = entry->second.texture;
+    m_entries.erase(entry);
+    m_stats.textureCount = m_entries.size();
+    return true;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "efg_resources.h"
+#include "efg_vfs.h"
+#include <cstdint>
+#include <future>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A texture owned by EfgTextureCache. Streamed textures keep their load, so every
+// reference waits on the same one.
+struct EfgCachedTexture
+{
+    EfgTexture texture;
+    bool cube = false;
+    std::shared_future<void> loaded;
+    uint64_t request = 0;
+    float priority = 0.0f;
+};
+
+// Shares textures loaded from the same file. Paths are normalized before the lookup, so
+// "a/../b.png" and "B.png" meet. With content hashing on, different files holding the
+// same bytes share one texture too, at the cost of reading each file to hash it.
+class EfgTextureCache
+{
+public:
+    struct Key
+    {
+        std::string path;
+        // 0 without content hashing or when a file could not be read.
+        uint64_t contentHash = 0;
+    };
+    struct Stats
+    {
+        uint64_t lookups = 0;
+        uint64_t pathHits = 0;
+        uint64_t contentHits = 0;
+        size_t textureCount = 0;
+    };
+
+    void SetContentHashing(bool enabled) { m_contentHashing = enabled; }
+    // The files of one texture, a cube has six or a single DDS. Adds a reference and returns
+    // the cached texture, or fills key for Insert and returns nullptr. Content hashing reads
+    // the files through vfs.
+    EfgCachedTexture* Acquire(const std::vector<std::wstring>& files, bool cube, const EfgVfs& vfs, Key& key);
+    EfgCachedTexture& Insert(const Key& key, const EfgCachedTexture& texture);
+    // Another reference to a texture Insert just added, for a repeat of its miss within one
+    // batch. A repeated path counts as a path hit, a different path with the same contents is
+    // registered too and counts as a content hit.
+    EfgCachedTexture& AddRepeat(const Key& key, uint64_t handle);
+    // Returns true and hands back the entry when that was its last reference.
+    bool Release(uint64_t handle, EfgCachedTexture& released);
+    const Stats& GetStats() const { return m_stats; }
+
+private:
+    struct Entry
+    {
+        EfgCachedTexture texture;
+        Key key;
+        uint32_t references = 0;
+    };
+
+    EfgCachedTexture* AddReference(uint64_t handle);
+
+    std::unordered_map<uint64_t, Entry> m_entries;
+    std::unordered_map<std::string, uint64_t> m_paths;
+    std::unordered_map<uint64_t, uint64_t> m_contents;
+    bool m_contentHashing = false;
+    Stats m_stats;
+};
@@ -0,0 +1,42 @@
+#include "efg_threadPool.h"
+
+void EfgThreadPool::Initialize(uint32_t threadCount, std::function<void()> threadStart, std::function<void()> threadExit)
+{
+    m_stopping = false;
+    for (uint32_t i = 0; i < threadCount; ++i)
+        m_threads.emplace_back(&EfgThreadPool::WorkerLoop, this, threadStart, threadExit);
+}
+
+void EfgThreadPool::Destroy()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+    for (std::thread& thread : m_threads)
+        thread.join();
+    m_threads.clear();
+}
+
+void EfgThreadPool::WorkerLoop(std::function<void()> threadStart, std::function<void()> threadExit)
+{
+    if (threadStart)
+        threadStart();
+    for (;;)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+            if (m_tasks.empty())
+                break;
+            task = std::move(m_tasks.front());
+            m_tasks.pop();
+        }
+        // Exceptions end up in the task's future.
+        task();
+    }
+    if (threadExit)
+        threadExit();
+}
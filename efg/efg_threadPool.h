@@ -0,0 +1,51 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed set of workers pulling from one FIFO queue. Tasks start in submission
+// order, so a task may block on the future of any task queued before it.
+class EfgThreadPool
+{
+public:
+    // threadStart and threadExit run on every worker, e.g. to set up COM for WIC.
+    void Initialize(uint32_t threadCount, std::function<void()> threadStart = {}, std::function<void()> threadExit = {});
+    // Finishes the queued tasks, then joins the workers.
+    void Destroy();
+    uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_threads.size()); }
+
+    // Runs inline when the pool has no workers.
+    template<typename FUNCTION>
+    auto Submit(FUNCTION&& function) -> std::future<decltype(function())>
+    {
+        using RESULT = decltype(function());
+        auto task = std::make_shared<std::packaged_task<RESULT()>>(std::forward<FUNCTION>(function));
+        std::future<RESULT> future = task->get_future();
+        if (m_threads.empty())
+        {
+            (*task)();
+            return future;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tasks.push([task]() { (*task)(); });
+        }
+        m_condition.notify_one();
+        return future;
+    }
+
+private:
+    void WorkerLoop(std::function<void()> threadStart, std::function<void()> threadExit);
+
+    std::vector<std::thread> m_threads;
+    std::queue<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stopping = false;
+};
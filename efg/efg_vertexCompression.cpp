@@ -0,0 +1,213 @@
+#include "efg_vertexCompression.h"
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+
+EFG_INPUT_LAYOUT efgGetInputLayout(EFG_VERTEX_FORMAT format)
+{
+    switch (format)
+    {
+    case efgVertexFormat_HALF:
+        return efgInputLayout_COMPRESSED_HALF;
+    case efgVertexFormat_UNORM16:
+        return efgInputLayout_COMPRESSED_UNORM16;
+    default:
+        return efgInputLayout_VERTEX;
+    }
+}
+
+uint32_t efgGetVertexStride(EFG_VERTEX_FORMAT format)
+{
+    return (format == efgVertexFormat_FLOAT) ? sizeof(Vertex) : sizeof(EfgCompressedVertex);
+}
+
+EfgVertexQuantization efgComputeVertexQuantization(const Vertex* vertices, size_t count, EFG_VERTEX_FORMAT format)
+{
+    EfgVertexQuantization quantization;
+    if (count == 0 || format == efgVertexFormat_FLOAT)
+        return quantization;
+
+    float boundsMin[3] = { vertices[0].position.x, vertices[0].position.y, vertices[0].position.z };
+    float boundsMax[3] = { boundsMin[0], boundsMin[1], boundsMin[2] };
+    for (size_t i = 1; i < count; ++i)
+    {
+        const float position[3] = { vertices[i].position.x, vertices[i].position.y, vertices[i].position.z };
+        for (int c = 0; c < 3; ++c)
+        {
+            boundsMin[c] = (position[c] < boundsMin[c]) ? position[c] : boundsMin[c];
+            boundsMax[c] = (position[c] > boundsMax[c]) ? position[c] : boundsMax[c];
+        }
+    }
+
+    for (int c = 0; c < 3; ++c)
+    {
+        if (format == efgVertexFormat_HALF)
+        {
+            // Half floats are most precise around zero.
+            quantization.positionOffset[c] = (boundsMin[c] + boundsMax[c]) * 0.5f;
+        }
+        else
+        {
+            float extent = boundsMax[c] - boundsMin[c];
+            quantization.positionOffset[c] = boundsMin[c];
+            quantization.positionScale[c] = (extent == 0.0f) ? 1.0f : extent;
+        }
+    }
+    return quantization;
+}
+
+// Rounds to nearest even like the F16C instructions, out of range values become infinity.
+static uint16_t FloatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    uint32_t magnitude = bits & 0x7FFFFFFF;
+    if (magnitude > 0x7F800000)
+        return sign | 0x7E00;
+    if (magnitude >= 0x477FF000)
+        return sign | 0x7C00;
+    if (magnitude >= 0x38800000)
+    {
+        // Rebias the exponent from 127 to 15, a rounding carry moves into the exponent.
+        uint32_t rounded = magnitude - 0x38000000 + 0xFFF + ((magnitude >> 13) & 1);
+        return sign | static_cast<uint16_t>(rounded >> 13);
+    }
+
+    // Subnormal, a multiple of 2^-24.
+    uint32_t exponent = magnitude >> 23;
+    if (exponent < 102)
+        return sign;
+    uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+    uint32_t shift = 126 - exponent;
+    uint32_t result = mantissa >> shift;
+    uint32_t remainder = mantissa & ((1u << shift) - 1);
+    uint32_t halfway = 1u << (shift - 1);
+    if (remainder > halfway || (remainder == halfway && (result & 1)))
+        result++;
+    return sign | static_cast<uint16_t>(result);
+}
+
+static float HalfToFloat(uint16_t half)
+{
+    uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1F;
+    uint32_t mantissa = half & 0x3FF;
+    if (exponent == 0)
+    {
+        float value = std::ldexp(static_cast<float>(mantissa), -24);
+        return sign ? -value : value;
+    }
+    uint32_t bits = sign | ((exponent == 31) ? 0x7F800000 : (exponent + 112) << 23) | (mantissa << 13);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Saturating like the R16_UNORM and R16_SNORM conversions, NaN becomes zero.
+static uint16_t FloatToUnorm16(float value)
+{
+    value = (value > 0.0f) ? ((value < 1.0f) ? value : 1.0f) : 0.0f;
+    return static_cast<uint16_t>(value * 65535.0f + 0.5f);
+}
+
+static int16_t FloatToSnorm16(float value)
+{
+    value = (value > -1.0f) ? ((value < 1.0f) ? value : 1.0f) : ((value == value) ? -1.0f : 0.0f);
+    return static_cast<int16_t>(std::floor(value * 32767.0f + 0.5f));
+}
+
+static float Snorm16ToFloat(int16_t value)
+{
+    float result = value / 32767.0f;
+    return (result < -1.0f) ? -1.0f : result;
+}
+
+static float SignNotZero(float value)
+{
+    return (value >= 0.0f) ? 1.0f : -1.0f;
+}
+
+// Projects the normal onto the octahedron |x| + |y| + |z| = 1 and folds the lower half
+// over the diagonals, so two components cover the sphere evenly.
+static void EncodeOctahedral(const XMFLOAT3& normal, float encoded[2])
+{
+    float sum = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+    if (sum == 0.0f)
+    {
+        encoded[0] = encoded[1] = 0.0f;
+        return;
+    }
+    float x = normal.x / sum;
+    float y = normal.y / sum;
+    if (normal.z < 0.0f)
+    {
+        float foldedX = (1.0f - std::fabs(y)) * SignNotZero(x);
+        float foldedY = (1.0f - std::fabs(x)) * SignNotZero(y);
+        x = foldedX;
+        y = foldedY;
+    }
+    encoded[0] = x;
+    encoded[1] = y;
+}
+
+// Same as DecodeOctahedral in the vertex shaders.
+static XMFLOAT3 DecodeOctahedral(float x, float y)
+{
+    float z = 1.0f - std::fabs(x) - std::fabs(y);
+    float t = (z < 0.0f) ? -z : 0.0f;
+    x += (x >= 0.0f) ? -t : t;
+    y += (y >= 0.0f) ? -t : t;
+    float length = std::sqrt(x * x + y * y + z * z);
+    float inverseLength = (length > 0.0f) ? 1.0f / length : 0.0f;
+    return XMFLOAT3(x * inverseLength, y * inverseLength, z * inverseLength);
+}
+
+// Plain scalar code, compression runs once per import and cached meshes are uploaded as stored.
+void efgCompressVertices(EfgCompressedVertex* destination, const Vertex* vertices, size_t count, EFG_VERTEX_FORMAT format,
+    const EfgVertexQuantization& quantization)
+{
+    float inverseScale[3];
+    for (int c = 0; c < 3; ++c)
+        inverseScale[c] = 1.0f / quantization.positionScale[c];
+    for (size_t i = 0; i < count; ++i)
+    {
+        const Vertex& vertex = vertices[i];
+        EfgCompressedVertex& compressed = destination[i];
+        const float position[3] = { vertex.position.x, vertex.position.y, vertex.position.z };
+        for (int c = 0; c < 3; ++c)
+        {
+            float value = (position[c] - quantization.positionOffset[c]) * inverseScale[c];
+            compressed.position[c] = (format == efgVertexFormat_UNORM16) ? FloatToUnorm16(value) : FloatToHalf(value);
+        }
+        compressed.position[3] = 0;
+
+        float normal[2];
+        EncodeOctahedral(vertex.normal, normal);
+        compressed.normal[0] = FloatToSnorm16(normal[0]);
+        compressed.normal[1] = FloatToSnorm16(normal[1]);
+
+        compressed.uv[0] = FloatToHalf(vertex.uv.x);
+        compressed.uv[1] = FloatToHalf(vertex.uv.y);
+    }
+}
+
+void efgDecompressVertices(Vertex* destination, const EfgCompressedVertex* vertices, size_t count, EFG_VERTEX_FORMAT format,
+    const EfgVertexQuantization& quantization)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const EfgCompressedVertex& compressed = vertices[i];
+        Vertex& vertex = destination[i];
+        float position[3];
+        for (int c = 0; c < 3; ++c)
+        {
+            float value = (format == efgVertexFormat_UNORM16) ? compressed.position[c] / 65535.0f : HalfToFloat(compressed.position[c]);
+            position[c] = value * quantization.positionScale[c] + quantization.positionOffset[c];
+        }
+        vertex.position = XMFLOAT3(position[0], position[1], position[2]);
+        vertex.normal = DecodeOctahedral(Snorm16ToFloat(compressed.normal[0]), Snorm16ToFloat(compressed.normal[1]));
+        vertex.uv = XMFLOAT2(HalfToFloat(compressed.uv[0]), HalfToFloat(compressed.uv[1]));
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "efg_pipelineState.h"
+#include "Shapes.h"
+
+// Vertex formats an imported mesh can be stored in. The compressed formats are half the
+// size of Vertex: 16-bit positions, octahedral normals and half float uvs.
+enum EFG_VERTEX_FORMAT
+{
+    efgVertexFormat_FLOAT,   // Vertex
+    efgVertexFormat_HALF,    // EfgCompressedVertex, half float positions around the mesh center
+    efgVertexFormat_UNORM16  // EfgCompressedVertex, positions normalized to the mesh bounds
+};
+
+struct EfgCompressedVertex
+{
+    uint16_t position[4]; // R16G16B16A16_UNORM or _FLOAT, w unused
+    int16_t normal[2];    // Octahedral, R16G16_SNORM
+    uint16_t uv[2];       // R16G16_FLOAT
+};
+
+// Per mesh dequantization, position = encoded * positionScale + positionOffset.
+// Laid out as the VertexQuantization cbuffer of the vertex shaders.
+struct EfgVertexQuantization
+{
+    float positionScale[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+    float positionOffset[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+};
+
+EFG_INPUT_LAYOUT efgGetInputLayout(EFG_VERTEX_FORMAT format);
+uint32_t efgGetVertexStride(EFG_VERTEX_FORMAT format);
+
+EfgVertexQuantization efgComputeVertexQuantization(const Vertex* vertices, size_t count, EFG_VERTEX_FORMAT format);
+void efgCompressVertices(EfgCompressedVertex* destination, const Vertex* vertices, size_t count, EFG_VERTEX_FORMAT format,
+    const EfgVertexQuantization& quantization);
+// What the vertex shader reconstructs, for checking the precision of a format.
+void efgDecompressVertices(Vertex* destination, const EfgCompressedVertex* vertices, size_t count, EFG_VERTEX_FORMAT format,
+    const EfgVertexQuantization& quantization);
@@ -0,0 +1,82 @@
+#include "efg_vertexWelder.h"
+#include <cstring>
+
+static const uint32_t EmptySlot = UINT32_MAX;
+
+// Raw float bits, with -0.0f folded into 0.0f so they weld like they compare.
+static void GetVertexBits(const Vertex& vertex, uint32_t bits[8])
+{
+    const float values[8] = { vertex.position.x, vertex.position.y, vertex.position.z,
+        vertex.normal.x, vertex.normal.y, vertex.normal.z, vertex.uv.x, vertex.uv.y };
+    for (int i = 0; i < 8; ++i)
+    {
+        float value = (values[i] == 0.0f) ? 0.0f : values[i];
+        memcpy(&bits[i], &value, sizeof(float));
+    }
+}
+
+static size_t HashVertex(const uint32_t bits[8])
+{
+    uint64_t hash = 0;
+    for (int i = 0; i < 8; ++i)
+    {
+        hash ^= bits[i];
+        hash *= 0x9E3779B97F4A7C15ull;
+        hash ^= hash >> 29;
+    }
+    return static_cast<size_t>(hash);
+}
+
+static size_t GetSlotCount(size_t vertexCount)
+{
+    // Kept at most half full, probes stay short.
+    size_t slotCount = 64;
+    while (slotCount < vertexCount * 2)
+        slotCount *= 2;
+    return slotCount;
+}
+
+EfgVertexWelder::EfgVertexWelder(std::vector<Vertex>& vertices, size_t expectedVertices)
+    : m_vertices(vertices)
+{
+    Rehash(GetSlotCount(m_vertices.size() + expectedVertices));
+    m_vertices.reserve(m_vertices.size() + expectedVertices);
+}
+
+void EfgVertexWelder::Rehash(size_t slotCount)
+{
+    m_slots.assign(slotCount, EmptySlot);
+    m_mask = slotCount - 1;
+    uint32_t bits[8];
+    for (uint32_t index = 0; index < m_vertices.size(); ++index)
+    {
+        GetVertexBits(m_vertices[index], bits);
+        size_t slot = HashVertex(bits) & m_mask;
+        while (m_slots[slot] != EmptySlot)
+            slot = (slot + 1) & m_mask;
+        m_slots[slot] = index;
+    }
+}
+
+uint32_t EfgVertexWelder::Add(const Vertex& vertex)
+{
+    uint32_t bits[8];
+    GetVertexBits(vertex, bits);
+    size_t slot = HashVertex(bits) & m_mask;
+    while (m_slots[slot] != EmptySlot)
+    {
+        uint32_t existingBits[8];
+        GetVertexBits(m_vertices[m_slots[slot]], existingBits);
+        if (memcmp(bits, existingBits, sizeof(bits)) == 0)
+            return m_slots[slot];
+        slot = (slot + 1) & m_mask;
+    }
+
+    uint32_t index = static_cast<uint32_t>(m_vertices.size());
+    m_vertices.push_back(vertex);
+    if (m_vertices.size() * 2 > m_slots.size())
+        Rehash(m_slots.size() * 2);
+    else
+        m_slots[slot] = index;
+    return index;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Shapes.h"
+
+// Merges vertices with identical position, normal and uv as they are added, so
+// imported faces share vertices and the index buffer does real work. Open
+// addressing with linear probing over indices into the output vertices.
+class EfgVertexWelder
+{
+public:
+    // Appends to vertices. expectedVertices sizes the table up front, 0 grows it as needed.
+    EfgVertexWelder(std::vector<Vertex>& vertices, size_t expectedVertices = 0);
+
+    // Returns the index of the first vertex equal to vertex, adding it when there is none.
+    uint32_t Add(const Vertex& vertex);
+
+private:
+    void Rehash(size_t slotCount);
+
+    std::vector<Vertex>& m_vertices;
+    std::vector<uint32_t> m_slots;
+    size_t m_mask = 0;
+};
@@ -0,0 +1,157 @@
+#include "efg_vfs.h"
+#include <chrono>
+
+namespace fs = std::filesystem;
+
+void EfgVfsFile::Close()
+{
+    m_mapping.reset();
+    m_contents.clear();
+    m_data = nullptr;
+    m_size = 0;
+}
+
+bool EfgVfs::Mount(const fs::path& archive, const fs::path& mountPoint)
+{
+    auto pack = std::make_shared<EfgPackArchive>();
+    if (!pack->Open(archive))
+        return false;
+    MountPoint mount;
+    mount.archive = pack;
+    if (!mountPoint.empty())
+    {
+        std::error_code error;
+        fs::path absolute = fs::absolute(mountPoint, error);
+        mount.prefix = efgPackName(error ? mountPoint : absolute);
+        if (mount.prefix.empty() || mount.prefix.back() != '/')
+            mount.prefix.push_back('/');
+    }
+    m_mounts.insert(m_mounts.begin(), mount);
+    return true;
+}
+
+const EfgPackEntry* EfgVfs::Find(const fs::path& path, const EfgPackArchive*& archive) const
+{
+    if (m_mounts.empty())
+        return nullptr;
+    std::string relativeName;
+    std::string absoluteName;
+    for (const MountPoint& mount : m_mounts)
+    {
+        std::string name;
+        if (mount.prefix.empty())
+        {
+            if (!path.is_relative())
+                continue;
+            if (relativeName.empty())
+                relativeName = efgPackName(path);
+            name = relativeName;
+        }
+        else
+        {
+            if (absoluteName.empty())
+            {
+                std::error_code error;
+                fs::path absolute = fs::absolute(path, error);
+                absoluteName = efgPackName(error ? path : absolute);
+            }
+            if (absoluteName.compare(0, mount.prefix.size(), mount.prefix) != 0)
+                continue;
+            name = absoluteName.substr(mount.prefix.size());
+        }
+        const EfgPackEntry* entry = mount.archive->Find(name);
+        if (entry != nullptr)
+        {
+            archive = mount.archive.get();
+            return entry;
+        }
+    }
+    return nullptr;
+}
+
+bool EfgVfs::Open(const fs::path& path, EfgVfsFile& file) const
+{
+    auto start = std::chrono::steady_clock::now();
+    file.Close();
+    const EfgPackArchive* archive = nullptr;
+    const EfgPackEntry* entry = Find(path, archive);
+    bool opened = false;
+    if (entry != nullptr)
+    {
+        if (entry->compression == efgPackCompression_NONE)
+        {
+            file.m_mapping = archive->GetFile();
+            file.m_data = archive->GetStoredData(*entry);
+            opened = true;
+        }
+        else
+        {
+            file.m_contents.resize(static_cast<size_t>(entry->size));
+            opened = archive->Read(*entry, file.m_contents.data());
+            file.m_data = file.m_contents.data();
+        }
+        file.m_size = static_cast<size_t>(entry->size);
+    }
+    else
+    {
+        auto mapping = std::make_shared<EfgMappedFile>();
+        opened = mapping->Open(path);
+        if (opened)
+        {
+            file.m_data = mapping->GetData();
+            file.m_size = mapping->GetSize();
+            file.m_mapping = mapping;
+        }
+    }
+    if (!opened)
+    {
+        file.Close();
+        return false;
+    }
+
+    std::chrono::duration<double, std::milli> openMs = std::chrono::steady_clock::now() - start;
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    if (entry != nullptr)
+        m_stats.archiveFiles++;
+    else
+        m_stats.looseFiles++;
+    if (file.IsMapped())
+        m_stats.mappedBytes += file.GetSize();
+    else
+        m_stats.decompressedBytes += file.GetSize();
+    m_stats.openMs += openMs.count();
+    return true;
+}
+
+bool EfgVfs::Exists(const fs::path& path) const
+{
+    const EfgPackArchive* archive = nullptr;
+    if (Find(path, archive) != nullptr)
+        return true;
+    std::error_code error;
+    return fs::is_regular_file(path, error);
+}
+
+bool EfgVfs::Stat(const fs::path& path, uint64_t& size, int64_t& writeTime) const
+{
+    const EfgPackArchive* archive = nullptr;
+    const EfgPackEntry* entry = Find(path, archive);
+    if (entry != nullptr)
+    {
+        size = entry->size;
+        writeTime = entry->writeTime;
+        return true;
+    }
+    std::error_code error;
+    size = fs::file_size(path, error);
+    if (error)
+        return false;
+    writeTime = static_cast<int64_t>(fs::last_write_time(path, error).time_since_epoch().count());
+    return !error;
+}
+
+EfgVfsStats EfgVfs::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    return m_stats;
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "efg_mappedFile.h"
+#include "efg_packArchive.h"
+
+// Bytes of a file opened through EfgVfs. Loose files and stored archive entries point
+// into a mapping the file keeps alive, compressed entries are decompressed into it.
+class EfgVfsFile
+{
+public:
+    bool IsOpen() const { return m_data != nullptr; }
+    const uint8_t* GetData() const { return m_data; }
+    size_t GetSize() const { return m_size; }
+    // False when the contents were copied out of the archive.
+    bool IsMapped() const { return m_mapping != nullptr; }
+    void Close();
+
+private:
+    friend class EfgVfs;
+    std::shared_ptr<EfgMappedFile> m_mapping;
+    std::vector<uint8_t> m_contents;
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+struct EfgVfsStats
+{
+    uint32_t archiveFiles = 0;
+    uint32_t looseFiles = 0;
+    uint64_t mappedBytes = 0;
+    uint64_t decompressedBytes = 0;
+    // Opening and decompressing, pages of mapped files are read in later by whoever touches them.
+    double openMs = 0.0;
+};
+
+// Looks asset paths up in the mounted archives before the disk, so loaders take the
+// same paths whether the assets are packed or loose.
+class EfgVfs
+{
+public:
+    // Paths under mountPoint are looked up in the archive by their path relative to it,
+    // with an empty mountPoint relative paths are looked up as they are. Later mounts take
+    // precedence. Mount before loading, lookups don't lock.
+    bool Mount(const std::filesystem::path& archive, const std::filesystem::path& mountPoint = {});
+    void UnmountAll() { m_mounts.clear(); }
+
+    // Thread safe.
+    bool Open(const std::filesystem::path& path, EfgVfsFile& file) const;
+    bool Exists(const std::filesystem::path& path) const;
+    // Packed files report the size and write time of the file that was packed.
+    bool Stat(const std::filesystem::path& path, uint64_t& size, int64_t& writeTime) const;
+    EfgVfsStats GetStats() const;
+
+private:
+    struct MountPoint
+    {
+        std::shared_ptr<EfgPackArchive> archive;
+        // efgPackName() of the absolute mount point with a trailing slash, empty for relative paths.
+        std::string prefix;
+    };
+    const EfgPackEntry* Find(const std::filesystem::path& path, const EfgPackArchive*& archive) const;
+
+    std::vector<MountPoint> m_mounts;
+    mutable std::mutex m_statsMutex;
+    mutable EfgVfsStats m_stats;
+};
@@ -1,3 +1,5 @@
+// Keywords: EFG_DIFFUSE_MAP, EFG_SINGLE_POINT_LIGHT
+
 cbuffer ViewBuffer : register(b1)
 {
     float3 viewPos;
@@ -122,10 +124,11 @@ float3 calculateDirLight(float3 fragPos, float3 normal, float3 viewDir, float2 u
 
     float shadow = CalculateDirShadow(fragPos, normal, lightDir);
 
-    if(mat.diffuseMapFlag > 0)
-        texDiffuse = diffuseMap.Sample(textureSampler, uv).xyz;
-    else
-        texDiffuse = mat.diffuse.xyz;
+#ifdef EFG_DIFFUSE_MAP
+    texDiffuse = diffuseMap.Sample(textureSampler, uv).xyz;
+#else
+    texDiffuse = mat.diffuse.xyz;
+#endif
 
     ambient = (dirLight.ambient * dirLight.color).xyz * texDiffuse;
     diffuse = (dirLight.diffuse.xyz * dirLight.color.xyz) * diff * texDiffuse * shadow;
@@ -189,14 +192,11 @@ float3 calculatePointLight(LightData light, float3 normal, float3 fragPos, float
 
     float shadow = CalcPointLightShadow(fragPos, light.position.xyz);
 
-    if(mat.diffuseMapFlag > 0)
-    {
-        texDiffuse = diffuseMap.Sample(textureSampler, uv).xyz;
-    }
-    else
-    {
-        texDiffuse = mat.diffuse.xyz;
-    }
+#ifdef EFG_DIFFUSE_MAP
+    texDiffuse = diffuseMap.Sample(textureSampler, uv).xyz;
+#else
+    texDiffuse = mat.diffuse.xyz;
+#endif
 
     ambient = (light.ambient * light.color).xyz * texDiffuse;
     diffuse = (light.diffuse.xyz * light.color.xyz) * diff * texDiffuse * (1.0 - shadow);
@@ -228,10 +228,14 @@ float4 Main(PSInput input) : SV_TARGET
 
     //color += calculateDirLight(input.fragPos, normal, viewDir, input.uv);
 
+#ifdef EFG_SINGLE_POINT_LIGHT
+    color += calculatePointLight(lights[0], normal, input.fragPos, viewDir, input.uv);
+#else
     for (uint i = 0; i < numPointlights; ++i)
     {
         color += calculatePointLight(lights[i], normal, input.fragPos, viewDir, input.uv);
     }
+#endif
     
     //return float4(visualizeShadowMapDepth(input.fragPos, lights[0].position.xyz), 1.0f);
     return float4(color, 1.0f);
@@ -1,3 +1,6 @@
+// Keywords: EFG_USE_TRANSFORM, EFG_INSTANCED
+// Defined by the engine for compressed input layouts: EFG_COMPRESSED_VERTEX
+
 cbuffer ViewProjectionBuffer : register(b0)
 {
     matrix viewProjectionMatrix;
@@ -8,23 +11,24 @@ cbuffer TransformBuffer : register(b4)
     matrix transform;
 }
 
-struct ObjectConstants
-{
-    uint isInstanced;
-    uint useTransform;
-    int padding[2];
-};
-cbuffer ObjectConstantsBuffer : register(b5)
+#ifdef EFG_COMPRESSED_VERTEX
+cbuffer VertexQuantization : register(b5)
 {
-    ObjectConstants constants;
+    float4 positionScale;
+    float4 positionOffset;
 }
+#endif
 
 StructuredBuffer<matrix> instances : register(t1);
 
 struct VSInput
 {
     float4 position : POSITION;
+#ifdef EFG_COMPRESSED_VERTEX
+    float2 normal : NORMAL;
+#else
     float3 normal : NORMAL;
+#endif
     float2 uv : TEXCOORD;
 };
 
@@ -36,22 +40,36 @@ struct PSInput
     float2 uv : TEXCOORD;
 };
 
+#ifdef EFG_COMPRESSED_VERTEX
+float3 DecodeOctahedral(float2 encoded)
+{
+    float3 normal = float3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+    float t = saturate(-normal.z);
+    normal.xy += (normal.xy >= 0.0f) ? -t : t;
+    return normalize(normal);
+}
+#endif
+
 PSInput Main(VSInput input, uint InstanceID : SV_InstanceID)
 {
     PSInput result;
+#ifdef EFG_COMPRESSED_VERTEX
+    input.position = float4(input.position.xyz * positionScale.xyz + positionOffset.xyz, 1.0f);
+    float3 normal = DecodeOctahedral(input.normal);
+#else
+    float3 normal = input.normal;
+#endif
     float4 worldPos = input.position;
-    if(constants.useTransform)
-    {
-        if(constants.isInstanced)
-            worldPos = mul(instances[InstanceID], input.position);
-        else
-            worldPos = mul(transform, input.position);
-    }
+#if defined(EFG_USE_TRANSFORM) && defined(EFG_INSTANCED)
+    worldPos = mul(instances[InstanceID], input.position);
+#elif defined(EFG_USE_TRANSFORM)
+    worldPos = mul(transform, input.position);
+#endif
     float4 clipPos = mul(viewProjectionMatrix, worldPos);
 
     result.position = clipPos;
     result.fragPos = worldPos.xyz;
-    result.normal = mul(float4(input.normal, 0.0f), transform).xyz;
+    result.normal = mul(float4(normal, 0.0f), transform).xyz;
     result.uv = input.uv;
 
     return result;
@@ -0,0 +1,454 @@
+// Converts an OBJ with its MTL to a GLB that EfgContext::LoadFromGlb uploads without
+// converting: one primitive per material, vertices interleaved like the engine's Vertex
+// and 32-bit indices. Texture images stay next to the model and are referenced by URI.
+// OBJ texcoords start at the bottom, V is flipped to glTF's top left origin. Ambient and
+// specular colors have no glTF equivalent and are dropped.
+//
+// efgObjToGlb <model.obj> <output.glb>
+// efgObjToGlb --bench <model.obj> <model.glb> [runs]
+//
+// --bench times loading both files to upload ready vertices and indices, the OBJ parsed
+// and welded, the GLB parsed and its streams used in place. The first run is cold when
+// the file cache was emptied first, with RAMMap's "Empty Standby List" on Windows or
+// "echo 3 > /proc/sys/vm/drop_caches" on Linux.
+// Outside Visual Studio:
+//   g++ -std=c++17 -O2 -I../efg main.cpp ../efg/efg_objParser.cpp ../efg/efg_gltf.cpp ../efg/efg_json.cpp
+//       ../efg/efg_vfs.cpp ../efg/efg_packArchive.cpp ../efg/efg_lz4.cpp ../efg/efg_mappedFile.cpp
+//       ../efg/efg_threadPool.cpp -pthread -o efgObjToGlb
+
+#include "efg_gltf.h"
+#include "efg_objParser.h"
+#include "efg_threadPool.h"
+#include "efg_vfs.h"
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+// Same layout as Vertex in Shapes.h.
+struct GlbVertex
+{
+    float position[3];
+    float normal[3];
+    float uv[2];
+};
+static_assert(sizeof(GlbVertex) == 32, "GlbVertex must match Vertex");
+
+struct GlbBatch
+{
+    int32_t materialId = -1;
+    std::vector<GlbVertex> vertices;
+    std::vector<uint32_t> indices;
+};
+
+struct CornerKey
+{
+    int32_t position;
+    int32_t texcoord;
+    int32_t normal;
+    bool operator==(const CornerKey& other) const
+    {
+        return position == other.position && texcoord == other.texcoord && normal == other.normal;
+    }
+};
+
+struct CornerKeyHash
+{
+    size_t operator()(const CornerKey& key) const
+    {
+        uint64_t hash = uint64_t(uint32_t(key.position)) * 0x9E3779B97F4A7C15ull;
+        hash ^= (uint64_t(uint32_t(key.texcoord)) + (hash << 6) + (hash >> 2)) * 0xC2B2AE3D27D4EB4Full;
+        hash ^= (uint64_t(uint32_t(key.normal)) + (hash << 6) + (hash >> 2)) * 0x165667B19E3779F9ull;
+        return static_cast<size_t>(hash);
+    }
+};
+
+static double GetMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Corners with the same OBJ indices share a vertex, one batch per material with faces.
+static std::vector<GlbBatch> WeldObj(const EfgObjMesh& obj, bool flipV)
+{
+    std::vector<GlbBatch> buckets(obj.materials.size() + 1);
+    std::vector<std::unordered_map<CornerKey, uint32_t, CornerKeyHash>> welded(buckets.size());
+    for (size_t triangle = 0; triangle < obj.materialIds.size(); ++triangle)
+    {
+        size_t bucket = static_cast<size_t>(obj.materialIds[triangle] + 1);
+        GlbBatch& batch = buckets[bucket];
+        for (size_t corner = triangle * 3; corner < triangle * 3 + 3; ++corner)
+        {
+            const EfgObjIndex& index = obj.indices[corner];
+            auto inserted = welded[bucket].emplace(CornerKey{ index.position, index.texcoord, index.normal }, static_cast<uint32_t>(batch.vertices.size()));
+            if (inserted.second)
+            {
+                GlbVertex vertex = {};
+                memcpy(vertex.position, &obj.positions[3 * size_t(index.position)], sizeof(vertex.position));
+                if (index.normal >= 0)
+                    memcpy(vertex.normal, &obj.normals[3 * size_t(index.normal)], sizeof(vertex.normal));
+                if (index.texcoord >= 0)
+                {
+                    vertex.uv[0] = obj.texcoords[2 * size_t(index.texcoord)];
+                    vertex.uv[1] = obj.texcoords[2 * size_t(index.texcoord) + 1];
+                    if (flipV)
+                        vertex.uv[1] = 1.0f - vertex.uv[1];
+                }
+                batch.vertices.push_back(vertex);
+            }
+            batch.indices.push_back(inserted.first->second);
+        }
+    }
+
+    std::vector<GlbBatch> batches;
+    for (size_t b = 0; b < buckets.size(); ++b)
+    {
+        if (buckets[b].indices.empty())
+            continue;
+        buckets[b].materialId = static_cast<int32_t>(b) - 1;
+        batches.push_back(std::move(buckets[b]));
+    }
+    return batches;
+}
+
+static std::string EscapeJson(const std::string& text)
+{
+    std::string escaped;
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            escaped += '\\';
+            escaped += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", c);
+            escaped += code;
+        }
+        else
+        {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+// Keeps the path separators, escapes what a URI can't hold as it is, like spaces.
+static std::string EncodeUri(const std::string& path)
+{
+    std::string encoded;
+    for (char c : path)
+    {
+        unsigned char u = static_cast<unsigned char>(c);
+        bool plain = (u >= 'a' && u <= 'z') || (u >= 'A' && u <= 'Z') || (u >= '0' && u <= '9') || strchr("-._~/", u) != nullptr;
+        if (plain && u != 0)
+        {
+            encoded += c;
+        }
+        else
+        {
+            char code[4];
+            snprintf(code, sizeof(code), "%%%02X", u);
+            encoded += code;
+        }
+    }
+    return encoded;
+}
+
+static int Convert(const fs::path& input, const fs::path& output, EfgThreadPool& pool)
+{
+    EfgVfs vfs;
+    EfgObjMesh obj;
+    std::string error;
+    if (!efgParseObj(input, {}, vfs, pool, obj, error))
+    {
+        std::cerr << "Error: " << error << std::endl;
+        return 1;
+    }
+    std::vector<GlbBatch> batches = WeldObj(obj, true);
+    if (batches.empty())
+    {
+        std::cerr << "Error: " << input.u8string() << " has no faces" << std::endl;
+        return 1;
+    }
+
+    std::ostringstream json;
+    json << std::setprecision(9);
+    std::vector<uint8_t> bin;
+    std::ostringstream accessors;
+    std::ostringstream views;
+    std::ostringstream primitives;
+    accessors << std::setprecision(9);
+    for (size_t b = 0; b < batches.size(); ++b)
+    {
+        const GlbBatch& batch = batches[b];
+        float boundsMin[3] = { batch.vertices[0].position[0], batch.vertices[0].position[1], batch.vertices[0].position[2] };
+        float boundsMax[3] = { boundsMin[0], boundsMin[1], boundsMin[2] };
+        for (const GlbVertex& vertex : batch.vertices)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                boundsMin[c] = std::min(boundsMin[c], vertex.position[c]);
+                boundsMax[c] = std::max(boundsMax[c], vertex.position[c]);
+            }
+        }
+
+        // One interleaved view for the vertices and one for the indices, both 4 byte aligned.
+        size_t vertexOffset = bin.size();
+        size_t vertexBytes = batch.vertices.size() * sizeof(GlbVertex);
+        bin.resize(vertexOffset + vertexBytes);
+        memcpy(bin.data() + vertexOffset, batch.vertices.data(), vertexBytes);
+        size_t indexOffset = bin.size();
+        size_t indexBytes = batch.indices.size() * sizeof(uint32_t);
+        bin.resize(indexOffset + indexBytes);
+        memcpy(bin.data() + indexOffset, batch.indices.data(), indexBytes);
+
+        const char* separator = (b == 0) ? "" : ",";
+        views << separator << "{\"buffer\":0,\"byteOffset\":" << vertexOffset << ",\"byteLength\":" << vertexBytes
+            << ",\"byteStride\":" << sizeof(GlbVertex) << ",\"target\":34962},"
+            << "{\"buffer\":0,\"byteOffset\":" << indexOffset << ",\"byteLength\":" << indexBytes << ",\"target\":34963}";
+        size_t vertexView = b * 2;
+        size_t vertexCount = batch.vertices.size();
+        accessors << separator
+            << "{\"bufferView\":" << vertexView << ",\"byteOffset\":0,\"componentType\":5126,\"count\":" << vertexCount << ",\"type\":\"VEC3\""
+            << ",\"min\":[" << boundsMin[0] << "," << boundsMin[1] << "," << boundsMin[2] << "]"
+            << ",\"max\":[" << boundsMax[0] << "," << boundsMax[1] << "," << boundsMax[2] << "]},"
+            << "{\"bufferView\":" << vertexView << ",\"byteOffset\":12,\"componentType\":5126,\"count\":" << vertexCount << ",\"type\":\"VEC3\"},"
+            << "{\"bufferView\":" << vertexView << ",\"byteOffset\":24,\"componentType\":5126,\"count\":" << vertexCount << ",\"type\":\"VEC2\"},"
+            << "{\"bufferView\":" << vertexView + 1 << ",\"componentType\":5125,\"count\":" << batch.indices.size() << ",\"type\":\"SCALAR\"}";
+        size_t accessor = b * 4;
+        primitives << separator << "{\"attributes\":{\"POSITION\":" << accessor << ",\"NORMAL\":" << accessor + 1 << ",\"TEXCOORD_0\":" << accessor + 2
+            << "},\"indices\":" << accessor + 3;
+        if (batch.materialId >= 0)
+            primitives << ",\"material\":" << batch.materialId;
+        primitives << "}";
+    }
+
+    std::ostringstream materials;
+    std::ostringstream images;
+    materials << std::setprecision(9);
+    size_t imageCount = 0;
+    for (size_t m = 0; m < obj.materials.size(); ++m)
+    {
+        const EfgObjMaterial& material = obj.materials[m];
+        materials << ((m == 0) ? "" : ",") << "{\"name\":\"" << EscapeJson(material.name) << "\",\"pbrMetallicRoughness\":{\"baseColorFactor\":["
+            << material.diffuse[0] << "," << material.diffuse[1] << "," << material.diffuse[2] << "," << material.dissolve << "]"
+            << ",\"metallicFactor\":" << material.metallic << ",\"roughnessFactor\":" << material.roughness;
+        if (!material.diffuseTexture.empty())
+        {
+            // Texture names in an MTL are relative to the OBJ, URIs to the GLB.
+            fs::path texture = input.parent_path() / fs::u8path(material.diffuseTexture);
+            fs::path relative = texture.lexically_proximate(output.parent_path().empty() ? fs::path(".") : output.parent_path());
+            images << ((imageCount == 0) ? "" : ",") << "{\"uri\":\"" << EscapeJson(EncodeUri(relative.generic_u8string())) << "\"}";
+            materials << ",\"baseColorTexture\":{\"index\":" << imageCount++ << "}";
+        }
+        materials << "},\"emissiveFactor\":[" << material.emission[0] << "," << material.emission[1] << "," << material.emission[2] << "]}";
+    }
+
+    json << "{\"asset\":{\"version\":\"2.0\",\"generator\":\"efgObjToGlb\"},\"scene\":0,\"scenes\":[{\"nodes\":[0]}],"
+        << "\"nodes\":[{\"mesh\":0,\"name\":\"" << EscapeJson(input.stem().u8string()) << "\"}],"
+        << "\"meshes\":[{\"primitives\":[" << primitives.str() << "]}],";
+    if (!obj.materials.empty())
+        json << "\"materials\":[" << materials.str() << "],";
+    if (imageCount > 0)
+    {
+        json << "\"textures\":[";
+        for (size_t i = 0; i < imageCount; ++i)
+            json << ((i == 0) ? "" : ",") << "{\"source\":" << i << "}";
+        json << "],\"images\":[" << images.str() << "],";
+    }
+    json << "\"accessors\":[" << accessors.str() << "],\"bufferViews\":[" << views.str() << "],\"buffers\":[{\"byteLength\":" << bin.size() << "}]}";
+
+    // Chunks are padded to 4 bytes, JSON with spaces and BIN with zeros.
+    std::string jsonChunk = json.str();
+    jsonChunk.resize((jsonChunk.size() + 3) & ~size_t(3), ' ');
+    bin.resize((bin.size() + 3) & ~size_t(3), 0);
+    uint32_t header[3] = { 0x46546C67, 2, static_cast<uint32_t>(12 + 8 + jsonChunk.size() + 8 + bin.size()) };
+    uint32_t jsonHeader[2] = { static_cast<uint32_t>(jsonChunk.size()), 0x4E4F534A };
+    uint32_t binHeader[2] = { static_cast<uint32_t>(bin.size()), 0x004E4942 };
+    std::ofstream file(output, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(jsonHeader), sizeof(jsonHeader));
+    file.write(jsonChunk.data(), jsonChunk.size());
+    file.write(reinterpret_cast<const char*>(binHeader), sizeof(binHeader));
+    file.write(reinterpret_cast<const char*>(bin.data()), bin.size());
+    if (!file)
+    {
+        std::cerr << "Error: failed to write " << output.u8string() << std::endl;
+        return 1;
+    }
+
+    size_t vertexCount = 0;
+    size_t triangleCount = 0;
+    for (const GlbBatch& batch : batches)
+    {
+        vertexCount += batch.vertices.size();
+        triangleCount += batch.indices.size() / 3;
+    }
+    std::cout << output.u8string() << ": " << batches.size() << " primitives, " << vertexCount << " vertices, " << triangleCount << " triangles, "
+        << imageCount << " textures, " << header[2] / 1024 << " KB" << std::endl;
+    return 0;
+}
+
+// Sums what an upload would read, so both paths touch every byte of their streams.
+static uint64_t Checksum(const void* data, size_t size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t sum = 0;
+    for (size_t i = 0; i < size; ++i)
+        sum += bytes[i];
+    return sum;
+}
+
+static bool LoadObj(const fs::path& path, const EfgVfs& vfs, EfgThreadPool& pool, uint64_t& sum, size_t& zeroCopyStreams, size_t& streamCount)
+{
+    EfgObjMesh obj;
+    std::string error;
+    if (!efgParseObj(path, {}, vfs, pool, obj, error))
+    {
+        std::cerr << "Error: " << error << std::endl;
+        return false;
+    }
+    for (const GlbBatch& batch : WeldObj(obj, true))
+    {
+        sum += Checksum(batch.vertices.data(), batch.vertices.size() * sizeof(GlbVertex));
+        sum += Checksum(batch.indices.data(), batch.indices.size() * sizeof(uint32_t));
+        streamCount += 2;
+    }
+    zeroCopyStreams = 0;
+    return true;
+}
+
+// Mirrors LoadFromGlb: streams laid out like Vertex are used in place, others converted.
+static bool LoadGlb(const fs::path& path, const EfgVfs& vfs, uint64_t& sum, size_t& zeroCopyStreams, size_t& streamCount)
+{
+    EfgGltfScene scene;
+    std::string error;
+    if (!efgParseGltf(path, vfs, scene, error))
+    {
+        std::cerr << "Error: " << error << std::endl;
+        return false;
+    }
+    for (const EfgGltfMesh& mesh : scene.meshes)
+    {
+        for (const EfgGltfPrimitive& primitive : mesh.primitives)
+        {
+            uint32_t vertexCount = primitive.positions.count;
+            const uint8_t* vertices = efgGetGltfInterleavedVertices(primitive, static_cast<uint32_t>(sizeof(GlbVertex)),
+                static_cast<uint32_t>(offsetof(GlbVertex, normal)), static_cast<uint32_t>(offsetof(GlbVertex, uv)));
+            if (vertices != nullptr)
+            {
+                sum += Checksum(vertices, size_t(vertexCount) * sizeof(GlbVertex));
+                zeroCopyStreams++;
+            }
+            else
+            {
+                std::vector<GlbVertex> converted(vertexCount);
+                for (uint32_t v = 0; v < vertexCount; ++v)
+                {
+                    for (uint32_t c = 0; c < 3; ++c)
+                    {
+                        converted[v].position[c] = efgReadGltfFloat(primitive.positions, v, c);
+                        converted[v].normal[c] = efgReadGltfFloat(primitive.normals, v, c);
+                    }
+                    converted[v].uv[0] = efgReadGltfFloat(primitive.texcoords, v, 0);
+                    converted[v].uv[1] = efgReadGltfFloat(primitive.texcoords, v, 1);
+                }
+                sum += Checksum(converted.data(), converted.size() * sizeof(GlbVertex));
+            }
+
+            const uint32_t* indices = efgGetGltfIndices32(primitive);
+            if (indices != nullptr)
+            {
+                sum += Checksum(indices, size_t(primitive.indices.count) * sizeof(uint32_t));
+                zeroCopyStreams++;
+            }
+            else
+            {
+                uint32_t indexCount = (primitive.indices.count > 0) ? primitive.indices.count : vertexCount;
+                std::vector<uint32_t> converted(indexCount);
+                for (uint32_t i = 0; i < indexCount; ++i)
+                    converted[i] = (primitive.indices.count > 0) ? efgReadGltfIndex(primitive.indices, i) : i;
+                sum += Checksum(converted.data(), converted.size() * sizeof(uint32_t));
+            }
+            streamCount += 2;
+        }
+    }
+    return true;
+}
+
+static int Bench(const fs::path& objPath, const fs::path& glbPath, int runs, EfgThreadPool& pool)
+{
+    EfgVfs vfs;
+    const char* names[2] = { "OBJ", "GLB" };
+    const fs::path* paths[2] = { &objPath, &glbPath };
+    // Each format's first run comes before any of its warm ones.
+    for (int format = 0; format < 2; ++format)
+    {
+        double firstMs = 0.0;
+        double warmMs = 0.0;
+        uint64_t sum = 0;
+        size_t zeroCopyStreams = 0;
+        size_t streamCount = 0;
+        for (int run = 0; run < runs; ++run)
+        {
+            sum = 0;
+            zeroCopyStreams = 0;
+            streamCount = 0;
+            auto start = std::chrono::steady_clock::now();
+            bool loaded = (format == 0) ? LoadObj(objPath, vfs, pool, sum, zeroCopyStreams, streamCount) : LoadGlb(glbPath, vfs, sum, zeroCopyStreams, streamCount);
+            if (!loaded)
+                return 1;
+            double ms = GetMs(start);
+            if (run == 0)
+                firstMs = ms;
+            else
+                warmMs += ms;
+        }
+        std::cout << names[format] << ": " << paths[format]->u8string() << " " << fs::file_size(*paths[format]) / 1024 << " KB, first run "
+            << firstMs << " ms";
+        if (runs > 1)
+            std::cout << ", then " << warmMs / (runs - 1) << " ms on average";
+        std::cout << ", " << zeroCopyStreams << " of " << streamCount << " streams used in place (checksum " << sum << ")" << std::endl;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> arguments;
+    bool bench = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--bench")
+            bench = true;
+        else
+            arguments.push_back(argv[i]);
+    }
+    bool valid = bench ? (arguments.size() == 2 || arguments.size() == 3) : arguments.size() == 2;
+    if (!valid)
+    {
+        std::cerr << "Usage: efgObjToGlb <model.obj> <output.glb>" << std::endl;
+        std::cerr << "       efgObjToGlb --bench <model.obj> <model.glb> [runs]" << std::endl;
+        return 1;
+    }
+    // efgParseObj parses chunks of the file on the pool.
+    EfgThreadPool pool;
+    pool.Initialize(std::thread::hardware_concurrency());
+    int result = 0;
+    if (bench)
+        result = Bench(fs::u8path(arguments[0]), fs::u8path(arguments[1]), (arguments.size() == 3) ? std::max(std::stoi(arguments[2]), 1) : 5, pool);
+    else
+        result = Convert(fs::u8path(arguments[0]), fs::u8path(arguments[1]), pool);
+    pool.Destroy();
+    return result;
+}
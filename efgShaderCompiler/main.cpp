@@ -0,0 +1,125 @@
+// Compiles every shader listed in a manifest and packs the results into a
+// shader archive the runtime maps at startup instead of compiling.
+//
+// efgShaderCompiler <manifest> <output> [--debug]
+
+#include "efg_exception.h"
+#include "efg_shaderArchive.h"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+struct ManifestEntry
+{
+    std::string file;
+    std::string entryPoint;
+    std::string target;
+    std::vector<EfgShaderDefine> defines;
+    int line = 0;
+};
+
+static bool ReadManifest(const fs::path& path, std::vector<ManifestEntry>& entries)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        EFG_SHOW_ERROR("Failed to open " << path.u8string());
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line.resize(comment);
+
+        std::istringstream tokens(line);
+        ManifestEntry entry = {};
+        entry.line = lineNumber;
+        if (!(tokens >> entry.file))
+            continue;
+        if (!(tokens >> entry.entryPoint >> entry.target))
+        {
+            EFG_SHOW_ERROR(path.u8string() << "(" << lineNumber << "): expected <file> <entry point> <target>");
+            return false;
+        }
+        std::string define;
+        while (tokens >> define)
+        {
+            size_t equals = define.find('=');
+            if (equals == std::string::npos)
+                entry.defines.push_back({ define, "1" });
+            else
+                entry.defines.push_back({ define.substr(0, equals), define.substr(equals + 1) });
+        }
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: efgShaderCompiler <manifest> <output> [--debug]" << std::endl;
+        return 1;
+    }
+    fs::path manifestPath = argv[1];
+    fs::path outputPath = argv[2];
+    UINT compileFlags = 0;
+    for (int i = 3; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--debug")
+            compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+    }
+
+    std::vector<ManifestEntry> entries;
+    if (!ReadManifest(manifestPath, entries))
+        return 1;
+
+    EfgShaderArchiveWriter writer;
+    fs::path shaderDirectory = manifestPath.parent_path();
+    double totalMs = 0.0;
+    for (const ManifestEntry& entry : entries)
+    {
+        std::vector<D3D_SHADER_MACRO> macros;
+        for (const EfgShaderDefine& define : entry.defines)
+            macros.push_back({ define.name.c_str(), define.value.c_str() });
+        macros.push_back({ nullptr, nullptr });
+
+        auto start = std::chrono::high_resolution_clock::now();
+        ComPtr<ID3DBlob> shaderBlob;
+        ComPtr<ID3DBlob> errorBlob;
+        HRESULT hr = D3DCompileFromFile((shaderDirectory / entry.file).c_str(), macros.data(), D3D_COMPILE_STANDARD_FILE_INCLUDE,
+            entry.entryPoint.c_str(), entry.target.c_str(), compileFlags, 0, &shaderBlob, &errorBlob);
+        if (FAILED(hr))
+        {
+            EFG_SHOW_ERROR(manifestPath.u8string() << "(" << entry.line << "): failed to compile " << entry.file << " " << entry.entryPoint);
+            if (errorBlob)
+                std::cerr << static_cast<const char*>(errorBlob->GetBufferPointer()) << std::endl;
+            return 1;
+        }
+        float compileMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        totalMs += compileMs;
+
+        std::vector<EfgShaderBinding> bindings;
+        efgReflectShader(shaderBlob.Get(), bindings);
+        writer.Add(entry.file, entry.entryPoint, entry.target, entry.defines,
+            shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), bindings, compileMs);
+        std::cout << entry.file << " " << entry.entryPoint << " " << entry.target << ": " << compileMs << " ms" << std::endl;
+    }
+
+    if (!writer.Write(outputPath))
+    {
+        EFG_SHOW_ERROR("Failed to write " << outputPath.u8string());
+        return 1;
+    }
+    std::cout << entries.size() << " shaders compiled in " << totalMs << " ms, written to " << outputPath.u8string() << std::endl;
+    return 0;
+}
@@ -0,0 +1,117 @@
+#include "efgTest.h"
+#include "efg_assetStreamer.h"
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// One worker held by a load that waits for Release, so everything submitted meanwhile
+// stays queued and runs in a known order afterwards.
+struct EfgBlockedStreamer
+{
+    EfgAssetStreamer streamer;
+    std::promise<void> started;
+    std::promise<void> release;
+    std::mutex mutex;
+    std::vector<int> order;
+
+    EfgBlockedStreamer()
+    {
+        streamer.Initialize(1);
+        std::shared_future<void> released = release.get_future().share();
+        streamer.Submit(0.0f, [this, released]() { started.set_value(); released.wait(); });
+        started.get_future().wait();
+    }
+    EfgAssetStreamer::Request Submit(float priority, int id)
+    {
+        return streamer.Submit(priority, [this, id]() { std::lock_guard<std::mutex> lock(mutex); order.push_back(id); });
+    }
+    // Releases the worker and waits until the queue has drained.
+    void Finish()
+    {
+        std::promise<void> done;
+        streamer.Submit(1e30f, [&done]() { done.set_value(); });
+        release.set_value();
+        done.get_future().wait();
+        streamer.Destroy();
+    }
+};
+
+EFG_TEST(assetStreamer, PriorityOrder)
+{
+    EfgBlockedStreamer blocked;
+    blocked.Submit(3.0f, 3);
+    blocked.Submit(1.0f, 1);
+    blocked.Submit(2.0f, 2);
+    blocked.Submit(1.0f, 4);
+    EFG_CHECK(blocked.streamer.GetQueuedCount() == 4);
+    blocked.Finish();
+    // Equal priorities keep submission order.
+    EFG_CHECK((blocked.order == std::vector<int>{ 1, 4, 2, 3 }));
+}
+
+EFG_TEST(assetStreamer, SetPriority)
+{
+    EfgBlockedStreamer blocked;
+    EfgAssetStreamer::Request first = blocked.Submit(1.0f, 1);
+    EfgAssetStreamer::Request second = blocked.Submit(2.0f, 2);
+    EfgAssetStreamer::Request third = blocked.Submit(3.0f, 3);
+    EFG_CHECK(blocked.streamer.SetPriority(third, 0.5f));
+    // Back and forth leaves stale heap entries with the same priority, the load still runs once.
+    EFG_CHECK(blocked.streamer.SetPriority(first, 5.0f));
+    EFG_CHECK(blocked.streamer.SetPriority(first, 1.5f));
+    EFG_CHECK(blocked.streamer.SetPriority(second, 4.0f));
+    EFG_CHECK(blocked.streamer.SetPriority(second, 2.0f));
+    EFG_CHECK(blocked.streamer.SetPriority(second, 4.0f));
+    EFG_CHECK(blocked.streamer.GetQueuedCount() == 3);
+    blocked.Finish();
+    EFG_CHECK((blocked.order == std::vector<int>{ 3, 1, 2 }));
+    // Started loads can't be reprioritized.
+    EFG_CHECK(!blocked.streamer.SetPriority(first, 0.0f));
+}
+
+EFG_TEST(assetStreamer, Cancel)
+{
+    EfgBlockedStreamer blocked;
+    std::shared_ptr<int> resource = std::make_shared<int>(0);
+    EfgAssetStreamer::Request cancelled = blocked.streamer.Submit(1.0f, [resource]() { *resource = 1; });
+    blocked.Submit(2.0f, 2);
+    EFG_CHECK(resource.use_count() == 2);
+    EFG_CHECK(blocked.streamer.Cancel(cancelled));
+    // The cancelled load is destroyed right away, its stale heap entry is skipped.
+    EFG_CHECK(resource.use_count() == 1);
+    EFG_CHECK(!blocked.streamer.Cancel(cancelled));
+    EFG_CHECK(!blocked.streamer.SetPriority(cancelled, 0.0f));
+    EFG_CHECK(blocked.streamer.GetQueuedCount() == 1);
+    blocked.Finish();
+    EFG_CHECK(*resource == 0);
+    EFG_CHECK((blocked.order == std::vector<int>{ 2 }));
+}
+
+EFG_TEST(assetStreamer, DestroyDropsQueued)
+{
+    EfgBlockedStreamer blocked;
+    std::shared_ptr<int> resource = std::make_shared<int>(0);
+    for (int i = 0; i < 8; ++i)
+        blocked.streamer.Submit(float(i), [resource]() { ++*resource; });
+    EFG_CHECK(resource.use_count() == 9);
+    // Destroy waits for the running load, the queued ones are dropped before it does.
+    std::thread destroy([&blocked]() { blocked.streamer.Destroy(); });
+    while (blocked.streamer.GetQueuedCount() != 0)
+        std::this_thread::yield();
+    blocked.release.set_value();
+    destroy.join();
+    EFG_CHECK(*resource == 0);
+    EFG_CHECK(resource.use_count() == 1);
+}
+
+EFG_TEST(assetStreamer, InlineWithoutWorkers)
+{
+    EfgAssetStreamer streamer;
+    int loads = 0;
+    EfgAssetStreamer::Request request = streamer.Submit(1.0f, [&loads]() { ++loads; });
+    EFG_CHECK(loads == 1 && request != 0);
+    EFG_CHECK(!streamer.Cancel(request));
+    EFG_CHECK(streamer.GetQueuedCount() == 0);
+    streamer.Destroy();
+}
@@ -0,0 +1,184 @@
+#include "efgTest.h"
+#include "efg_bcEncoder.h"
+#include "efg_threadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+// Smooth gradients in every channel with a little noise, like a photo rather than flat art.
+static EfgImage MakeTestImage(uint32_t width, uint32_t height)
+{
+    EfgImage image;
+    image.width = width;
+    image.height = height;
+    image.pixels.resize(size_t(width) * height * 4);
+    uint32_t seed = 12345;
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            int noise = int(seed >> 29) - 4;
+            float u = float(x) / width;
+            float v = float(y) / height;
+            const float channels[4] = { 255.0f * u, 255.0f * v, 127.5f + 127.5f * std::sin(6.0f * (u + v)), 255.0f * (1.0f - u * v) };
+            for (int c = 0; c < 4; ++c)
+            {
+                int value = int(channels[c]) + noise;
+                image.pixels[(size_t(y) * width + x) * 4 + c] = uint8_t(value < 0 ? 0 : (value > 255 ? 255 : value));
+            }
+        }
+    }
+    return image;
+}
+
+// The top left corner of image.
+static EfgImage Crop(const EfgImage& image, uint32_t width, uint32_t height)
+{
+    EfgImage crop;
+    crop.width = width;
+    crop.height = height;
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const uint8_t* row = &image.pixels[size_t(y) * image.width * 4];
+        crop.pixels.insert(crop.pixels.end(), row, row + size_t(width) * 4);
+    }
+    return crop;
+}
+
+static double CompressAndMeasure(EFG_BC_FORMAT format, const EfgImage& image, EfgThreadPool& pool)
+{
+    std::vector<uint8_t> compressed(efgGetCompressedSize(format, image.width, image.height));
+    efgCompressImage(format, image, compressed.data(), pool);
+    return efgMeasurePsnr(format, image, compressed.data());
+}
+
+EFG_TEST(bcEncoder, RoundTripPsnr)
+{
+    EfgThreadPool pool;
+    pool.Initialize(2);
+    EfgImage image = MakeTestImage(128, 128);
+    const EFG_BC_FORMAT formats[4] = { efgBC_1, efgBC_3, efgBC_5, efgBC_7 };
+    const char* names[4] = { "BC1", "BC3", "BC5", "BC7" };
+    // Floors a few dB below what the encoder reaches, 5:6:5 endpoints limit BC1 and BC3 color.
+    const double floors[4] = { 36.0, 37.0, 48.0, 39.0 };
+    for (int f = 0; f < 4; ++f)
+    {
+        double psnr = CompressAndMeasure(formats[f], image, pool);
+        printf("       %s: %.1f dB\n", names[f], psnr);
+        EFG_CHECK(psnr >= floors[f]);
+    }
+    pool.Destroy();
+}
+
+EFG_TEST(bcEncoder, SolidBlocks)
+{
+    // Colors that fit the endpoints exactly come back exactly, in every format.
+    const uint8_t color[4] = { 255, 0, 132, 255 };
+    uint8_t texels[64];
+    for (int i = 0; i < 16; ++i)
+    {
+        for (int c = 0; c < 4; ++c)
+            texels[i * 4 + c] = color[c];
+    }
+    const EFG_BC_FORMAT formats[4] = { efgBC_1, efgBC_3, efgBC_5, efgBC_7 };
+    for (EFG_BC_FORMAT format : formats)
+    {
+        int channels = (format == efgBC_1) ? 3 : ((format == efgBC_5) ? 2 : 4);
+        uint8_t block[16] = {};
+        uint8_t decoded[64] = {};
+        efgCompressBlock(format, texels, block);
+        efgDecompressBlock(format, block, decoded);
+        int maxError = 0;
+        for (int i = 0; i < 16; ++i)
+        {
+            for (int c = 0; c < channels; ++c)
+                maxError = std::max(maxError, std::abs(int(decoded[i * 4 + c]) - int(texels[i * 4 + c])));
+        }
+        // 132 isn't a 6-bit green or 5-bit blue value, BC1 and BC3 round it.
+        EFG_CHECK(maxError <= ((format == efgBC_1 || format == efgBC_3) ? 4 : 1));
+    }
+}
+
+EFG_TEST(bcEncoder, OddSizedMips)
+{
+    std::vector<EfgImage> mips(1, MakeTestImage(13, 7));
+    efgGenerateMips(mips, false);
+    const uint32_t sizes[4][2] = { { 13, 7 }, { 6, 3 }, { 3, 1 }, { 1, 1 } };
+    EFG_CHECK(mips.size() == 4);
+    for (size_t m = 0; m < mips.size() && m < 4; ++m)
+    {
+        EFG_CHECK(mips[m].width == sizes[m][0] && mips[m].height == sizes[m][1]);
+        EFG_CHECK(mips[m].pixels.size() == size_t(sizes[m][0]) * sizes[m][1] * 4);
+    }
+    // Partial blocks still take a whole block.
+    EFG_CHECK(efgGetCompressedSize(efgBC_1, 13, 7) == 4 * 2 * 8);
+    EFG_CHECK(efgGetCompressedSize(efgBC_7, 3, 1) == 16);
+    EFG_CHECK(efgGetCompressedSize(efgBC_3, 1, 1) == 16);
+
+    // Blocks past the edge repeat the last row and column, the texels inside stay as
+    // accurate as in a whole image with the same content.
+    EfgThreadPool pool;
+    EfgImage image = MakeTestImage(128, 128);
+    const uint32_t crops[3][2] = { { 125, 61 }, { 13, 7 }, { 3, 1 } };
+    for (const auto& crop : crops)
+    {
+        for (EFG_BC_FORMAT format : { efgBC_1, efgBC_7 })
+            EFG_CHECK(CompressAndMeasure(format, Crop(image, crop[0], crop[1]), pool) >= 35.0);
+    }
+
+    // A 1xN chain only halves the long side.
+    std::vector<EfgImage> column(1, MakeTestImage(1, 5));
+    efgGenerateMips(column, false);
+    EFG_CHECK(column.size() == 3 && column[1].width == 1 && column[1].height == 2 && column[2].height == 1);
+}
+
+EFG_TEST(bcEncoder, Srgb)
+{
+    EFG_CHECK(efgGetDxgiFormat(efgBC_1, true) == 72 && efgGetDxgiFormat(efgBC_1, false) == 71);
+    EFG_CHECK(efgGetDxgiFormat(efgBC_3, true) == 78 && efgGetDxgiFormat(efgBC_3, false) == 77);
+    EFG_CHECK(efgGetDxgiFormat(efgBC_7, true) == 99 && efgGetDxgiFormat(efgBC_7, false) == 98);
+    EFG_CHECK(efgGetDxgiFormat(efgBC_5, true) == 83 && efgGetDxgiFormat(efgBC_5, false) == 83);
+
+    // Black and white texels average to half the light, which is 188 in sRGB and 128 in linear.
+    EfgImage checker;
+    checker.width = 2;
+    checker.height = 2;
+    checker.pixels = { 0, 0, 0, 0, 255, 255, 255, 255, 255, 255, 255, 255, 0, 0, 0, 0 };
+    std::vector<EfgImage> srgb(1, checker);
+    efgGenerateMips(srgb, true);
+    std::vector<EfgImage> linear(1, checker);
+    efgGenerateMips(linear, false);
+    EFG_CHECK(srgb.size() == 2 && linear.size() == 2);
+    for (int c = 0; c < 3; ++c)
+    {
+        EFG_CHECK(srgb[1].pixels[c] == 188);
+        EFG_CHECK(linear[1].pixels[c] == 128);
+    }
+    // Alpha is linear either way.
+    EFG_CHECK(srgb[1].pixels[3] == 128 && linear[1].pixels[3] == 128);
+
+    // Flat colors survive the round trip through linear space.
+    EfgImage flat;
+    flat.width = 4;
+    flat.height = 4;
+    for (int i = 0; i < 16; ++i)
+        flat.pixels.insert(flat.pixels.end(), { 10, 100, 200, 255 });
+    std::vector<EfgImage> flatMips(1, flat);
+    efgGenerateMips(flatMips, true);
+    for (const EfgImage& mip : flatMips)
+        EFG_CHECK(mip.pixels[0] == 10 && mip.pixels[1] == 100 && mip.pixels[2] == 200 && mip.pixels[3] == 255);
+}
+
+EFG_TEST(bcEncoder, Throughput)
+{
+    EfgThreadPool pool;
+    pool.Initialize(std::max(1u, std::thread::hardware_concurrency()));
+    EfgImage image = MakeTestImage(1024, 1024);
+    std::vector<uint8_t> compressed(efgGetCompressedSize(efgBC_7, image.width, image.height));
+    auto start = std::chrono::steady_clock::now();
+    efgCompressImage(efgBC_7, image, compressed.data(), pool);
+    efgTestReportTime("compress 1024x1024 to BC7", start);
+    pool.Destroy();
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+// Stand-in for the DirectXMath storage types the portable modules use, for platforms
+// without the Windows SDK. Only the types, none of the vector math.
+namespace DirectX
+{
+    struct XMFLOAT2
+    {
+        float x;
+        float y;
+
+        XMFLOAT2() = default;
+        constexpr XMFLOAT2(float _x, float _y) : x(_x), y(_y) {}
+        explicit XMFLOAT2(const float* array) : x(array[0]), y(array[1]) {}
+    };
+
+    struct XMFLOAT3
+    {
+        float x;
+        float y;
+        float z;
+
+        XMFLOAT3() = default;
+        constexpr XMFLOAT3(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
+        explicit XMFLOAT3(const float* array) : x(array[0]), y(array[1]), z(array[2]) {}
+    };
+
+    struct XMFLOAT4
+    {
+        float x;
+        float y;
+        float z;
+        float w;
+
+        XMFLOAT4() = default;
+        constexpr XMFLOAT4(float _x, float _y, float _z, float _w) : x(_x), y(_y), z(_z), w(_w) {}
+        explicit XMFLOAT4(const float* array) : x(array[0]), y(array[1]), z(array[2]), w(array[3]) {}
+    };
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <vector>
+
+// Minimal test registry for the portable engine modules. Tests register themselves
+// with EFG_TEST and report failed checks without stopping.
+struct EfgTestCase
+{
+    const char* group;
+    const char* name;
+    void (*function)();
+};
+
+std::vector<EfgTestCase>& efgGetTests();
+void efgTestFail(const char* file, int line, const char* expression);
+// An empty directory under the system temp directory, removed and created again per call.
+std::filesystem::path efgCreateTestDirectory(const char* name);
+// Prints label and the milliseconds since start. Timings are reported, never checked,
+// they depend on the machine.
+void efgTestReportTime(const char* label, std::chrono::steady_clock::time_point start);
+
+struct EfgTestRegistrar
+{
+    EfgTestRegistrar(const char* group, const char* name, void (*function)())
+    {
+        efgGetTests().push_back({ group, name, function });
+    }
+};
+
+#define EFG_TEST(group, name) \
+    static void group##_##name(); \
+    static EfgTestRegistrar group##_##name##_registrar(#group, #name, group##_##name); \
+    static void group##_##name()
+
+#define EFG_CHECK(expression) \
+    do { if (!(expression)) efgTestFail(__FILE__, __LINE__, #expression); } while (false)
@@ -0,0 +1,74 @@
+#include "efgTestMesh.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+EfgTestMesh efgMakeTestGrid(uint32_t size)
+{
+    EfgTestMesh mesh;
+    for (uint32_t y = 0; y <= size; ++y)
+    {
+        for (uint32_t x = 0; x <= size; ++x)
+        {
+            Vertex vertex;
+            vertex.position = DirectX::XMFLOAT3(float(x), float(y), 0.0f);
+            vertex.normal = DirectX::XMFLOAT3(0.0f, 0.0f, 1.0f);
+            vertex.uv = DirectX::XMFLOAT2(float(x) / size, float(y) / size);
+            mesh.vertices.push_back(vertex);
+        }
+    }
+    const uint32_t stride = size + 1;
+    for (uint32_t y = 0; y < size; ++y)
+    {
+        for (uint32_t x = 0; x < size; ++x)
+        {
+            uint32_t corner = y * stride + x;
+            const uint32_t quad[6] = { corner, corner + 1, corner + stride + 1, corner, corner + stride + 1, corner + stride };
+            mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+        }
+    }
+    return mesh;
+}
+
+EfgTestMesh efgMakeTestSphere(uint32_t rings, uint32_t segments)
+{
+    const float pi = 3.14159265358979f;
+    EfgTestMesh mesh;
+    for (uint32_t i = 0; i <= rings; ++i)
+    {
+        float latitude = float(i) * pi / rings - pi / 2.0f;
+        for (uint32_t j = 0; j <= segments; ++j)
+        {
+            float longitude = float(j) * 2.0f * pi / segments;
+            Vertex vertex;
+            vertex.position = DirectX::XMFLOAT3(std::cos(latitude) * std::sin(longitude), std::sin(latitude), std::cos(latitude) * std::cos(longitude));
+            vertex.normal = vertex.position;
+            vertex.uv = DirectX::XMFLOAT2(float(j) / segments, 1.0f - float(i) / rings);
+            mesh.vertices.push_back(vertex);
+        }
+    }
+    const uint32_t stride = segments + 1;
+    for (uint32_t i = 0; i < rings; ++i)
+    {
+        for (uint32_t j = 0; j < segments; ++j)
+        {
+            const uint32_t quad[6] = { i * stride + j, i * stride + j + 1, (i + 1) * stride + j,
+                i * stride + j + 1, (i + 1) * stride + j + 1, (i + 1) * stride + j };
+            mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+        }
+    }
+    return mesh;
+}
+
+void efgShuffleTestTriangles(std::vector<uint32_t>& indices, uint32_t seed)
+{
+    std::vector<uint32_t> order(indices.size() / 3);
+    for (uint32_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::shuffle(order.begin(), order.end(), std::mt19937(seed));
+    std::vector<uint32_t> shuffled;
+    shuffled.reserve(indices.size());
+    for (uint32_t triangle : order)
+        shuffled.insert(shuffled.end(), indices.begin() + triangle * 3, indices.begin() + triangle * 3 + 3);
+    indices.swap(shuffled);
+}
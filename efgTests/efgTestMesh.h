@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Shapes.h"
+
+// Meshes for the geometry tests, built here rather than by Shapes.cpp, which needs the
+// DirectXMath vector functions.
+struct EfgTestMesh
+{
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+};
+
+// size x size quads of the xy plane facing +z, triangles row by row.
+EfgTestMesh efgMakeTestGrid(uint32_t size);
+// UV sphere of radius 1 with a seam, triangles ring by ring like Shapes::SPHERE.
+EfgTestMesh efgMakeTestSphere(uint32_t rings, uint32_t segments);
+// Reorders the triangles, keeping the corners of each, the worst case for the vertex cache.
+void efgShuffleTestTriangles(std::vector<uint32_t>& indices, uint32_t seed);
@@ -0,0 +1,300 @@
+#include "efgTest.h"
+#include "efg_gltf.h"
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+namespace fs = std::filesystem;
+
+static void WriteBytes(const fs::path& path, const std::vector<uint8_t>& bytes)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+template<typename TYPE> static void Append(std::vector<uint8_t>& bytes, std::initializer_list<TYPE> values)
+{
+    for (TYPE value : values)
+    {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(&value);
+        bytes.insert(bytes.end(), p, p + sizeof(TYPE));
+    }
+    // Buffer views start on 4 bytes.
+    while (bytes.size() % 4 != 0)
+        bytes.push_back(0);
+}
+
+static std::string EncodeBase64(const std::vector<uint8_t>& bytes)
+{
+    static const char Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string text;
+    for (size_t i = 0; i < bytes.size(); i += 3)
+    {
+        uint32_t bits = uint32_t(bytes[i]) << 16;
+        bits |= (i + 1 < bytes.size()) ? uint32_t(bytes[i + 1]) << 8 : 0;
+        bits |= (i + 2 < bytes.size()) ? uint32_t(bytes[i + 2]) : 0;
+        text += Alphabet[(bits >> 18) & 63];
+        text += Alphabet[(bits >> 12) & 63];
+        text += (i + 1 < bytes.size()) ? Alphabet[(bits >> 6) & 63] : '=';
+        text += (i + 2 < bytes.size()) ? Alphabet[bits & 63] : '=';
+    }
+    return text;
+}
+
+// A quad with interleaved float vertices and 32-bit indices, and a triangle quantized by
+// KHR_mesh_quantization with 8-bit indices.
+static std::vector<uint8_t> MakeBin()
+{
+    std::vector<uint8_t> bin;
+    // View 0, 4 vertices of position, normal and texcoord, 32 bytes each.
+    for (int v = 0; v < 4; ++v)
+        Append<float>(bin, { float(v & 1), 0.0f, float(v >> 1), 0.0f, 1.0f, 0.0f, float(v & 1), float(v >> 1) });
+    // View 1 at 128.
+    Append<uint32_t>(bin, { 0, 2, 1, 1, 2, 3 });
+    // View 2 at 152, positions padded to 8 bytes.
+    Append<int16_t>(bin, { 32767, 0, -32767, 0, -32768, 16384, 0, 0, 0, 32767, 0, 0 });
+    // View 3 at 176, normals padded to 4 bytes.
+    Append<int8_t>(bin, { 127, 0, 0, 0, 0, -127, 0, 0, 0, 0, 127, 0 });
+    // View 4 at 188.
+    Append<uint16_t>(bin, { 0, 0, 65535, 0, 0, 65535 });
+    // View 5 at 200.
+    Append<uint8_t>(bin, { 0, 1, 2 });
+    return bin;
+}
+
+// Instance translations and scales, carried in a data URI.
+static std::vector<uint8_t> MakeInstanceBuffer()
+{
+    std::vector<uint8_t> bytes;
+    Append<float>(bytes, { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 3.0f, 0.0f, 0.0f, 6.0f });
+    Append<float>(bytes, { 0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f });
+    return bytes;
+}
+
+// A root node moved by 10 on x with two children, the quad scaled by 2 and three instances of
+// the quantized triangle under a matrix moving them by 5 on y. Node 3 is outside the scene.
+static std::string MakeJson(const std::string& binUri)
+{
+    std::string buffer0 = binUri.empty() ? "{\"byteLength\": 204}" : "{\"uri\": \"" + binUri + "\", \"byteLength\": 204}";
+    return std::string("{\"asset\": {\"version\": \"2.0\"},\n"
+        "\"extensionsUsed\": [\"KHR_mesh_quantization\", \"EXT_mesh_gpu_instancing\"],\n"
+        "\"extensionsRequired\": [\"KHR_mesh_quantization\", \"EXT_mesh_gpu_instancing\"],\n"
+        "\"buffers\": [") + buffer0 + ", {\"uri\": \"data:application/octet-stream;base64," + EncodeBase64(MakeInstanceBuffer()) + "\", \"byteLength\": 72}],\n"
+        "\"bufferViews\": [\n"
+        "  {\"buffer\": 0, \"byteOffset\": 0, \"byteLength\": 128, \"byteStride\": 32},\n"
+        "  {\"buffer\": 0, \"byteOffset\": 128, \"byteLength\": 24},\n"
+        "  {\"buffer\": 0, \"byteOffset\": 152, \"byteLength\": 24, \"byteStride\": 8},\n"
+        "  {\"buffer\": 0, \"byteOffset\": 176, \"byteLength\": 12, \"byteStride\": 4},\n"
+        "  {\"buffer\": 0, \"byteOffset\": 188, \"byteLength\": 12},\n"
+        "  {\"buffer\": 0, \"byteOffset\": 200, \"byteLength\": 3},\n"
+        "  {\"buffer\": 1, \"byteOffset\": 0, \"byteLength\": 36},\n"
+        "  {\"buffer\": 1, \"byteOffset\": 36, \"byteLength\": 36}],\n"
+        "\"accessors\": [\n"
+        "  {\"bufferView\": 0, \"componentType\": 5126, \"count\": 4, \"type\": \"VEC3\", \"min\": [0, 0, 0], \"max\": [1, 0, 1]},\n"
+        "  {\"bufferView\": 0, \"byteOffset\": 12, \"componentType\": 5126, \"count\": 4, \"type\": \"VEC3\"},\n"
+        "  {\"bufferView\": 0, \"byteOffset\": 24, \"componentType\": 5126, \"count\": 4, \"type\": \"VEC2\"},\n"
+        "  {\"bufferView\": 1, \"componentType\": 5125, \"count\": 6, \"type\": \"SCALAR\"},\n"
+        "  {\"bufferView\": 2, \"componentType\": 5122, \"normalized\": true, \"count\": 3, \"type\": \"VEC3\"},\n"
+        "  {\"bufferView\": 3, \"componentType\": 5120, \"normalized\": true, \"count\": 3, \"type\": \"VEC3\"},\n"
+        "  {\"bufferView\": 4, \"componentType\": 5123, \"normalized\": true, \"count\": 3, \"type\": \"VEC2\"},\n"
+        "  {\"bufferView\": 5, \"componentType\": 5121, \"count\": 3, \"type\": \"SCALAR\"},\n"
+        "  {\"bufferView\": 6, \"componentType\": 5126, \"count\": 3, \"type\": \"VEC3\"},\n"
+        "  {\"bufferView\": 7, \"componentType\": 5126, \"count\": 3, \"type\": \"VEC3\"}],\n"
+        "\"images\": [{\"uri\": \"data:image/png;base64,iVBORw0KGgo=\", \"mimeType\": \"image/png\"}],\n"
+        "\"textures\": [{\"source\": 0}],\n"
+        "\"materials\": [{\"name\": \"grass\", \"pbrMetallicRoughness\": {\"baseColorFactor\": [0.5, 0.25, 1, 1], \"metallicFactor\": 0,\n"
+        "  \"baseColorTexture\": {\"index\": 0}}}],\n"
+        "\"meshes\": [\n"
+        "  {\"name\": \"quad\", \"primitives\": [{\"attributes\": {\"POSITION\": 0, \"NORMAL\": 1, \"TEXCOORD_0\": 2}, \"indices\": 3, \"material\": 0},\n"
+        "    {\"attributes\": {\"POSITION\": 0}, \"mode\": 1}]},\n"
+        "  {\"name\": \"quantized\", \"primitives\": [{\"attributes\": {\"POSITION\": 4, \"NORMAL\": 5, \"TEXCOORD_0\": 6}, \"indices\": 7}]}],\n"
+        "\"nodes\": [\n"
+        "  {\"name\": \"root\", \"translation\": [10, 0, 0], \"children\": [1, 2]},\n"
+        "  {\"mesh\": 0, \"scale\": [2, 2, 2]},\n"
+        "  {\"mesh\": 1, \"matrix\": [1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 5, 0, 1],\n"
+        "    \"extensions\": {\"EXT_mesh_gpu_instancing\": {\"attributes\": {\"TRANSLATION\": 8, \"SCALE\": 9}}}},\n"
+        "  {\"mesh\": 0}],\n"
+        "\"scenes\": [{\"nodes\": [0]}],\n"
+        "\"scene\": 0}\n";
+}
+
+static std::vector<uint8_t> MakeGlb(const std::string& json, const std::vector<uint8_t>& bin)
+{
+    std::string paddedJson = json;
+    while (paddedJson.size() % 4 != 0)
+        paddedJson.push_back(' ');
+    std::vector<uint8_t> glb;
+    uint32_t length = static_cast<uint32_t>(12 + 8 + paddedJson.size() + 8 + bin.size());
+    Append<uint32_t>(glb, { 0x46546C67, 2, length, static_cast<uint32_t>(paddedJson.size()), 0x4E4F534A });
+    glb.insert(glb.end(), paddedJson.begin(), paddedJson.end());
+    Append<uint32_t>(glb, { static_cast<uint32_t>(bin.size()), 0x004E4942 });
+    glb.insert(glb.end(), bin.begin(), bin.end());
+    return glb;
+}
+
+static bool IsTranslation(const float* transform, float scale, float x, float y, float z)
+{
+    const float expected[16] = { scale, 0, 0, 0, 0, scale, 0, 0, 0, 0, scale, 0, x, y, z, 1 };
+    for (int i = 0; i < 16; ++i)
+    {
+        if (std::fabs(transform[i] - expected[i]) > 1e-5f)
+            return false;
+    }
+    return true;
+}
+
+static void CheckScene(const EfgGltfScene& scene)
+{
+    EFG_CHECK(scene.meshes.size() == 2 && scene.skippedPrimitives == 1);
+    if (scene.meshes.size() != 2)
+        return;
+
+    // The quad uploads as it is.
+    const EfgGltfMesh& quad = scene.meshes[0];
+    EFG_CHECK(quad.name == "quad" && quad.primitives.size() == 1);
+    const EfgGltfPrimitive& quadPrimitive = quad.primitives[0];
+    EFG_CHECK(quadPrimitive.material == 0 && quadPrimitive.positions.count == 4 && quadPrimitive.positions.hasBounds);
+    EFG_CHECK(quadPrimitive.positions.max[0] == 1.0f && quadPrimitive.positions.max[2] == 1.0f);
+    EFG_CHECK(efgGetGltfInterleavedVertices(quadPrimitive, 32, 12, 24) == quadPrimitive.positions.data);
+    EFG_CHECK(efgGetGltfInterleavedVertices(quadPrimitive, 32, 12, 28) == nullptr);
+    const uint32_t* indices = efgGetGltfIndices32(quadPrimitive);
+    EFG_CHECK(indices != nullptr && quadPrimitive.indices.count == 6 && indices[5] == 3);
+    EFG_CHECK(efgReadGltfFloat(quadPrimitive.texcoords, 3, 1) == 1.0f && efgReadGltfFloat(quadPrimitive.normals, 2, 1) == 1.0f);
+
+    // Quantized attributes read back normalized, the missing bounds are computed.
+    const EfgGltfPrimitive& quantized = scene.meshes[1].primitives[0];
+    EFG_CHECK(quantized.positions.componentType == efgGltfComponent_SHORT && quantized.positions.stride == 8);
+    EFG_CHECK(efgReadGltfFloat(quantized.positions, 0, 0) == 1.0f && efgReadGltfFloat(quantized.positions, 0, 2) == -1.0f);
+    EFG_CHECK(efgReadGltfFloat(quantized.positions, 1, 0) == -1.0f && std::fabs(efgReadGltfFloat(quantized.positions, 1, 1) - 0.5f) < 1e-4f);
+    EFG_CHECK(quantized.positions.hasBounds && quantized.positions.min[0] == -1.0f && quantized.positions.max[1] == 1.0f);
+    EFG_CHECK(efgReadGltfFloat(quantized.normals, 1, 1) == -1.0f && efgReadGltfFloat(quantized.normals, 2, 2) == 1.0f);
+    EFG_CHECK(efgReadGltfFloat(quantized.texcoords, 1, 0) == 1.0f && efgReadGltfFloat(quantized.texcoords, 2, 1) == 1.0f);
+    EFG_CHECK(efgGetGltfInterleavedVertices(quantized, 8, 0, 0) == nullptr && efgGetGltfIndices32(quantized) == nullptr);
+    EFG_CHECK(efgReadGltfIndex(quantized.indices, 2) == 2);
+
+    EFG_CHECK(scene.materials.size() == 1 && scene.materials[0].name == "grass" && scene.materials[0].baseColor[1] == 0.25f);
+    EFG_CHECK(scene.materials.size() == 1 && scene.materials[0].metallic == 0.0f && scene.materials[0].roughness == 1.0f);
+    EFG_CHECK(scene.materials.size() == 1 && scene.materials[0].baseColorImage == 0);
+    EFG_CHECK(scene.images.size() == 1 && scene.images[0].mimeType == "image/png" && scene.images[0].path.empty());
+    EFG_CHECK(scene.images.size() == 1 && scene.images[0].size == 8 && memcmp(scene.images[0].data, "\x89PNG\r\n\x1A\n", 8) == 0);
+
+    // Parents apply after children, instances in the space of their node.
+    EFG_CHECK(scene.instances.size() == 4);
+    if (scene.instances.size() == 4)
+    {
+        EFG_CHECK(scene.instances[0].mesh == 0 && IsTranslation(scene.instances[0].transform, 2.0f, 10.0f, 0.0f, 0.0f));
+        for (uint32_t i = 0; i < 3; ++i)
+            EFG_CHECK(scene.instances[1 + i].mesh == 1 && IsTranslation(scene.instances[1 + i].transform, 0.5f, 10.0f, 5.0f, 3.0f * i));
+    }
+}
+
+EFG_TEST(gltf, Glb)
+{
+    fs::path directory = efgCreateTestDirectory("gltf");
+    WriteBytes(directory / "scene.glb", MakeGlb(MakeJson(""), MakeBin()));
+    EfgVfs vfs;
+    EfgGltfScene scene;
+    std::string error;
+    EFG_CHECK(efgParseGltf(directory / "scene.glb", vfs, scene, error));
+    CheckScene(scene);
+}
+
+EFG_TEST(gltf, ExternalBuffer)
+{
+    // A .gltf with its buffer next to it, under an escaped name.
+    fs::path directory = efgCreateTestDirectory("gltf");
+    WriteBytes(directory / "my scene.bin", MakeBin());
+    std::string json = MakeJson("my%20scene.bin");
+    WriteBytes(directory / "scene.gltf", std::vector<uint8_t>(json.begin(), json.end()));
+    EfgVfs vfs;
+    EfgGltfScene scene;
+    std::string error;
+    EFG_CHECK(efgParseGltf(directory / "scene.gltf", vfs, scene, error));
+    CheckScene(scene);
+    EFG_CHECK(scene.bufferFiles.size() == 1 && scene.dataUris.size() == 2);
+
+    fs::remove(directory / "my scene.bin");
+    EFG_CHECK(!efgParseGltf(directory / "scene.gltf", vfs, scene, error) && error.find("could not open") != std::string::npos);
+    EFG_CHECK(!efgParseGltf(directory / "missing.gltf", vfs, scene, error));
+}
+
+EFG_TEST(gltf, Truncated)
+{
+    fs::path directory = efgCreateTestDirectory("gltf");
+    fs::path path = directory / "truncated.glb";
+    const std::vector<uint8_t> glb = MakeGlb(MakeJson(""), MakeBin());
+    EfgVfs vfs;
+    EfgGltfScene scene;
+    std::string error;
+    // Cut anywhere, with the header's length left alone or matching the cut.
+    bool truncatedFails = true;
+    for (size_t size = 0; size < glb.size(); size += 5)
+    {
+        std::vector<uint8_t> truncated(glb.begin(), glb.begin() + size);
+        WriteBytes(path, truncated);
+        truncatedFails &= !efgParseGltf(path, vfs, scene, error) && !error.empty();
+        if (size >= 12)
+        {
+            uint32_t length = static_cast<uint32_t>(size);
+            memcpy(&truncated[8], &length, sizeof(length));
+            WriteBytes(path, truncated);
+            truncatedFails &= !efgParseGltf(path, vfs, scene, error) && !error.empty();
+        }
+    }
+    EFG_CHECK(truncatedFails);
+}
+
+EFG_TEST(gltf, Corrupt)
+{
+    fs::path directory = efgCreateTestDirectory("gltf");
+    fs::path path = directory / "corrupt.glb";
+    const std::string json = MakeJson("");
+    EfgVfs vfs;
+    auto fails = [&](const std::string& from, const std::string& to, const char* message) {
+        std::string corrupt = json;
+        size_t at = corrupt.find(from);
+        EFG_CHECK(at != std::string::npos);
+        corrupt.replace(at, from.size(), to);
+        WriteBytes(path, MakeGlb(corrupt, MakeBin()));
+        EfgGltfScene scene;
+        std::string error;
+        bool parsed = efgParseGltf(path, vfs, scene, error);
+        if (!parsed && error.find(message) == std::string::npos)
+            printf("       unexpected error: %s\n", error.c_str());
+        return !parsed && error.find(message) != std::string::npos;
+    };
+
+    EFG_CHECK(fails("\"version\": \"2.0\"", "\"version\": \"1.0\"", "only glTF 2.0"));
+    EFG_CHECK(fails("\"extensionsRequired\": [", "\"extensionsRequired\": [\"KHR_draco_mesh_compression\", ", "unsupported extension"));
+    EFG_CHECK(fails("\"scene\": 0}", "\"scene\": 0", "unterminated object"));
+    EFG_CHECK(fails("base64,iVBORw0KGgo=", "base64,iVBOR!w0KGgo=", "invalid base64"));
+    EFG_CHECK(fails(";base64,iVBORw0KGgo=", ",iVBORw0KGgo=", "must be base64"));
+    EFG_CHECK(fails("\"byteLength\": 72}", "\"byteLength\": 80}", "shorter than its byteLength"));
+    EFG_CHECK(fails("\"byteOffset\": 200, \"byteLength\": 3}", "\"byteOffset\": 200, \"byteLength\": 8}", "out of its buffer"));
+    EFG_CHECK(fails("{\"bufferView\": 0, \"componentType\": 5126, \"count\": 4", "{\"bufferView\": 0, \"componentType\": 5126, \"count\": 5",
+        "out of its buffer view"));
+    EFG_CHECK(fails("\"byteLength\": 24, \"byteStride\": 8}", "\"byteLength\": 24, \"byteStride\": 4}", "overlaps itself"));
+    EFG_CHECK(fails("\"componentType\": 5121, \"count\": 3", "\"componentType\": 5121, \"count\": 2", "three per triangle"));
+    EFG_CHECK(fails("\"type\": \"VEC2\"},\n  {\"bufferView\": 5", "\"type\": \"VEC2\"},\n  {\"sparse\": {}, \"bufferView\": 5", "sparse"));
+    EFG_CHECK(fails("\"indices\": 3, \"material\": 0", "\"indices\": 3, \"material\": 1", "invalid material"));
+    EFG_CHECK(fails("{\"mesh\": 0, \"scale\"", "{\"mesh\": 7, \"scale\"", "invalid mesh"));
+    EFG_CHECK(fails("\"TRANSLATION\": 8, \"SCALE\": 9", "\"TRANSLATION\": 8, \"SCALE\": 0", "EXT_mesh_gpu_instancing"));
+    // A cycle and a child that doesn't exist. Nodes outside the scene aren't visited.
+    EFG_CHECK(fails("\"children\": [1, 2]", "\"children\": [1, 2, 0]", "invalid node hierarchy"));
+    EFG_CHECK(!fails("{\"mesh\": 0}]", "{\"mesh\": 0, \"children\": [3]}]", ""));
+    EFG_CHECK(fails("\"children\": [1, 2]", "\"children\": [1, 9]", "invalid node hierarchy"));
+
+    // An index past the vertices, in the binary chunk.
+    std::vector<uint8_t> bin = MakeBin();
+    bin[202] = 3;
+    WriteBytes(path, MakeGlb(json, bin));
+    EfgGltfScene scene;
+    std::string error;
+    EFG_CHECK(!efgParseGltf(path, vfs, scene, error) && error.find("index out of range") != std::string::npos);
+    // Not a GLB version this reads.
+    std::vector<uint8_t> glb = MakeGlb(json, MakeBin());
+    glb[4] = 1;
+    WriteBytes(path, glb);
+    EFG_CHECK(!efgParseGltf(path, vfs, scene, error) && error.find("GLB header") != std::string::npos);
+}
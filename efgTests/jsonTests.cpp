@@ -0,0 +1,103 @@
+#include "efgTest.h"
+#include "efg_json.h"
+#include <cstring>
+#include <string>
+
+static bool Parse(const std::string& text, EfgJsonValue& root)
+{
+    std::string error;
+    return efgParseJson(text.data(), text.size(), root, error);
+}
+
+static bool Fails(const std::string& text)
+{
+    EfgJsonValue root;
+    std::string error;
+    return !efgParseJson(text.data(), text.size(), root, error) && !error.empty();
+}
+
+EFG_TEST(json, Values)
+{
+    EfgJsonValue root;
+    const char* text = "\xEF\xBB\xBF { \"asset\": { \"version\": \"2.0\" }, \"count\": 3, \"scale\": [1.5, -2e2, 0],\n"
+        "\t\"flag\": true, \"off\": false, \"none\": null, \"empty\": {}, \"list\": [] }\r\n";
+    EFG_CHECK(Parse(text, root));
+    EFG_CHECK(root.GetType() == efgJson_OBJECT && root.GetSize() == 8 && root.GetKey(1) == "count");
+    EFG_CHECK(root["asset"]["version"].GetString() == "2.0");
+    EFG_CHECK(root["count"].GetInt() == 3 && root["count"].GetNumber() == 3.0);
+    EFG_CHECK(root["flag"].GetBool() && !root["off"].GetBool(true));
+    EFG_CHECK(root["none"].IsNull() && root["empty"].GetType() == efgJson_OBJECT && root["list"].GetType() == efgJson_ARRAY);
+
+    float scale[4] = { 9.0f, 9.0f, 9.0f, 9.0f };
+    root["scale"].GetFloats(scale, 4);
+    // Values past the end of the array keep what they had.
+    EFG_CHECK(scale[0] == 1.5f && scale[1] == -200.0f && scale[2] == 0.0f && scale[3] == 9.0f);
+
+    // Misses at any depth read as null, and as the fallback.
+    EFG_CHECK(root["missing"]["deeper"][3].IsNull());
+    EFG_CHECK(root["scale"][7].GetFloat(4.0f) == 4.0f && root["asset"][size_t(0)].IsNull() && root["count"]["x"].IsNull());
+    EFG_CHECK(root["asset"].GetInt() == -1 && root["asset"]["version"].GetNumber(2.5) == 2.5);
+}
+
+EFG_TEST(json, Numbers)
+{
+    EfgJsonValue root;
+    EFG_CHECK(Parse("[0, -0.5, 1e3, 2.5E-2, 4294967296, -2147483648, 2147483648]", root));
+    EFG_CHECK(root[size_t(0)].GetNumber(1.0) == 0.0 && root[1].GetNumber() == -0.5 && root[2].GetNumber() == 1000.0);
+    EFG_CHECK(root[3].GetNumber() == 0.025);
+    // Integers outside int32 take the fallback instead of wrapping.
+    EFG_CHECK(root[4].GetInt() == -1 && root[5].GetInt() == INT32_MIN && root[6].GetInt(7) == 7);
+    EFG_CHECK(Fails("[+1]") && Fails("[.5]") && Fails("[-]") && Fails("[0x10]") && Fails("[inf]") && Fails("[1e999]"));
+}
+
+EFG_TEST(json, Strings)
+{
+    EfgJsonValue root;
+    EFG_CHECK(Parse("[\"plain\", \"a\\\"b\\\\c\\/d\\n\\t\", \"\\u00e9\\u20AC\", \"\\ud83d\\ude00\", \"\xC3\xA9\"]", root));
+    EFG_CHECK(root[size_t(0)].GetString() == "plain");
+    EFG_CHECK(root[1].GetString() == "a\"b\\c/d\n\t");
+    EFG_CHECK(root[2].GetString() == "\xC3\xA9\xE2\x82\xAC");
+    // A surrogate pair becomes one four byte character.
+    EFG_CHECK(root[3].GetString() == "\xF0\x9F\x98\x80");
+    EFG_CHECK(root[4].GetString() == "\xC3\xA9");
+
+    EFG_CHECK(Fails("[\"open]"));
+    EFG_CHECK(Fails("[\"tab\there\"]"));
+    EFG_CHECK(Fails("[\"\\x41\"]"));
+    EFG_CHECK(Fails("[\"\\u12\"]") && Fails("[\"\\u12G4\"]"));
+    EFG_CHECK(Fails("[\"\\ud83d\"]") && Fails("[\"\\ude00\"]") && Fails("[\"\\ud83d\\u0041\"]"));
+}
+
+EFG_TEST(json, Malformed)
+{
+    EFG_CHECK(Fails(""));
+    EFG_CHECK(Fails("   "));
+    EFG_CHECK(Fails("{"));
+    EFG_CHECK(Fails("{\"a\" 1}"));
+    EFG_CHECK(Fails("{\"a\": 1,}"));
+    EFG_CHECK(Fails("{a: 1}"));
+    EFG_CHECK(Fails("[1, 2"));
+    EFG_CHECK(Fails("[1 2]"));
+    EFG_CHECK(Fails("[tru]") && Fails("[nul]") && Fails("[False]"));
+    EFG_CHECK(Fails("{} {}"));
+    // The error names the offset.
+    EfgJsonValue root;
+    std::string error;
+    EFG_CHECK(!efgParseJson("[1, x]", 6, root, error) && error.find("offset 4") != std::string::npos);
+
+    // Deep nesting is rejected instead of overflowing the stack.
+    EFG_CHECK(Fails(std::string(100000, '[')));
+    std::string deep = std::string(200, '[') + std::string(200, ']');
+    EFG_CHECK(Parse(deep, root));
+
+    // Every truncation of a valid document fails, and none reads past the end.
+    const std::string document = "{\"nodes\": [{\"name\": \"a\\u00e9\", \"matrix\": [1, 0, -2.5e1]}], \"scene\": 0}";
+    EFG_CHECK(Parse(document, root));
+    bool truncatedFails = true;
+    for (size_t size = 0; size < document.size(); ++size)
+    {
+        std::string truncated = document.substr(0, size);
+        truncatedFails &= !efgParseJson(truncated.data(), truncated.size(), root, error);
+    }
+    EFG_CHECK(truncatedFails);
+}
@@ -0,0 +1,141 @@
+#include "efgTest.h"
+#include "efg_lz4.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static std::vector<uint8_t> MakeRandom(size_t size, uint32_t seed)
+{
+    std::vector<uint8_t> data(size);
+    for (uint8_t& byte : data)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        byte = static_cast<uint8_t>(seed >> 24);
+    }
+    return data;
+}
+
+// Text with repeats near and far, like OBJ or JSON files.
+static std::vector<uint8_t> MakeText(size_t size)
+{
+    std::string text;
+    for (uint32_t line = 0; text.size() < size; ++line)
+        text += "v " + std::to_string(line % 97) + ".5 " + std::to_string(line % 13) + ".25 -1.0\n";
+    text.resize(size);
+    return std::vector<uint8_t>(text.begin(), text.end());
+}
+
+static std::vector<uint8_t> Compress(const std::vector<uint8_t>& data)
+{
+    std::vector<uint8_t> compressed(efgLz4CompressBound(data.size()));
+    compressed.resize(efgLz4Compress(data.data(), data.size(), compressed.data(), compressed.size()));
+    return compressed;
+}
+
+static bool RoundTrips(const std::vector<uint8_t>& data)
+{
+    std::vector<uint8_t> compressed = Compress(data);
+    if (compressed.empty())
+        return false;
+    std::vector<uint8_t> decompressed(data.size() + 1, 0xCD);
+    return efgLz4Decompress(compressed.data(), compressed.size(), decompressed.data(), data.size()) &&
+        std::equal(data.begin(), data.end(), decompressed.begin()) && decompressed[data.size()] == 0xCD;
+}
+
+EFG_TEST(lz4, RoundTrip)
+{
+    EFG_CHECK(RoundTrips({}));
+    EFG_CHECK(RoundTrips({ 42 }));
+    // Shorter than the literals every block ends with, and just past the match limits.
+    for (size_t size : { 5, 12, 13, 17, 64 })
+        EFG_CHECK(RoundTrips(std::vector<uint8_t>(size, 7)));
+    EFG_CHECK(RoundTrips(std::vector<uint8_t>(1 << 20, 0)));
+    EFG_CHECK(RoundTrips(MakeRandom(100000, 1)));
+    EFG_CHECK(RoundTrips(MakeText(300000)));
+    // Matches further back than the 64 KB window.
+    std::vector<uint8_t> distant = MakeRandom(70000, 2);
+    std::vector<uint8_t> repeat = MakeRandom(1000, 3);
+    distant.insert(distant.begin(), repeat.begin(), repeat.end());
+    distant.insert(distant.end(), repeat.begin(), repeat.end());
+    EFG_CHECK(RoundTrips(distant));
+}
+
+EFG_TEST(lz4, Ratio)
+{
+    std::vector<uint8_t> text = MakeText(300000);
+    EFG_CHECK(Compress(text).size() < text.size() / 3);
+    std::vector<uint8_t> zeros(1 << 20, 0);
+    EFG_CHECK(Compress(zeros).size() < 8192);
+    // Incompressible data grows by at most the bound, and the bound is needed.
+    std::vector<uint8_t> random = MakeRandom(100000, 4);
+    std::vector<uint8_t> compressed = Compress(random);
+    EFG_CHECK(compressed.size() > random.size() && compressed.size() <= efgLz4CompressBound(random.size()));
+    std::vector<uint8_t> small(random.size());
+    EFG_CHECK(efgLz4Compress(random.data(), random.size(), small.data(), small.size()) == 0);
+}
+
+EFG_TEST(lz4, ReferenceBlock)
+{
+    // Written by hand to the block format: one literal, a match of 8 at offset 1 that
+    // overlaps its own output, then the 5 closing literals.
+    const uint8_t block[] = { 0x14, 'a', 0x01, 0x00, 0x50, 'a', 'a', 'a', 'b', 'c' };
+    uint8_t decompressed[14] = {};
+    EFG_CHECK(efgLz4Decompress(block, sizeof(block), decompressed, sizeof(decompressed)));
+    EFG_CHECK(memcmp(decompressed, "aaaaaaaaaaaabc", sizeof(decompressed)) == 0);
+}
+
+EFG_TEST(lz4, CorruptInput)
+{
+    std::vector<uint8_t> text = MakeText(20000);
+    std::vector<uint8_t> compressed = Compress(text);
+    std::vector<uint8_t> decompressed(text.size());
+
+    // Wrong sizes either way.
+    EFG_CHECK(!efgLz4Decompress(compressed.data(), compressed.size(), decompressed.data(), text.size() - 1));
+    decompressed.resize(text.size() + 1);
+    EFG_CHECK(!efgLz4Decompress(compressed.data(), compressed.size(), decompressed.data(), text.size() + 1));
+
+    // Every truncation fails.
+    bool truncatedFails = true;
+    for (size_t size = 0; size < compressed.size(); size += 7)
+        truncatedFails &= !efgLz4Decompress(compressed.data(), size, decompressed.data(), text.size());
+    EFG_CHECK(truncatedFails);
+
+    // A match reaching back before the start of the output.
+    const uint8_t before[] = { 0x14, 'a', 0x02, 0x00, 0x50, 'a', 'a', 'a', 'a', 'a' };
+    uint8_t small[14];
+    EFG_CHECK(!efgLz4Decompress(before, sizeof(before), small, sizeof(small)));
+    // Offset 0 is never valid.
+    const uint8_t zeroOffset[] = { 0x14, 'a', 0x00, 0x00, 0x50, 'a', 'a', 'a', 'a', 'a' };
+    EFG_CHECK(!efgLz4Decompress(zeroOffset, sizeof(zeroOffset), small, sizeof(small)));
+    // A literal length running past the input.
+    const uint8_t longLiterals[] = { 0xF0, 0xFF, 0xFF, 0x10, 'a' };
+    EFG_CHECK(!efgLz4Decompress(longLiterals, sizeof(longLiterals), small, sizeof(small)));
+
+    // Random damage may decode to garbage, but stays inside the buffers.
+    uint32_t seed = 5;
+    for (int i = 0; i < 200; ++i)
+    {
+        std::vector<uint8_t> damaged = compressed;
+        for (int b = 0; b < 4; ++b)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            damaged[(seed >> 8) % damaged.size()] ^= static_cast<uint8_t>(seed >> 24) | 1;
+        }
+        efgLz4Decompress(damaged.data(), damaged.size(), decompressed.data(), text.size());
+    }
+}
+
+EFG_TEST(lz4, Throughput)
+{
+    std::vector<uint8_t> text = MakeText(16 << 20);
+    std::vector<uint8_t> compressed(efgLz4CompressBound(text.size()));
+    auto start = std::chrono::steady_clock::now();
+    compressed.resize(efgLz4Compress(text.data(), text.size(), compressed.data(), compressed.size()));
+    efgTestReportTime("compress 16 MB of text", start);
+    std::vector<uint8_t> decompressed(text.size());
+    start = std::chrono::steady_clock::now();
+    EFG_CHECK(efgLz4Decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size()));
+    efgTestReportTime("decompress 16 MB of text", start);
+}
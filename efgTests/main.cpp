@@ -0,0 +1,70 @@
+// Tests of the engine modules that are free of D3D, runnable on any platform.
+//
+// efgTests [group...]
+//
+// Runs every test, or only those of the given groups. Built by the CMake project at
+// the root, each group is its own ctest test.
+
+#include "efgTest.h"
+#include <cstring>
+#include <iostream>
+#include <string>
+
+static int g_failedChecks = 0;
+
+std::vector<EfgTestCase>& efgGetTests()
+{
+    static std::vector<EfgTestCase> tests;
+    return tests;
+}
+
+void efgTestFail(const char* file, int line, const char* expression)
+{
+    std::cerr << file << ":" << line << ": check failed: " << expression << std::endl;
+    g_failedChecks++;
+}
+
+std::filesystem::path efgCreateTestDirectory(const char* name)
+{
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / (std::string("efgTests_") + name);
+    std::error_code error;
+    std::filesystem::remove_all(directory, error);
+    std::filesystem::create_directories(directory);
+    return directory;
+}
+
+void efgTestReportTime(const char* label, std::chrono::steady_clock::time_point start)
+{
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "       " << label << ": " << elapsed.count() << " ms" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    int run = 0;
+    int failed = 0;
+    for (const EfgTestCase& test : efgGetTests())
+    {
+        bool selected = (argc < 2);
+        for (int i = 1; i < argc; ++i)
+            selected = selected || strcmp(argv[i], test.group) == 0;
+        if (!selected)
+            continue;
+        int failedBefore = g_failedChecks;
+        try
+        {
+            test.function();
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "exception: " << e.what() << std::endl;
+            g_failedChecks++;
+        }
+        bool passed = (g_failedChecks == failedBefore);
+        std::cout << (passed ? "[ ok ] " : "[FAIL] ") << test.group << "." << test.name << std::endl;
+        run++;
+        failed += passed ? 0 : 1;
+    }
+    std::cout << run - failed << " of " << run << " tests passed" << std::endl;
+    return (run == 0 || failed > 0) ? 1 : 0;
+}
@@ -0,0 +1,114 @@
+#include "efgTest.h"
+#include "efgTestMesh.h"
+#include "efg_meshOptimizer.h"
+#include <algorithm>
+#include <array>
+
+// The triangles of a mesh as sorted position triples, equal when two meshes draw the
+// same triangles in any order and with any vertex numbering.
+static std::vector<std::array<float, 9>> GetTriangles(const EfgTestMesh& mesh)
+{
+    std::vector<std::array<float, 9>> triangles;
+    for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3)
+    {
+        std::array<std::array<float, 3>, 3> corners;
+        for (int c = 0; c < 3; ++c)
+        {
+            const Vertex& vertex = mesh.vertices[mesh.indices[t + c]];
+            corners[c] = { vertex.position.x, vertex.position.y, vertex.position.z };
+        }
+        // Rotated to start at the smallest corner, the winding stays.
+        size_t first = std::min_element(corners.begin(), corners.end()) - corners.begin();
+        std::array<float, 9> triangle;
+        for (int c = 0; c < 3; ++c)
+            std::copy(corners[(first + c) % 3].begin(), corners[(first + c) % 3].end(), triangle.begin() + c * 3);
+        triangles.push_back(triangle);
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+static bool IsOrderedByFirstUse(const EfgTestMesh& mesh)
+{
+    uint32_t next = 0;
+    for (uint32_t index : mesh.indices)
+    {
+        if (index > next)
+            return false;
+        next = std::max(next, index + 1);
+    }
+    return next == mesh.vertices.size();
+}
+
+EFG_TEST(meshOptimizer, AnalyzeVertexCache)
+{
+    const uint32_t triangle[3] = { 0, 1, 2 };
+    EfgVertexCacheStats single = efgAnalyzeVertexCache(triangle, 3, 3);
+    EFG_CHECK(single.transformCount == 3 && single.acmr == 3.0f && single.atvr == 1.0f);
+
+    // A strip of quads only transforms each vertex once.
+    EfgTestMesh strip = efgMakeTestGrid(1);
+    EfgVertexCacheStats stats = efgAnalyzeVertexCache(strip.indices.data(), strip.indices.size(), strip.vertices.size());
+    EFG_CHECK(stats.triangleCount == 2 && stats.vertexCount == 4 && stats.transformCount == 4);
+
+    // A cache of one transforms every corner that isn't a repeat of the previous one.
+    const uint32_t repeats[6] = { 0, 1, 2, 2, 1, 0 };
+    EFG_CHECK(efgAnalyzeVertexCache(repeats, 6, 3, 1).transformCount == 5);
+}
+
+EFG_TEST(meshOptimizer, ShuffledGridImproves)
+{
+    EfgTestMesh mesh = efgMakeTestGrid(64);
+    efgShuffleTestTriangles(mesh.indices, 1);
+    std::vector<std::array<float, 9>> triangles = GetTriangles(mesh);
+
+    EfgMeshOptimizeStats stats = efgOptimizeMesh(mesh.vertices, mesh.indices);
+    EFG_CHECK(stats.after.acmr < stats.before.acmr * 0.5f);
+    EFG_CHECK(stats.after.acmr < 0.8f);
+    EFG_CHECK(stats.after.atvr <= stats.before.atvr && stats.after.atvr < 1.6f);
+    EFG_CHECK(GetTriangles(mesh) == triangles);
+    EFG_CHECK(IsOrderedByFirstUse(mesh));
+}
+
+EFG_TEST(meshOptimizer, SourceOrderDoesNotRegress)
+{
+    // Ring by ring is already fair, Tipsify and the overdraw pass must not undo that.
+    const EfgTestMesh meshes[] = { efgMakeTestSphere(20, 40), efgMakeTestGrid(100), efgMakeTestGrid(3) };
+    for (EfgTestMesh mesh : meshes)
+    {
+        std::vector<std::array<float, 9>> triangles = GetTriangles(mesh);
+        EfgMeshOptimizeStats stats = efgOptimizeMesh(mesh.vertices, mesh.indices);
+        EFG_CHECK(stats.after.acmr <= stats.before.acmr);
+        EFG_CHECK(stats.after.atvr <= stats.before.atvr);
+        EFG_CHECK(stats.after.triangleCount == stats.before.triangleCount);
+        EFG_CHECK(GetTriangles(mesh) == triangles);
+        EFG_CHECK(IsOrderedByFirstUse(mesh));
+    }
+}
+
+EFG_TEST(meshOptimizer, VertexFetchDropsUnused)
+{
+    EfgTestMesh mesh = efgMakeTestGrid(4);
+    // The first row of quads only, the rest of the vertices are unused.
+    mesh.indices.resize(4 * 6);
+    std::reverse(mesh.indices.begin(), mesh.indices.end());
+    std::vector<std::array<float, 9>> triangles = GetTriangles(mesh);
+
+    std::vector<Vertex> fetched(mesh.vertices.size());
+    size_t vertexCount = efgOptimizeVertexFetch(fetched.data(), mesh.indices.data(), mesh.indices.size(), mesh.vertices.data(), mesh.vertices.size());
+    EFG_CHECK(vertexCount == 10);
+    fetched.resize(vertexCount);
+    mesh.vertices.swap(fetched);
+    EFG_CHECK(GetTriangles(mesh) == triangles);
+    EFG_CHECK(IsOrderedByFirstUse(mesh));
+}
+
+EFG_TEST(meshOptimizer, Throughput)
+{
+    EfgTestMesh mesh = efgMakeTestGrid(700);
+    efgShuffleTestTriangles(mesh.indices, 2);
+    auto start = std::chrono::steady_clock::now();
+    EfgMeshOptimizeStats stats = efgOptimizeMesh(mesh.vertices, mesh.indices);
+    efgTestReportTime("optimize 980K triangles", start);
+    EFG_CHECK(stats.after.acmr < stats.before.acmr);
+}
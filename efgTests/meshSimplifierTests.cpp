@@ -0,0 +1,122 @@
+#include "efgTest.h"
+#include "efgTestMesh.h"
+#include "efg_meshOptimizer.h"
+#include "efg_meshSimplifier.h"
+
+// Levels follow each other in the index buffer, each smaller than the one before and
+// every index inside the vertex buffer.
+static bool IsValidChain(const EfgMeshLod* lods, uint32_t lodCount, const std::vector<uint32_t>& indices, size_t vertexCount)
+{
+    uint32_t firstIndex = 0;
+    for (uint32_t l = 0; l < lodCount; ++l)
+    {
+        if (lods[l].firstIndex != firstIndex || lods[l].indexCount == 0 || lods[l].indexCount % 3 != 0 ||
+            (l > 0 && lods[l].indexCount >= lods[l - 1].indexCount))
+        {
+            return false;
+        }
+        firstIndex += lods[l].indexCount;
+    }
+    if (firstIndex != indices.size())
+        return false;
+    for (uint32_t index : indices)
+    {
+        if (index >= vertexCount)
+            return false;
+    }
+    return true;
+}
+
+EFG_TEST(meshSimplifier, PlanarGridHasNoError)
+{
+    // Any collapse inside a plane keeps the surface, only the triangle count changes.
+    EfgTestMesh grid = efgMakeTestGrid(32);
+    efgOptimizeMesh(grid.vertices, grid.indices);
+    EfgMeshLod lods[EfgMaxLods];
+    uint32_t lodCount = efgBuildLods(lods, EfgMaxLods, grid.indices, grid.vertices.data(), grid.vertices.size());
+    EFG_CHECK(lodCount >= 4);
+    EFG_CHECK(IsValidChain(lods, lodCount, grid.indices, grid.vertices.size()));
+    for (uint32_t l = 0; l < lodCount; ++l)
+        EFG_CHECK(lods[l].error < 1e-4f);
+}
+
+EFG_TEST(meshSimplifier, SphereErrorsGrow)
+{
+    EfgTestMesh sphere = efgMakeTestSphere(40, 80);
+    efgOptimizeMesh(sphere.vertices, sphere.indices);
+    size_t originalIndexCount = sphere.indices.size();
+    EfgMeshLod lods[EfgMaxLods];
+    uint32_t lodCount = efgBuildLods(lods, EfgMaxLods, sphere.indices, sphere.vertices.data(), sphere.vertices.size());
+    EFG_CHECK(lodCount >= 4);
+    EFG_CHECK(lods[0].indexCount == originalIndexCount && lods[0].error == 0.0f);
+    EFG_CHECK(IsValidChain(lods, lodCount, sphere.indices, sphere.vertices.size()));
+    // Errors add up along the chain and stay well below the radius.
+    for (uint32_t l = 1; l < lodCount; ++l)
+        EFG_CHECK(lods[l].error > 0.0f && lods[l].error >= lods[l - 1].error && lods[l].error < 1.0f);
+    // About half the triangles per level.
+    EFG_CHECK(lods[1].indexCount <= lods[0].indexCount * 6 / 10);
+}
+
+EFG_TEST(meshSimplifier, SimplifyMeshLimits)
+{
+    EfgTestMesh sphere = efgMakeTestSphere(20, 40);
+    std::vector<uint32_t> simplified(sphere.indices.size());
+    float error = -1.0f;
+    size_t target = sphere.indices.size() / 4 / 3 * 3;
+    size_t indexCount = efgSimplifyMesh(simplified.data(), sphere.indices.data(), sphere.indices.size(), sphere.vertices.data(),
+        sphere.vertices.size(), target, 1e30f, &error);
+    EFG_CHECK(indexCount <= target && indexCount > 0 && indexCount % 3 == 0 && error > 0.0f);
+
+    // A tiny error limit stops well short of the target, only degenerate pole collapses are free.
+    indexCount = efgSimplifyMesh(simplified.data(), sphere.indices.data(), sphere.indices.size(), sphere.vertices.data(),
+        sphere.vertices.size(), target, 1e-7f, &error);
+    EFG_CHECK(indexCount > sphere.indices.size() * 9 / 10 && error <= 1e-7f);
+}
+
+EFG_TEST(meshSimplifier, SelectLodHysteresis)
+{
+    EfgMeshLod lods[4];
+    const float errors[4] = { 0.0f, 0.01f, 0.02f, 0.04f };
+    for (uint32_t l = 0; l < 4; ++l)
+        lods[l].error = errors[l];
+
+    // Far away the coarsest level, close up the finest.
+    EFG_CHECK(efgSelectLod(lods, 4, 0, 1.0f) == 3);
+    EFG_CHECK(efgSelectLod(lods, 4, 3, 1000.0f) == 0);
+    EFG_CHECK(efgSelectLod(lods, 0, 2, 1.0f) == 0);
+    EFG_CHECK(efgSelectLod(lods, 4, 7, 1.0f) == 3);
+
+    // Moving away picks ever coarser levels, never a finer one.
+    uint32_t lod = 0;
+    for (float pixelsPerUnit = 1000.0f; pixelsPerUnit > 1.0f; pixelsPerUnit *= 0.97f)
+    {
+        uint32_t next = efgSelectLod(lods, 4, lod, pixelsPerUnit);
+        EFG_CHECK(next >= lod);
+        lod = next;
+    }
+    EFG_CHECK(lod == 3);
+
+    // Jitter around the switch from level 1 to 2 at 50 pixels per unit stays on one level.
+    lod = efgSelectLod(lods, 4, 0, 50.0f);
+    uint32_t switches = 0;
+    for (int frame = 0; frame < 100; ++frame)
+    {
+        float pixelsPerUnit = 50.0f * ((frame % 2) ? 1.1f : 0.9f);
+        uint32_t next = efgSelectLod(lods, 4, lod, pixelsPerUnit);
+        switches += (next != lod) ? 1 : 0;
+        lod = next;
+    }
+    EFG_CHECK(switches == 0);
+}
+
+EFG_TEST(meshSimplifier, Throughput)
+{
+    // 64K triangles, built on one thread.
+    EfgTestMesh sphere = efgMakeTestSphere(128, 256);
+    efgOptimizeMesh(sphere.vertices, sphere.indices);
+    EfgMeshLod lods[EfgMaxLods];
+    auto start = std::chrono::steady_clock::now();
+    uint32_t lodCount = efgBuildLods(lods, EfgMaxLods, sphere.indices, sphere.vertices.data(), sphere.vertices.size());
+    efgTestReportTime("build the LOD chain of 64K triangles", start);
+    EFG_CHECK(lodCount > 1);
+}
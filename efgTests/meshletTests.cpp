@@ -0,0 +1,157 @@
+#include "efgTest.h"
+#include "efgTestMesh.h"
+#include "efg_meshlet.h"
+#include "efg_meshOptimizer.h"
+#include <cmath>
+#include <random>
+
+static DirectX::XMFLOAT3 Subtract(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b)
+{
+    return DirectX::XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z);
+}
+
+static float Dot(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+// Every meshlet is within the limits and fully used, and walking them in order gives back
+// the index buffer they were built from.
+static bool IsValidSplit(const EfgMeshlets& meshlets, const EfgTestMesh& mesh, uint32_t maxVertices, uint32_t maxTriangles)
+{
+    std::vector<uint32_t> indices;
+    uint32_t vertexOffset = 0;
+    uint32_t triangleOffset = 0;
+    for (const EfgMeshlet& meshlet : meshlets.meshlets)
+    {
+        if (meshlet.vertexCount == 0 || meshlet.vertexCount > maxVertices || meshlet.triangleCount == 0 || meshlet.triangleCount > maxTriangles ||
+            meshlet.vertexOffset != vertexOffset || meshlet.triangleOffset != triangleOffset)
+        {
+            return false;
+        }
+        std::vector<uint8_t> used(meshlet.vertexCount, 0);
+        for (uint32_t i = 0; i < meshlet.triangleCount * 3; ++i)
+        {
+            uint8_t local = meshlets.triangles[(meshlet.triangleOffset * 3) + i];
+            if (local >= meshlet.vertexCount)
+                return false;
+            used[local] = 1;
+            indices.push_back(meshlets.vertices[meshlet.vertexOffset + local]);
+        }
+        // No vertex is listed twice or left unused.
+        for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+        {
+            for (uint32_t j = i + 1; j < meshlet.vertexCount; ++j)
+            {
+                if (meshlets.vertices[meshlet.vertexOffset + i] == meshlets.vertices[meshlet.vertexOffset + j])
+                    return false;
+            }
+            if (!used[i])
+                return false;
+        }
+        vertexOffset += meshlet.vertexCount;
+        triangleOffset += meshlet.triangleCount;
+    }
+    return vertexOffset == meshlets.vertices.size() && triangleOffset * 3 == meshlets.triangles.size() && indices == mesh.indices;
+}
+
+static bool AreBoundsConservative(const EfgMeshlets& meshlets, const EfgTestMesh& mesh)
+{
+    for (const EfgMeshlet& meshlet : meshlets.meshlets)
+    {
+        for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+        {
+            DirectX::XMFLOAT3 offset = Subtract(mesh.vertices[meshlets.vertices[meshlet.vertexOffset + i]].position, meshlet.center);
+            if (std::sqrt(Dot(offset, offset)) > meshlet.radius * 1.0001f + 1e-6f)
+                return false;
+        }
+    }
+    return true;
+}
+
+EFG_TEST(meshlet, LimitsAndCoverage)
+{
+    EfgTestMesh sphere = efgMakeTestSphere(40, 80);
+    efgOptimizeMesh(sphere.vertices, sphere.indices);
+    EfgTestMesh shuffled = efgMakeTestGrid(60);
+    efgShuffleTestTriangles(shuffled.indices, 3);
+    for (const EfgTestMesh* mesh : { &sphere, &shuffled })
+    {
+        EfgMeshlets meshlets;
+        efgBuildMeshlets(meshlets, mesh->indices.data(), mesh->indices.size(), mesh->vertices.data(), mesh->vertices.size());
+        EFG_CHECK(IsValidSplit(meshlets, *mesh, EfgMeshletMaxVertices, EfgMeshletMaxTriangles));
+        EFG_CHECK(AreBoundsConservative(meshlets, *mesh));
+    }
+
+    // Vertex cache order fills meshlets well, a triangle needs about one new vertex.
+    EfgMeshlets meshlets;
+    efgBuildMeshlets(meshlets, sphere.indices.data(), sphere.indices.size(), sphere.vertices.data(), sphere.vertices.size());
+    EFG_CHECK(meshlets.meshlets.size() < (sphere.indices.size() / 3) / 80);
+}
+
+EFG_TEST(meshlet, CustomLimits)
+{
+    EfgTestMesh grid = efgMakeTestGrid(10);
+    const uint32_t limits[][2] = { { 3, 1 }, { 4, 124 }, { 64, 2 }, { 128, 255 } };
+    for (const auto& limit : limits)
+    {
+        EfgMeshlets meshlets;
+        efgBuildMeshlets(meshlets, grid.indices.data(), grid.indices.size(), grid.vertices.data(), grid.vertices.size(), limit[0], limit[1]);
+        EFG_CHECK(IsValidSplit(meshlets, grid, limit[0], limit[1]));
+    }
+
+    EfgMeshlets empty;
+    efgBuildMeshlets(empty, nullptr, 0, grid.vertices.data(), grid.vertices.size());
+    EFG_CHECK(empty.meshlets.empty() && empty.vertices.empty() && empty.triangles.empty());
+}
+
+EFG_TEST(meshlet, BackfaceCullingIsConservative)
+{
+    EfgTestMesh sphere = efgMakeTestSphere(80, 160);
+    efgOptimizeMesh(sphere.vertices, sphere.indices);
+    EfgMeshlets meshlets;
+    efgBuildMeshlets(meshlets, sphere.indices.data(), sphere.indices.size(), sphere.vertices.data(), sphere.vertices.size());
+
+    // Cameras all around, a culled meshlet must not have a single triangle facing the camera.
+    std::mt19937 random(4);
+    std::normal_distribution<float> direction(0.0f, 1.0f);
+    size_t culled = 0;
+    bool conservative = true;
+    for (int c = 0; c < 200; ++c)
+    {
+        DirectX::XMFLOAT3 camera(direction(random), direction(random), direction(random));
+        float scale = 10.0f / std::sqrt(Dot(camera, camera));
+        camera = DirectX::XMFLOAT3(camera.x * scale, camera.y * scale, camera.z * scale);
+        for (const EfgMeshlet& meshlet : meshlets.meshlets)
+        {
+            if (!efgIsMeshletBackfacing(meshlet, camera))
+                continue;
+            culled++;
+            for (uint32_t t = 0; t < meshlet.triangleCount; ++t)
+            {
+                const uint8_t* triangle = &meshlets.triangles[(meshlet.triangleOffset + t) * 3];
+                const DirectX::XMFLOAT3& p0 = sphere.vertices[meshlets.vertices[meshlet.vertexOffset + triangle[0]]].position;
+                const DirectX::XMFLOAT3& p1 = sphere.vertices[meshlets.vertices[meshlet.vertexOffset + triangle[1]]].position;
+                const DirectX::XMFLOAT3& p2 = sphere.vertices[meshlets.vertices[meshlet.vertexOffset + triangle[2]]].position;
+                DirectX::XMFLOAT3 e1 = Subtract(p1, p0);
+                DirectX::XMFLOAT3 e2 = Subtract(p2, p0);
+                DirectX::XMFLOAT3 normal(e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x);
+                conservative = conservative && Dot(normal, Subtract(p0, camera)) >= 0.0f;
+            }
+        }
+    }
+    EFG_CHECK(conservative);
+    // From ten radii away half of the sphere faces away, the cones catch about half of that.
+    EFG_CHECK(culled > 200 * meshlets.meshlets.size() / 8);
+}
+
+EFG_TEST(meshlet, Throughput)
+{
+    EfgTestMesh mesh = efgMakeTestGrid(700);
+    efgOptimizeMesh(mesh.vertices, mesh.indices);
+    EfgMeshlets meshlets;
+    auto start = std::chrono::steady_clock::now();
+    efgBuildMeshlets(meshlets, mesh.indices.data(), mesh.indices.size(), mesh.vertices.data(), mesh.vertices.size());
+    efgTestReportTime("build meshlets of 980K triangles", start);
+    EFG_CHECK(!meshlets.meshlets.empty());
+}
@@ -0,0 +1,200 @@
+#include "efgTest.h"
+#include "efg_mipResidency.h"
+
+// Mips 0 and 1 stream, 2 and 3 are the base. Sizes only matter to the budget.
+static const std::vector<uint64_t> MipSizes = { 16, 16, 4, 1 };
+static const uint64_t BaseSize = 5;
+// Frames a texture goes unreported before it stops asking for its finer mips, see efg_mipResidency.cpp.
+static const int IdleFrames = 30;
+
+struct EfgResidencyFrame
+{
+    std::vector<EfgMipResidency::Eviction> evictions;
+    std::vector<EfgMipResidency::Load> loads;
+};
+
+static EfgResidencyFrame Update(EfgMipResidency& residency, uint64_t maxLoadBytes = 1 << 20)
+{
+    EfgResidencyFrame frame;
+    residency.Update(maxLoadBytes, frame.evictions, frame.loads);
+    return frame;
+}
+
+// Reports mip for texture and completes whatever load that hands out.
+static void StreamTo(EfgMipResidency& residency, uint64_t texture, float mip)
+{
+    for (int frame = 0; frame < 4 && residency.GetResidentMip(texture) > static_cast<uint32_t>(mip); ++frame)
+    {
+        residency.Report(texture, mip);
+        for (const EfgMipResidency::Load& load : Update(residency).loads)
+            residency.CompleteLoad(load.texture, true);
+    }
+}
+
+EFG_TEST(mipResidency, LoadsWithinBudget)
+{
+    EfgMipResidency residency;
+    residency.SetBudget(BaseSize * 2 + 16 + 8);
+    residency.Add(1, 2, MipSizes);
+    residency.Add(2, 2, MipSizes);
+    EFG_CHECK(residency.GetResidentMip(1) == 2 && residency.GetUsage() == BaseSize * 2);
+
+    // One mip per texture at a time, and a load counts against the budget while it runs.
+    residency.Report(1, 0.0f);
+    residency.Report(2, 0.0f);
+    EfgResidencyFrame frame = Update(residency);
+    EFG_CHECK(frame.evictions.empty() && frame.loads.size() == 1);
+    EFG_CHECK(frame.loads[0].mip == 1 && frame.loads[0].urgency == 2.0f);
+    EFG_CHECK(residency.GetUsage() == BaseSize * 2 + 16);
+    EFG_CHECK(residency.GetResidentMip(frame.loads[0].texture) == 2);
+    residency.CompleteLoad(frame.loads[0].texture, true);
+    EFG_CHECK(residency.GetResidentMip(frame.loads[0].texture) == 1);
+
+    // The rest would overrun the budget, and both textures want the mips they have as much.
+    for (int f = 0; f < 4; ++f)
+    {
+        residency.Report(1, 0.0f);
+        residency.Report(2, 0.0f);
+        frame = Update(residency);
+        EFG_CHECK(frame.loads.empty() && frame.evictions.empty());
+        EFG_CHECK(residency.GetUsage() <= residency.GetBudget());
+    }
+}
+
+EFG_TEST(mipResidency, MostUrgentFirst)
+{
+    EfgMipResidency residency;
+    residency.Add(1, 2, MipSizes);
+    residency.Add(2, 2, MipSizes);
+    residency.Add(3, 2, MipSizes);
+    // The finest report of a frame counts.
+    residency.Report(1, 1.5f);
+    residency.Report(2, 1.0f);
+    residency.Report(2, 0.0f);
+    residency.Report(3, 1.0f);
+    EfgResidencyFrame frame = Update(residency, 32);
+    EFG_CHECK(frame.loads.size() == 2 && frame.loads[0].texture == 2 && frame.loads[1].texture == 3);
+    // Sampling mip 1.5 reads mip 1, the first texture is handed out once the upload budget allows.
+    frame = Update(residency, 32);
+    EFG_CHECK(frame.loads.size() == 1 && frame.loads[0].texture == 1 && frame.loads[0].mip == 1);
+    // The first load goes out even when it is larger than the upload budget.
+    for (uint64_t texture = 1; texture <= 3; ++texture)
+        residency.CompleteLoad(texture, true);
+    residency.Report(2, 0.0f);
+    frame = Update(residency, 1);
+    EFG_CHECK(frame.loads.size() == 1 && frame.loads[0].texture == 2 && frame.loads[0].mip == 0);
+}
+
+EFG_TEST(mipResidency, EvictsLeastWanted)
+{
+    EfgMipResidency residency;
+    for (uint64_t texture = 1; texture <= 3; ++texture)
+    {
+        residency.Add(texture, 2, MipSizes);
+        StreamTo(residency, texture, 1.0f);
+        EFG_CHECK(residency.GetResidentMip(texture) == 1);
+    }
+    residency.SetBudget(residency.GetUsage());
+
+    // Texture 3 goes out of view and keeps its mip while nothing needs the memory.
+    for (int f = 0; f <= IdleFrames; ++f)
+    {
+        residency.Report(1, 1.0f);
+        residency.Report(2, 1.0f);
+        EfgResidencyFrame frame = Update(residency);
+        EFG_CHECK(frame.loads.empty() && frame.evictions.empty());
+    }
+    EFG_CHECK(residency.GetResidentMip(3) == 1);
+
+    // Texture 2 is as short as texture 1 would stay, only the idle texture gives way.
+    residency.Report(1, 0.0f);
+    residency.Report(2, 1.0f);
+    EfgResidencyFrame frame = Update(residency);
+    EFG_CHECK(frame.evictions.size() == 1 && frame.evictions[0].texture == 3 && frame.evictions[0].mip == 1);
+    EFG_CHECK(frame.loads.size() == 1 && frame.loads[0].texture == 1 && frame.loads[0].mip == 0);
+    EFG_CHECK(residency.GetResidentMip(3) == 2 && residency.GetResidentMip(2) == 1);
+    EFG_CHECK(residency.GetUsage() <= residency.GetBudget());
+    residency.CompleteLoad(1, true);
+
+    // The base mips are never evicted, texture 3 coming back waits for memory.
+    residency.Report(1, 0.0f);
+    residency.Report(2, 1.0f);
+    residency.Report(3, 1.0f);
+    frame = Update(residency);
+    EFG_CHECK(frame.evictions.empty() && frame.loads.empty());
+}
+
+EFG_TEST(mipResidency, IdleFallBack)
+{
+    EfgMipResidency residency;
+    residency.Add(1, 2, MipSizes);
+    residency.Add(2, 2, MipSizes);
+    StreamTo(residency, 1, 1.0f);
+    StreamTo(residency, 2, 1.0f);
+    residency.SetBudget(residency.GetUsage());
+
+    // Until it has been idle for a while, texture 2 still counts as wanting its mip.
+    for (int f = 0; f < IdleFrames; ++f)
+    {
+        residency.Report(1, 0.0f);
+        EfgResidencyFrame frame = Update(residency);
+        EFG_CHECK(frame.evictions.empty() && frame.loads.empty());
+    }
+    residency.Report(1, 0.0f);
+    EfgResidencyFrame frame = Update(residency);
+    EFG_CHECK(frame.evictions.size() == 1 && frame.evictions[0].texture == 2);
+    EFG_CHECK(frame.loads.size() == 1 && frame.loads[0].texture == 1);
+
+    // A single report brings the wish back.
+    residency.CompleteLoad(1, true);
+    residency.SetBudget(residency.GetUsage() + 16);
+    residency.Report(2, 1.0f);
+    frame = Update(residency);
+    EFG_CHECK(frame.loads.size() == 1 && frame.loads[0].texture == 2 && frame.loads[0].mip == 1);
+}
+
+EFG_TEST(mipResidency, FailedLoad)
+{
+    EfgMipResidency residency;
+    residency.Add(1, 2, MipSizes);
+    residency.Report(1, 0.0f);
+    EfgResidencyFrame frame = Update(residency);
+    EFG_CHECK(frame.loads.size() == 1 && residency.GetUsage() == BaseSize + 16);
+
+    // A load in flight isn't handed out twice.
+    residency.Report(1, 0.0f);
+    EFG_CHECK(Update(residency).loads.empty());
+
+    // Failing gives the memory back and leaves the mip to be tried again.
+    residency.CompleteLoad(1, false);
+    EFG_CHECK(residency.GetUsage() == BaseSize && residency.GetResidentMip(1) == 2);
+    residency.CompleteLoad(1, true);
+    EFG_CHECK(residency.GetResidentMip(1) == 2);
+    residency.Report(1, 0.0f);
+    frame = Update(residency);
+    EFG_CHECK(frame.loads.size() == 1 && frame.loads[0].mip == 1);
+}
+
+EFG_TEST(mipResidency, Remove)
+{
+    EfgMipResidency residency;
+    residency.Add(1, 2, MipSizes);
+    residency.Add(2, 2, MipSizes);
+    StreamTo(residency, 1, 1.0f);
+    residency.Report(2, 1.0f);
+    EFG_CHECK(Update(residency).loads.size() == 1);
+
+    // Removing a texture gives back its resident mips and the load in flight, which may still complete.
+    residency.Remove(1);
+    residency.Remove(2);
+    EFG_CHECK(residency.GetUsage() == 0);
+    residency.CompleteLoad(2, true);
+    EFG_CHECK(residency.GetUsage() == 0 && residency.GetResidentMip(2) == 0);
+    residency.Report(2, 0.0f);
+    EFG_CHECK(Update(residency).loads.empty());
+
+    // Adding again replaces the texture, a base past the chain is clamped to its last mip.
+    residency.Add(1, 2, MipSizes);
+    residency.Add(1, 7, MipSizes);
+    EFG_CHECK(residency.GetUsage() == 1 && residency.GetResidentMip(1) == 3);
+}
@@ -0,0 +1,185 @@
+#include "efgTest.h"
+#include "efg_objParser.h"
+#include <fstream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+static const char* MaterialNames[] = { "red", "green", "blue", "missing" };
+
+// Quads with their own four positions, texcoords and a normal each. Most faces use
+// relative indices, every fifth absolute ones, and the material switches every few
+// quads, so both cross the chunk boundaries of a multi megabyte file.
+struct ObjScene
+{
+    fs::path path;
+    size_t quadCount = 0;
+    std::vector<int32_t> quadMaterials;
+};
+
+static ObjScene WriteScene(const char* name, size_t quadCount)
+{
+    ObjScene scene;
+    fs::path directory = efgCreateTestDirectory(name);
+    {
+        std::ofstream mtl(directory / "scene.mtl", std::ios::binary);
+        mtl << "newmtl red\nKd 1 0 0\nnewmtl green\nKd 0 1 0\nmap_Kd -bm 1 green.png\nnewmtl blue\nKd 0 0 1\nd 0.5\n";
+    }
+
+    std::ostringstream obj;
+    obj << "# synthetic scene\nmtllib scene.mtl\n";
+    int32_t material = -1;
+    for (size_t q = 0; q < quadCount; ++q)
+    {
+        if (q % 7 == 3)
+        {
+            size_t nameIndex = (q / 7) % 4;
+            obj << "usemtl " << MaterialNames[nameIndex] << "\n";
+            material = (nameIndex < 3) ? static_cast<int32_t>(nameIndex) : -1;
+        }
+        float x = static_cast<float>(q % 1000);
+        float y = static_cast<float>(q / 1000);
+        obj << "v " << x << " " << y << " 0\nv " << x + 1 << " " << y << " 0\nv " << x + 1 << " " << y + 1 << " 0\nv " << x << " " << y + 1 << " 0.5\n";
+        obj << "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\nvn 0 0 " << ((q % 2) ? "1" : "-1") << "\n";
+        if (q % 5 == 0)
+        {
+            size_t first = q * 4 + 1;
+            obj << "f " << first << "/" << first << "/" << q + 1 << " " << first + 1 << "/" << first + 1 << "/" << q + 1 << " " << first + 2
+                << "/" << first + 2 << "/" << q + 1 << " " << first + 3 << "/" << first + 3 << "/" << q + 1 << "\n";
+        }
+        else
+        {
+            obj << "f -4/-4/-1 -3/-3/-1 -2/-2/-1 -1/-1/-1\n";
+        }
+        scene.quadMaterials.push_back(material);
+    }
+    std::ofstream file(directory / "scene.obj", std::ios::binary);
+    file << obj.str();
+    scene.path = directory / "scene.obj";
+    scene.quadCount = quadCount;
+    return scene;
+}
+
+static bool Parse(const ObjScene& scene, uint32_t threadCount, EfgObjMesh& mesh)
+{
+    EfgVfs vfs;
+    EfgThreadPool threadPool;
+    threadPool.Initialize(threadCount);
+    std::string error;
+    bool parsed = efgParseObj(scene.path, {}, vfs, threadPool, mesh, error);
+    threadPool.Destroy();
+    return parsed && error.empty();
+}
+
+static bool SameIndices(const EfgObjMesh& a, const EfgObjMesh& b)
+{
+    if (a.indices.size() != b.indices.size())
+        return false;
+    for (size_t i = 0; i < a.indices.size(); ++i)
+    {
+        if (a.indices[i].position != b.indices[i].position || a.indices[i].texcoord != b.indices[i].texcoord ||
+            a.indices[i].normal != b.indices[i].normal)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+EFG_TEST(objParser, MatchesSerialParse)
+{
+    // About 5 MB, more than a chunk per worker.
+    ObjScene scene = WriteScene("objParserSerial", 40000);
+    EfgObjMesh serial;
+    EfgObjMesh parallel;
+    EFG_CHECK(Parse(scene, 0, serial));
+    EFG_CHECK(Parse(scene, 4, parallel));
+    EFG_CHECK(fs::file_size(scene.path) > 4 << 20);
+
+    EFG_CHECK(serial.positions.size() == scene.quadCount * 12);
+    EFG_CHECK(serial.texcoords.size() == scene.quadCount * 8);
+    EFG_CHECK(serial.normals.size() == scene.quadCount * 3);
+    EFG_CHECK(serial.positions == parallel.positions);
+    EFG_CHECK(serial.normals == parallel.normals);
+    EFG_CHECK(serial.texcoords == parallel.texcoords);
+    EFG_CHECK(SameIndices(serial, parallel));
+    EFG_CHECK(serial.materialIds == parallel.materialIds);
+    EFG_CHECK(serial.materials.size() == 3 && parallel.materials.size() == 3);
+}
+
+EFG_TEST(objParser, ResolvesRelativeIndicesAndMaterials)
+{
+    ObjScene scene = WriteScene("objParserIndices", 40000);
+    EfgObjMesh mesh;
+    EFG_CHECK(Parse(scene, 4, mesh));
+    EFG_CHECK(mesh.indices.size() == scene.quadCount * 6);
+    EFG_CHECK(mesh.materialIds.size() == scene.quadCount * 2);
+
+    // Fan triangulated, corners 0 1 2 and 0 2 3 of every quad.
+    bool indicesMatch = true;
+    bool materialsMatch = true;
+    for (size_t q = 0; q < scene.quadCount && indicesMatch && materialsMatch; ++q)
+    {
+        const int32_t fan[6] = { 0, 1, 2, 0, 2, 3 };
+        for (int c = 0; c < 6; ++c)
+        {
+            const EfgObjIndex& corner = mesh.indices[q * 6 + c];
+            int32_t expected = static_cast<int32_t>(q * 4) + fan[c];
+            indicesMatch = indicesMatch && corner.position == expected && corner.texcoord == expected &&
+                corner.normal == static_cast<int32_t>(q);
+        }
+        materialsMatch = mesh.materialIds[q * 2] == scene.quadMaterials[q] && mesh.materialIds[q * 2 + 1] == scene.quadMaterials[q];
+    }
+    EFG_CHECK(indicesMatch);
+    EFG_CHECK(materialsMatch);
+}
+
+EFG_TEST(objParser, ReadsMaterials)
+{
+    ObjScene scene = WriteScene("objParserMaterials", 10);
+    EfgObjMesh mesh;
+    EFG_CHECK(Parse(scene, 0, mesh));
+    EFG_CHECK(mesh.materials.size() == 3 && mesh.materialLibraries.size() == 1);
+    if (mesh.materials.size() == 3)
+    {
+        EFG_CHECK(mesh.materials[0].name == "red" && mesh.materials[0].diffuse[0] == 1.0f);
+        EFG_CHECK(mesh.materials[1].diffuseTexture == "green.png");
+        EFG_CHECK(mesh.materials[2].dissolve == 0.5f && mesh.materials[2].shininess == 1.0f);
+    }
+}
+
+EFG_TEST(objParser, RejectsBadFaces)
+{
+    fs::path directory = efgCreateTestDirectory("objParserBad");
+    const char* sources[] = {
+        "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 4\n",
+        "v 0 0 0\nv 1 0 0\nv 0 1 0\nf -1 -2 -4\n",
+        "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 x\n",
+        "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 0 1 2\n",
+    };
+    for (const char* source : sources)
+    {
+        {
+            std::ofstream file(directory / "bad.obj", std::ios::binary | std::ios::trunc);
+            file << source;
+        }
+        ObjScene scene;
+        scene.path = directory / "bad.obj";
+        EfgObjMesh mesh;
+        EFG_CHECK(!Parse(scene, 2, mesh));
+    }
+}
+
+EFG_TEST(objParser, Throughput)
+{
+    // About 25 MB.
+    ObjScene scene = WriteScene("objParserThroughput", 200000);
+    for (uint32_t threadCount : { 0u, 2u, 8u })
+    {
+        EfgObjMesh mesh;
+        auto start = std::chrono::steady_clock::now();
+        EFG_CHECK(Parse(scene, threadCount, mesh));
+        std::string label = "parse 25 MB with " + std::to_string(threadCount) + " workers";
+        efgTestReportTime(label.c_str(), start);
+    }
+}
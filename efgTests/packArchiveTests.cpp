@@ -0,0 +1,185 @@
+#include "efgTest.h"
+#include "efg_hash.h"
+#include "efg_packArchive.h"
+#include "efg_vfs.h"
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+namespace fs = std::filesystem;
+
+static std::vector<uint8_t> ReadBytes(const fs::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void WriteBytes(const fs::path& path, const std::vector<uint8_t>& bytes)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+static std::vector<uint8_t> MakeText(size_t size)
+{
+    std::string text;
+    for (uint32_t line = 0; text.size() < size; ++line)
+        text += "f " + std::to_string(line) + "/1 " + std::to_string(line + 1) + "/2 " + std::to_string(line + 2) + "/3\n";
+    text.resize(size);
+    return std::vector<uint8_t>(text.begin(), text.end());
+}
+
+static std::vector<uint8_t> MakeRandom(size_t size)
+{
+    std::vector<uint8_t> data(size);
+    uint32_t seed = 99;
+    for (uint8_t& byte : data)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        byte = static_cast<uint8_t>(seed >> 24);
+    }
+    return data;
+}
+
+// A text file that compresses, an image that doesn't and an empty file.
+static fs::path WriteArchive(const fs::path& directory)
+{
+    EfgPackArchiveWriter writer;
+    EFG_CHECK(writer.Add(efgPackName("Meshes/Sponza.obj"), MakeText(100000), 11, true));
+    EFG_CHECK(writer.Add(efgPackName("textures/grass.dds"), MakeRandom(50000), 22, true));
+    EFG_CHECK(writer.Add(efgPackName("./empty.txt"), {}, 33, true));
+    // The same file again, e.g. differing only in case, replaces the first.
+    EFG_CHECK(!writer.Add(efgPackName("Textures/Grass.DDS"), MakeRandom(60000), 44, true));
+    EfgPackWriterStats stats = writer.GetStats();
+    EFG_CHECK(stats.entryCount == 3 && stats.compressedCount == 1 && stats.size == 160000 && stats.storedSize < stats.size);
+    fs::path path = directory / "assets.pak";
+    EFG_CHECK(writer.Write(path));
+    return path;
+}
+
+EFG_TEST(packArchive, WriteAndRead)
+{
+    EFG_CHECK(efgPackName("./Meshes/../Textures/A.PNG") == "textures/a.png");
+    fs::path path = WriteArchive(efgCreateTestDirectory("packArchive"));
+    EfgPackArchive archive;
+    EFG_CHECK(archive.Open(path));
+    EFG_CHECK(archive.GetEntryCount() == 3);
+
+    const EfgPackEntry* text = archive.Find("meshes/sponza.obj");
+    EFG_CHECK(text != nullptr);
+    if (text != nullptr)
+    {
+        std::vector<uint8_t> expected = MakeText(100000);
+        EFG_CHECK(text->compression == efgPackCompression_LZ4 && text->storedSize < text->size && text->writeTime == 11);
+        EFG_CHECK(text->hash == efgHash(expected.data(), expected.size()));
+        EFG_CHECK(std::string(archive.GetName(*text)) == "meshes/sponza.obj");
+        std::vector<uint8_t> contents(static_cast<size_t>(text->size));
+        EFG_CHECK(archive.Read(*text, contents.data()) && contents == expected);
+    }
+
+    // Random bytes don't compress, they are stored on a page of their own for mapping.
+    const EfgPackEntry* image = archive.Find(efgPackName("TEXTURES/GRASS.dds"));
+    EFG_CHECK(image != nullptr);
+    if (image != nullptr)
+    {
+        std::vector<uint8_t> expected = MakeRandom(60000);
+        EFG_CHECK(image->compression == efgPackCompression_NONE && image->offset % 4096 == 0 && image->writeTime == 44);
+        EFG_CHECK(image->size == expected.size() && memcmp(archive.GetStoredData(*image), expected.data(), expected.size()) == 0);
+    }
+
+    const EfgPackEntry* empty = archive.Find("empty.txt");
+    EFG_CHECK(empty != nullptr && empty->size == 0 && archive.Read(*empty, nullptr));
+    EFG_CHECK(archive.Find("Meshes/Sponza.obj") == nullptr);
+    EFG_CHECK(archive.Find("meshes/sponza.ob") == nullptr);
+    EFG_CHECK(archive.Find("") == nullptr);
+
+    archive.Close();
+    EFG_CHECK(!archive.IsOpen() && archive.Find("empty.txt") == nullptr);
+    // A missing archive fails without complaint.
+    EFG_CHECK(!archive.Open(path.parent_path() / "missing.pak"));
+}
+
+EFG_TEST(packArchive, VfsLookup)
+{
+    fs::path directory = efgCreateTestDirectory("packArchive");
+    fs::path path = WriteArchive(directory);
+    fs::path assets = directory / "Assets";
+    fs::create_directories(assets);
+    WriteBytes(assets / "loose.txt", { 'l', 'o', 'o', 's', 'e' });
+
+    EfgVfs vfs;
+    EFG_CHECK(vfs.Mount(path, assets));
+    // Paths under the mount point ignore case and .. like Windows does.
+    EfgVfsFile file;
+    EFG_CHECK(vfs.Open(assets / "MESHES" / "sponza.OBJ", file) && file.GetSize() == 100000 && !file.IsMapped());
+    EFG_CHECK(vfs.Open(assets / "meshes" / ".." / "Textures" / "Grass.dds", file) && file.GetSize() == 60000 && file.IsMapped());
+    uint64_t size = 0;
+    int64_t writeTime = 0;
+    EFG_CHECK(vfs.Stat(assets / "textures/grass.dds", size, writeTime) && size == 60000 && writeTime == 44);
+    // Files that aren't packed come from the disk.
+    EFG_CHECK(vfs.Open(assets / "loose.txt", file) && file.GetSize() == 5 && memcmp(file.GetData(), "loose", 5) == 0);
+    EFG_CHECK(!vfs.Exists(assets / "missing.txt"));
+    EFG_CHECK(!vfs.Exists(directory / "meshes/sponza.obj"));
+    EfgVfsStats stats = vfs.GetStats();
+    EFG_CHECK(stats.archiveFiles == 2 && stats.looseFiles == 1 && stats.decompressedBytes == 100000);
+}
+
+EFG_TEST(packArchive, CorruptArchive)
+{
+    fs::path directory = efgCreateTestDirectory("packArchive");
+    const std::vector<uint8_t> original = ReadBytes(WriteArchive(directory));
+    EfgPackHeader header;
+    memcpy(&header, original.data(), sizeof(header));
+    fs::path path = directory / "corrupt.pak";
+    EfgPackArchive archive;
+    auto opens = [&](const std::vector<uint8_t>& bytes) {
+        WriteBytes(path, bytes);
+        bool opened = archive.Open(path);
+        archive.Close();
+        return opened;
+    };
+    auto patch = [&](size_t offset, uint64_t value, size_t size) {
+        std::vector<uint8_t> bytes = original;
+        memcpy(&bytes[offset], &value, size);
+        return bytes;
+    };
+    size_t firstEntry = static_cast<size_t>(header.entriesOffset);
+
+    EFG_CHECK(opens(original));
+    EFG_CHECK(!opens({}));
+    EFG_CHECK(!opens(std::vector<uint8_t>(original.begin(), original.begin() + sizeof(header) - 1)));
+    EFG_CHECK(!opens(std::vector<uint8_t>(original.begin(), original.end() - 1)));
+    EFG_CHECK(!opens(patch(offsetof(EfgPackHeader, magic), 0, 4)));
+    EFG_CHECK(!opens(patch(offsetof(EfgPackHeader, version), 2, 4)));
+    EFG_CHECK(!opens(patch(offsetof(EfgPackHeader, entryCount), 1000, 4)));
+    // Offsets that only pass when the sum wraps around.
+    EFG_CHECK(!opens(patch(offsetof(EfgPackHeader, entriesOffset), UINT64_MAX - 63, 8)));
+    // The strings would end on a zero byte of the header.
+    EFG_CHECK(!opens(patch(offsetof(EfgPackHeader, stringsOffset), UINT64_MAX - header.stringsSize + 1 + offsetof(EfgPackHeader, reserved) + 2, 8)));
+    EFG_CHECK(!opens(patch(firstEntry + offsetof(EfgPackEntry, offset), UINT64_MAX - 15, 8)));
+    // Entries are read in place, they must be aligned.
+    EFG_CHECK(!opens(patch(offsetof(EfgPackHeader, entriesOffset), header.entriesOffset + 4, 8)));
+    EFG_CHECK(!opens(patch(firstEntry + offsetof(EfgPackEntry, nameOffset), static_cast<uint32_t>(header.stringsSize), 4)));
+    EFG_CHECK(!opens(patch(firstEntry + offsetof(EfgPackEntry, compression), 7, 4)));
+    // The string table must end with a terminator.
+    EFG_CHECK(!opens(patch(static_cast<size_t>(header.stringsOffset + header.stringsSize - 1), 'x', 1)));
+
+    // Damaged compressed data is caught by Read, the archive itself looks fine.
+    EfgPackArchive valid;
+    EFG_CHECK(valid.Open(directory / "assets.pak"));
+    const EfgPackEntry* text = valid.Find("meshes/sponza.obj");
+    EFG_CHECK(text != nullptr);
+    if (text != nullptr)
+    {
+        size_t entry = firstEntry + static_cast<size_t>(text - &valid.GetEntry(0)) * sizeof(EfgPackEntry);
+        std::vector<uint8_t> cut = patch(entry + offsetof(EfgPackEntry, storedSize), text->storedSize - 8, 8);
+        valid.Close();
+        WriteBytes(path, cut);
+        EFG_CHECK(archive.Open(path));
+        text = archive.Find("meshes/sponza.obj");
+        std::vector<uint8_t> contents(100000);
+        EFG_CHECK(text != nullptr && !archive.Read(*text, contents.data()));
+    }
+}
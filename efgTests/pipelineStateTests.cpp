@@ -0,0 +1,87 @@
+#include "efgTest.h"
+#include "efg_pipelineState.h"
+#include <functional>
+
+static bool Matches(const EfgPipelineStateDesc& a, const EfgPipelineStateDesc& b)
+{
+    return a == b && !(a != b) && a.Hash() == b.Hash();
+}
+
+static bool Differs(const EfgPipelineStateDesc& a, const EfgPipelineStateDesc& b)
+{
+    return a != b && !(a == b) && a.Hash() != b.Hash();
+}
+
+EFG_TEST(pipelineState, HashIsStable)
+{
+    // Stable across runs and compilers, so it can key on-disk caches.
+    EFG_CHECK(EfgPipelineStateDesc().Hash() == EfgPipelineStateDesc().Hash());
+    EFG_CHECK(EfgPipelineStateDesc().Hash() == 0x1540b8449f9fe52eull);
+}
+
+EFG_TEST(pipelineState, EveryFieldChangesTheDesc)
+{
+    const EfgPipelineStateDesc base;
+    std::vector<std::function<void(EfgPipelineStateDesc&)>> edits = {
+        [](EfgPipelineStateDesc& d) { d.inputLayout = efgInputLayout_POSITION; },
+        [](EfgPipelineStateDesc& d) { d.fillMode = efgFill_WIREFRAME; },
+        [](EfgPipelineStateDesc& d) { d.cullMode = efgCull_NONE; },
+        [](EfgPipelineStateDesc& d) { d.depthBias = 1; },
+        [](EfgPipelineStateDesc& d) { d.slopeScaledDepthBias = 0.5f; },
+        [](EfgPipelineStateDesc& d) { d.depthTest = false; },
+        [](EfgPipelineStateDesc& d) { d.depthWrite = false; },
+        [](EfgPipelineStateDesc& d) { d.depthFunc = efgCompare_GREATER; },
+        [](EfgPipelineStateDesc& d) { d.blendMode = efgBlend_ALPHA; },
+        [](EfgPipelineStateDesc& d) { d.renderTargetCount = 2; },
+        [](EfgPipelineStateDesc& d) { d.renderTargetFormats[0] = efgFormat_R16G16B16A16_FLOAT; },
+        [](EfgPipelineStateDesc& d) { d.depthFormat = efgFormat_D24_UNORM_S8_UINT; },
+    };
+    for (const auto& edit : edits)
+    {
+        EfgPipelineStateDesc changed = base;
+        edit(changed);
+        EFG_CHECK(Differs(base, changed));
+    }
+}
+
+EFG_TEST(pipelineState, UnusedStateIsIgnored)
+{
+    // Formats past renderTargetCount don't take part.
+    EfgPipelineStateDesc a;
+    EfgPipelineStateDesc b;
+    b.renderTargetFormats[3] = efgFormat_R32_FLOAT;
+    EFG_CHECK(Matches(a, b));
+    EFG_CHECK(Matches(a.DepthOnly(), EfgPipelineStateDesc(a).DepthOnly()));
+
+    EfgPipelineStateDesc depthOnly = a.DepthOnly();
+    depthOnly.renderTargetFormats[0] = efgFormat_R11G11B10_FLOAT;
+    EFG_CHECK(Matches(a.DepthOnly(), depthOnly));
+
+    // -0 and 0 compare equal, so they hash equal.
+    EfgPipelineStateDesc negativeZero;
+    negativeZero.slopeScaledDepthBias = -0.0f;
+    EFG_CHECK(Matches(a, negativeZero));
+}
+
+EFG_TEST(pipelineState, DerivedVariants)
+{
+    const EfgPipelineStateDesc base;
+    EfgPipelineStateDesc depthOnly = base.DepthOnly();
+    EFG_CHECK(depthOnly.renderTargetCount == 0 && depthOnly.depthWrite);
+    EfgPipelineStateDesc shadowMap = base.ShadowMap();
+    EFG_CHECK(shadowMap.renderTargetCount == 0 && shadowMap.depthBias > 0);
+    EfgPipelineStateDesc wireframe = base.Wireframe();
+    EFG_CHECK(wireframe.fillMode == efgFill_WIREFRAME && wireframe.cullMode == efgCull_NONE);
+    EfgPipelineStateDesc afterPrepass = base.AfterDepthPrepass();
+    EFG_CHECK(!afterPrepass.depthWrite && afterPrepass.depthFunc == efgCompare_LESS_EQUAL);
+
+    // Every variant is its own pipeline, deriving twice gives the same one.
+    std::vector<EfgPipelineStateDesc> variants = { base, depthOnly, shadowMap, wireframe, afterPrepass };
+    for (size_t i = 0; i < variants.size(); ++i)
+    {
+        for (size_t j = i + 1; j < variants.size(); ++j)
+            EFG_CHECK(Differs(variants[i], variants[j]));
+    }
+    EFG_CHECK(Matches(base.ShadowMap(), base.DepthOnly().ShadowMap()));
+    EFG_CHECK(Matches(base.Wireframe().Wireframe(), wireframe));
+}
@@ -0,0 +1,165 @@
+#include "efgTest.h"
+#include "efg_shaderCache.h"
+#include <cstring>
+#include <fstream>
+#include <string>
+
+namespace fs = std::filesystem;
+
+static void WriteText(const fs::path& path, const std::string& text)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << text;
+}
+
+// main.hlsl includes common.hlsli, which includes nested.hlsli from the root directory.
+static fs::path WriteShaders(const char* name)
+{
+    fs::path directory = efgCreateTestDirectory(name);
+    fs::create_directories(directory / "include");
+    WriteText(directory / "main.hlsl", "#include \"include/common.hlsli\"\nfloat4 Main() : SV_Target { return Color(); }\n");
+    WriteText(directory / "include" / "common.hlsli", "  #  include <nested.hlsli>\nfloat4 Color() { return Tint; }\n");
+    WriteText(directory / "nested.hlsli", "static const float4 Tint = float4(1, 0, 0, 1);\n");
+    return directory;
+}
+
+static uint64_t ComputeKey(const EfgShaderCache& cache, const fs::path& source, const std::vector<EfgShaderDefine>& defines = {},
+    const char* entryPoint = "Main", const char* target = "ps_5_0", uint32_t flags = 0)
+{
+    return cache.ComputeKey(source, defines, entryPoint, target, flags, 47);
+}
+
+EFG_TEST(shaderCache, KeyIsStable)
+{
+    fs::path directory = WriteShaders("shaderCacheKey");
+    EfgVfs vfs;
+    EfgShaderCache first;
+    first.Initialize({}, vfs);
+    EfgShaderCache second;
+    second.Initialize({}, vfs);
+    fs::path source = directory / "main.hlsl";
+    uint64_t key = ComputeKey(first, source);
+    EFG_CHECK(key == ComputeKey(first, source));
+    EFG_CHECK(key == ComputeKey(second, source));
+
+    // Every compile input is part of the key.
+    EFG_CHECK(key != ComputeKey(first, source, { { "EFG_INSTANCED", "1" } }));
+    EFG_CHECK(ComputeKey(first, source, { { "A", "1" } }) != ComputeKey(first, source, { { "A", "2" } }));
+    EFG_CHECK(key != ComputeKey(first, source, {}, "Other"));
+    EFG_CHECK(key != ComputeKey(first, source, {}, "Main", "ps_5_1"));
+    EFG_CHECK(key != ComputeKey(first, source, {}, "Main", "ps_5_0", 1));
+    EFG_CHECK(key != first.ComputeKey(source, {}, "Main", "ps_5_0", 0, 48));
+}
+
+EFG_TEST(shaderCache, KeyFollowsIncludes)
+{
+    fs::path directory = WriteShaders("shaderCacheIncludes");
+    EfgVfs vfs;
+    EfgShaderCache cache;
+    cache.Initialize({}, vfs);
+    fs::path source = directory / "main.hlsl";
+
+    std::vector<fs::path> files = cache.GetSourceFiles(source);
+    EFG_CHECK(files.size() == 3);
+
+    uint64_t key = ComputeKey(cache, source);
+    WriteText(directory / "nested.hlsli", "static const float4 Tint = float4(0, 1, 0, 1);\n");
+    uint64_t nestedChanged = ComputeKey(cache, source);
+    EFG_CHECK(nestedChanged != key);
+    WriteText(directory / "include" / "common.hlsli", "#include <nested.hlsli>\nfloat4 Color() { return Tint * 2; }\n");
+    EFG_CHECK(ComputeKey(cache, source) != nestedChanged);
+}
+
+EFG_TEST(shaderCache, DiskRoundTrip)
+{
+    fs::path directory = efgCreateTestDirectory("shaderCacheDisk");
+    EfgVfs vfs;
+    std::vector<uint8_t> byteCode(1000);
+    for (size_t i = 0; i < byteCode.size(); ++i)
+        byteCode[i] = static_cast<uint8_t>(i * 7);
+
+    EfgShaderCache writer;
+    writer.Initialize(directory, vfs);
+    writer.Store(0x1234, byteCode.data(), byteCode.size());
+    std::vector<uint8_t> found;
+    EFG_CHECK(writer.Find(0x1234, found) && found == byteCode);
+    EFG_CHECK(writer.GetStats().memoryHits == 1);
+
+    // A new process only has the disk entries.
+    EfgShaderCache reader;
+    reader.Initialize(directory, vfs);
+    found.clear();
+    EFG_CHECK(reader.Find(0x1234, found) && found == byteCode);
+    EFG_CHECK(!reader.Find(0x5678, found));
+    EfgShaderCacheStats stats = reader.GetStats();
+    EFG_CHECK(stats.diskHits == 1 && stats.misses == 1);
+}
+
+static fs::path FindEntry(const fs::path& directory)
+{
+    for (const fs::directory_entry& entry : fs::directory_iterator(directory))
+    {
+        if (entry.path().extension() == ".cso")
+            return entry.path();
+    }
+    return {};
+}
+
+static bool FindInNewCache(const fs::path& directory, uint64_t key)
+{
+    EfgVfs vfs;
+    EfgShaderCache cache;
+    cache.Initialize(directory, vfs);
+    std::vector<uint8_t> byteCode;
+    return cache.Find(key, byteCode);
+}
+
+EFG_TEST(shaderCache, RejectsCorruptEntries)
+{
+    fs::path directory = efgCreateTestDirectory("shaderCacheCorrupt");
+    EfgVfs vfs;
+    std::vector<uint8_t> byteCode(256, 0xAB);
+    {
+        EfgShaderCache cache;
+        cache.Initialize(directory, vfs);
+        cache.Store(42, byteCode.data(), byteCode.size());
+    }
+    fs::path entry = FindEntry(directory);
+    EFG_CHECK(!entry.empty());
+    EFG_CHECK(FindInNewCache(directory, 42));
+
+    std::vector<char> contents(fs::file_size(entry));
+    {
+        std::ifstream file(entry, std::ios::binary);
+        file.read(contents.data(), contents.size());
+    }
+    auto writeEntry = [&entry](const std::vector<char>& data) {
+        std::ofstream file(entry, std::ios::binary | std::ios::trunc);
+        file.write(data.data(), data.size());
+    };
+
+    // A flipped payload byte fails the data hash.
+    std::vector<char> flipped = contents;
+    flipped.back() ^= 1;
+    writeEntry(flipped);
+    EFG_CHECK(!FindInNewCache(directory, 42));
+
+    // Truncated payload and truncated header.
+    writeEntry(std::vector<char>(contents.begin(), contents.end() - 10));
+    EFG_CHECK(!FindInNewCache(directory, 42));
+    writeEntry(std::vector<char>(contents.begin(), contents.begin() + 8));
+    EFG_CHECK(!FindInNewCache(directory, 42));
+
+    // A size far beyond the file is a miss, not an allocation. It follows magic,
+    // version and key in the header.
+    std::vector<char> huge = contents;
+    uint64_t size = ~0ull >> 4;
+    memcpy(huge.data() + 16, &size, sizeof(size));
+    writeEntry(huge);
+    EFG_CHECK(!FindInNewCache(directory, 42));
+
+    // An entry renamed to another key doesn't match it.
+    writeEntry(contents);
+    fs::rename(entry, directory / "000000000000002b.cso");
+    EFG_CHECK(!FindInNewCache(directory, 43));
+}
@@ -0,0 +1,180 @@
+#include "efgTest.h"
+#include "efg_vertexCompression.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+// Vertices spread over a box away from the origin, with normals over the whole sphere
+// and uvs past the unit square, as tiled uvs are.
+static std::vector<Vertex> MakeVertices(size_t count, uint32_t seed)
+{
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> position(-40.0f, 120.0f);
+    std::normal_distribution<float> direction(0.0f, 1.0f);
+    std::uniform_real_distribution<float> uv(-4.0f, 4.0f);
+    std::vector<Vertex> vertices(count);
+    for (Vertex& vertex : vertices)
+    {
+        vertex.position = DirectX::XMFLOAT3(position(random), position(random) * 0.25f, position(random));
+        float x = direction(random);
+        float y = direction(random);
+        float z = direction(random);
+        float length = std::sqrt(x * x + y * y + z * z);
+        vertex.normal = DirectX::XMFLOAT3(x / length, y / length, z / length);
+        vertex.uv = DirectX::XMFLOAT2(uv(random), uv(random));
+    }
+    return vertices;
+}
+
+static std::vector<Vertex> RoundTrip(const std::vector<Vertex>& vertices, EFG_VERTEX_FORMAT format, EfgVertexQuantization& quantization)
+{
+    quantization = efgComputeVertexQuantization(vertices.data(), vertices.size(), format);
+    std::vector<EfgCompressedVertex> compressed(vertices.size());
+    efgCompressVertices(compressed.data(), vertices.data(), vertices.size(), format, quantization);
+    std::vector<Vertex> decompressed(vertices.size());
+    efgDecompressVertices(decompressed.data(), compressed.data(), compressed.size(), format, quantization);
+    return decompressed;
+}
+
+// From the cross product as well, acos alone loses small angles to rounding.
+static float GetAngle(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b)
+{
+    float cross[3] = { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+    float sine = std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+    return std::atan2(sine, a.x * b.x + a.y * b.y + a.z * b.z);
+}
+
+// Half floats keep 11 significant bits, rounding is off by half a unit in the last place.
+static bool IsWithinHalfPrecision(float decoded, float original)
+{
+    return std::fabs(decoded - original) <= std::fabs(original) * (1.0f / 2048.0f) + 1e-7f;
+}
+
+EFG_TEST(vertexCompression, Unorm16PositionBound)
+{
+    std::vector<Vertex> vertices = MakeVertices(100000, 1);
+    EfgVertexQuantization quantization;
+    std::vector<Vertex> decoded = RoundTrip(vertices, efgVertexFormat_UNORM16, quantization);
+
+    // Half a step of the bounds divided in 65535, plus float rounding of the dequantization.
+    bool withinBound = true;
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        const float original[3] = { vertices[i].position.x, vertices[i].position.y, vertices[i].position.z };
+        const float result[3] = { decoded[i].position.x, decoded[i].position.y, decoded[i].position.z };
+        for (int c = 0; c < 3; ++c)
+        {
+            float bound = quantization.positionScale[c] * (0.5f / 65535.0f) + std::fabs(original[c]) * 1e-6f;
+            withinBound = withinBound && std::fabs(result[c] - original[c]) <= bound;
+        }
+    }
+    EFG_CHECK(withinBound);
+    EFG_CHECK(quantization.positionScale[3] == 0.0f && quantization.positionOffset[3] == 0.0f);
+}
+
+EFG_TEST(vertexCompression, HalfPositionBound)
+{
+    std::vector<Vertex> vertices = MakeVertices(100000, 2);
+    EfgVertexQuantization quantization;
+    std::vector<Vertex> decoded = RoundTrip(vertices, efgVertexFormat_HALF, quantization);
+
+    // Relative to the mesh center the positions are encoded around.
+    bool withinBound = true;
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        const float original[3] = { vertices[i].position.x, vertices[i].position.y, vertices[i].position.z };
+        const float result[3] = { decoded[i].position.x, decoded[i].position.y, decoded[i].position.z };
+        for (int c = 0; c < 3; ++c)
+        {
+            float centered = original[c] - quantization.positionOffset[c];
+            withinBound = withinBound && IsWithinHalfPrecision(result[c] - quantization.positionOffset[c], centered);
+        }
+    }
+    EFG_CHECK(withinBound);
+}
+
+EFG_TEST(vertexCompression, HalfUvBound)
+{
+    std::vector<Vertex> vertices = MakeVertices(100000, 3);
+    vertices[0].uv = DirectX::XMFLOAT2(1.0f, 0.0f);
+    vertices[1].uv = DirectX::XMFLOAT2(-0.5f, 65504.0f);
+    vertices[2].uv = DirectX::XMFLOAT2(1e-7f, -3e-5f);
+    EfgVertexQuantization quantization;
+    std::vector<Vertex> decoded = RoundTrip(vertices, efgVertexFormat_UNORM16, quantization);
+
+    bool withinBound = true;
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        withinBound = withinBound && IsWithinHalfPrecision(decoded[i].uv.x, vertices[i].uv.x) &&
+            IsWithinHalfPrecision(decoded[i].uv.y, vertices[i].uv.y);
+    }
+    EFG_CHECK(withinBound);
+
+    // Exact encodings, rounding to nearest even and overflow to infinity.
+    EfgCompressedVertex compressed = {};
+    Vertex vertex;
+    vertex.uv = DirectX::XMFLOAT2(1.0f, -2.0f);
+    efgCompressVertices(&compressed, &vertex, 1, efgVertexFormat_HALF, quantization);
+    EFG_CHECK(compressed.uv[0] == 0x3C00 && compressed.uv[1] == 0xC000);
+    vertex.uv = DirectX::XMFLOAT2(1.0f + 1.0f / 2048.0f, 1.0f + 3.0f / 2048.0f);
+    efgCompressVertices(&compressed, &vertex, 1, efgVertexFormat_HALF, quantization);
+    EFG_CHECK(compressed.uv[0] == 0x3C00 && compressed.uv[1] == 0x3C02);
+    vertex.uv = DirectX::XMFLOAT2(65520.0f, 1.0f / 16777216.0f);
+    efgCompressVertices(&compressed, &vertex, 1, efgVertexFormat_HALF, quantization);
+    EFG_CHECK(compressed.uv[0] == 0x7C00 && compressed.uv[1] == 0x0001);
+}
+
+EFG_TEST(vertexCompression, OctahedralNormalBound)
+{
+    std::vector<Vertex> vertices = MakeVertices(100000, 4);
+    const DirectX::XMFLOAT3 axes[6] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+    for (int i = 0; i < 6; ++i)
+        vertices[i].normal = axes[i];
+    EfgVertexQuantization quantization;
+    std::vector<Vertex> decoded = RoundTrip(vertices, efgVertexFormat_UNORM16, quantization);
+
+    // A 16-bit step of the octahedron is well under a hundredth of a degree.
+    float largestAngle = 0.0f;
+    for (size_t i = 0; i < vertices.size(); ++i)
+        largestAngle = std::max(largestAngle, GetAngle(decoded[i].normal, vertices[i].normal));
+    EFG_CHECK(largestAngle < 1e-4f);
+    for (int i = 0; i < 6; ++i)
+        EFG_CHECK(GetAngle(decoded[i].normal, axes[i]) < 1e-6f);
+}
+
+EFG_TEST(vertexCompression, DegenerateInput)
+{
+    // A flat mesh has no extent along z and a zero normal, neither may produce NaN.
+    std::vector<Vertex> vertices = MakeVertices(16, 5);
+    for (Vertex& vertex : vertices)
+        vertex.position.z = 7.0f;
+    vertices[0].normal = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+    for (EFG_VERTEX_FORMAT format : { efgVertexFormat_HALF, efgVertexFormat_UNORM16 })
+    {
+        EfgVertexQuantization quantization;
+        std::vector<Vertex> decoded = RoundTrip(vertices, format, quantization);
+        EFG_CHECK(quantization.positionScale[2] == 1.0f);
+        bool finite = true;
+        for (const Vertex& vertex : decoded)
+        {
+            finite = finite && vertex.position.z == 7.0f && std::isfinite(vertex.normal.x) && std::isfinite(vertex.normal.y) &&
+                std::isfinite(vertex.normal.z);
+        }
+        EFG_CHECK(finite);
+    }
+    EFG_CHECK(efgGetVertexStride(efgVertexFormat_HALF) == 16 && efgGetVertexStride(efgVertexFormat_FLOAT) == sizeof(Vertex));
+}
+
+EFG_TEST(vertexCompression, Throughput)
+{
+    std::vector<Vertex> vertices = MakeVertices(1 << 20, 6);
+    EfgVertexQuantization quantization = efgComputeVertexQuantization(vertices.data(), vertices.size(), efgVertexFormat_UNORM16);
+    std::vector<EfgCompressedVertex> compressed(vertices.size());
+    auto start = std::chrono::steady_clock::now();
+    efgCompressVertices(compressed.data(), vertices.data(), vertices.size(), efgVertexFormat_UNORM16, quantization);
+    efgTestReportTime("compress 1M vertices", start);
+    std::vector<Vertex> decoded(vertices.size());
+    start = std::chrono::steady_clock::now();
+    efgDecompressVertices(decoded.data(), compressed.data(), compressed.size(), efgVertexFormat_UNORM16, quantization);
+    efgTestReportTime("decompress 1M vertices", start);
+}
@@ -0,0 +1,108 @@
+#include "efgTest.h"
+#include "efg_vertexWelder.h"
+
+static Vertex MakeVertex(float x, float y, float z, float u = 0.0f, float v = 0.0f)
+{
+    Vertex vertex;
+    vertex.position = DirectX::XMFLOAT3(x, y, z);
+    vertex.normal = DirectX::XMFLOAT3(0.0f, 0.0f, 1.0f);
+    vertex.uv = DirectX::XMFLOAT2(u, v);
+    return vertex;
+}
+
+// Every quad of a size x size grid as two triangles with their own corners, the way
+// an OBJ face list arrives before welding.
+static std::vector<Vertex> MakeGridCorners(int size)
+{
+    std::vector<Vertex> corners;
+    for (int y = 0; y < size; ++y)
+    {
+        for (int x = 0; x < size; ++x)
+        {
+            const int quad[6][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 0 }, { 1, 1 }, { 0, 1 } };
+            for (const auto& corner : quad)
+            {
+                float cx = static_cast<float>(x + corner[0]);
+                float cy = static_cast<float>(y + corner[1]);
+                corners.push_back(MakeVertex(cx, cy, 0.0f, cx / size, cy / size));
+            }
+        }
+    }
+    return corners;
+}
+
+EFG_TEST(vertexWelder, SharedCornersWeld)
+{
+    // Small expected sizes force several rehashes on the way.
+    for (size_t expected : { size_t(0), size_t(16), size_t(100000) })
+    {
+        const int size = 64;
+        std::vector<Vertex> corners = MakeGridCorners(size);
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        EfgVertexWelder welder(vertices, expected);
+        for (const Vertex& corner : corners)
+            indices.push_back(welder.Add(corner));
+
+        EFG_CHECK(vertices.size() == size_t((size + 1) * (size + 1)));
+        EFG_CHECK(indices.size() == corners.size());
+        bool same = true;
+        for (size_t i = 0; i < indices.size(); ++i)
+        {
+            const Vertex& welded = vertices[indices[i]];
+            same = same && welded.position.x == corners[i].position.x && welded.position.y == corners[i].position.y &&
+                welded.uv.x == corners[i].uv.x && welded.uv.y == corners[i].uv.y;
+        }
+        EFG_CHECK(same);
+    }
+}
+
+EFG_TEST(vertexWelder, AttributesSplitVertices)
+{
+    std::vector<Vertex> vertices;
+    EfgVertexWelder welder(vertices);
+    Vertex base = MakeVertex(1.0f, 2.0f, 3.0f, 0.5f, 0.5f);
+    uint32_t first = welder.Add(base);
+    EFG_CHECK(welder.Add(base) == first);
+
+    // A uv or normal seam keeps its own vertex.
+    Vertex seam = base;
+    seam.uv.x = 0.75f;
+    EFG_CHECK(welder.Add(seam) != first);
+    Vertex crease = base;
+    crease.normal = DirectX::XMFLOAT3(1.0f, 0.0f, 0.0f);
+    EFG_CHECK(welder.Add(crease) != first);
+    EFG_CHECK(vertices.size() == 3);
+
+    // -0 and 0 compare equal, so they weld.
+    Vertex zero = MakeVertex(0.0f, 0.0f, 0.0f);
+    Vertex negativeZero = MakeVertex(-0.0f, 0.0f, -0.0f);
+    EFG_CHECK(welder.Add(zero) == welder.Add(negativeZero));
+    EFG_CHECK(vertices.size() == 4);
+}
+
+EFG_TEST(vertexWelder, AppendsToExistingVertices)
+{
+    // Vertices already in the buffer are found, new ones go after them.
+    std::vector<Vertex> vertices = { MakeVertex(0.0f, 0.0f, 0.0f), MakeVertex(1.0f, 0.0f, 0.0f) };
+    EfgVertexWelder welder(vertices);
+    EFG_CHECK(welder.Add(MakeVertex(1.0f, 0.0f, 0.0f)) == 1);
+    EFG_CHECK(welder.Add(MakeVertex(2.0f, 0.0f, 0.0f)) == 2);
+    EFG_CHECK(welder.Add(MakeVertex(0.0f, 0.0f, 0.0f)) == 0);
+    EFG_CHECK(vertices.size() == 3);
+}
+
+EFG_TEST(vertexWelder, Throughput)
+{
+    // About the corner count of a 1M triangle scan.
+    const int size = 700;
+    std::vector<Vertex> corners = MakeGridCorners(size);
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices(corners.size());
+    auto start = std::chrono::steady_clock::now();
+    EfgVertexWelder welder(vertices, corners.size() / 4);
+    for (size_t i = 0; i < corners.size(); ++i)
+        indices[i] = welder.Add(corners[i]);
+    efgTestReportTime("weld 2.9M corners", start);
+    EFG_CHECK(vertices.size() == size_t((size + 1) * (size + 1)));
+}
@@ -0,0 +1,721 @@
+#include "efg_bcEncoder.h"
+#include "efg_threadPool.h"
+#include <cmath>
+#include <cstring>
+#include <future>
+
+// Interpolation weights of the 4-bit BC7 indices, out of 64.
+static const int Bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static int Clamp(int value, int low, int high)
+{
+    return (value < low) ? low : ((value > high) ? high : value);
+}
+
+uint32_t efgGetBlockBytes(EFG_BC_FORMAT format)
+{
+    return (format == efgBC_1) ? 8 : 16;
+}
+
+uint32_t efgGetDxgiFormat(EFG_BC_FORMAT format, bool srgb)
+{
+    switch (format)
+    {
+    case efgBC_1:
+        return srgb ? 72 : 71; // DXGI_FORMAT_BC1_UNORM_SRGB, DXGI_FORMAT_BC1_UNORM
+    case efgBC_3:
+        return srgb ? 78 : 77; // DXGI_FORMAT_BC3_UNORM_SRGB, DXGI_FORMAT_BC3_UNORM
+    case efgBC_5:
+        return 83;             // DXGI_FORMAT_BC5_UNORM, there is no sRGB BC5
+    case efgBC_7:
+        return srgb ? 99 : 98; // DXGI_FORMAT_BC7_UNORM_SRGB, DXGI_FORMAT_BC7_UNORM
+    }
+    return 0;
+}
+
+size_t efgGetCompressedSize(EFG_BC_FORMAT format, uint32_t width, uint32_t height)
+{
+    return size_t((width + 3) / 4) * ((height + 3) / 4) * efgGetBlockBytes(format);
+}
+
+static float SrgbToLinear(int value)
+{
+    float color = value / 255.0f;
+    return (color <= 0.04045f) ? color / 12.92f : std::pow((color + 0.055f) / 1.055f, 2.4f);
+}
+
+static uint8_t LinearToSrgb(float color)
+{
+    float srgb = (color <= 0.0031308f) ? color * 12.92f : 1.055f * std::pow(color, 1.0f / 2.4f) - 0.055f;
+    return static_cast<uint8_t>(Clamp(static_cast<int>(std::lround(srgb * 255.0f)), 0, 255));
+}
+
+void efgGenerateMips(std::vector<EfgImage>& mips, bool srgb)
+{
+    float toLinear[256];
+    for (int i = 0; i < 256; ++i)
+        toLinear[i] = srgb ? SrgbToLinear(i) : i / 255.0f;
+
+    while (mips.back().width > 1 || mips.back().height > 1)
+    {
+        EfgImage mip;
+        const EfgImage& source = mips.back();
+        mip.width = (source.width > 1) ? source.width / 2 : 1;
+        mip.height = (source.height > 1) ? source.height / 2 : 1;
+        mip.pixels.resize(size_t(mip.width) * mip.height * 4);
+        for (uint32_t y = 0; y < mip.height; ++y)
+        {
+            for (uint32_t x = 0; x < mip.width; ++x)
+            {
+                // Odd sizes clamp the second texel instead of widening the filter.
+                uint32_t x0 = x * 2;
+                uint32_t y0 = y * 2;
+                uint32_t x1 = (x0 + 1 < source.width) ? x0 + 1 : x0;
+                uint32_t y1 = (y0 + 1 < source.height) ? y0 + 1 : y0;
+                const uint8_t* texels[4] = {
+                    &source.pixels[(size_t(y0) * source.width + x0) * 4], &source.pixels[(size_t(y0) * source.width + x1) * 4],
+                    &source.pixels[(size_t(y1) * source.width + x0) * 4], &source.pixels[(size_t(y1) * source.width + x1) * 4] };
+                uint8_t* destination = &mip.pixels[(size_t(y) * mip.width + x) * 4];
+                for (int c = 0; c < 3; ++c)
+                {
+                    float sum = 0.0f;
+                    for (const uint8_t* texel : texels)
+                        sum += toLinear[texel[c]];
+                    destination[c] = srgb ? LinearToSrgb(sum * 0.25f) : static_cast<uint8_t>(Clamp(static_cast<int>(std::lround(sum * 0.25f * 255.0f)), 0, 255));
+                }
+                destination[3] = static_cast<uint8_t>((texels[0][3] + texels[1][3] + texels[2][3] + texels[3][3] + 2) / 4);
+            }
+        }
+        mips.push_back(std::move(mip));
+    }
+}
+
+// Principal axis of the points, by power iteration on their covariance.
+static void ComputeAxis(const float points[16][4], int channels, float mean[4], float axis[4])
+{
+    for (int c = 0; c < 4; ++c)
+    {
+        mean[c] = 0.0f;
+        for (int i = 0; i < 16; ++i)
+            mean[c] += points[i][c];
+        mean[c] /= 16.0f;
+    }
+    float covariance[4][4] = {};
+    for (int i = 0; i < 16; ++i)
+    {
+        for (int a = 0; a < channels; ++a)
+        {
+            for (int b = 0; b < channels; ++b)
+                covariance[a][b] += (points[i][a] - mean[a]) * (points[i][b] - mean[b]);
+        }
+    }
+    for (int c = 0; c < 4; ++c)
+        axis[c] = (c < channels) ? 1.0f : 0.0f;
+    for (int iteration = 0; iteration < 8; ++iteration)
+    {
+        float next[4] = {};
+        float length = 0.0f;
+        for (int a = 0; a < channels; ++a)
+        {
+            for (int b = 0; b < channels; ++b)
+                next[a] += covariance[a][b] * axis[b];
+            length += next[a] * next[a];
+        }
+        // Flat blocks keep the diagonal, every point projects to the mean anyway.
+        if (length < 1e-12f)
+            break;
+        length = std::sqrt(length);
+        for (int c = 0; c < channels; ++c)
+            axis[c] = next[c] / length;
+    }
+    float length = 0.0f;
+    for (int c = 0; c < channels; ++c)
+        length += axis[c] * axis[c];
+    length = std::sqrt(length);
+    for (int c = 0; c < channels; ++c)
+        axis[c] /= length;
+}
+
+// Endpoints at the extremes of the points along the axis.
+static void ComputeEndpoints(const float points[16][4], int channels, float endpoint0[4], float endpoint1[4])
+{
+    float mean[4];
+    float axis[4];
+    ComputeAxis(points, channels, mean, axis);
+    float minT = 1e30f;
+    float maxT = -1e30f;
+    for (int i = 0; i < 16; ++i)
+    {
+        float t = 0.0f;
+        for (int c = 0; c < channels; ++c)
+            t += (points[i][c] - mean[c]) * axis[c];
+        minT = (t < minT) ? t : minT;
+        maxT = (t > maxT) ? t : maxT;
+    }
+    for (int c = 0; c < 4; ++c)
+    {
+        endpoint0[c] = mean[c] + axis[c] * maxT;
+        endpoint1[c] = mean[c] + axis[c] * minT;
+    }
+}
+
+// Least squares endpoints for fixed indices, weights[index] is the share of endpoint0.
+// Returns false when every index has the same weight.
+static bool SolveEndpoints(const float points[16][4], int channels, const uint8_t indices[16], const float* weights,
+    float endpoint0[4], float endpoint1[4])
+{
+    float aa = 0.0f;
+    float ab = 0.0f;
+    float bb = 0.0f;
+    float ax[4] = {};
+    float bx[4] = {};
+    for (int i = 0; i < 16; ++i)
+    {
+        float a = weights[indices[i]];
+        float b = 1.0f - a;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (int c = 0; c < channels; ++c)
+        {
+            ax[c] += a * points[i][c];
+            bx[c] += b * points[i][c];
+        }
+    }
+    float determinant = aa * bb - ab * ab;
+    if (std::fabs(determinant) < 1e-6f)
+        return false;
+    for (int c = 0; c < channels; ++c)
+    {
+        endpoint0[c] = (ax[c] * bb - bx[c] * ab) / determinant;
+        endpoint1[c] = (bx[c] * aa - ax[c] * ab) / determinant;
+    }
+    return true;
+}
+
+static void GatherPoints(const uint8_t texels[64], float points[16][4])
+{
+    for (int i = 0; i < 16; ++i)
+    {
+        for (int c = 0; c < 4; ++c)
+            points[i][c] = texels[i * 4 + c];
+    }
+}
+
+static uint16_t Pack565(const float color[4])
+{
+    int r = Clamp(static_cast<int>(color[0] * 31.0f / 255.0f + 0.5f), 0, 31);
+    int g = Clamp(static_cast<int>(color[1] * 63.0f / 255.0f + 0.5f), 0, 63);
+    int b = Clamp(static_cast<int>(color[2] * 31.0f / 255.0f + 0.5f), 0, 31);
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static void Unpack565(uint16_t packed, int color[3])
+{
+    int r = (packed >> 11) & 31;
+    int g = (packed >> 5) & 63;
+    int b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+// The four color palette, BC3 always uses it and BC1 when color0 > color1.
+static void BuildColorPalette(uint16_t color0, uint16_t color1, int palette[4][3])
+{
+    Unpack565(color0, palette[0]);
+    Unpack565(color1, palette[1]);
+    for (int c = 0; c < 3; ++c)
+    {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+}
+
+static float FitColorIndices(const float points[16][4], uint16_t color0, uint16_t color1, uint8_t indices[16])
+{
+    int palette[4][3];
+    BuildColorPalette(color0, color1, palette);
+    float error = 0.0f;
+    for (int i = 0; i < 16; ++i)
+    {
+        float bestDistance = 1e30f;
+        for (uint8_t index = 0; index < 4; ++index)
+        {
+            float distance = 0.0f;
+            for (int c = 0; c < 3; ++c)
+                distance += (points[i][c] - palette[index][c]) * (points[i][c] - palette[index][c]);
+            if (distance < bestDistance)
+            {
+                bestDistance = distance;
+                indices[i] = index;
+            }
+        }
+        error += bestDistance;
+    }
+    return error;
+}
+
+static void CompressColorBlock(const uint8_t texels[64], uint8_t* block)
+{
+    static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+    float points[16][4];
+    GatherPoints(texels, points);
+    float endpoint0[4];
+    float endpoint1[4];
+    ComputeEndpoints(points, 3, endpoint0, endpoint1);
+    uint16_t color0 = Pack565(endpoint0);
+    uint16_t color1 = Pack565(endpoint1);
+    uint8_t indices[16];
+    float error = FitColorIndices(points, color0, color1, indices);
+
+    for (int iteration = 0; iteration < 2; ++iteration)
+    {
+        if (!SolveEndpoints(points, 3, indices, weights, endpoint0, endpoint1))
+            break;
+        uint16_t refined0 = Pack565(endpoint0);
+        uint16_t refined1 = Pack565(endpoint1);
+        uint8_t refinedIndices[16];
+        float refinedError = FitColorIndices(points, refined0, refined1, refinedIndices);
+        if (refinedError >= error)
+            break;
+        color0 = refined0;
+        color1 = refined1;
+        error = refinedError;
+        memcpy(indices, refinedIndices, sizeof(indices));
+    }
+
+    // BC1 reads color0 <= color1 as the three color mode with transparent black, so
+    // swap into the four color order. Swapping exchanges indices 0 and 1, 2 and 3.
+    if (color0 < color1)
+    {
+        uint16_t swap = color0;
+        color0 = color1;
+        color1 = swap;
+        for (uint8_t& index : indices)
+            index ^= 1;
+    }
+    else if (color0 == color1)
+    {
+        memset(indices, 0, sizeof(indices));
+    }
+
+    uint32_t bits = 0;
+    for (int i = 0; i < 16; ++i)
+        bits |= uint32_t(indices[i]) << (i * 2);
+    block[0] = static_cast<uint8_t>(color0);
+    block[1] = static_cast<uint8_t>(color0 >> 8);
+    block[2] = static_cast<uint8_t>(color1);
+    block[3] = static_cast<uint8_t>(color1 >> 8);
+    memcpy(block + 4, &bits, sizeof(bits));
+}
+
+// Eight interpolated values when value0 > value1, otherwise six plus 0 and 255.
+static void BuildChannelPalette(int value0, int value1, int palette[8])
+{
+    palette[0] = value0;
+    palette[1] = value1;
+    if (value0 > value1)
+    {
+        for (int i = 2; i < 8; ++i)
+            palette[i] = ((8 - i) * value0 + (i - 1) * value1 + 3) / 7;
+    }
+    else
+    {
+        for (int i = 2; i < 6; ++i)
+            palette[i] = ((6 - i) * value0 + (i - 1) * value1 + 2) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+static int FitChannelIndices(const int values[16], int value0, int value1, uint8_t indices[16])
+{
+    int palette[8];
+    BuildChannelPalette(value0, value1, palette);
+    int error = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        int bestDistance = 1 << 30;
+        for (uint8_t index = 0; index < 8; ++index)
+        {
+            int distance = (values[i] - palette[index]) * (values[i] - palette[index]);
+            if (distance < bestDistance)
+            {
+                bestDistance = distance;
+                indices[i] = index;
+            }
+        }
+        error += bestDistance;
+    }
+    return error;
+}
+
+// One channel in 8 bytes, the BC3 alpha block and both halves of BC5.
+static void CompressChannelBlock(const uint8_t texels[64], int channel, uint8_t* block)
+{
+    int values[16];
+    int minValue = 255;
+    int maxValue = 0;
+    int innerMin = 255;
+    int innerMax = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        values[i] = texels[i * 4 + channel];
+        minValue = (values[i] < minValue) ? values[i] : minValue;
+        maxValue = (values[i] > maxValue) ? values[i] : maxValue;
+        if (values[i] != 0 && values[i] != 255)
+        {
+            innerMin = (values[i] < innerMin) ? values[i] : innerMin;
+            innerMax = (values[i] > innerMax) ? values[i] : innerMax;
+        }
+    }
+
+    // The six value mode leaves 0 and 255 to the fixed entries, it wins for blocks that
+    // hold either extreme next to values in between.
+    int value0 = (innerMin <= innerMax) ? innerMin : 0;
+    int value1 = (innerMin <= innerMax) ? innerMax : 0;
+    uint8_t indices[16];
+    int error = FitChannelIndices(values, value0, value1, indices);
+    if (maxValue > minValue)
+    {
+        uint8_t interpolatedIndices[16];
+        int interpolatedError = FitChannelIndices(values, maxValue, minValue, interpolatedIndices);
+        if (interpolatedError < error)
+        {
+            value0 = maxValue;
+            value1 = minValue;
+            memcpy(indices, interpolatedIndices, sizeof(indices));
+        }
+    }
+
+    uint64_t bits = 0;
+    for (int i = 0; i < 16; ++i)
+        bits |= uint64_t(indices[i]) << (i * 3);
+    block[0] = static_cast<uint8_t>(value0);
+    block[1] = static_cast<uint8_t>(value1);
+    for (int i = 0; i < 6; ++i)
+        block[2 + i] = static_cast<uint8_t>(bits >> (i * 8));
+}
+
+// BC7 mode 6: one subset, 7-bit RGBA endpoints with a p-bit each, 4-bit indices.
+struct Bc7Endpoints
+{
+    int quantized[2][4] = {};
+    int pBits[2] = {};
+};
+
+static void QuantizeBc7Endpoint(const float endpoint[4], Bc7Endpoints& endpoints, int e)
+{
+    float bestError = 1e30f;
+    for (int p = 0; p < 2; ++p)
+    {
+        int quantized[4];
+        float error = 0.0f;
+        for (int c = 0; c < 4; ++c)
+        {
+            quantized[c] = Clamp(static_cast<int>(std::lround((endpoint[c] - p) * 0.5f)), 0, 127);
+            float difference = (quantized[c] * 2 + p) - endpoint[c];
+            error += difference * difference;
+        }
+        if (error < bestError)
+        {
+            bestError = error;
+            memcpy(endpoints.quantized[e], quantized, sizeof(quantized));
+            endpoints.pBits[e] = p;
+        }
+    }
+}
+
+static float FitBc7Indices(const float points[16][4], const Bc7Endpoints& endpoints, uint8_t indices[16])
+{
+    int palette[16][4];
+    for (int index = 0; index < 16; ++index)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            int value0 = endpoints.quantized[0][c] * 2 + endpoints.pBits[0];
+            int value1 = endpoints.quantized[1][c] * 2 + endpoints.pBits[1];
+            palette[index][c] = ((64 - Bc7Weights[index]) * value0 + Bc7Weights[index] * value1 + 32) >> 6;
+        }
+    }
+    float error = 0.0f;
+    for (int i = 0; i < 16; ++i)
+    {
+        float bestDistance = 1e30f;
+        for (uint8_t index = 0; index < 16; ++index)
+        {
+            float distance = 0.0f;
+            for (int c = 0; c < 4; ++c)
+                distance += (points[i][c] - palette[index][c]) * (points[i][c] - palette[index][c]);
+            if (distance < bestDistance)
+            {
+                bestDistance = distance;
+                indices[i] = index;
+            }
+        }
+        error += bestDistance;
+    }
+    return error;
+}
+
+static void WriteBits(uint8_t* block, uint32_t& offset, uint32_t value, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i, ++offset)
+    {
+        if (value & (1u << i))
+            block[offset / 8] |= static_cast<uint8_t>(1u << (offset % 8));
+    }
+}
+
+static uint32_t ReadBits(const uint8_t* block, uint32_t& offset, uint32_t count)
+{
+    uint32_t value = 0;
+    for (uint32_t i = 0; i < count; ++i, ++offset)
+        value |= uint32_t((block[offset / 8] >> (offset % 8)) & 1) << i;
+    return value;
+}
+
+static void CompressBc7Block(const uint8_t texels[64], uint8_t* block)
+{
+    float weights[16];
+    for (int index = 0; index < 16; ++index)
+        weights[index] = 1.0f - Bc7Weights[index] / 64.0f;
+    float points[16][4];
+    GatherPoints(texels, points);
+    float endpoint0[4];
+    float endpoint1[4];
+    ComputeEndpoints(points, 4, endpoint0, endpoint1);
+    Bc7Endpoints endpoints;
+    QuantizeBc7Endpoint(endpoint0, endpoints, 0);
+    QuantizeBc7Endpoint(endpoint1, endpoints, 1);
+    uint8_t indices[16];
+    float error = FitBc7Indices(points, endpoints, indices);
+
+    for (int iteration = 0; iteration < 2; ++iteration)
+    {
+        if (!SolveEndpoints(points, 4, indices, weights, endpoint0, endpoint1))
+            break;
+        Bc7Endpoints refined;
+        QuantizeBc7Endpoint(endpoint0, refined, 0);
+        QuantizeBc7Endpoint(endpoint1, refined, 1);
+        uint8_t refinedIndices[16];
+        float refinedError = FitBc7Indices(points, refined, refinedIndices);
+        if (refinedError >= error)
+            break;
+        endpoints = refined;
+        error = refinedError;
+        memcpy(indices, refinedIndices, sizeof(indices));
+    }
+
+    // The first index is stored without its top bit, swap the endpoints when it is set.
+    if (indices[0] >= 8)
+    {
+        Bc7Endpoints swapped;
+        memcpy(swapped.quantized[0], endpoints.quantized[1], sizeof(swapped.quantized[0]));
+        memcpy(swapped.quantized[1], endpoints.quantized[0], sizeof(swapped.quantized[1]));
+        swapped.pBits[0] = endpoints.pBits[1];
+        swapped.pBits[1] = endpoints.pBits[0];
+        endpoints = swapped;
+        for (uint8_t& index : indices)
+            index = static_cast<uint8_t>(15 - index);
+    }
+
+    memset(block, 0, 16);
+    uint32_t offset = 0;
+    WriteBits(block, offset, 1u << 6, 7);
+    for (int c = 0; c < 4; ++c)
+    {
+        WriteBits(block, offset, endpoints.quantized[0][c], 7);
+        WriteBits(block, offset, endpoints.quantized[1][c], 7);
+    }
+    WriteBits(block, offset, endpoints.pBits[0], 1);
+    WriteBits(block, offset, endpoints.pBits[1], 1);
+    WriteBits(block, offset, indices[0], 3);
+    for (int i = 1; i < 16; ++i)
+        WriteBits(block, offset, indices[i], 4);
+}
+
+void efgCompressBlock(EFG_BC_FORMAT format, const uint8_t texels[64], uint8_t* block)
+{
+    switch (format)
+    {
+    case efgBC_1:
+        CompressColorBlock(texels, block);
+        break;
+    case efgBC_3:
+        CompressChannelBlock(texels, 3, block);
+        CompressColorBlock(texels, block + 8);
+        break;
+    case efgBC_5:
+        CompressChannelBlock(texels, 0, block);
+        CompressChannelBlock(texels, 1, block + 8);
+        break;
+    case efgBC_7:
+        CompressBc7Block(texels, block);
+        break;
+    }
+}
+
+static void DecompressColorBlock(const uint8_t* block, bool fourColors, uint8_t texels[64])
+{
+    uint16_t color0 = static_cast<uint16_t>(block[0] | (block[1] << 8));
+    uint16_t color1 = static_cast<uint16_t>(block[2] | (block[3] << 8));
+    int palette[4][3];
+    BuildColorPalette(color0, color1, palette);
+    bool threeColors = !fourColors && color0 <= color1;
+    if (threeColors)
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+    }
+    uint32_t bits = 0;
+    memcpy(&bits, block + 4, sizeof(bits));
+    for (int i = 0; i < 16; ++i)
+    {
+        uint32_t index = (bits >> (i * 2)) & 3;
+        for (int c = 0; c < 3; ++c)
+            texels[i * 4 + c] = static_cast<uint8_t>(palette[index][c]);
+        texels[i * 4 + 3] = (threeColors && index == 3) ? 0 : 255;
+    }
+}
+
+static void DecompressChannelBlock(const uint8_t* block, int channel, uint8_t texels[64])
+{
+    int palette[8];
+    BuildChannelPalette(block[0], block[1], palette);
+    uint64_t bits = 0;
+    for (int i = 0; i < 6; ++i)
+        bits |= uint64_t(block[2 + i]) << (i * 8);
+    for (int i = 0; i < 16; ++i)
+        texels[i * 4 + channel] = static_cast<uint8_t>(palette[(bits >> (i * 3)) & 7]);
+}
+
+static void DecompressBc7Block(const uint8_t* block, uint8_t texels[64])
+{
+    uint32_t offset = 0;
+    if (ReadBits(block, offset, 7) != (1u << 6))
+    {
+        memset(texels, 0, 64);
+        return;
+    }
+    int endpoints[2][4];
+    for (int c = 0; c < 4; ++c)
+    {
+        endpoints[0][c] = ReadBits(block, offset, 7) << 1;
+        endpoints[1][c] = ReadBits(block, offset, 7) << 1;
+    }
+    uint32_t pBit0 = ReadBits(block, offset, 1);
+    uint32_t pBit1 = ReadBits(block, offset, 1);
+    for (int c = 0; c < 4; ++c)
+    {
+        endpoints[0][c] |= pBit0;
+        endpoints[1][c] |= pBit1;
+    }
+    for (int i = 0; i < 16; ++i)
+    {
+        uint32_t index = ReadBits(block, offset, (i == 0) ? 3 : 4);
+        for (int c = 0; c < 4; ++c)
+            texels[i * 4 + c] = static_cast<uint8_t>(((64 - Bc7Weights[index]) * endpoints[0][c] + Bc7Weights[index] * endpoints[1][c] + 32) >> 6);
+    }
+}
+
+void efgDecompressBlock(EFG_BC_FORMAT format, const uint8_t* block, uint8_t texels[64])
+{
+    switch (format)
+    {
+    case efgBC_1:
+        DecompressColorBlock(block, false, texels);
+        break;
+    case efgBC_3:
+        DecompressColorBlock(block + 8, true, texels);
+        DecompressChannelBlock(block, 3, texels);
+        break;
+    case efgBC_5:
+        memset(texels, 0, 64);
+        DecompressChannelBlock(block, 0, texels);
+        DecompressChannelBlock(block + 8, 1, texels);
+        break;
+    case efgBC_7:
+        DecompressBc7Block(block, texels);
+        break;
+    }
+}
+
+static void GatherBlock(const EfgImage& image, uint32_t blockX, uint32_t blockY, uint8_t texels[64])
+{
+    for (uint32_t y = 0; y < 4; ++y)
+    {
+        uint32_t sourceY = (blockY * 4 + y < image.height) ? blockY * 4 + y : image.height - 1;
+        for (uint32_t x = 0; x < 4; ++x)
+        {
+            uint32_t sourceX = (blockX * 4 + x < image.width) ? blockX * 4 + x : image.width - 1;
+            memcpy(&texels[(y * 4 + x) * 4], &image.pixels[(size_t(sourceY) * image.width + sourceX) * 4], 4);
+        }
+    }
+}
+
+void efgCompressImage(EFG_BC_FORMAT format, const EfgImage& image, uint8_t* destination, EfgThreadPool& pool)
+{
+    uint32_t blocksX = (image.width + 3) / 4;
+    uint32_t blocksY = (image.height + 3) / 4;
+    uint32_t blockBytes = efgGetBlockBytes(format);
+    auto compressRows = [&](uint32_t firstRow, uint32_t endRow) {
+        uint8_t texels[64];
+        for (uint32_t blockY = firstRow; blockY < endRow; ++blockY)
+        {
+            for (uint32_t blockX = 0; blockX < blocksX; ++blockX)
+            {
+                GatherBlock(image, blockX, blockY, texels);
+                efgCompressBlock(format, texels, destination + (size_t(blockY) * blocksX + blockX) * blockBytes);
+            }
+        }
+    };
+
+    // A few tasks per worker, so rows of cheap flat blocks don't leave workers idle.
+    uint32_t taskCount = (pool.GetThreadCount() > 0) ? pool.GetThreadCount() * 4 : 1;
+    uint32_t rowsPerTask = (blocksY + taskCount - 1) / taskCount;
+    std::vector<std::future<void>> tasks;
+    for (uint32_t row = 0; row < blocksY; row += rowsPerTask)
+    {
+        uint32_t endRow = (row + rowsPerTask < blocksY) ? row + rowsPerTask : blocksY;
+        tasks.push_back(pool.Submit([&compressRows, row, endRow]() { compressRows(row, endRow); }));
+    }
+    for (std::future<void>& task : tasks)
+        task.get();
+}
+
+double efgMeasurePsnr(EFG_BC_FORMAT format, const EfgImage& image, const uint8_t* compressed)
+{
+    int channels = (format == efgBC_1) ? 3 : ((format == efgBC_5) ? 2 : 4);
+    uint32_t blocksX = (image.width + 3) / 4;
+    uint32_t blocksY = (image.height + 3) / 4;
+    double squaredError = 0.0;
+    uint8_t texels[64];
+    for (uint32_t blockY = 0; blockY < blocksY; ++blockY)
+    {
+        for (uint32_t blockX = 0; blockX < blocksX; ++blockX)
+        {
+            efgDecompressBlock(format, compressed + (size_t(blockY) * blocksX + blockX) * efgGetBlockBytes(format), texels);
+            for (uint32_t y = 0; y < 4 && blockY * 4 + y < image.height; ++y)
+            {
+                for (uint32_t x = 0; x < 4 && blockX * 4 + x < image.width; ++x)
+                {
+                    const uint8_t* source = &image.pixels[(size_t(blockY * 4 + y) * image.width + blockX * 4 + x) * 4];
+                    for (int c = 0; c < channels; ++c)
+                    {
+                        double difference = double(source[c]) - texels[(y * 4 + x) * 4 + c];
+                        squaredError += difference * difference;
+                    }
+                }
+            }
+        }
+    }
+    double meanSquaredError = squaredError / (double(image.width) * image.height * channels);
+    if (meanSquaredError == 0.0)
+        return 99.0;
+    return 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+}
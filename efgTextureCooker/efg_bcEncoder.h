@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Block compression for the texture cooker. Plain CPU code without D3D or Windows
+// headers, so the cooker also builds on Linux.
+
+class EfgThreadPool;
+
+enum EFG_BC_FORMAT
+{
+    efgBC_1, // RGB, 4 bits per texel
+    efgBC_3, // RGBA, 8 bits per texel
+    efgBC_5, // Two channels like normal map XY, 8 bits per texel
+    efgBC_7  // RGBA, 8 bits per texel, keeps gradients and alpha best
+};
+
+// Tightly packed RGBA8 rows.
+struct EfgImage
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> pixels;
+};
+
+uint32_t efgGetBlockBytes(EFG_BC_FORMAT format);
+// The DXGI_FORMAT written to the DDS header.
+uint32_t efgGetDxgiFormat(EFG_BC_FORMAT format, bool srgb);
+size_t efgGetCompressedSize(EFG_BC_FORMAT format, uint32_t width, uint32_t height);
+
+// Appends box filtered levels to mips[0] down to 1x1. sRGB colors are averaged in linear space.
+void efgGenerateMips(std::vector<EfgImage>& mips, bool srgb);
+
+// texels are a 4x4 block of RGBA8, row major.
+void efgCompressBlock(EFG_BC_FORMAT format, const uint8_t texels[64], uint8_t* block);
+// Only decodes what efgCompressBlock writes, BC7 blocks must be mode 6.
+void efgDecompressBlock(EFG_BC_FORMAT format, const uint8_t* block, uint8_t texels[64]);
+
+// Rows of blocks are spread over the pool. Blocks past the edge repeat the last row and column.
+void efgCompressImage(EFG_BC_FORMAT format, const EfgImage& image, uint8_t* destination, EfgThreadPool& pool);
+// Peak signal to noise ratio of the compressed image against the source, over the channels the format keeps.
+double efgMeasurePsnr(EFG_BC_FORMAT format, const EfgImage& image, const uint8_t* compressed);
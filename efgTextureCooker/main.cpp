@@ -0,0 +1,345 @@
+// Cooks source images into block compressed DDS textures with full mip chains, so
+// the runtime uploads them as they are instead of decoding and compressing on load.
+//
+// efgTextureCooker <input> <output.dds> [--format bc1|bc3|bc5|bc7] [--srgb] [--no-mips]
+// efgTextureCooker --cube <+x> <-x> <+y> <-y> <+z> <-z> <output.dds> [options]
+//
+// TGA and binary PPM inputs are read everywhere, other formats go through WIC on Windows.
+// Outside Visual Studio:
+//   g++ -std=c++17 -O2 -I../efg main.cpp efg_bcEncoder.cpp ../efg/efg_threadPool.cpp -pthread -o efgTextureCooker
+
+#include "efg_bcEncoder.h"
+#include "efg_threadPool.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#include <wincodec.h>
+#include <wrl.h>
+using Microsoft::WRL::ComPtr;
+#endif
+
+namespace fs = std::filesystem;
+
+static bool ReadFile(const fs::path& path, std::vector<uint8_t>& data)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+// Uncompressed and RLE true color or grayscale TGA.
+static bool ReadTga(const std::vector<uint8_t>& data, EfgImage& image)
+{
+    if (data.size() < 18)
+        return false;
+    uint8_t idLength = data[0];
+    uint8_t imageType = data[2];
+    image.width = data[12] | (data[13] << 8);
+    image.height = data[14] | (data[15] << 8);
+    uint32_t bytesPerPixel = data[16] / 8;
+    bool topDown = (data[17] & 0x20) != 0;
+    bool rle = imageType == 10 || imageType == 11;
+    bool gray = imageType == 3 || imageType == 11;
+    if (data[1] != 0 || (imageType != 2 && imageType != 3 && imageType != 10 && imageType != 11))
+        return false;
+    if (gray ? bytesPerPixel != 1 : (bytesPerPixel != 3 && bytesPerPixel != 4))
+        return false;
+    if (image.width == 0 || image.height == 0)
+        return false;
+
+    size_t pixelCount = size_t(image.width) * image.height;
+    image.pixels.resize(pixelCount * 4);
+    size_t offset = 18 + idLength;
+    size_t pixel = 0;
+    auto readPixel = [&](uint8_t* destination) {
+        if (offset + bytesPerPixel > data.size())
+            return false;
+        const uint8_t* source = &data[offset];
+        offset += bytesPerPixel;
+        if (gray)
+        {
+            destination[0] = destination[1] = destination[2] = source[0];
+            destination[3] = 255;
+        }
+        else
+        {
+            // TGA stores BGR(A).
+            destination[0] = source[2];
+            destination[1] = source[1];
+            destination[2] = source[0];
+            destination[3] = (bytesPerPixel == 4) ? source[3] : 255;
+        }
+        return true;
+    };
+    while (pixel < pixelCount)
+    {
+        size_t run = 1;
+        bool repeat = false;
+        if (rle)
+        {
+            if (offset >= data.size())
+                return false;
+            uint8_t packet = data[offset++];
+            run = (packet & 0x7F) + 1;
+            repeat = (packet & 0x80) != 0;
+        }
+        if (pixel + run > pixelCount)
+            return false;
+        for (size_t i = 0; i < run; ++i, ++pixel)
+        {
+            uint8_t* destination = &image.pixels[pixel * 4];
+            if (repeat && i > 0)
+                memcpy(destination, destination - 4, 4);
+            else if (!readPixel(destination))
+                return false;
+        }
+    }
+
+    if (!topDown)
+    {
+        size_t rowBytes = size_t(image.width) * 4;
+        for (uint32_t y = 0; y < image.height / 2; ++y)
+            std::swap_ranges(&image.pixels[y * rowBytes], &image.pixels[(y + 1) * rowBytes], &image.pixels[(image.height - 1 - y) * rowBytes]);
+    }
+    return true;
+}
+
+// Binary PPM with 8-bit channels.
+static bool ReadPpm(const std::vector<uint8_t>& data, EfgImage& image)
+{
+    size_t offset = 2;
+    auto readNumber = [&](uint32_t& value) {
+        while (offset < data.size() && (isspace(data[offset]) || data[offset] == '#'))
+        {
+            if (data[offset] == '#')
+            {
+                while (offset < data.size() && data[offset] != '\n')
+                    offset++;
+            }
+            else
+            {
+                offset++;
+            }
+        }
+        if (offset >= data.size() || !isdigit(data[offset]))
+            return false;
+        value = 0;
+        while (offset < data.size() && isdigit(data[offset]))
+            value = value * 10 + (data[offset++] - '0');
+        return true;
+    };
+    uint32_t maxValue = 0;
+    if (data.size() < 2 || data[0] != 'P' || data[1] != '6')
+        return false;
+    if (!readNumber(image.width) || !readNumber(image.height) || !readNumber(maxValue) || maxValue != 255)
+        return false;
+    offset++;
+    size_t pixelCount = size_t(image.width) * image.height;
+    if (pixelCount == 0 || offset + pixelCount * 3 > data.size())
+        return false;
+    image.pixels.resize(pixelCount * 4);
+    for (size_t i = 0; i < pixelCount; ++i)
+    {
+        memcpy(&image.pixels[i * 4], &data[offset + i * 3], 3);
+        image.pixels[i * 4 + 3] = 255;
+    }
+    return true;
+}
+
+#ifdef _WIN32
+static bool ReadWic(const fs::path& path, EfgImage& image)
+{
+    ComPtr<IWICImagingFactory> factory;
+    ComPtr<IWICBitmapDecoder> decoder;
+    ComPtr<IWICBitmapFrameDecode> frame;
+    ComPtr<IWICBitmapSource> converted;
+    if (FAILED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory))))
+        return false;
+    if (FAILED(factory->CreateDecoderFromFilename(path.c_str(), nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder)))
+        return false;
+    if (FAILED(decoder->GetFrame(0, &frame)))
+        return false;
+    if (FAILED(WICConvertBitmapSource(GUID_WICPixelFormat32bppRGBA, frame.Get(), &converted)))
+        return false;
+    UINT width = 0;
+    UINT height = 0;
+    converted->GetSize(&width, &height);
+    image.width = width;
+    image.height = height;
+    image.pixels.resize(size_t(width) * height * 4);
+    return SUCCEEDED(converted->CopyPixels(nullptr, width * 4, static_cast<UINT>(image.pixels.size()), image.pixels.data()));
+}
+#endif
+
+static bool ReadImage(const fs::path& path, EfgImage& image)
+{
+    std::string extension = path.extension().string();
+    for (char& c : extension)
+        c = static_cast<char>(tolower(c));
+    if (extension == ".tga" || extension == ".ppm")
+    {
+        std::vector<uint8_t> data;
+        if (!ReadFile(path, data))
+            return false;
+        return (extension == ".tga") ? ReadTga(data, image) : ReadPpm(data, image);
+    }
+#ifdef _WIN32
+    return ReadWic(path, image);
+#else
+    return false;
+#endif
+}
+
+// Faces, each holding its whole mip chain, as D3D12 expects subresources in a DDS.
+static bool WriteDds(const fs::path& path, uint32_t width, uint32_t height, uint32_t mipCount, bool cube,
+    uint32_t dxgiFormat, const std::vector<uint8_t>& data, size_t topMipSize)
+{
+    uint32_t header[32] = {};
+    header[0] = 0x20534444;                          // "DDS "
+    header[1] = 124;                                 // dwSize
+    header[2] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000; // CAPS, HEIGHT, WIDTH, PIXELFORMAT, MIPMAPCOUNT, LINEARSIZE
+    header[3] = height;
+    header[4] = width;
+    header[5] = static_cast<uint32_t>(topMipSize);
+    header[7] = mipCount;
+    header[19] = 32;                                 // ddspf.dwSize
+    header[20] = 0x4;                                // DDPF_FOURCC
+    header[21] = 0x30315844;                         // "DX10"
+    header[27] = 0x1000;                             // DDSCAPS_TEXTURE
+    if (mipCount > 1 || cube)
+        header[27] |= 0x8 | ((mipCount > 1) ? 0x400000 : 0); // COMPLEX, MIPMAP
+    if (cube)
+        header[28] = 0xFE00;                         // CUBEMAP and all six faces
+    uint32_t dx10[5] = {};
+    dx10[0] = dxgiFormat;
+    dx10[1] = 3;                                     // D3D10_RESOURCE_DIMENSION_TEXTURE2D
+    dx10[2] = cube ? 0x4 : 0;                        // D3D10_RESOURCE_MISC_TEXTURECUBE
+    dx10[3] = 1;                                     // arraySize, in cubes for a cube map
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(dx10), sizeof(dx10));
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    return static_cast<bool>(file);
+}
+
+static bool ParseFormat(const std::string& name, EFG_BC_FORMAT& format)
+{
+    static const struct { const char* name; EFG_BC_FORMAT format; } formats[] = {
+        { "bc1", efgBC_1 }, { "bc3", efgBC_3 }, { "bc5", efgBC_5 }, { "bc7", efgBC_7 } };
+    for (const auto& entry : formats)
+    {
+        if (name == entry.name)
+        {
+            format = entry.format;
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<fs::path> inputs;
+    EFG_BC_FORMAT format = efgBC_7;
+    bool srgb = false;
+    bool mips = true;
+    bool cube = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        if (argument == "--format" && i + 1 < argc)
+        {
+            if (!ParseFormat(argv[++i], format))
+            {
+                std::cerr << "Error: unknown format " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (argument == "--srgb")
+            srgb = true;
+        else if (argument == "--no-mips")
+            mips = false;
+        else if (argument == "--cube")
+            cube = true;
+        else
+            inputs.push_back(argument);
+    }
+    if (inputs.size() != (cube ? 7u : 2u))
+    {
+        std::cerr << "Usage: efgTextureCooker <input> <output.dds> [--format bc1|bc3|bc5|bc7] [--srgb] [--no-mips]" << std::endl;
+        std::cerr << "       efgTextureCooker --cube <+x> <-x> <+y> <-y> <+z> <-z> <output.dds> [options]" << std::endl;
+        return 1;
+    }
+    fs::path outputPath = inputs.back();
+    inputs.pop_back();
+
+#ifdef _WIN32
+    CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+#endif
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<EfgImage> faces(inputs.size());
+    for (size_t i = 0; i < inputs.size(); ++i)
+    {
+        if (!ReadImage(inputs[i], faces[i]))
+        {
+            std::cerr << "Error: failed to read " << inputs[i].u8string() << std::endl;
+            return 1;
+        }
+        if (faces[i].width != faces[0].width || faces[i].height != faces[0].height || (cube && faces[i].width != faces[i].height))
+        {
+            std::cerr << "Error: cube faces must be square and the same size, " << inputs[i].u8string() << " is not" << std::endl;
+            return 1;
+        }
+    }
+
+    EfgThreadPool pool;
+    pool.Initialize(std::thread::hardware_concurrency());
+    std::vector<uint8_t> data;
+    size_t uncompressedSize = 0;
+    double psnr = 0.0;
+    uint32_t mipCount = 0;
+    for (EfgImage& face : faces)
+    {
+        std::vector<EfgImage> chain;
+        chain.push_back(std::move(face));
+        if (mips)
+            efgGenerateMips(chain, srgb);
+        mipCount = static_cast<uint32_t>(chain.size());
+        for (const EfgImage& mip : chain)
+        {
+            size_t offset = data.size();
+            data.resize(offset + efgGetCompressedSize(format, mip.width, mip.height));
+            efgCompressImage(format, mip, data.data() + offset, pool);
+            uncompressedSize += mip.pixels.size();
+            if (&mip == &chain.front())
+                psnr += efgMeasurePsnr(format, mip, data.data() + offset) / faces.size();
+        }
+        face = std::move(chain.front());
+    }
+    pool.Destroy();
+
+    if (!WriteDds(outputPath, faces[0].width, faces[0].height, mipCount, cube, efgGetDxgiFormat(format, srgb), data,
+        efgGetCompressedSize(format, faces[0].width, faces[0].height)))
+    {
+        std::cerr << "Error: failed to write " << outputPath.u8string() << std::endl;
+        return 1;
+    }
+    float elapsedMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    std::cout << outputPath.u8string() << ": " << faces[0].width << "x" << faces[0].height << ", " << mipCount << " mips, "
+        << data.size() / 1024 << " KB vs " << uncompressedSize / 1024 << " KB RGBA8 (" << double(uncompressedSize) / data.size()
+        << "x), PSNR " << psnr << " dB, " << elapsedMs << " ms" << std::endl;
+    return 0;
+}